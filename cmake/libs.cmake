@@ -1,15 +1,19 @@
 set(ZHETAPI_SOURCE
+	source/communicator.cpp
 	source/complex.cpp
 	source/display.cpp
 	source/engine.cpp
 	source/equation.cpp
 	source/function.cpp
+	source/idx.cpp
 	source/image.cpp
 	source/linalg.cpp
+	source/model_file.cpp
 	source/module.cpp
 	source/operand.cpp
 	source/plot.cpp
 	source/polynomial.cpp
+	source/profiler.cpp
 	source/registration.cpp
 	source/timer.cpp
 	source/token.cpp
@@ -2,15 +2,24 @@
 add_executable(port
 	testing/port/port-activation.cpp
 	testing/port/port-calculus.cpp
+	testing/port/port-conv.cpp
+	testing/port/port-dnn.cpp
+	testing/port/port-fixed.cpp
 	testing/port/port-fourier.cpp
 	testing/port/port-function.cpp
+	testing/port/port-idx.cpp
 	testing/port/port-interval.cpp
 	testing/port/port-linalg.cpp
 	testing/port/port-matrix.cpp
+	testing/port/port-memory.cpp
+	testing/port/port-model-file.cpp
 	testing/port/port-module.cpp
 	testing/port/port-node.cpp
+	testing/port/port-parallel.cpp
 	testing/port/port-parsing.cpp
 	testing/port/port-polynomial.cpp
+	testing/port/port-quantized.cpp
+	testing/port/port-sparse.cpp
 	testing/port/port-special.cpp
 	testing/port/port-tensor.cpp
 	testing/port/port-vector.cpp
@@ -19,6 +19,8 @@
 
 #include "vector.hpp"
 
+#include "core/simd.hpp"
+
 #endif
 
 #include "cuda/essentials.cuh"
@@ -57,7 +59,9 @@ public:
 		AT_Default,
 		AT_Linear,
 		AT_ReLU,
-		AT_Sigmoid
+		AT_Sigmoid,
+		AT_Softmax,
+		AT_Tanh
 	};
 
 	__cuda_dual__
@@ -76,6 +80,9 @@ public:
 		Activation(activation_type, const std::vector <T> &)	// Type and argument constructor
 	);
 
+	__cuda_dual__
+	virtual ~Activation() {}
+
 	virtual Activation *copy() const;
 	
 	// Computation
@@ -97,6 +104,10 @@ public:
 
 #ifndef __AVR	// Does not support AVR
 
+	// Batched computation, with one input per row
+	virtual Matrix <T> batch_compute(const Matrix <T> &) const;
+	virtual void batch_compute(const Matrix <T> &, Matrix <T> &) const;
+
 	// Saving
 	void write_type(std::ofstream &) const;
 	void write_args(std::ofstream &) const;
@@ -105,7 +116,9 @@ public:
 
 	// Loading
 	static Activation <T> *load(std::ifstream &);
+	static Activation <T> *load(const unsigned char *, size_t);
 	static Activation <T> *load(const std::string &, const std::vector <T> &);
+	static Activation <T> *load_id(const std::string &, const std::vector <T> &);
 
 	// Global list of all registered activations
 	static std::map <std::string, Loader <T>> _act_loaders_id;
@@ -113,6 +126,7 @@ public:
 
 	// Exceptions
 	class undefined_loader {};
+	class bad_record {};
 #endif		// Does not support AVR
 
 protected:
@@ -189,6 +203,96 @@ Vector <T> Activation <T> ::compute(const Vector <T> &x) const
 
 #ifndef __AVR	// Does not support AVR
 
+/**
+ * @brief Applies the activation to each row of a matrix. The default
+ * implementation calls compute on each row, so activations which mix the
+ * components of their input (such as softmax) are evaluated per sample.
+ */
+template <class T>
+Matrix <T> Activation <T> ::batch_compute(const Matrix <T> &X) const
+{
+	Matrix <T> out;
+
+	batch_compute(X, out);
+
+	return out;
+}
+
+/**
+ * @brief Same as batch_compute(X), with the result written to out, which is
+ * only reallocated if its dimensions are not already those of X. The input
+ * and the output may be the same matrix.
+ *
+ * Activations which override this method do not allocate.
+ */
+template <class T>
+void Activation <T> ::batch_compute(const Matrix <T> &X, Matrix <T> &out) const
+{
+	size_t rs = X.get_rows();
+	size_t cs = X.get_cols();
+
+	out.resize(rs, cs);
+	for (size_t i = 0; i < rs; i++) {
+		// Slice of the row (not copied)
+		Vector <T> row(cs, const_cast <T *> (X[i]));
+		Vector <T> y = compute(row);
+
+		T *dst = out[i];
+		for (size_t j = 0; j < cs; j++)
+			dst[j] = y[j];
+	}
+}
+
+/**
+ * @brief Writes f(x) for each component x of X into out, for elementwise
+ * activations (and their derivatives). X and out may be the same matrix.
+ */
+template <class T, class F>
+void batch_map(const Matrix <T> &X, Matrix <T> &out, const F &f)
+{
+	out.resize(X.get_rows(), X.get_cols());
+
+	size_t n = X.get_rows() * X.get_cols();
+
+	const T *src = X[0];
+	T *dst = out[0];
+
+	parallel::for_range(n,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				dst[i] = f(src[i]);
+		}
+	);
+}
+
+/**
+ * @brief Same as batch_map, with f applied to packs of components (see
+ * core/simd.hpp), for activations which can be vectorized: f is a generic
+ * lambda which takes and returns a pack.
+ */
+template <class T, class F>
+void batch_simd_map(const Matrix <T> &X, Matrix <T> &out, const F &f)
+{
+	out.resize(X.get_rows(), X.get_cols());
+
+	size_t n = X.get_rows() * X.get_cols();
+
+	const T *src = X[0];
+	T *dst = out[0];
+
+	parallel::for_range(n,
+		[&](size_t start, size_t end) {
+			simd::for_each <T> (end - start,
+				[&](auto p, size_t i) {
+					using P = decltype(p);
+
+					f(P::load(src + start + i)).store(dst + start + i);
+				}
+			);
+		}
+	);
+}
+
 // Saving
 template <class T>
 void Activation <T> ::write_type(std::ofstream &fout) const
@@ -219,14 +323,27 @@ void Activation <T> ::write(std::ofstream &fout) const
 	write_args(fout);
 }
 
-// Loading
+// Loading (throws bad_record if the lengths in the record go past the end of
+// the stream)
 template <class T>
 Activation <T> *Activation <T> ::load(std::ifstream &fin)
 {
+	std::streampos pos = fin.tellg();
+
+	fin.seekg(0, std::ios::end);
+	std::streamoff left = fin.tellg() - pos;
+	fin.seekg(pos);
+
 	size_t len;
 
 	fin.read((char *) &len, sizeof(size_t));
 
+	if (!fin || left < std::streamoff(2 * sizeof(size_t))
+			|| len > size_t(left) - 2 * sizeof(size_t))
+		throw bad_record();
+
+	left -= sizeof(size_t) + len;
+
 	char *aname = new char[len + 1];
 
 	fin.read(aname, sizeof(char) * (len));
@@ -239,6 +356,14 @@ Activation <T> *Activation <T> ::load(std::ifstream &fin)
 	
 	fin.read((char *) &argc, sizeof(size_t));
 
+	left -= sizeof(size_t);
+
+	if (!fin || argc > size_t(left)/sizeof(T)) {
+		delete[] aname;
+
+		throw bad_record();
+	}
+
 	std::vector <T> args;
 	for (size_t i = 0; i < argc; i++) {
 		T t;
@@ -246,14 +371,56 @@ Activation <T> *Activation <T> ::load(std::ifstream &fin)
 		args.push_back(t);
 	}
 
-	if (_act_loaders_id.find(name) == _act_loaders_id.end())
-		throw undefined_loader();
+	delete[] aname;
 
-	Loader <T> loader = _act_loaders_id[name];
+	return load_id(name, args);
+}
 
-	delete[] aname;
+// Loads a record of the given size written by write from memory (possibly
+// unaligned), throwing bad_record if its contents do not fit in it
+template <class T>
+Activation <T> *Activation <T> ::load(const unsigned char *record, size_t size)
+{
+	size_t len;
 
-	return loader(args);
+	if (size < sizeof(size_t))
+		throw bad_record();
+
+	memcpy(&len, record, sizeof(size_t));
+	record += sizeof(size_t);
+	size -= sizeof(size_t);
+
+	if (len > size || size - len < sizeof(size_t))
+		throw bad_record();
+
+	std::string name((const char *) record, len);
+	record += len;
+	size -= len;
+
+	size_t argc;
+
+	memcpy(&argc, record, sizeof(size_t));
+	record += sizeof(size_t);
+	size -= sizeof(size_t);
+
+	if (argc > size/sizeof(T))
+		throw bad_record();
+
+	std::vector <T> args(argc);
+	for (size_t i = 0; i < argc; i++)
+		memcpy(&args[i], record + i * sizeof(T), sizeof(T));
+
+	return load_id(name, args);
+}
+
+// Loads an activation from the name of its type (as written by write_type)
+template <class T>
+Activation <T> *Activation <T> ::load_id(const std::string &name, const std::vector <T> &args)
+{
+	if (_act_loaders_id.find(name) == _act_loaders_id.end())
+		throw undefined_loader();
+
+	return _act_loaders_id[name](args);
 }
 
 template <class T>
@@ -0,0 +1,143 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+// C/C++ headers
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// Engine headers
+#include "dataset.hpp"
+#include "dnn.hpp"
+#include "erf.hpp"
+#include "profiler.hpp"
+#include "workspace.hpp"
+
+#include "core/parallel.hpp"
+
+/**
+ * @file checkpoint.hpp
+ * @brief Tools to choose the checkpoint interval of a network (see
+ * DNN::set_checkpoint_interval) and the size of its batches for a memory
+ * budget.
+ */
+
+namespace zhetapi {
+
+namespace ml {
+
+/**
+ * @return the largest batch whose workspace buffers fit in the given number of
+ * bytes (0 if none does), with the current checkpoint interval of the
+ * workspace.
+ */
+template <class T>
+size_t largest_batch(const Workspace <T> &ws, size_t budget)
+{
+	if (ws.bytes(1) > budget)
+		return 0;
+
+	// The size grows with the batch
+	size_t lo = 1;
+	size_t hi = 2;
+	while (ws.bytes(hi) <= budget) {
+		lo = hi;
+		hi *= 2;
+	}
+
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo)/2;
+
+		if (ws.bytes(mid) <= budget)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+// Memory and time of the gradients of a batch, for a checkpoint interval
+struct CheckpointCost {
+	size_t	interval	= 0;
+	size_t	bytes		= 0;	// Buffers of the workspace
+	double	time		= 0;	// Microseconds per gradient
+	double	recomputed	= 0;	// Share of the forward products done twice
+};
+
+/**
+ * @brief Measures the memory and the time of the gradient of a batch for each
+ * of the given checkpoint intervals, to choose the interval (and the batch
+ * size, see largest_batch) for a memory budget. The network is not
+ * modified.
+ *
+ * @param dnn the network.
+ * @param ins the inputs of the batch.
+ * @param outs the targets of the batch.
+ * @param cost the cost function.
+ * @param intervals the intervals to measure (0 or 1 keeps every activation).
+ * @param steps the number of gradients which are timed for each interval.
+ * @param pool the pool which computes the chunks of the batch, if any.
+ */
+template <class T>
+std::vector <CheckpointCost> checkpoint_report(
+		DNN <T> &dnn,
+		const DataSet <T> &ins,
+		const DataSet <T> &outs,
+		Erf <T> *cost,
+		const std::vector <size_t> &intervals,
+		size_t steps = 5,
+		ThreadPool *pool = nullptr)
+{
+	Layer <T> *layers = dnn.layers();
+
+	double products = 0;
+	for (size_t i = 0; i < dnn.size(); i++)
+		products += layers[i].mat().size();
+
+	std::vector <CheckpointCost> report;
+	for (size_t interval : intervals) {
+		Workspace <T> ws(dnn, 0, pool ? pool->size() : 1);
+
+		ws.set_checkpoint_interval(interval);
+		ws.load(ins, outs);
+
+		CheckpointCost c;
+
+		c.interval = interval;
+		c.bytes = ws.bytes();
+
+		// Every segment but the last one is recomputed
+		size_t k = (interval > 1 && interval < dnn.size()) ? interval : 0;
+		if (k) {
+			size_t last = ((dnn.size() - 1)/k) * k;
+
+			double again = 0;
+			for (size_t i = 0; i < last; i++)
+				again += layers[i].mat().size();
+
+			c.recomputed = again/products;
+		}
+
+		// The first gradient sizes the derivative of the cost
+		workspace_gradient(layers, ws, cost, pool);
+
+		Profiler::clock::time_point start = Profiler::clock::now();
+
+		for (size_t i = 0; i < steps; i++)
+			workspace_gradient(layers, ws, cost, pool);
+
+		c.time = std::chrono::duration <double, std::micro>
+			(Profiler::clock::now() - start).count()/std::max(steps, (size_t) 1);
+
+		report.push_back(c);
+	}
+
+	return report;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef COMMUNICATOR_H_
+#define COMMUNICATOR_H_
+
+#ifndef __AVR	// Does not support AVR
+
+// C/C++ headers
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace zhetapi {
+
+namespace ml {
+
+/**
+ * @brief An anonymous mapping shared with the processes forked after its
+ * creation (the mapping is inherited, so every process sees the same memory).
+ */
+class SharedRegion {
+	void *	_data	= nullptr;
+	size_t	_size	= 0;
+public:
+	explicit SharedRegion(size_t);
+
+	SharedRegion(const SharedRegion &) = delete;
+	SharedRegion &operator=(const SharedRegion &) = delete;
+
+	~SharedRegion();
+
+	void *data() const;
+	size_t size() const;
+
+	// Exceptions
+	class bad_map {};
+};
+
+/**
+ * @brief A barrier between processes, placed in shared memory. It can be
+ * aborted by any of its parties (for example when one of them fails), which
+ * makes every current and future wait throw instead of blocking forever.
+ */
+class SharedBarrier {
+	std::atomic <uint32_t>	_count;
+	std::atomic <uint32_t>	_generation;
+	std::atomic <uint32_t>	_aborted;
+
+	uint32_t		_parties;
+public:
+	explicit SharedBarrier(size_t);
+
+	void wait();
+	void abort();
+
+	bool aborted() const;
+
+	// Exceptions
+	class aborted_error {};
+};
+
+/**
+ * @brief Collective operations between the replicas of a data parallel
+ * training (see train_data_parallel), each identified by its rank.
+ */
+template <class T>
+class Communicator {
+protected:
+	size_t	_rank	= 0;
+	size_t	_size	= 1;
+public:
+	Communicator(size_t rank, size_t size) : _rank(rank), _size(size) {}
+
+	virtual ~Communicator() {}
+
+	size_t rank() const {
+		return _rank;
+	}
+
+	size_t size() const {
+		return _size;
+	}
+
+	// Replaces the n components of data with their sum over every rank,
+	// identical on every rank
+	virtual void all_reduce(T *, size_t) = 0;
+
+	// Exceptions
+	class bad_size {};
+};
+
+// Bounds of the segment i of n components split into k segments
+inline size_t segment_start(size_t n, size_t k, size_t i)
+{
+	return (n * i)/k;
+}
+
+/**
+ * @brief All-reduce through shared memory: every rank copies its data into its
+ * own slot, then sums one segment of the slots (a reduce-scatter, in which
+ * each segment is summed in rank order) into a shared result, which every
+ * rank copies back (an all-gather). Since each rank can read every slot, the
+ * steps of a ring all-reduce are done in a single pass.
+ *
+ * The region is laid out by initialize, before the processes are forked.
+ */
+template <class T>
+class SharedMemoryCommunicator : public Communicator <T> {
+	SharedBarrier *	_barrier	= nullptr;
+
+	T *		_slots		= nullptr;	// size + 1 slots (the last one is the result)
+	size_t		_capacity	= 0;
+public:
+	SharedMemoryCommunicator(SharedRegion &, size_t, size_t, size_t);
+
+	void all_reduce(T *, size_t) override;
+
+	static size_t bytes(size_t, size_t);
+	static void initialize(SharedRegion &, size_t);
+};
+
+/**
+ * @brief Ring all-reduce over connected stream sockets: rank r sends to rank
+ * r + 1 and receives from rank r - 1 (modulo the size). The data is split
+ * into one segment per rank; each segment is summed as it goes around the
+ * ring once (reduce-scatter), then the sums go around the ring once more
+ * (all-gather), so every rank ends up with the same values.
+ *
+ * The sockets are usually created by local_ring, but any pair of connected
+ * stream sockets works (which is how this extends to several hosts).
+ */
+template <class T>
+class SocketCommunicator : public Communicator <T> {
+	int		_next	= -1;
+	int		_prev	= -1;
+
+	std::vector <T>	_buffer;
+public:
+	SocketCommunicator(size_t, size_t, int, int);
+
+	SocketCommunicator(const SocketCommunicator &) = delete;
+	SocketCommunicator &operator=(const SocketCommunicator &) = delete;
+
+	~SocketCommunicator();
+
+	void all_reduce(T *, size_t) override;
+};
+
+// Ring of local sockets: rank r writes to next[r] and reads from prev[r]
+void local_ring(size_t, std::vector <int> &, std::vector <int> &);
+
+// Sends and receives simultaneously (so that a ring does not deadlock)
+void exchange(int, const void *, size_t, int, void *, size_t);
+
+void close_socket(int);
+
+// Exception of the socket functions
+class socket_error {};
+
+// Shared memory communicator
+template <class T>
+SharedMemoryCommunicator <T> ::SharedMemoryCommunicator(SharedRegion &region,
+		size_t rank, size_t size, size_t capacity)
+		: Communicator <T> (rank, size), _capacity(capacity)
+{
+	if (region.size() < bytes(size, capacity))
+		throw typename Communicator <T> ::bad_size();
+
+	char *base = (char *) region.data();
+
+	_barrier = (SharedBarrier *) base;
+	_slots = (T *) (base + bytes(0, 0));
+}
+
+/**
+ * @return the size of the region needed by a group of the given size, for
+ * data of up to capacity components.
+ */
+template <class T>
+size_t SharedMemoryCommunicator <T> ::bytes(size_t size, size_t capacity)
+{
+	// The slots start on a cache line
+	size_t header = ((sizeof(SharedBarrier) + 63)/64) * 64;
+
+	return header + (size + 1) * capacity * sizeof(T);
+}
+
+template <class T>
+void SharedMemoryCommunicator <T> ::initialize(SharedRegion &region, size_t size)
+{
+	new (region.data()) SharedBarrier(size);
+}
+
+template <class T>
+void SharedMemoryCommunicator <T> ::all_reduce(T *data, size_t n)
+{
+	if (n > _capacity)
+		throw typename Communicator <T> ::bad_size();
+
+	size_t rank = this->_rank;
+	size_t size = this->_size;
+
+	T *result = _slots + size * _capacity;
+
+	std::copy(data, data + n, _slots + rank * _capacity);
+
+	_barrier->wait();
+
+	size_t start = segment_start(n, size, rank);
+	size_t end = segment_start(n, size, rank + 1);
+
+	for (size_t j = start; j < end; j++) {
+		T sum = _slots[j];
+		for (size_t r = 1; r < size; r++)
+			sum += _slots[r * _capacity + j];
+
+		result[j] = sum;
+	}
+
+	_barrier->wait();
+
+	std::copy(result, result + n, data);
+
+	// The slots are reused by the next call
+	_barrier->wait();
+}
+
+// Socket communicator
+template <class T>
+SocketCommunicator <T> ::SocketCommunicator(size_t rank, size_t size, int next,
+		int prev) : Communicator <T> (rank, size), _next(next),
+		_prev(prev) {}
+
+template <class T>
+SocketCommunicator <T> ::~SocketCommunicator()
+{
+	close_socket(_next);
+	close_socket(_prev);
+}
+
+template <class T>
+void SocketCommunicator <T> ::all_reduce(T *data, size_t n)
+{
+	size_t size = this->_size;
+	size_t rank = this->_rank;
+
+	if (size < 2)
+		return;
+
+	auto start = [&](size_t i) {
+		return segment_start(n, size, i % size);
+	};
+
+	auto length = [&](size_t i) {
+		return segment_start(n, size, i % size + 1) - start(i);
+	};
+
+	_buffer.resize(n/size + 1);
+
+	// Reduce-scatter: after step s, the segment rank - s - 1 holds the sum
+	// of s + 2 ranks
+	for (size_t s = 0; s < size - 1; s++) {
+		size_t send = rank + size - s;
+		size_t recv = rank + size - s - 1;
+
+		exchange(_next, data + start(send), length(send) * sizeof(T),
+			_prev, _buffer.data(), length(recv) * sizeof(T));
+
+		T *dst = data + start(recv);
+		for (size_t j = 0; j < length(recv); j++)
+			dst[j] += _buffer[j];
+	}
+
+	// All-gather: rank r starts with the sum of the segment r + 1
+	for (size_t s = 0; s < size - 1; s++) {
+		size_t send = rank + 1 + size - s;
+		size_t recv = rank + size - s;
+
+		exchange(_next, data + start(send), length(send) * sizeof(T),
+			_prev, data + start(recv), length(recv) * sizeof(T));
+	}
+}
+
+}
+
+}
+
+#endif		// Does not support AVR
+
+#endif
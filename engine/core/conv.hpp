@@ -0,0 +1,207 @@
+#ifndef CONV_H_
+#define CONV_H_
+
+// C/C++ headers
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Engine headers
+#include "parallel.hpp"
+#include "simd.hpp"
+
+/**
+ * @file conv.hpp
+ * @brief Two dimensional convolutions of interleaved 8-bit images (stored row
+ * after row, with the channels of a pixel next to each other, as in
+ * image::Image) with several filters at once, with a stride and zero padding.
+ *
+ * The convolution is lowered to products: for each output row, channel and
+ * filter row, the input pixels seen by the filter row are gathered into a
+ * panel (im2col), with one row of the panel for each column of the filter.
+ * The product of the filters with the panel is computed as one update of a
+ * whole output row per filter component, with SIMD packs over the output
+ * columns, and the output rows are computed in parallel.
+ *
+ * Each row of a filter is summed in column order before it is added to the
+ * total, in row order, and the packs do not fuse multiplies and adds, so the
+ * results are the same as those of the scalar loops (see conv2d_scalar).
+ */
+
+namespace zhetapi {
+
+namespace blas {
+
+// Geometry of a convolution
+struct ConvShape {
+	size_t	rows		= 0;	// Input
+	size_t	cols		= 0;
+	size_t	channels	= 1;
+
+	size_t	depth		= 1;	// Leading channels which are convolved
+
+	size_t	krows		= 1;	// Filters
+	size_t	kcols		= 1;
+
+	size_t	stride		= 1;
+
+	size_t	pad_rows	= 0;	// Zeros before the first row
+	size_t	pad_cols	= 0;	// Zeros before the first column
+	size_t	pad_rows_after	= 0;	// Zeros after the last row
+	size_t	pad_cols_after	= 0;	// Zeros after the last column
+
+	size_t	orows		= 0;	// Output
+	size_t	ocols		= 0;
+};
+
+/**
+ * @return the size of the output of a convolution along one dimension, with
+ * the given padding before and after the input.
+ */
+inline size_t conv_output(size_t size, size_t k, size_t stride, size_t before,
+		size_t after)
+{
+	if (size + before + after < k || !stride)
+		return 0;
+
+	return (size + before + after - k)/stride + 1;
+}
+
+/**
+ * @brief Reference convolution, one output at a time.
+ *
+ * The output of filter f, at row r, column c and channel ch, is at
+ * out[((f * orows + r) * ocols + c) * depth + ch]. The filters are stored one
+ * after the other, each row after row.
+ */
+template <class T>
+void conv2d_scalar(const ConvShape &s, const unsigned char *in,
+		const T *filters, size_t nfilters, T *out)
+{
+	for (size_t f = 0; f < nfilters; f++) {
+		const T *flt = filters + f * s.krows * s.kcols;
+
+		for (size_t r = 0; r < s.orows; r++) {
+			for (size_t c = 0; c < s.ocols; c++) {
+				for (size_t ch = 0; ch < s.depth; ch++) {
+					T total = 0;
+
+					for (size_t kr = 0; kr < s.krows; kr++) {
+						long ir = long(r * s.stride + kr) - long(s.pad_rows);
+						if (ir < 0 || ir >= long(s.rows))
+							continue;
+
+						T sum = 0;
+						for (size_t kc = 0; kc < s.kcols; kc++) {
+							long ic = long(c * s.stride + kc) - long(s.pad_cols);
+							if (ic < 0 || ic >= long(s.cols))
+								continue;
+
+							sum += flt[kr * s.kcols + kc]
+								* T(in[(ir * s.cols + ic) * s.channels + ch]);
+						}
+
+						total += sum;
+					}
+
+					out[((f * s.orows + r) * s.ocols + c) * s.depth + ch] = total;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @brief Convolution through im2col panels, in parallel over the output rows
+ * (same layout and results as conv2d_scalar), on the given number of threads
+ * (or with the global setting if it is 0).
+ */
+template <class T>
+void conv2d(const ConvShape &s, const unsigned char *in, const T *filters,
+		size_t nfilters, T *out, size_t threads = 0)
+{
+	size_t work = s.orows * s.ocols * s.depth * s.krows * s.kcols * nfilters;
+
+	size_t oc = s.ocols;
+
+	parallel::for_range(s.orows, work,
+		[&](size_t start, size_t end) {
+			// Panel of a filter row, and the sums of each filter
+			std::vector <T> panel(s.kcols * oc);
+			std::vector <T> row(oc);
+			std::vector <T> total(nfilters * oc);
+
+			for (size_t r = start; r < end; r++) {
+				for (size_t ch = 0; ch < s.depth; ch++) {
+					std::fill(total.begin(), total.end(), T(0));
+
+					for (size_t kr = 0; kr < s.krows; kr++) {
+						long ir = long(r * s.stride + kr) - long(s.pad_rows);
+						if (ir < 0 || ir >= long(s.rows))
+							continue;
+
+						const unsigned char *src = in + ir * s.cols * s.channels + ch;
+
+						// Row kc of the panel holds the pixels seen by
+						// column kc of the filter (zero outside)
+						for (size_t kc = 0; kc < s.kcols; kc++) {
+							T *p = &panel[kc * oc];
+
+							for (size_t c = 0; c < oc; c++) {
+								long ic = long(c * s.stride + kc) - long(s.pad_cols);
+
+								p[c] = (ic < 0 || ic >= long(s.cols))
+									? T(0) : T(src[ic * s.channels]);
+							}
+						}
+
+						for (size_t f = 0; f < nfilters; f++) {
+							const T *flt = filters + (f * s.krows + kr) * s.kcols;
+
+							T *rp = row.data();
+							T *tp = &total[f * oc];
+
+							std::fill(row.begin(), row.end(), T(0));
+
+							for (size_t kc = 0; kc < s.kcols; kc++) {
+								const T *p = &panel[kc * oc];
+								T w = flt[kc];
+
+								simd::for_each <T> (oc,
+									[&](auto pk, size_t c) {
+										using P = decltype(pk);
+
+										(P::load(rp + c) + P::set(w)
+											* P::load(p + c)).store(rp + c);
+									}
+								);
+							}
+
+							simd::for_each <T> (oc,
+								[&](auto pk, size_t c) {
+									using P = decltype(pk);
+
+									(P::load(tp + c) + P::load(rp + c)).store(tp + c);
+								}
+							);
+						}
+					}
+
+					for (size_t f = 0; f < nfilters; f++) {
+						T *dst = out + ((f * s.orows + r) * oc) * s.depth + ch;
+
+						const T *tp = &total[f * oc];
+						for (size_t c = 0; c < oc; c++)
+							dst[c * s.depth] = tp[c];
+					}
+				}
+			}
+		}, threads
+	);
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,438 @@
+#ifndef ELIMINATION_H_
+#define ELIMINATION_H_
+
+// C/C++ headers
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Engine headers
+#include "parallel.hpp"
+
+/**
+ * @file elimination.hpp
+ * @brief Gaussian elimination kernels on square, row-major buffers: LU
+ * factorization with partial pivoting and triangular solves for floating point
+ * types, and fraction-free (Bareiss) elimination for exact types such as
+ * integers and rationals. These back the determinant and inverse methods of
+ * Matrix, and the LU factorization in linalg.hpp.
+ */
+
+namespace zhetapi {
+
+namespace linalg {
+
+// Elimination with a pivot chosen by magnitude (floating point types) or as
+// the first nonzero component (all other types)
+template <class T>
+size_t lu_pivot(size_t n, const T *a, size_t k, std::true_type)
+{
+	size_t p = k;
+
+	for (size_t i = k + 1; i < n; i++) {
+		if (std::abs(a[i * n + k]) > std::abs(a[p * n + k]))
+			p = i;
+	}
+
+	return p;
+}
+
+template <class T>
+size_t lu_pivot(size_t n, const T *a, size_t k, std::false_type)
+{
+	for (size_t i = k; i < n; i++) {
+		if (a[i * n + k] != T(0))
+			return i;
+	}
+
+	return k;
+}
+
+template <class T>
+void swap_rows(size_t cols, T *a, size_t i, size_t j)
+{
+	T *ar = a + i * cols;
+	T *br = a + j * cols;
+
+	for (size_t k = 0; k < cols; k++)
+		std::swap(ar[k], br[k]);
+}
+
+/**
+ * @brief Computes the LU factorization PA = LU of an n x n matrix in place,
+ * with partial pivoting. On return, the strict lower triangle of a holds L
+ * (whose diagonal is implicitly 1) and the upper triangle holds U.
+ *
+ * @param n the size of the matrix.
+ * @param a the components of the matrix (row-major).
+ * @param piv filled with the row permutation: row i of PA is row piv[i] of A.
+ *
+ * @return the sign of the permutation, 1 or -1.
+ */
+template <class T>
+int lu_factor(size_t n, T *a, size_t *piv)
+{
+	int sign = 1;
+
+	for (size_t i = 0; i < n; i++)
+		piv[i] = i;
+
+	for (size_t k = 0; k < n; k++) {
+		size_t p = lu_pivot(n, a, k, std::is_floating_point <T> ());
+
+		if (p != k) {
+			swap_rows(n, a, p, k);
+			std::swap(piv[p], piv[k]);
+
+			sign = -sign;
+		}
+
+		T pivot = a[k * n + k];
+
+		// Singular column, nothing to eliminate
+		if (pivot == T(0))
+			continue;
+
+		const T *ak = a + k * n;
+
+		// Rank one update of the trailing submatrix
+		parallel::for_range(n - k - 1, (n - k) * (n - k),
+			[&](size_t start, size_t end) {
+				for (size_t i = k + 1 + start; i < k + 1 + end; i++) {
+					T *ai = a + i * n;
+
+					T l = ai[k] / pivot;
+
+					ai[k] = l;
+					for (size_t j = k + 1; j < n; j++)
+						ai[j] -= l * ak[j];
+				}
+			}
+		);
+	}
+
+	return sign;
+}
+
+/**
+ * @brief Solves AX = B for X given the factorization computed by lu_factor.
+ *
+ * @param n the size of A.
+ * @param lu the factorization, from lu_factor.
+ * @param piv the permutation, from lu_factor.
+ * @param b the n x m right hand side (row-major), which is overwritten with X.
+ * @param m the number of columns of B.
+ */
+template <class T>
+void lu_solve(size_t n, const T *lu, const size_t *piv, T *b, size_t m)
+{
+	// Apply the permutation
+	std::vector <T> pb(b, b + n * m);
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < m; j++)
+			b[i * m + j] = pb[piv[i] * m + j];
+	}
+
+	// Columns of X are independent
+	parallel::for_range(m, n * n * m,
+		[&](size_t start, size_t end) {
+			// Forward substitution (unit lower triangular)
+			for (size_t i = 1; i < n; i++) {
+				const T *li = lu + i * n;
+				T *bi = b + i * m;
+
+				for (size_t k = 0; k < i; k++) {
+					const T *bk = b + k * m;
+
+					for (size_t j = start; j < end; j++)
+						bi[j] -= li[k] * bk[j];
+				}
+			}
+
+			// Back substitution
+			for (size_t i = n; i-- > 0; ) {
+				const T *ui = lu + i * n;
+				T *bi = b + i * m;
+
+				for (size_t k = i + 1; k < n; k++) {
+					const T *bk = b + k * m;
+
+					for (size_t j = start; j < end; j++)
+						bi[j] -= ui[k] * bk[j];
+				}
+
+				for (size_t j = start; j < end; j++)
+					bi[j] /= ui[i];
+			}
+		}
+	);
+}
+
+/**
+ * @brief Computes the determinant of an n x n matrix with fraction-free
+ * (Bareiss) elimination, in place. Every division is exact, so integer
+ * matrices stay integral and intermediate values are bounded by minors of the
+ * matrix.
+ *
+ * @param n the size of the matrix.
+ * @param a the components of the matrix (row-major), which are overwritten.
+ *
+ * @return the determinant.
+ */
+template <class T>
+T bareiss_determinant(size_t n, T *a)
+{
+	if (n == 0)
+		return T(1);
+
+	bool negate = false;
+
+	T prev = T(1);
+	for (size_t k = 0; k + 1 < n; k++) {
+		size_t p = lu_pivot(n, a, k, std::false_type());
+
+		if (a[p * n + k] == T(0))
+			return T(0);
+
+		if (p != k) {
+			swap_rows(n, a, p, k);
+
+			negate = !negate;
+		}
+
+		const T *ak = a + k * n;
+		for (size_t i = k + 1; i < n; i++) {
+			T *ai = a + i * n;
+
+			for (size_t j = k + 1; j < n; j++)
+				ai[j] = (ak[k] * ai[j] - ai[k] * ak[j]) / prev;
+		}
+
+		prev = ak[k];
+	}
+
+	T det = a[n * n - 1];
+
+	return negate ? T(0) - det : det;
+}
+
+/**
+ * @brief Fraction-free (Bareiss) Gauss-Jordan elimination on [A | B], which
+ * reduces to [det(A) I | det(A) A^-1 B] (up to the sign of the row exchanges)
+ * with only exact divisions. In particular, B = I yields the adjugate.
+ *
+ * @param n the size of A.
+ * @param a the components of A (row-major).
+ * @param b the n x m right hand side (row-major), which is overwritten with
+ * det(A) A^-1 B.
+ * @param m the number of columns of B.
+ * @param det set to the determinant of A.
+ *
+ * @return false if A is singular, in which case b is not set.
+ */
+template <class T>
+bool bareiss_solve(size_t n, const T *a, T *b, size_t m, T &det)
+{
+	size_t cols = n + m;
+
+	// Augmented matrix [A | B]
+	std::vector <T> aug(n * cols);
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < n; j++)
+			aug[i * cols + j] = a[i * n + j];
+
+		for (size_t j = 0; j < m; j++)
+			aug[i * cols + n + j] = b[i * m + j];
+	}
+
+	bool negate = false;
+
+	T prev = T(1);
+	for (size_t k = 0; k < n; k++) {
+		size_t p = k;
+		while (p < n && aug[p * cols + k] == T(0))
+			p++;
+
+		if (p == n) {
+			det = T(0);
+
+			return false;
+		}
+
+		if (p != k) {
+			swap_rows(cols, aug.data(), p, k);
+
+			negate = !negate;
+		}
+
+		const T *ak = &aug[k * cols];
+		for (size_t i = 0; i < n; i++) {
+			if (i == k)
+				continue;
+
+			T *ai = &aug[i * cols];
+			for (size_t j = 0; j < cols; j++) {
+				if (j != k)
+					ai[j] = (ak[k] * ai[j] - ai[k] * ak[j]) / prev;
+			}
+
+			ai[k] = T(0);
+		}
+
+		prev = ak[k];
+	}
+
+	// With P the row exchanges, the result is [det(PA) I | det(PA) A^-1 B],
+	// and det(PA) = det(P) det(A)
+	det = negate ? T(0) - prev : prev;
+
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < m; j++) {
+			T x = aug[i * cols + n + j];
+
+			b[i * m + j] = negate ? T(0) - x : x;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief Computes the adjugate and the determinant of an n x n matrix with
+ * fraction-free elimination.
+ *
+ * @return false if the matrix is singular, in which case adj is not set.
+ */
+template <class T>
+bool bareiss_adjugate(size_t n, const T *a, T *adj, T &det)
+{
+	for (size_t i = 0; i < n * n; i++)
+		adj[i] = T(0);
+
+	for (size_t i = 0; i < n; i++)
+		adj[i * n + i] = T(1);
+
+	return bareiss_solve(n, a, adj, n, det);
+}
+
+// Determinants: LU for floating point types, Bareiss otherwise
+template <class T>
+T lu_determinant(size_t n, const T *a, std::true_type)
+{
+	std::vector <T> lu(a, a + n * n);
+	std::vector <size_t> piv(n);
+
+	T det = T(lu_factor(n, lu.data(), piv.data()));
+	for (size_t i = 0; i < n; i++)
+		det *= lu[i * n + i];
+
+	return det;
+}
+
+template <class T>
+T lu_determinant(size_t n, const T *a, std::false_type)
+{
+	std::vector <T> copy(a, a + n * n);
+
+	return bareiss_determinant(n, copy.data());
+}
+
+/**
+ * @brief Computes the determinant of an n x n matrix in O(n^3) operations. The
+ * result is exact for integral and rational types.
+ */
+template <class T>
+T lu_determinant(size_t n, const T *a)
+{
+	return lu_determinant(n, a, std::is_floating_point <T> ());
+}
+
+// Inverses: LU for floating point types, adjugate over determinant otherwise
+template <class T>
+bool lu_inverse(size_t n, const T *a, T *inv, std::true_type)
+{
+	std::vector <T> lu(a, a + n * n);
+	std::vector <size_t> piv(n);
+
+	lu_factor(n, lu.data(), piv.data());
+
+	for (size_t i = 0; i < n * n; i++)
+		inv[i] = T(0);
+
+	for (size_t i = 0; i < n; i++)
+		inv[i * n + i] = T(1);
+
+	lu_solve(n, lu.data(), piv.data(), inv, n);
+
+	return true;
+}
+
+template <class T>
+bool lu_inverse(size_t n, const T *a, T *inv, std::false_type)
+{
+	T det;
+	if (!bareiss_adjugate(n, a, inv, det))
+		return false;
+
+	for (size_t i = 0; i < n * n; i++)
+		inv[i] /= det;
+
+	return true;
+}
+
+/**
+ * @brief Computes the inverse of an n x n matrix in O(n^3) operations. For
+ * types other than floating point types, this is the adjugate divided by the
+ * determinant, computed exactly.
+ *
+ * @return false if the inverse could not be computed (an exact type with a
+ * singular matrix). Singular floating point matrices yield non-finite
+ * components instead.
+ */
+template <class T>
+bool lu_inverse(size_t n, const T *a, T *inv)
+{
+	return lu_inverse(n, a, inv, std::is_floating_point <T> ());
+}
+
+template <class T>
+bool lu_adjugate(size_t n, const T *a, T *adj, std::true_type)
+{
+	T det = lu_determinant(n, a);
+	if (det == T(0))
+		return false;
+
+	lu_inverse(n, a, adj);
+	for (size_t i = 0; i < n * n; i++)
+		adj[i] *= det;
+
+	return true;
+}
+
+template <class T>
+bool lu_adjugate(size_t n, const T *a, T *adj, std::false_type)
+{
+	T det;
+
+	return bareiss_adjugate(n, a, adj, det);
+}
+
+/**
+ * @brief Computes the adjugate of a nonsingular n x n matrix in O(n^3)
+ * operations (exactly, for integral and rational types).
+ *
+ * @return false if the matrix is singular, in which case adj is not set.
+ */
+template <class T>
+bool lu_adjugate(size_t n, const T *a, T *adj)
+{
+	return lu_adjugate(n, a, adj, std::is_floating_point <T> ());
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,707 @@
+#ifndef GEMM_H_
+#define GEMM_H_
+
+// C/C++ headers
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Engine headers
+#include "parallel.hpp"
+
+// Check for x86 SIMD support (GCC and Clang only)
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) \
+	&& !defined(__CUDACC__)
+
+#define ZHP_GEMM_X86
+
+#include <immintrin.h>
+
+#endif
+
+/**
+ * @file gemm.hpp
+ * @brief Cache-blocked general matrix multiplication on row-major buffers.
+ *
+ * Floating point types (float and double) go through a packed, cache-blocked
+ * path where an architecture specific microkernel computes small MR x NR tiles
+ * of the product in registers. The microkernel is chosen at runtime from the
+ * instruction sets supported by the host CPU (AVX-512, AVX2 with FMA, or a
+ * portable scalar kernel). All other types use the simple i-k-j loop.
+ */
+
+namespace zhetapi {
+
+namespace blas {
+
+// Blocking parameters: a KC x NC block of B and an MC x KC block of A are
+// packed so that they stay in the L3 and L2 caches respectively. MC and NC
+// must be multiples of the MR and NR values of every microkernel.
+static const size_t GEMM_MC = 96;
+static const size_t GEMM_KC = 256;
+static const size_t GEMM_NC = 2048;
+
+// Products with fewer multiply-adds than this are not worth packing
+static const size_t GEMM_THRESHOLD = 32 * 32 * 32;
+
+/**
+ * @brief Instruction sets for which there is a dedicated GEMM microkernel.
+ */
+enum simd_level {
+	simd_scalar,
+	simd_avx2,
+	simd_avx512
+};
+
+/**
+ * @return the best instruction set supported by the CPU. The result is
+ * computed once and cached.
+ */
+inline simd_level simd_support()
+{
+#ifdef ZHP_GEMM_X86
+
+	static const simd_level level = []() {
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx512f"))
+			return simd_avx512;
+
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return simd_avx2;
+
+		return simd_scalar;
+	}();
+
+	return level;
+
+#else
+
+	return simd_scalar;
+
+#endif
+}
+
+/**
+ * @brief Computes C += A * B with the plain i-k-j loop, where A is m x k, B
+ * is k x n and C is m x n. All matrices are row-major with leading dimensions
+ * (row strides) lda, ldb and ldc.
+ */
+template <class T, class U>
+void simple_gemm(size_t m, size_t n, size_t k,
+		const T *A, size_t lda,
+		const U *B, size_t ldb,
+		T *C, size_t ldc)
+{
+	for (size_t i = 0; i < m; i++) {
+		const T *Ar = A + i * lda;
+		T *Cr = C + i * ldc;
+
+		for (size_t p = 0; p < k; p++) {
+			const U *Br = B + p * ldb;
+
+			T a = Ar[p];
+			for (size_t j = 0; j < n; j++)
+				Cr[j] += T(a * Br[j]);
+		}
+	}
+}
+
+/**
+ * @brief Portable microkernel. Computes the MR x NR tile c += a * b, where a
+ * is a packed MR x kc panel (column by column) and b is a packed kc x NR panel
+ * (row by row).
+ */
+template <class T>
+struct scalar_kernel {
+	static const size_t MR = 4;
+	static const size_t NR = 4;
+
+	static void run(size_t kc, const T *a, const T *b, T *c, size_t ldc)
+	{
+		T acc[MR][NR] = {};
+
+		for (size_t p = 0; p < kc; p++) {
+			for (size_t i = 0; i < MR; i++) {
+				for (size_t j = 0; j < NR; j++)
+					acc[i][j] += a[i] * b[j];
+			}
+
+			a += MR;
+			b += NR;
+		}
+
+		for (size_t i = 0; i < MR; i++) {
+			for (size_t j = 0; j < NR; j++)
+				c[i * ldc + j] += acc[i][j];
+		}
+	}
+};
+
+#ifdef ZHP_GEMM_X86
+
+template <class T>
+struct avx2_kernel;
+
+template <>
+struct avx2_kernel <double> {
+	static const size_t MR = 6;
+	static const size_t NR = 8;
+
+	__attribute__((target("avx2,fma")))
+	static void run(size_t kc, const double *a, const double *b, double *c, size_t ldc)
+	{
+		__m256d acc[MR][2];
+
+		for (size_t i = 0; i < MR; i++)
+			acc[i][0] = acc[i][1] = _mm256_setzero_pd();
+
+		for (size_t p = 0; p < kc; p++) {
+			__m256d b0 = _mm256_loadu_pd(b);
+			__m256d b1 = _mm256_loadu_pd(b + 4);
+
+			for (size_t i = 0; i < MR; i++) {
+				__m256d ai = _mm256_broadcast_sd(a + i);
+
+				acc[i][0] = _mm256_fmadd_pd(ai, b0, acc[i][0]);
+				acc[i][1] = _mm256_fmadd_pd(ai, b1, acc[i][1]);
+			}
+
+			a += MR;
+			b += NR;
+		}
+
+		for (size_t i = 0; i < MR; i++) {
+			double *cr = c + i * ldc;
+
+			_mm256_storeu_pd(cr, _mm256_add_pd(_mm256_loadu_pd(cr), acc[i][0]));
+			_mm256_storeu_pd(cr + 4, _mm256_add_pd(_mm256_loadu_pd(cr + 4), acc[i][1]));
+		}
+	}
+};
+
+template <>
+struct avx2_kernel <float> {
+	static const size_t MR = 6;
+	static const size_t NR = 16;
+
+	__attribute__((target("avx2,fma")))
+	static void run(size_t kc, const float *a, const float *b, float *c, size_t ldc)
+	{
+		__m256 acc[MR][2];
+
+		for (size_t i = 0; i < MR; i++)
+			acc[i][0] = acc[i][1] = _mm256_setzero_ps();
+
+		for (size_t p = 0; p < kc; p++) {
+			__m256 b0 = _mm256_loadu_ps(b);
+			__m256 b1 = _mm256_loadu_ps(b + 8);
+
+			for (size_t i = 0; i < MR; i++) {
+				__m256 ai = _mm256_broadcast_ss(a + i);
+
+				acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+				acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+			}
+
+			a += MR;
+			b += NR;
+		}
+
+		for (size_t i = 0; i < MR; i++) {
+			float *cr = c + i * ldc;
+
+			_mm256_storeu_ps(cr, _mm256_add_ps(_mm256_loadu_ps(cr), acc[i][0]));
+			_mm256_storeu_ps(cr + 8, _mm256_add_ps(_mm256_loadu_ps(cr + 8), acc[i][1]));
+		}
+	}
+};
+
+template <class T>
+struct avx512_kernel;
+
+template <>
+struct avx512_kernel <double> {
+	static const size_t MR = 8;
+	static const size_t NR = 16;
+
+	__attribute__((target("avx512f")))
+	static void run(size_t kc, const double *a, const double *b, double *c, size_t ldc)
+	{
+		__m512d acc[MR][2];
+
+		for (size_t i = 0; i < MR; i++)
+			acc[i][0] = acc[i][1] = _mm512_setzero_pd();
+
+		for (size_t p = 0; p < kc; p++) {
+			__m512d b0 = _mm512_loadu_pd(b);
+			__m512d b1 = _mm512_loadu_pd(b + 8);
+
+			for (size_t i = 0; i < MR; i++) {
+				__m512d ai = _mm512_set1_pd(a[i]);
+
+				acc[i][0] = _mm512_fmadd_pd(ai, b0, acc[i][0]);
+				acc[i][1] = _mm512_fmadd_pd(ai, b1, acc[i][1]);
+			}
+
+			a += MR;
+			b += NR;
+		}
+
+		for (size_t i = 0; i < MR; i++) {
+			double *cr = c + i * ldc;
+
+			_mm512_storeu_pd(cr, _mm512_add_pd(_mm512_loadu_pd(cr), acc[i][0]));
+			_mm512_storeu_pd(cr + 8, _mm512_add_pd(_mm512_loadu_pd(cr + 8), acc[i][1]));
+		}
+	}
+};
+
+template <>
+struct avx512_kernel <float> {
+	static const size_t MR = 8;
+	static const size_t NR = 32;
+
+	__attribute__((target("avx512f")))
+	static void run(size_t kc, const float *a, const float *b, float *c, size_t ldc)
+	{
+		__m512 acc[MR][2];
+
+		for (size_t i = 0; i < MR; i++)
+			acc[i][0] = acc[i][1] = _mm512_setzero_ps();
+
+		for (size_t p = 0; p < kc; p++) {
+			__m512 b0 = _mm512_loadu_ps(b);
+			__m512 b1 = _mm512_loadu_ps(b + 16);
+
+			for (size_t i = 0; i < MR; i++) {
+				__m512 ai = _mm512_set1_ps(a[i]);
+
+				acc[i][0] = _mm512_fmadd_ps(ai, b0, acc[i][0]);
+				acc[i][1] = _mm512_fmadd_ps(ai, b1, acc[i][1]);
+			}
+
+			a += MR;
+			b += NR;
+		}
+
+		for (size_t i = 0; i < MR; i++) {
+			float *cr = c + i * ldc;
+
+			_mm512_storeu_ps(cr, _mm512_add_ps(_mm512_loadu_ps(cr), acc[i][0]));
+			_mm512_storeu_ps(cr + 16, _mm512_add_ps(_mm512_loadu_ps(cr + 16), acc[i][1]));
+		}
+	}
+};
+
+#endif
+
+/**
+ * @brief Packs the mc x kc block of A at the given position into panels of MR
+ * rows, each stored column by column and scaled by alpha. Component (i, p) of
+ * the block is A[i * rsa + p * csa], so that transposed operands are packed
+ * directly. Missing rows are padded with zeros.
+ */
+template <size_t MR, class T>
+void pack_a(size_t mc, size_t kc, T alpha, const T *A, size_t rsa, size_t csa, T *pa)
+{
+	for (size_t ir = 0; ir < mc; ir += MR) {
+		size_t mr = (mc - ir < MR) ? mc - ir : MR;
+
+		for (size_t p = 0; p < kc; p++) {
+			const T *Ac = A + ir * rsa + p * csa;
+
+			for (size_t i = 0; i < mr; i++)
+				pa[i] = alpha * Ac[i * rsa];
+
+			for (size_t i = mr; i < MR; i++)
+				pa[i] = T(0);
+
+			pa += MR;
+		}
+	}
+}
+
+/**
+ * @brief Packs the kc x nc block of B at the given position into panels of NR
+ * columns, each stored row by row. Component (p, j) of the block is
+ * B[p * rsb + j * csb]. Missing columns are padded with zeros.
+ */
+template <size_t NR, class T>
+void pack_b(size_t kc, size_t nc, const T *B, size_t rsb, size_t csb, T *pb)
+{
+	for (size_t jr = 0; jr < nc; jr += NR) {
+		size_t nr = (nc - jr < NR) ? nc - jr : NR;
+
+		for (size_t p = 0; p < kc; p++) {
+			const T *Br = B + p * rsb + jr * csb;
+
+			for (size_t j = 0; j < nr; j++)
+				pb[j] = Br[j * csb];
+
+			for (size_t j = nr; j < NR; j++)
+				pb[j] = T(0);
+
+			pb += NR;
+		}
+	}
+}
+
+/**
+ * @brief Blocked C += alpha * A * B driven by the microkernel K, where the
+ * operands are given by their row and column strides. The packing buffers are
+ * kept per thread so that repeated products do not allocate.
+ */
+template <class K, class T>
+void blocked_gemm(size_t m, size_t n, size_t k, T alpha,
+		const T *A, size_t rsa, size_t csa,
+		const T *B, size_t rsb, size_t csb,
+		T *C, size_t ldc)
+{
+	const size_t MR = K::MR;
+	const size_t NR = K::NR;
+
+	static thread_local std::vector <T> abuf;
+	static thread_local std::vector <T> bbuf;
+
+	size_t asize = GEMM_MC * GEMM_KC;
+	size_t bsize = GEMM_KC * GEMM_NC;
+
+	if (abuf.size() < asize)
+		abuf.resize(asize);
+	if (bbuf.size() < bsize)
+		bbuf.resize(bsize);
+
+	T *pa = abuf.data();
+	T *pb = bbuf.data();
+
+	// Edge tiles are computed here and then copied into C
+	T edge[MR * NR];
+
+	for (size_t jc = 0; jc < n; jc += GEMM_NC) {
+		size_t nc = (n - jc < GEMM_NC) ? n - jc : GEMM_NC;
+
+		for (size_t pc = 0; pc < k; pc += GEMM_KC) {
+			size_t kc = (k - pc < GEMM_KC) ? k - pc : GEMM_KC;
+
+			pack_b <NR> (kc, nc, B + pc * rsb + jc * csb, rsb, csb, pb);
+
+			for (size_t ic = 0; ic < m; ic += GEMM_MC) {
+				size_t mc = (m - ic < GEMM_MC) ? m - ic : GEMM_MC;
+
+				pack_a <MR> (mc, kc, alpha, A + ic * rsa + pc * csa, rsa, csa, pa);
+
+				for (size_t jr = 0; jr < nc; jr += NR) {
+					size_t nr = (nc - jr < NR) ? nc - jr : NR;
+
+					const T *b = pb + jr * kc;
+
+					for (size_t ir = 0; ir < mc; ir += MR) {
+						size_t mr = (mc - ir < MR) ? mc - ir : MR;
+
+						const T *a = pa + ir * kc;
+						T *c = C + (ic + ir) * ldc + jc + jr;
+
+						if (mr == MR && nr == NR) {
+							K::run(kc, a, b, c, ldc);
+
+							continue;
+						}
+
+						memset(edge, 0, sizeof(edge));
+
+						K::run(kc, a, b, edge, NR);
+
+						for (size_t i = 0; i < mr; i++) {
+							for (size_t j = 0; j < nr; j++)
+								c[i * ldc + j] += edge[i * NR + j];
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+// Products are split into blocks of rows of C for parallel execution
+template <class K, class T>
+void parallel_gemm(size_t m, size_t n, size_t k, T alpha,
+		const T *A, size_t rsa, size_t csa,
+		const T *B, size_t rsb, size_t csb,
+		T *C, size_t ldc, size_t threads)
+{
+	parallel::for_range(m, m * n * k,
+		[&](size_t start, size_t end) {
+			blocked_gemm <K> (end - start, n, k, alpha,
+					A + start * rsa, rsa, csa,
+					B, rsb, csb,
+					C + start * ldc, ldc);
+		}, threads
+	);
+}
+
+/**
+ * @brief Computes C += alpha * A * B with plain loops, where the operands are
+ * given by their row and column strides. The loop order keeps the innermost
+ * loop contiguous: i-k-j if the rows of B are contiguous, and a dot product of
+ * rows (i-j-k) otherwise, as for A * B^T.
+ */
+template <class T, class U>
+void strided_gemm(size_t m, size_t n, size_t k, T alpha,
+		const T *A, size_t rsa, size_t csa,
+		const U *B, size_t rsb, size_t csb,
+		T *C, size_t ldc)
+{
+	if (csb == 1) {
+		for (size_t i = 0; i < m; i++) {
+			T *Cr = C + i * ldc;
+
+			for (size_t p = 0; p < k; p++) {
+				const U *Br = B + p * rsb;
+
+				T a = alpha * A[i * rsa + p * csa];
+				for (size_t j = 0; j < n; j++)
+					Cr[j] += T(a * Br[j]);
+			}
+		}
+
+		return;
+	}
+
+	for (size_t i = 0; i < m; i++) {
+		T *Cr = C + i * ldc;
+
+		for (size_t j = 0; j < n; j++) {
+			const U *Bc = B + j * csb;
+
+			T acc = T(0);
+			for (size_t p = 0; p < k; p++)
+				acc += T(A[i * rsa + p * csa] * Bc[p * rsb]);
+
+			Cr[j] += alpha * acc;
+		}
+	}
+}
+
+/**
+ * @brief Transposition of an operand of gemm or gemv, as in BLAS: the operand
+ * is stored row-major either as is (no_trans) or as its transpose (trans).
+ */
+enum transpose_flag {
+	no_trans,
+	trans
+};
+
+// Row and column strides of a stored operand after applying its flag
+inline size_t op_row_stride(transpose_flag t, size_t ld)
+{
+	return (t == trans) ? 1 : ld;
+}
+
+inline size_t op_col_stride(transpose_flag t, size_t ld)
+{
+	return (t == trans) ? ld : 1;
+}
+
+// Computes C = beta * C before accumulating a product (without reading C if
+// beta is zero, so that uninitialized components do not propagate)
+template <class T>
+void scale_c(size_t m, size_t n, T beta, T *C, size_t ldc, size_t threads = 0)
+{
+	if (beta == T(1))
+		return;
+
+	parallel::for_range(m, m * n,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++) {
+				T *Cr = C + i * ldc;
+
+				for (size_t j = 0; j < n; j++)
+					Cr[j] = (beta == T(0)) ? T(0) : beta * Cr[j];
+			}
+		}, threads
+	);
+}
+
+// Dispatch of C += alpha * A * B on strided operands: blocked kernels for
+// float and double, plain loops otherwise
+template <class T>
+typename std::enable_if <std::is_same <T, float> ::value
+		|| std::is_same <T, double> ::value> ::type
+strided_dispatch(size_t m, size_t n, size_t k, T alpha,
+		const T *A, size_t rsa, size_t csa,
+		const T *B, size_t rsb, size_t csb,
+		T *C, size_t ldc, size_t threads)
+{
+	if (m * n * k < GEMM_THRESHOLD)
+		return strided_gemm(m, n, k, alpha, A, rsa, csa, B, rsb, csb, C, ldc);
+
+	switch (simd_support()) {
+
+#ifdef ZHP_GEMM_X86
+
+	case simd_avx512:
+		return parallel_gemm <avx512_kernel <T>> (m, n, k, alpha,
+				A, rsa, csa, B, rsb, csb, C, ldc, threads);
+	case simd_avx2:
+		return parallel_gemm <avx2_kernel <T>> (m, n, k, alpha,
+				A, rsa, csa, B, rsb, csb, C, ldc, threads);
+
+#endif
+
+	default:
+		return parallel_gemm <scalar_kernel <T>> (m, n, k, alpha,
+				A, rsa, csa, B, rsb, csb, C, ldc, threads);
+	}
+}
+
+template <class T, class U>
+typename std::enable_if <!(std::is_same <T, U> ::value
+		&& (std::is_same <T, float> ::value
+		|| std::is_same <T, double> ::value))> ::type
+strided_dispatch(size_t m, size_t n, size_t k, T alpha,
+		const T *A, size_t rsa, size_t csa,
+		const U *B, size_t rsb, size_t csb,
+		T *C, size_t ldc, size_t threads)
+{
+	parallel::for_range(m, m * n * k,
+		[&](size_t start, size_t end) {
+			strided_gemm(end - start, n, k, alpha,
+					A + start * rsa, rsa, csa,
+					B, rsb, csb,
+					C + start * ldc, ldc);
+		}, threads
+	);
+}
+
+/**
+ * @brief Computes C += A * B, where A is m x k, B is k x n and C is m x n.
+ * All matrices are row-major with leading dimensions lda, ldb and ldc.
+ *
+ * Uses the blocked kernels for float and double, and the simple loop
+ * otherwise (or when the product is too small to benefit from packing).
+ * Large products are computed in parallel, on the given number of threads (or
+ * with the global setting if it is 0).
+ */
+template <class T, class U>
+void gemm(size_t m, size_t n, size_t k,
+		const T *A, size_t lda,
+		const U *B, size_t ldb,
+		T *C, size_t ldc,
+		size_t threads = 0)
+{
+	strided_dispatch(m, n, k, T(1), A, lda, 1, B, ldb, 1, C, ldc, threads);
+}
+
+/**
+ * @brief Computes C = alpha * op(A) * op(B) + beta * C, as in BLAS, where
+ * op(A) is m x k, op(B) is k x n and C is m x n. Transposed operands are read
+ * in place, so products such as A^T * B and A * B^T never build a transpose.
+ *
+ * @param ta whether A is stored transposed (as a k x m matrix).
+ * @param tb whether B is stored transposed (as an n x k matrix).
+ * @param lda the leading dimension (row stride) of A as stored.
+ * @param ldb the leading dimension (row stride) of B as stored.
+ * @param ldc the leading dimension of C.
+ * @param threads the number of threads, or 0 to use the global setting.
+ */
+template <class T>
+void gemm(transpose_flag ta, transpose_flag tb,
+		size_t m, size_t n, size_t k,
+		T alpha,
+		const T *A, size_t lda,
+		const T *B, size_t ldb,
+		T beta,
+		T *C, size_t ldc,
+		size_t threads = 0)
+{
+	scale_c(m, n, beta, C, ldc, threads);
+
+	if (alpha == T(0) || k == 0)
+		return;
+
+	strided_dispatch(m, n, k, alpha,
+			A, op_row_stride(ta, lda), op_col_stride(ta, lda),
+			B, op_row_stride(tb, ldb), op_col_stride(tb, ldb),
+			C, ldc, threads);
+}
+
+/**
+ * @brief Dot product of two contiguous arrays, accumulated in A. Independent
+ * partial sums break the dependency chain of a single accumulator, so that the
+ * compiler can keep them in vector registers.
+ */
+template <class A, class T>
+A dot(size_t n, const T *x, const T *y)
+{
+	A partial[8] {};
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		for (size_t l = 0; l < 8; l++)
+			partial[l] += A(x[i + l]) * A(y[i + l]);
+	}
+
+	A acc = A(0);
+	for (; i < n; i++)
+		acc += A(x[i]) * A(y[i]);
+
+	for (size_t l = 0; l < 8; l++)
+		acc += partial[l];
+
+	return acc;
+}
+
+/**
+ * @brief Computes y = alpha * op(A) * x + beta * y, as in BLAS, where A is
+ * stored as an m x n row-major matrix with leading dimension lda. For
+ * op(A) = A^T (ta = trans), the rows of A are accumulated into y so that A is
+ * still traversed row by row.
+ */
+template <class T>
+void gemv(transpose_flag ta, size_t m, size_t n,
+		T alpha,
+		const T *A, size_t lda,
+		const T *x,
+		T beta,
+		T *y)
+{
+	size_t ylen = (ta == trans) ? n : m;
+
+	scale_c(ylen, 1, beta, y, 1);
+
+	if (alpha == T(0))
+		return;
+
+	if (ta == no_trans) {
+		parallel::for_range(m, m * n,
+			[&](size_t start, size_t end) {
+				for (size_t i = start; i < end; i++) {
+					y[i] += alpha * dot <T> (n, A + i * lda, x);
+				}
+			}
+		);
+
+		return;
+	}
+
+	// Each block of y is accumulated from the same columns of every row
+	parallel::for_range(n, m * n,
+		[&](size_t start, size_t end) {
+			for (size_t i = 0; i < m; i++) {
+				const T *Ar = A + i * lda;
+
+				T xi = alpha * x[i];
+				for (size_t j = start; j < end; j++)
+					y[j] += xi * Ar[j];
+			}
+		}
+	);
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef INT8_H_
+#define INT8_H_
+
+// C/C++ headers
+#include <cstddef>
+#include <cstdint>
+
+// Engine headers
+#include "gemm.hpp"
+#include "parallel.hpp"
+
+#if defined(__SSE2__) && defined(__GNUC__) && !defined(__CUDACC__)
+
+#include <emmintrin.h>
+
+#endif
+
+/**
+ * @file int8.hpp
+ * @brief Products of 8-bit integers accumulated in 32-bit integers, for
+ * quantized inference.
+ *
+ * The components are sign-extended to 16 bits and multiplied in pairs with
+ * madd (the sum of two products of 8-bit values always fits in 16 bits), with
+ * an AVX2 kernel chosen at runtime (see blas::simd_support) and an SSE2 kernel
+ * otherwise. The results are exact, so every kernel gives the same results.
+ */
+
+namespace zhetapi {
+
+namespace blas {
+
+inline int32_t dot_s8_scalar(const int8_t *a, const int8_t *b, size_t k)
+{
+	int32_t acc = 0;
+	for (size_t i = 0; i < k; i++)
+		acc += int32_t(a[i]) * int32_t(b[i]);
+
+	return acc;
+}
+
+#ifdef ZHP_GEMM_X86
+
+__attribute__((target("avx2")))
+inline int32_t dot_s8_avx2(const int8_t *a, const int8_t *b, size_t k)
+{
+	__m256i acc = _mm256_setzero_si256();
+
+	size_t i = 0;
+	for (; i + 16 <= k; i += 16) {
+		__m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (a + i)));
+		__m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (b + i)));
+
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+	}
+
+	__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc),
+			_mm256_extracti128_si256(acc, 1));
+
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+
+	return _mm_cvtsi128_si32(sum) + dot_s8_scalar(a + i, b + i, k - i);
+}
+
+#endif
+
+#ifdef __SSE2__
+
+// Sign extension of the low and high halves of 16 8-bit integers
+inline __m128i unpack_lo_s8(__m128i v)
+{
+	return _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+}
+
+inline __m128i unpack_hi_s8(__m128i v)
+{
+	return _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+}
+
+inline int32_t dot_s8_sse2(const int8_t *a, const int8_t *b, size_t k)
+{
+	__m128i acc = _mm_setzero_si128();
+
+	size_t i = 0;
+	for (; i + 16 <= k; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *) (a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *) (b + i));
+
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(unpack_lo_s8(va), unpack_lo_s8(vb)));
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(unpack_hi_s8(va), unpack_hi_s8(vb)));
+	}
+
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+
+	return _mm_cvtsi128_si32(acc) + dot_s8_scalar(a + i, b + i, k - i);
+}
+
+#endif
+
+/**
+ * @brief Dot product of two vectors of k 8-bit integers.
+ */
+inline int32_t dot_s8(const int8_t *a, const int8_t *b, size_t k)
+{
+#ifdef ZHP_GEMM_X86
+
+	if (simd_support() != simd_scalar)
+		return dot_s8_avx2(a, b, k);
+
+#endif
+
+#ifdef __SSE2__
+
+	return dot_s8_sse2(a, b, k);
+
+#else
+
+	return dot_s8_scalar(a, b, k);
+
+#endif
+}
+
+/**
+ * @brief Computes C = A * B^T for an m x k matrix A and an n x k matrix B of
+ * 8-bit integers (rows with strides lda and ldb), into the m x n matrix C of
+ * 32-bit integers. The rows of C are computed in parallel.
+ */
+inline void gemm_s8(size_t m, size_t n, size_t k,
+		const int8_t *A, size_t lda,
+		const int8_t *B, size_t ldb,
+		int32_t *C, size_t ldc)
+{
+	parallel::for_range(m, m * n * k,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++) {
+				for (size_t j = 0; j < n; j++)
+					C[i * ldc + j] = dot_s8(A + i * lda, B + j * ldb, k);
+			}
+		}
+	);
+}
+
+}
+
+}
+
+#endif
@@ -1,10 +1,20 @@
 #ifndef KERNELS_H_
 #define KERNELS_H_
 
+#ifndef __AVR
+
+// C/C++ headers
+#include <type_traits>
+#include <vector>
+
+#endif
+
 // Engine headers
 #include "../matrix.hpp"
 #include "../vector.hpp"
 
+#include "simd.hpp"
+
 /**
  * @file kernels.hpp
  * @brief This file contains CPU "kernels" which speed up computation in other parts of
@@ -17,8 +27,12 @@ namespace zhetapi {
 /**
  * Computes M * V', where V' is V with 1 appended to the top. Speed-up is due to
  * the fact that a new vector is not being created and copied.
+ *
+ * The dot products are accumulated in A, which can be wider than T (for
+ * example, float components with double accumulation in mixed precision
+ * training).
  */
-template <class T>
+template <class T, class A>
 Vector <T> apt_and_mult(const Matrix <T> &M, const Vector <T> &V)
 {
 	size_t rs = M._rows;
@@ -27,50 +41,91 @@ Vector <T> apt_and_mult(const Matrix <T> &M, const Vector <T> &V)
 	Vector <T> out(rs, T(0));
 
 	size_t k = V._size;
-	for (size_t i = 0; i < rs; i++) {
-		T acc = M._array[i * cs];
 
-		for (size_t j = 0; j < k; j++)
-			acc += M._array[i * cs + 1 + j] * V._array[j];
+	const T *marr = M._array;
+	const T *varr = V._array;
+	T *oarr = out._array;
 
-		out._array[i] = acc;
-	}
+	parallel::for_range(rs, rs * k,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++) {
+				const T *row = marr + i * cs;
+
+				oarr[i] = T(A(row[0]) + blas::dot <A> (k, row + 1, varr));
+			}
+		}
+	);
 
 	return out;
 }
 
 /**
- * Computes U', where U = M * V and U' is U without the first element. Speed-up
- * is again due to the fact that a new vector is not being created.
+ * Computes U', where U = M^T * V and U' is U without the first element (the
+ * bias column of M). M is traversed row by row, without building M^T. As with
+ * apt_and_mult, the sums are accumulated in A.
  */
-template <class T>
+template <class T, class A>
 Vector <T> rmt_and_mult(const Matrix <T> &M, const Vector <T> &V)
 {
 	size_t rs = M._rows;
 	size_t cs = M._cols;
 
 	Vector <T> out(cs - 1, T(0));
-	/* for (size_t i = 1; i < cs; i++) {
-		T acc = 0;
 
-		for (size_t k = 0; k < rs; k++)
-			acc += M._array[k * cs + i] * V._array[k];
+#ifdef __AVR
 
-		out._array[i - 1] = acc;
-	} */
-
-	// Reverse loops
 	for (size_t k = 0; k < rs; k++) {
 		const T *arr = &(M._array[k * cs]);
 		T v = V._array[k];
 
 		for (size_t i = 1; i < cs; i++)
-			out._array[i - 1] = arr[i] * v;
+			out._array[i - 1] += arr[i] * v;
 	}
 
+#else
+
+	if (std::is_same <T, A> ::value) {
+		blas::gemv(blas::trans, rs, cs - 1, T(1),
+				M._array + 1, cs,
+				V._array,
+				T(0),
+				out._array);
+	} else {
+		std::vector <A> acc(cs - 1, A(0));
+
+		for (size_t k = 0; k < rs; k++) {
+			const T *arr = &(M._array[k * cs]);
+			A v = V._array[k];
+
+			for (size_t i = 1; i < cs; i++)
+				acc[i - 1] += A(arr[i]) * v;
+		}
+
+		for (size_t i = 1; i < cs; i++)
+			out._array[i - 1] = T(acc[i - 1]);
+	}
+
+#endif
+
 	return out;
 }
 
+// Fused softmax and cross entropy for a single sample (see
+// batch_softmax_ce_delta): p * sum(y) - y
+template <class T>
+Vector <T> softmax_ce_delta(const Vector <T> &y, const Vector <T> &p)
+{
+	T sum = 0;
+	for (size_t j = 0; j < y.size(); j++)
+		sum += y[j];
+
+	return Vector <T> (y.size(),
+		[&](size_t j) {
+			return p[j] * sum - y[j];
+		}
+	);
+}
+
 /**
  * Computes V * (Vt)^T (transpose). Speed-up comes from the fact that we avoid
  * creating the transpose vector.
@@ -84,12 +139,168 @@ Matrix <T> vvt_mult(const Vector <T> &V, const Vector <T> &Vt)
 	size_t n = rs * cs;
 
 	T *tmp = new T[n];
+
+#ifdef __AVR
+
 	for (size_t i = 0; i < n; i++)
 		tmp[i] = V._array[i / cs] * Vt._array[i % cs];
 
+#else
+
+	blas::gemm(blas::no_trans, blas::trans, rs, cs, 1,
+			T(1), V._array, 1, Vt._array, 1,
+			T(0), tmp, cs);
+
+#endif
+
 	return Matrix <T> (rs, cs, tmp, false);
 }
 
+#ifndef __AVR
+
+/**
+ * Batched apt_and_mult: each row of X is an input, and the corresponding row of
+ * the result is M * X_i', where X_i' is X_i with 1 appended to the top. All
+ * the inputs are multiplied by M in a single matrix product.
+ *
+ * The result is written to out, which is only reallocated if its dimensions
+ * are not already correct.
+ */
+template <class T>
+void batch_apt_and_mult(const Matrix <T> &M, const Matrix <T> &X, Matrix <T> &out)
+{
+	size_t rs = M.get_rows();
+	size_t cs = M.get_cols();
+	size_t n = X.get_rows();
+
+	out.resize(n, rs);
+
+	// Start each row from the bias column
+	for (size_t i = 0; i < n; i++) {
+		T *row = out[i];
+
+		for (size_t j = 0; j < rs; j++)
+			row[j] = M[j][0];
+	}
+
+	blas::gemm(blas::no_trans, blas::trans, n, rs, cs - 1,
+			T(1), X[0], cs - 1, M[0] + 1, cs,
+			T(1), out[0], rs);
+}
+
+template <class T>
+Matrix <T> batch_apt_and_mult(const Matrix <T> &M, const Matrix <T> &X)
+{
+	Matrix <T> out;
+
+	batch_apt_and_mult(M, X, out);
+
+	return out;
+}
+
+/**
+ * Batched rmt_and_mult: each row of D is a vector V, and the corresponding row
+ * of the result is M^T * V without its first element.
+ */
+template <class T>
+void batch_rmt_and_mult(const Matrix <T> &M, const Matrix <T> &D, Matrix <T> &out)
+{
+	size_t rs = M.get_rows();
+	size_t cs = M.get_cols();
+	size_t n = D.get_rows();
+
+	out.resize(n, cs - 1);
+
+	blas::gemm(blas::no_trans, blas::no_trans, n, cs - 1, rs,
+			T(1), D[0], rs, M[0] + 1, cs,
+			T(0), out[0], cs - 1);
+}
+
+template <class T>
+Matrix <T> batch_rmt_and_mult(const Matrix <T> &M, const Matrix <T> &D)
+{
+	Matrix <T> out;
+
+	batch_rmt_and_mult(M, D, out);
+
+	return out;
+}
+
+/**
+ * Batched vvt_mult: computes the sum of D_i * (A_i')^T over the rows of D and
+ * A, where A_i' is A_i with 1 appended to the top. The first column of the
+ * result is the sum of the rows of D, and the rest is D^T * A.
+ */
+template <class T>
+void batch_vvt_mult(const Matrix <T> &D, const Matrix <T> &A, Matrix <T> &out)
+{
+	size_t rs = D.get_cols();
+	size_t cs = A.get_cols() + 1;
+	size_t n = D.get_rows();
+
+	out.resize(rs, cs);
+
+	for (size_t i = 0; i < rs; i++)
+		out[i][0] = T(0);
+
+	for (size_t k = 0; k < n; k++) {
+		const T *row = D[k];
+
+		for (size_t i = 0; i < rs; i++)
+			out[i][0] += row[i];
+	}
+
+	blas::gemm(blas::trans, blas::no_trans, rs, cs - 1, n,
+			T(1), D[0], rs, A[0], cs - 1,
+			T(0), out[0] + 1, cs);
+}
+
+template <class T>
+Matrix <T> batch_vvt_mult(const Matrix <T> &D, const Matrix <T> &A)
+{
+	Matrix <T> out;
+
+	batch_vvt_mult(D, A, out);
+
+	return out;
+}
+
+/**
+ * Fused softmax and cross entropy: for each row y of Y (the targets) and p of
+ * P (the outputs of a softmax), the corresponding row of the result is the
+ * derivative of the cross entropy -sum(y log p) with respect to the inputs of
+ * the softmax, which is p * sum(y) - y. Unlike the derivative of the cross
+ * entropy followed by that of the softmax, this does not divide by p and is
+ * exact (the derivative of softmax alone only keeps the diagonal).
+ */
+template <class T>
+void batch_softmax_ce_delta(const Matrix <T> &Y, const Matrix <T> &P, Matrix <T> &out)
+{
+	size_t rs = Y.get_rows();
+	size_t cs = Y.get_cols();
+
+	out.resize(rs, cs);
+	for (size_t i = 0; i < rs; i++) {
+		const T *y = Y[i];
+		const T *p = P[i];
+		T *d = out[i];
+
+		T sum = 0;
+		for (size_t j = 0; j < cs; j++)
+			sum += y[j];
+
+		simd::for_each <T> (cs,
+			[&](auto pk, size_t j) {
+				using K = decltype(pk);
+
+				(K::load(p + j) * K::set(sum) - K::load(y + j)).store(d + j);
+			}
+		);
+	}
+}
+
+#endif
+
 }
 
 #endif
@@ -0,0 +1,414 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#ifndef __AVR
+
+// C/C++ headers
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#else
+
+#include <stddef.h>
+
+#endif
+
+/**
+ * @file parallel.hpp
+ * @brief Parallel execution of the numerical kernels (matrix products and
+ * large elementwise operations) on a persistent pool of worker threads.
+ *
+ * Work is only split across threads when it is large enough (see
+ * parallel::set_threshold) and when the calling thread is not already running
+ * inside of the pool, so small matrices and nested calls stay serial. The
+ * number of threads used is set globally with parallel::set_threads, and can
+ * be overridden for a single call of parallel::for_range.
+ */
+
+namespace zhetapi {
+
+#ifndef __AVR
+
+/**
+ * @brief A fixed set of worker threads which execute batches of indexed tasks.
+ * The thread which submits a batch also works on it, and blocks until every
+ * task of the batch has completed.
+ */
+class ThreadPool {
+	std::vector <std::thread>		_workers;
+
+	std::mutex				_lock;
+	std::mutex				_submit;
+
+	std::condition_variable			_wake;
+	std::condition_variable			_done;
+
+	const std::function <void (size_t)> *	_task = nullptr;
+
+	size_t					_tasks = 0;
+	std::atomic <size_t>			_next;
+
+	size_t					_busy = 0;
+	size_t					_generation = 0;
+
+	std::exception_ptr			_error;
+
+	bool					_stop = false;
+
+	void work();
+	void loop();
+	void dispatch(size_t, const std::function <void (size_t)> &);
+
+	static bool &inside();
+public:
+	explicit ThreadPool(size_t);
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	~ThreadPool();
+
+	size_t size() const;
+
+	void run(size_t, const std::function <void (size_t)> &);
+	bool try_run(size_t, const std::function <void (size_t)> &);
+
+	static bool in_worker();
+
+	static ThreadPool &local(size_t);
+};
+
+/**
+ * @brief Creates a pool with the given number of threads, including the
+ * thread that submits work (so that a pool of size 1 spawns no workers).
+ */
+inline ThreadPool::ThreadPool(size_t threads) : _next(0)
+{
+	for (size_t i = 1; i < threads; i++)
+		_workers.emplace_back(&ThreadPool::loop, this);
+}
+
+inline ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard <std::mutex> guard(_lock);
+
+		_stop = true;
+	}
+
+	_wake.notify_all();
+
+	for (std::thread &t : _workers)
+		t.join();
+}
+
+/**
+ * @return the number of threads which execute tasks, including the thread
+ * which submits them.
+ */
+inline size_t ThreadPool::size() const
+{
+	return _workers.size() + 1;
+}
+
+// Whether the current thread is executing tasks of a pool
+inline bool &ThreadPool::inside()
+{
+	static thread_local bool flag = false;
+
+	return flag;
+}
+
+inline bool ThreadPool::in_worker()
+{
+	return inside();
+}
+
+/**
+ * @brief A pool with the given number of threads which belongs to the calling
+ * thread, for the functions which take a number of threads instead of a pool.
+ * The pool is created on the first call with that number of threads, and is
+ * reused by the next ones until the calling thread exits.
+ */
+inline ThreadPool &ThreadPool::local(size_t threads)
+{
+	static thread_local std::vector <std::unique_ptr <ThreadPool>> pools;
+
+	threads = std::max(threads, (size_t) 1);
+	for (const std::unique_ptr <ThreadPool> &pool : pools) {
+		if (pool->size() == threads)
+			return *pool;
+	}
+
+	pools.emplace_back(new ThreadPool(threads));
+
+	return *pools.back();
+}
+
+inline void ThreadPool::work()
+{
+	bool prev = inside();
+
+	inside() = true;
+
+	size_t i;
+	while ((i = _next++) < _tasks) {
+		try {
+			(*_task)(i);
+		} catch (...) {
+			std::lock_guard <std::mutex> guard(_lock);
+
+			if (!_error)
+				_error = std::current_exception();
+		}
+	}
+
+	inside() = prev;
+}
+
+inline void ThreadPool::loop()
+{
+	size_t seen = 0;
+
+	while (true) {
+		{
+			std::unique_lock <std::mutex> lock(_lock);
+
+			_wake.wait(lock, [&]() {
+				return _stop || _generation != seen;
+			});
+
+			if (_stop)
+				return;
+
+			seen = _generation;
+		}
+
+		work();
+
+		std::lock_guard <std::mutex> guard(_lock);
+		if (--_busy == 0)
+			_done.notify_one();
+	}
+}
+
+// Runs a batch of tasks, with the submission lock already held
+inline void ThreadPool::dispatch(size_t tasks, const std::function <void (size_t)> &task)
+{
+	{
+		std::lock_guard <std::mutex> guard(_lock);
+
+		_task = &task;
+		_tasks = tasks;
+		_next = 0;
+		_busy = _workers.size();
+		_error = nullptr;
+		_generation++;
+	}
+
+	_wake.notify_all();
+
+	work();
+
+	std::exception_ptr error;
+
+	{
+		std::unique_lock <std::mutex> lock(_lock);
+
+		_done.wait(lock, [&]() {
+			return _busy == 0;
+		});
+
+		_task = nullptr;
+
+		std::swap(error, _error);
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+/**
+ * @brief Executes task(i) for every i in [0, tasks) and waits for all of them
+ * to finish. The first exception thrown by a task is rethrown here.
+ */
+inline void ThreadPool::run(size_t tasks, const std::function <void (size_t)> &task)
+{
+	std::lock_guard <std::mutex> submit(_submit);
+
+	dispatch(tasks, task);
+}
+
+/**
+ * @brief Same as run, except that nothing is executed and false is returned if
+ * the pool is already busy with work submitted by another thread.
+ */
+inline bool ThreadPool::try_run(size_t tasks, const std::function <void (size_t)> &task)
+{
+	std::unique_lock <std::mutex> submit(_submit, std::try_to_lock);
+
+	if (!submit.owns_lock())
+		return false;
+
+	dispatch(tasks, task);
+
+	return true;
+}
+
+#endif
+
+namespace parallel {
+
+#ifndef __AVR
+
+// Global configuration and the pool used by the kernels
+struct parallel_state {
+	std::atomic <size_t>		threads;
+	std::atomic <size_t>		threshold;
+
+	std::mutex			lock;
+	std::shared_ptr <ThreadPool>	pool;
+
+	parallel_state()
+			: threads(std::max(std::thread::hardware_concurrency(), 1u)),
+			threshold(1 << 16) {}
+};
+
+inline parallel_state &state()
+{
+	static parallel_state ps;
+
+	return ps;
+}
+
+/**
+ * @brief Sets the number of threads used by the parallel kernels. A value of
+ * 0 selects the number of hardware threads, and 1 disables parallelism. The
+ * worker pool is recreated lazily on the next parallel call.
+ */
+inline void set_threads(size_t threads)
+{
+	parallel_state &ps = state();
+
+	if (!threads)
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	std::lock_guard <std::mutex> guard(ps.lock);
+
+	if (ps.threads != threads) {
+		ps.threads = threads;
+		ps.pool.reset();
+	}
+}
+
+/**
+ * @return the number of threads used by the parallel kernels.
+ */
+inline size_t get_threads()
+{
+	return state().threads;
+}
+
+/**
+ * @brief Sets the minimum amount of work (roughly, the number of scalar
+ * operations) for which a kernel is split across threads.
+ */
+inline void set_threshold(size_t threshold)
+{
+	state().threshold = threshold;
+}
+
+inline size_t get_threshold()
+{
+	return state().threshold;
+}
+
+/**
+ * @brief Partitions the range [0, n) into contiguous blocks and calls
+ * body(start, end) for each of them, in parallel if the work is large enough.
+ *
+ * The partition only depends on n and the number of threads, so the result of
+ * a deterministic body does not depend on scheduling.
+ *
+ * @param n the size of the range.
+ * @param work an estimate of the number of scalar operations for the whole
+ * range, which is compared to the threshold.
+ * @param body the function called for each block.
+ * @param threads the number of threads to use for this call, or 0 to use the
+ * global setting.
+ */
+template <class F>
+void for_range(size_t n, size_t work, const F &body, size_t threads = 0)
+{
+	parallel_state &ps = state();
+
+	if (!threads)
+		threads = ps.threads;
+
+	if (threads < 2 || n < 2 || work < ps.threshold
+			|| ThreadPool::in_worker())
+		return body(0, n);
+
+	std::shared_ptr <ThreadPool> pool;
+
+	{
+		std::lock_guard <std::mutex> guard(ps.lock);
+
+		// A larger thread count for this call grows the pool
+		if (!ps.pool || ps.pool->size() < threads)
+			ps.pool.reset(new ThreadPool(std::max(ps.threads.load(), threads)));
+
+		pool = ps.pool;
+	}
+
+	// A single captured pointer fits in the small buffer of std::function,
+	// so that dispatching the blocks does not allocate
+	struct {
+		size_t		n;
+		size_t		blocks;
+		const F *	body;
+	} range {n, std::min(threads, n), &body};
+
+	size_t blocks = range.blocks;
+
+	auto *rp = &range;
+	std::function <void (size_t)> task = [rp](size_t i) {
+		(*rp->body)((rp->n * i)/rp->blocks, (rp->n * (i + 1))/rp->blocks);
+	};
+
+	// Stay serial when another thread is using the pool
+	if (!pool->try_run(blocks, task))
+		body(0, n);
+}
+
+#else
+
+template <class F>
+void for_range(size_t n, size_t work, const F &body, size_t threads = 0)
+{
+	body(0, n);
+}
+
+#endif
+
+/**
+ * @brief Parallel loop over an elementwise operation of n components.
+ */
+template <class F>
+void for_range(size_t n, const F &body)
+{
+	for_range(n, n, body);
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef SEGMENTS_H_
+#define SEGMENTS_H_
+
+// C/C++ headers
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Engine headers
+#include "../matrix.hpp"
+
+/**
+ * @file segments.hpp
+ * @brief Layout of the activation buffers of a chunk of a batch when the
+ * activations are checkpointed every k layers (see
+ * DNN::set_checkpoint_interval).
+ *
+ * The network is split into segments of k layers. Only the input of the first
+ * layer of each segment and the output of the network get buffers of their
+ * own. The other inputs and the linear outputs of a segment are views of a
+ * storage shared by every segment (as they are recomputed one segment at a
+ * time), which is followed by two buffers for the deltas, used by alternate
+ * layers.
+ *
+ * The widths are those of the inputs of each layer, followed by the width of
+ * the output (size + 1 values).
+ */
+
+namespace zhetapi {
+
+namespace ml {
+
+/**
+ * @return the number of layers per segment for the given checkpoint interval,
+ * or 0 if every activation is kept (intervals of 0, 1, or at least the number
+ * of layers).
+ */
+inline size_t checkpoint_segment(size_t interval, size_t size)
+{
+	return (interval > 1 && interval < size) ? interval : 0;
+}
+
+/**
+ * @brief Counts the components of the activation and delta buffers of a chunk
+ * with k layers per segment.
+ *
+ * @param widths the widths of the inputs of each layer and of the output.
+ * @param size the number of layers.
+ * @param k the number of layers per segment (non-zero).
+ * @param rows the number of rows of the chunk.
+ * @param shared set to the components of the storage shared by the segments
+ * (including the deltas).
+ *
+ * @return the components of every buffer, including the shared storage.
+ */
+inline size_t checkpoint_elements(const size_t *widths, size_t size, size_t k,
+		size_t rows, size_t &shared)
+{
+	size_t total = 0;
+
+	// Checkpoints and output
+	for (size_t i = 0; i < size; i += k)
+		total += rows * widths[i];
+
+	total += rows * widths[size];
+
+	// Largest segment (the linear outputs, and the inputs after the
+	// first), followed by two deltas
+	size_t width = 0;
+
+	shared = 0;
+	for (size_t start = 0; start < size; start += k) {
+		size_t end = std::min(start + k, size);
+
+		size_t used = 0;
+		for (size_t i = start; i < end; i++) {
+			used += rows * widths[i + 1] * ((i + 1 < end) ? 2 : 1);
+
+			width = std::max(width, widths[i + 1]);
+		}
+
+		shared = std::max(shared, used);
+	}
+
+	shared += 2 * rows * width;
+
+	return total + shared;
+}
+
+/**
+ * @brief Lays out the activation buffers of a chunk with k layers per
+ * segment. The inputs A[1..size] which are not checkpoints, the derivatives Z
+ * and the deltas D become views of the shared storage (which is resized). The
+ * other inputs, except for A[0], are sized as buffers of their own. The
+ * matrices are expected to be empty, so that the views replace no buffers.
+ */
+template <class T>
+void checkpoint_views(const size_t *widths, size_t size, size_t k,
+		size_t rows, std::vector <T> &storage,
+		Matrix <T> *A, Matrix <T> *Z, Matrix <T> *D)
+{
+	size_t shared;
+	checkpoint_elements(widths, size, k, rows, shared);
+
+	storage.assign(shared, T(0));
+
+	T *base = storage.data();
+
+	size_t width = 0;
+	for (size_t start = 0; start < size; start += k) {
+		size_t end = std::min(start + k, size);
+
+		T *p = base;
+		for (size_t i = start; i < end; i++) {
+			Z[i] = Matrix <T> (rows, widths[i + 1], p);
+			p += rows * widths[i + 1];
+
+			if (i + 1 < end) {
+				A[i + 1] = Matrix <T> (rows, widths[i + 1], p);
+				p += rows * widths[i + 1];
+			} else {
+				A[i + 1].resize(rows, widths[i + 1]);
+			}
+
+			width = std::max(width, widths[i + 1]);
+		}
+	}
+
+	// The deltas of consecutive layers are in different buffers
+	T *deltas = base + shared - 2 * rows * width;
+	for (size_t i = 0; i < size; i++) {
+		D[i] = Matrix <T> (rows, widths[i + 1],
+				deltas + (i % 2) * rows * width);
+	}
+}
+
+}
+
+}
+
+#endif
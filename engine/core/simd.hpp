@@ -0,0 +1,540 @@
+#ifndef SIMD_H_
+#define SIMD_H_
+
+// C/C++ headers
+#include <cmath>
+#include <cstddef>
+
+// SSE2 is part of the x86-64 baseline, so it needs no runtime dispatch
+#if defined(__SSE2__) && defined(__GNUC__) && !defined(__CUDACC__)
+
+#define ZHP_SIMD_SSE2
+
+#include <emmintrin.h>
+
+#endif
+
+/**
+ * @file simd.hpp
+ * @brief Short vectors ("packs") of floating point components for elementwise
+ * kernels which are written once and run on several components at a time.
+ *
+ * A kernel is a generic lambda which takes a pack type P and an index i, and
+ * processes the components [i, i + P::width) through P::load, P::store,
+ * P::set and the arithmetic operators. simd::for_each runs it with the widest
+ * pack available for T, and finishes the components that are left over with a
+ * partial pack of the same type (padded with zeros), so that every component
+ * goes through the same instructions, wherever it is in the array. Packs do
+ * not fuse multiplies and adds.
+ *
+ * The exponential (and the sigmoid and tanh built on it) of the wider packs
+ * is a polynomial approximation, accurate to a few ulps, which saturates
+ * instead of overflowing. On scalars (when T has no wider pack), these use
+ * the standard library.
+ */
+
+namespace zhetapi {
+
+namespace simd {
+
+/**
+ * @brief A pack of a single component, which works for any type.
+ */
+template <class T>
+struct scalar {
+	using value_type = T;
+
+	static const size_t width = 1;
+
+	T v;
+
+	static scalar load(const T *p) {
+		return {*p};
+	}
+
+	static scalar set(const T &x) {
+		return {x};
+	}
+
+	void store(T *p) const {
+		*p = v;
+	}
+};
+
+template <class T>
+inline scalar <T> operator+(const scalar <T> &a, const scalar <T> &b)
+{
+	return {a.v + b.v};
+}
+
+template <class T>
+inline scalar <T> operator-(const scalar <T> &a, const scalar <T> &b)
+{
+	return {a.v - b.v};
+}
+
+template <class T>
+inline scalar <T> operator*(const scalar <T> &a, const scalar <T> &b)
+{
+	return {a.v * b.v};
+}
+
+template <class T>
+inline scalar <T> operator/(const scalar <T> &a, const scalar <T> &b)
+{
+	return {a.v / b.v};
+}
+
+template <class T>
+inline scalar <T> sqrt(const scalar <T> &a)
+{
+	using std::sqrt;
+
+	return {T(sqrt(a.v))};
+}
+
+// Return the second argument if either is NaN, like the SSE instructions
+template <class T>
+inline scalar <T> max(const scalar <T> &a, const scalar <T> &b)
+{
+	return {(a.v > b.v) ? a.v : b.v};
+}
+
+template <class T>
+inline scalar <T> min(const scalar <T> &a, const scalar <T> &b)
+{
+	return {(a.v < b.v) ? a.v : b.v};
+}
+
+// x where a < b, and y elsewhere
+template <class T>
+inline scalar <T> select_less(const scalar <T> &a, const scalar <T> &b,
+		const scalar <T> &x, const scalar <T> &y)
+{
+	return {(a.v < b.v) ? x.v : y.v};
+}
+
+template <class T>
+inline scalar <T> exp(const scalar <T> &a)
+{
+	using std::exp;
+
+	return {T(exp(a.v))};
+}
+
+template <class T>
+inline scalar <T> tanh(const scalar <T> &a)
+{
+	using std::tanh;
+
+	return {T(tanh(a.v))};
+}
+
+/**
+ * @brief The widest pack for T (scalar unless specialized).
+ */
+template <class T>
+struct pack {
+	using type = scalar <T>;
+};
+
+#ifdef ZHP_SIMD_SSE2
+
+struct sse2_double {
+	using value_type = double;
+
+	static const size_t width = 2;
+
+	__m128d v;
+
+	static sse2_double load(const double *p) {
+		return {_mm_loadu_pd(p)};
+	}
+
+	static sse2_double set(double x) {
+		return {_mm_set1_pd(x)};
+	}
+
+	void store(double *p) const {
+		_mm_storeu_pd(p, v);
+	}
+};
+
+inline sse2_double operator+(const sse2_double &a, const sse2_double &b)
+{
+	return {_mm_add_pd(a.v, b.v)};
+}
+
+inline sse2_double operator-(const sse2_double &a, const sse2_double &b)
+{
+	return {_mm_sub_pd(a.v, b.v)};
+}
+
+inline sse2_double operator*(const sse2_double &a, const sse2_double &b)
+{
+	return {_mm_mul_pd(a.v, b.v)};
+}
+
+inline sse2_double operator/(const sse2_double &a, const sse2_double &b)
+{
+	return {_mm_div_pd(a.v, b.v)};
+}
+
+inline sse2_double sqrt(const sse2_double &a)
+{
+	return {_mm_sqrt_pd(a.v)};
+}
+
+inline sse2_double max(const sse2_double &a, const sse2_double &b)
+{
+	return {_mm_max_pd(a.v, b.v)};
+}
+
+inline sse2_double min(const sse2_double &a, const sse2_double &b)
+{
+	return {_mm_min_pd(a.v, b.v)};
+}
+
+inline sse2_double select_less(const sse2_double &a, const sse2_double &b,
+		const sse2_double &x, const sse2_double &y)
+{
+	__m128d m = _mm_cmplt_pd(a.v, b.v);
+
+	return {_mm_or_pd(_mm_and_pd(m, x.v), _mm_andnot_pd(m, y.v))};
+}
+
+// Rounds to the nearest integer (|a| < 2^31)
+inline sse2_double round(const sse2_double &a)
+{
+	return {_mm_cvtepi32_pd(_mm_cvtpd_epi32(a.v))};
+}
+
+// 2^n for integers n in the range of the exponent
+inline sse2_double exp2i(const sse2_double &n)
+{
+	__m128i k = _mm_add_epi32(_mm_cvtpd_epi32(n.v), _mm_set1_epi32(1023));
+
+	k = _mm_unpacklo_epi32(k, _mm_setzero_si128());
+
+	return {_mm_castsi128_pd(_mm_slli_epi64(k, 52))};
+}
+
+struct sse2_float {
+	using value_type = float;
+
+	static const size_t width = 4;
+
+	__m128 v;
+
+	static sse2_float load(const float *p) {
+		return {_mm_loadu_ps(p)};
+	}
+
+	static sse2_float set(float x) {
+		return {_mm_set1_ps(x)};
+	}
+
+	void store(float *p) const {
+		_mm_storeu_ps(p, v);
+	}
+};
+
+inline sse2_float operator+(const sse2_float &a, const sse2_float &b)
+{
+	return {_mm_add_ps(a.v, b.v)};
+}
+
+inline sse2_float operator-(const sse2_float &a, const sse2_float &b)
+{
+	return {_mm_sub_ps(a.v, b.v)};
+}
+
+inline sse2_float operator*(const sse2_float &a, const sse2_float &b)
+{
+	return {_mm_mul_ps(a.v, b.v)};
+}
+
+inline sse2_float operator/(const sse2_float &a, const sse2_float &b)
+{
+	return {_mm_div_ps(a.v, b.v)};
+}
+
+inline sse2_float sqrt(const sse2_float &a)
+{
+	return {_mm_sqrt_ps(a.v)};
+}
+
+inline sse2_float max(const sse2_float &a, const sse2_float &b)
+{
+	return {_mm_max_ps(a.v, b.v)};
+}
+
+inline sse2_float min(const sse2_float &a, const sse2_float &b)
+{
+	return {_mm_min_ps(a.v, b.v)};
+}
+
+inline sse2_float select_less(const sse2_float &a, const sse2_float &b,
+		const sse2_float &x, const sse2_float &y)
+{
+	__m128 m = _mm_cmplt_ps(a.v, b.v);
+
+	return {_mm_or_ps(_mm_and_ps(m, x.v), _mm_andnot_ps(m, y.v))};
+}
+
+inline sse2_float round(const sse2_float &a)
+{
+	return {_mm_cvtepi32_ps(_mm_cvtps_epi32(a.v))};
+}
+
+inline sse2_float exp2i(const sse2_float &n)
+{
+	__m128i k = _mm_add_epi32(_mm_cvtps_epi32(n.v), _mm_set1_epi32(127));
+
+	return {_mm_castsi128_ps(_mm_slli_epi32(k, 23))};
+}
+
+/*
+ * exp(x) = 2^n * exp(r), with n the integer nearest to x / log(2), and
+ * r = x - n * log(2) (in two parts, so that it is exact) in [-log(2)/2,
+ * log(2)/2], where exp(r) is a truncated Taylor series. The input is clamped
+ * so that 2^n is a normal number; NaNs go through.
+ */
+template <class P>
+P exp_poly(const P &x)
+{
+	using T = typename P::value_type;
+
+	// Inverse factorials
+	static const double c[] = {
+		1.0, 1.0, 1.0/2, 1.0/6, 1.0/24, 1.0/120, 1.0/720, 1.0/5040,
+		1.0/40320, 1.0/362880, 1.0/3628800, 1.0/39916800,
+		1.0/479001600, 1.0/6227020800.0
+	};
+
+	const bool single = sizeof(T) < sizeof(double);
+
+	const size_t degree = single ? 7 : 13;
+
+	T lo = single ? T(-87) : T(-708);
+	T hi = single ? T(88) : T(709);
+
+	T ln2_hi = single ? T(0.693359375) : T(0.693145751953125);
+	T ln2_lo = single ? T(-2.12194440e-4) : T(1.42860682030941723212e-6);
+
+	P xc = min(P::set(hi), max(P::set(lo), x));
+	P n = round(xc * P::set(T(1.44269504088896340736)));
+	P r = (xc - n * P::set(ln2_hi)) - n * P::set(ln2_lo);
+
+	P p = P::set(T(c[degree]));
+	for (size_t k = degree; k-- > 0; )
+		p = p * r + P::set(T(c[k]));
+
+	return p * exp2i(n);
+}
+
+inline sse2_double exp(const sse2_double &x)
+{
+	return exp_poly(x);
+}
+
+inline sse2_float exp(const sse2_float &x)
+{
+	return exp_poly(x);
+}
+
+template <>
+struct pack <double> {
+	using type = sse2_double;
+};
+
+template <>
+struct pack <float> {
+	using type = sse2_float;
+};
+
+#endif
+
+// 1/(1 + exp(-x))
+template <class P>
+inline P sigmoid(const P &x)
+{
+	return P::set(1) / (P::set(1) + exp(P::set(0) - x));
+}
+
+/*
+ * tanh(|x|) is 1 - 2/(exp(2|x|) + 1) for |x| >= 1/2, where it is at least
+ * 0.46, and e/(e + 2) with e = expm1(2|x|) below, where expm1 is a truncated
+ * Taylor series (on [0, 1)), so that the cancellation of the first form near
+ * 0 is avoided. The sign of x is restored at the end.
+ */
+template <class P>
+P tanh(const P &x)
+{
+	using T = typename P::value_type;
+
+	// Inverse factorials, from 1/1!
+	static const double c[] = {
+		1.0, 1.0/2, 1.0/6, 1.0/24, 1.0/120, 1.0/720, 1.0/5040,
+		1.0/40320, 1.0/362880, 1.0/3628800, 1.0/39916800,
+		1.0/479001600, 1.0/6227020800.0, 1.0/87178291200.0,
+		1.0/1307674368000.0, 1.0/20922789888000.0,
+		1.0/355687428096000.0, 1.0/6402373705728000.0
+	};
+
+	const size_t degree = (sizeof(T) < sizeof(double)) ? 10 : 18;
+
+	P zero = P::set(0);
+	P ax = max(x, zero - x);
+	P u = P::set(2) * ax;
+
+	P p = P::set(T(c[degree - 1]));
+	for (size_t k = degree - 1; k-- > 0; )
+		p = p * u + P::set(T(c[k]));
+
+	P e = p * u;
+
+	P small = e / (e + P::set(2));
+	P large = P::set(1) - P::set(2) / (exp(u) + P::set(1));
+
+	P t = select_less(ax, P::set(T(0.5)), small, large);
+
+	return select_less(x, zero, zero - t, t);
+}
+
+/**
+ * @brief The first N components of a pack P: loads fill the other components
+ * with zeros, and stores leave the memory after the first N untouched.
+ */
+template <class P, size_t N>
+struct partial {
+	using value_type = typename P::value_type;
+
+	static const size_t width = N;
+
+	P v;
+
+	static partial load(const value_type *p) {
+		value_type buf[P::width] = {};
+		for (size_t i = 0; i < N; i++)
+			buf[i] = p[i];
+
+		return {P::load(buf)};
+	}
+
+	static partial set(const value_type &x) {
+		return {P::set(x)};
+	}
+
+	void store(value_type *p) const {
+		value_type buf[P::width];
+
+		v.store(buf);
+		for (size_t i = 0; i < N; i++)
+			p[i] = buf[i];
+	}
+};
+
+template <class P, size_t N>
+inline partial <P, N> operator+(const partial <P, N> &a, const partial <P, N> &b)
+{
+	return {a.v + b.v};
+}
+
+template <class P, size_t N>
+inline partial <P, N> operator-(const partial <P, N> &a, const partial <P, N> &b)
+{
+	return {a.v - b.v};
+}
+
+template <class P, size_t N>
+inline partial <P, N> operator*(const partial <P, N> &a, const partial <P, N> &b)
+{
+	return {a.v * b.v};
+}
+
+template <class P, size_t N>
+inline partial <P, N> operator/(const partial <P, N> &a, const partial <P, N> &b)
+{
+	return {a.v / b.v};
+}
+
+template <class P, size_t N>
+inline partial <P, N> sqrt(const partial <P, N> &a)
+{
+	return {sqrt(a.v)};
+}
+
+template <class P, size_t N>
+inline partial <P, N> max(const partial <P, N> &a, const partial <P, N> &b)
+{
+	return {max(a.v, b.v)};
+}
+
+template <class P, size_t N>
+inline partial <P, N> min(const partial <P, N> &a, const partial <P, N> &b)
+{
+	return {min(a.v, b.v)};
+}
+
+template <class P, size_t N>
+inline partial <P, N> select_less(const partial <P, N> &a, const partial <P, N> &b,
+		const partial <P, N> &x, const partial <P, N> &y)
+{
+	return {select_less(a.v, b.v, x.v, y.v)};
+}
+
+template <class P, size_t N>
+inline partial <P, N> exp(const partial <P, N> &a)
+{
+	return {exp(a.v)};
+}
+
+template <class P, size_t N>
+inline partial <P, N> tanh(const partial <P, N> &a)
+{
+	return {tanh(a.v)};
+}
+
+// Runs the kernel on the last n < P::width components, from i, with the
+// partial pack of the right width (chosen at compile time)
+template <class P, size_t N = 1, bool = (N < P::width)>
+struct tail {
+	template <class F>
+	static void run(size_t n, size_t i, const F &kernel) {
+		if (n == N)
+			kernel(partial <P, N> (), i);
+		else
+			tail <P, N + 1> ::run(n, i, kernel);
+	}
+};
+
+template <class P, size_t N>
+struct tail <P, N, false> {
+	template <class F>
+	static void run(size_t, size_t, const F &) {}
+};
+
+/**
+ * @brief Runs kernel(P(), i) over the components [0, n), in packs of the
+ * widest type available for T, and then once with a partial pack for the
+ * components that are left over.
+ */
+template <class T, class F>
+void for_each(size_t n, const F &kernel)
+{
+	using P = typename pack <T> ::type;
+
+	size_t i = 0;
+	for (; i + P::width <= n; i += P::width)
+		kernel(P(), i);
+
+	if (i < n)
+		tail <P> ::run(n - i, i, kernel);
+}
+
+}
+
+}
+
+#endif
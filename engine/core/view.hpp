@@ -0,0 +1,223 @@
+#ifndef VIEW_H_
+#define VIEW_H_
+
+// C/C++ headers
+#include <cstddef>
+#include <type_traits>
+
+/**
+ * @file view.hpp
+ * @brief Non-owning, strided views of two dimensional arrays. A view is
+ * described by a base pointer, an offset, a shape (rows and columns) and a
+ * stride for each dimension, so that sub-blocks, rows, columns and transposes
+ * of a matrix are all views of the same memory and can be taken without
+ * copying anything.
+ *
+ * Views do not own or track the lifetime of their memory: they are only valid
+ * while the underlying Matrix (or buffer) is alive and not resized. A view of
+ * const T is read-only, and views of T convert to views of const T.
+ */
+
+namespace zhetapi {
+
+/**
+ * @brief A strided, non-owning view of a two dimensional array. The component
+ * at (i, j) is base[offset + i * row_stride + j * col_stride].
+ *
+ * @tparam T the type of each component, const qualified for read-only views.
+ */
+template <class T>
+class MatrixView {
+	T *	_base		= nullptr;
+	size_t	_offset		= 0;
+
+	size_t	_rows		= 0;
+	size_t	_cols		= 0;
+
+	size_t	_row_stride	= 0;
+	size_t	_col_stride	= 1;
+public:
+	MatrixView() {}
+
+	/**
+	 * @brief Constructs a view from its components.
+	 *
+	 * @param base the start of the underlying memory.
+	 * @param offset the position of the component at (0, 0) from base.
+	 * @param rows the number of rows.
+	 * @param cols the number of columns.
+	 * @param row_stride the distance between consecutive rows.
+	 * @param col_stride the distance between consecutive columns.
+	 */
+	MatrixView(T *base, size_t offset, size_t rows, size_t cols,
+			size_t row_stride, size_t col_stride = 1)
+			: _base(base), _offset(offset),
+			_rows(rows), _cols(cols),
+			_row_stride(row_stride), _col_stride(col_stride) {}
+
+	/**
+	 * @brief Conversion from a view of non-const to a view of const
+	 * components.
+	 */
+	template <class U, class = typename std::enable_if <
+		std::is_same <const U, T> ::value
+			&& !std::is_same <U, T> ::value> ::type>
+	MatrixView(const MatrixView <U> &other)
+			: _base(other.base()), _offset(other.offset()),
+			_rows(other.get_rows()), _cols(other.get_cols()),
+			_row_stride(other.row_stride()),
+			_col_stride(other.col_stride()) {}
+
+	T *base() const
+	{
+		return _base;
+	}
+
+	size_t offset() const
+	{
+		return _offset;
+	}
+
+	size_t get_rows() const
+	{
+		return _rows;
+	}
+
+	size_t get_cols() const
+	{
+		return _cols;
+	}
+
+	size_t size() const
+	{
+		return _rows * _cols;
+	}
+
+	size_t row_stride() const
+	{
+		return _row_stride;
+	}
+
+	size_t col_stride() const
+	{
+		return _col_stride;
+	}
+
+	/**
+	 * @return a pointer to the component at (0, 0).
+	 */
+	T *data() const
+	{
+		return _base + _offset;
+	}
+
+	/**
+	 * @return whether each row is contiguous in memory, so that the view can
+	 * be passed to kernels which take a pointer and a leading dimension.
+	 */
+	bool row_major() const
+	{
+		return _col_stride == 1 || _cols <= 1;
+	}
+
+	/**
+	 * @return whether the entire view is a single contiguous row-major
+	 * block.
+	 */
+	bool contiguous() const
+	{
+		return row_major() && (_row_stride == _cols || _rows <= 1);
+	}
+
+	T &operator()(size_t i, size_t j) const
+	{
+		return _base[_offset + i * _row_stride + j * _col_stride];
+	}
+
+	/**
+	 * @brief Sub-block of the view.
+	 *
+	 * @param i the first row of the block.
+	 * @param j the first column of the block.
+	 * @param rows the number of rows of the block.
+	 * @param cols the number of columns of the block.
+	 */
+	MatrixView block(size_t i, size_t j, size_t rows, size_t cols) const
+	{
+		return MatrixView(_base, _offset + i * _row_stride + j * _col_stride,
+				rows, cols, _row_stride, _col_stride);
+	}
+
+	/**
+	 * @return row i, as a 1 x cols view.
+	 */
+	MatrixView row(size_t i) const
+	{
+		return block(i, 0, 1, _cols);
+	}
+
+	/**
+	 * @return the rows [start, end), as an (end - start) x cols view.
+	 */
+	MatrixView row_range(size_t start, size_t end) const
+	{
+		return block(start, 0, end - start, _cols);
+	}
+
+	/**
+	 * @return column j, as a rows x 1 view.
+	 */
+	MatrixView column(size_t j) const
+	{
+		return block(0, j, _rows, 1);
+	}
+
+	/**
+	 * @return the transpose, which swaps the shape and the strides.
+	 */
+	MatrixView transpose() const
+	{
+		return MatrixView(_base, _offset, _cols, _rows,
+				_col_stride, _row_stride);
+	}
+};
+
+/**
+ * @brief Copies the components of one view into another of the same shape.
+ * The views must not overlap.
+ */
+template <class T, class U>
+void copy(const MatrixView <T> &src, const MatrixView <U> &dst)
+{
+	size_t rs = src.get_rows();
+	size_t cs = src.get_cols();
+
+	for (size_t i = 0; i < rs; i++) {
+		if (src.row_major() && dst.row_major()) {
+			const T *s = &src(i, 0);
+			U *d = &dst(i, 0);
+
+			for (size_t j = 0; j < cs; j++)
+				d[j] = s[j];
+		} else {
+			for (size_t j = 0; j < cs; j++)
+				dst(i, j) = src(i, j);
+		}
+	}
+}
+
+/**
+ * @brief Sets every component of a view.
+ */
+template <class T>
+void fill(const MatrixView <T> &dst, const T &x)
+{
+	for (size_t i = 0; i < dst.get_rows(); i++) {
+		for (size_t j = 0; j < dst.get_cols(); j++)
+			dst(i, j) = x;
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,422 @@
+#ifndef DATA_PARALLEL_H_
+#define DATA_PARALLEL_H_
+
+#ifndef __AVR	// Does not support AVR
+
+// C/C++ headers
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <cerrno>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Engine headers
+#include "communicator.hpp"
+#include "dataset.hpp"
+#include "dnn.hpp"
+#include "erf.hpp"
+#include "model_file.hpp"
+#include "optimizer.hpp"
+#include "training.hpp"
+#include "workspace.hpp"
+
+#include "core/parallel.hpp"
+
+namespace zhetapi {
+
+namespace ml {
+
+// Transports of the gradients between the worker processes
+enum dp_transport {
+	DP_SharedMemory,	// See SharedMemoryCommunicator
+	DP_LocalSocket		// See SocketCommunicator
+};
+
+// Statistics of a data parallel training
+template <class T>
+struct DataParallelStatistics {
+	T	_cost		= T(0);		// Over the last epoch
+	size_t	_passed		= 0;		// Over the last epoch
+
+	size_t	_workers	= 1;
+	size_t	_samples	= 0;		// Trained on, over every epoch
+
+	double	_kernel_time	= 0;		// Microseconds (slowest worker)
+	double	_wall_time	= 0;		// Microseconds
+	double	_throughput	= 0;		// Samples per second
+
+	// Whether the weights of every replica were identical at the end
+	bool	_identical	= true;
+};
+
+// Exception thrown when a worker process fails
+class worker_error {};
+
+// Results of a worker, in shared memory
+struct WorkerRecord {
+	double		cost		= 0;
+	size_t		passed		= 0;
+	double		kernel_time	= 0;
+	uint64_t	checksum	= 0;
+};
+
+template <class T>
+uint64_t weights_checksum(DNN <T> &dnn)
+{
+	uint64_t hash = ModelFile::checksum(nullptr, 0);
+	for (size_t i = 0; i < dnn.size(); i++) {
+		const Matrix <T> &W = dnn.layers()[i].mat();
+
+		hash = ModelFile::checksum((const unsigned char *) W[0],
+				W.size() * sizeof(T), hash);
+	}
+
+	return hash;
+}
+
+/*
+ * Training loop of a replica: each batch is split into one shard per rank,
+ * the gradients of the shards are summed with the communicator, and every
+ * replica applies the same averaged gradient with its own copy of the
+ * optimizer (so that the replicas stay identical).
+ */
+template <class T>
+void data_parallel_worker(
+		DNN <T> &dnn,
+		const PackedDataSet <T> &ins,
+		const PackedDataSet <T> &outs,
+		size_t batch_size,
+		size_t epochs,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		Comparator <T> cmp,
+		Communicator <T> &comm,
+		WorkerRecord &record)
+{
+	size_t rank = comm.rank();
+	size_t workers = comm.size();
+	size_t size = dnn.size();
+
+	Layer <T> *layers = dnn.layers();
+
+	Workspace <T> ws(dnn, (batch_size + workers - 1)/workers, 1);
+
+	// The averaged gradients, and their flattened sums
+	std::vector <Matrix <T>> G(size);
+
+	size_t params = 0;
+	for (size_t k = 0; k < size; k++) {
+		G[k] = Matrix <T> (layers[k].mat().get_rows(),
+				layers[k].mat().get_cols());
+
+		params += G[k].size();
+	}
+
+	std::vector <T> flat(params);
+
+	size_t n = ins.size();
+	for (size_t e = 0; e < epochs; e++) {
+		record.cost = 0;
+		record.passed = 0;
+
+		for (size_t b = 0; b < n; b += batch_size) {
+			size_t global = std::min(batch_size, n - b);
+
+			size_t start = b + (global * rank)/workers;
+			size_t end = b + (global * (rank + 1))/workers;
+
+			size_t local = end - start;
+
+			if (local) {
+				ws.load(ins.batch(start, end), outs.batch(start, end));
+
+				typename Workspace <T> ::Chunk &ch = ws[0];
+
+				const Matrix <T> &P = dnn.infer(ch.A[0], ws.scratch());
+
+				for (size_t i = 0; i < P.get_rows(); i++) {
+					// Slices of the rows (not copied)
+					Vector <T> to(P.get_cols(), const_cast <T *> (P[i]));
+					Vector <T> out(ch.Y.get_cols(), ch.Y[i]);
+
+					record.cost += erf->compute(to, out).x();
+					record.passed += cmp(to, out);
+				}
+			}
+
+			Profiler::clock::time_point t = Profiler::clock::now();
+
+			// Sum of the gradients of the shard
+			if (local) {
+				Matrix <T> *J = workspace_gradient(layers, ws, erf);
+
+				size_t off = 0;
+				for (size_t k = 0; k < size; k++) {
+					const T *src = J[k][0];
+					for (size_t j = 0; j < J[k].size(); j++)
+						flat[off + j] = src[j] * T(local);
+
+					off += J[k].size();
+				}
+			} else {
+				std::fill(flat.begin(), flat.end(), T(0));
+			}
+
+			comm.all_reduce(flat.data(), params);
+
+			size_t off = 0;
+			for (size_t k = 0; k < size; k++) {
+				T *dst = G[k][0];
+				for (size_t j = 0; j < G[k].size(); j++)
+					dst[j] = flat[off + j]/T(global);
+
+				off += G[k].size();
+			}
+
+			opt->step(layers, G.data(), size);
+
+			record.kernel_time += elapsed_us(t);
+		}
+	}
+
+	record.checksum = weights_checksum(dnn);
+}
+
+/**
+ * @brief Data parallel training on local worker processes. Each worker is a
+ * process forked from the caller, with its own replica of the network and of
+ * the optimizer, and trains on a shard of every batch (the batches are
+ * consecutive samples, as in train_dataset_perf). The gradients of the shards
+ * are summed after every step with an all-reduce, over shared memory or over a
+ * ring of local sockets, so the replicas apply the same update and keep
+ * identical weights.
+ *
+ * Each worker runs its kernels on a single thread, so the number of workers
+ * plays the role of the number of threads. The weights of the network are
+ * updated with those of the replicas at the end, but the state of the
+ * optimizer of the caller (such as the moments of Adam) is not.
+ *
+ * @param dnn the network.
+ * @param ins the inputs.
+ * @param outs the targets.
+ * @param batch_size the number of samples of each step (over every worker).
+ * @param epochs the number of passes over the data.
+ * @param erf the cost function.
+ * @param opt the optimizer.
+ * @param workers the number of worker processes.
+ * @param transport the transport of the gradients.
+ * @param cmp the comparator for the statistics.
+ *
+ * @return the statistics of the training, including its throughput.
+ */
+template <class T>
+DataParallelStatistics <T> train_data_parallel(
+		DNN <T> &dnn,
+		const DataSet <T> &ins,
+		const DataSet <T> &outs,
+		size_t batch_size,
+		size_t epochs,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		size_t workers,
+		dp_transport transport = DP_SharedMemory,
+		Comparator <T> cmp = _def_cmp <T>)
+{
+	assert(ins.size() == outs.size());
+
+	workers = std::max(workers, (size_t) 1);
+	batch_size = std::max(batch_size, (size_t) 1);
+
+	PackedDataSet <T> pins(ins);
+	PackedDataSet <T> pouts(outs);
+
+	size_t params = 0;
+	for (size_t k = 0; k < dnn.size(); k++)
+		params += dnn.layers()[k].mat().size();
+
+	// Records of the workers, and the final weights
+	size_t records = ((workers * sizeof(WorkerRecord) + 63)/64) * 64;
+
+	SharedRegion results(records + params * sizeof(T));
+
+	WorkerRecord *record = (WorkerRecord *) results.data();
+	T *weights = (T *) ((char *) results.data() + records);
+
+	for (size_t r = 0; r < workers; r++)
+		new (record + r) WorkerRecord();
+
+	std::unique_ptr <SharedRegion> slots;
+	if (transport == DP_SharedMemory) {
+		slots.reset(new SharedRegion(SharedMemoryCommunicator <T>
+				::bytes(workers, params)));
+
+		SharedMemoryCommunicator <T> ::initialize(*slots, workers);
+	}
+
+	std::vector <int> next;
+	std::vector <int> prev;
+
+	if (transport == DP_LocalSocket)
+		local_ring(workers, next, prev);
+
+	auto close_all = [&]() {
+		for (size_t r = 0; r < next.size(); r++) {
+			close_socket(next[r]);
+			close_socket(prev[r]);
+		}
+	};
+
+	auto start = Profiler::clock::now();
+
+	std::vector <pid_t> pids;
+	for (size_t rank = 0; rank < workers; rank++) {
+		pid_t pid = fork();
+
+		// The workers which were started stop at their next step
+		if (pid < 0) {
+			if (slots)
+				((SharedBarrier *) slots->data())->abort();
+
+			break;
+		}
+
+		if (pid > 0) {
+			pids.push_back(pid);
+
+			continue;
+		}
+
+		// Worker: the threads of the caller do not exist in this process,
+		// so its kernels must not use the global pool
+		parallel::state().threads = 1;
+
+		int status = 0;
+
+		try {
+			std::unique_ptr <Communicator <T>> comm;
+
+			if (transport == DP_SharedMemory) {
+				comm.reset(new SharedMemoryCommunicator <T> (*slots,
+						rank, workers, params));
+			} else {
+				for (size_t r = 0; r < workers; r++) {
+					if (r != rank) {
+						close_socket(next[r]);
+						close_socket(prev[r]);
+					}
+				}
+
+				comm.reset(new SocketCommunicator <T> (rank, workers,
+						next[rank], prev[rank]));
+			}
+
+			data_parallel_worker(dnn, pins, pouts, batch_size, epochs,
+					erf, opt, cmp, *comm, record[rank]);
+
+			if (rank == 0) {
+				size_t off = 0;
+				for (size_t k = 0; k < dnn.size(); k++) {
+					const Matrix <T> &W = dnn.layers()[k].mat();
+
+					std::copy(W[0], W[0] + W.size(), weights + off);
+
+					off += W.size();
+				}
+			}
+		} catch (...) {
+			if (slots)
+				((SharedBarrier *) slots->data())->abort();
+
+			status = 1;
+		}
+
+		_exit(status);
+	}
+
+	// The workers hold the only copies of their sockets, so that the others
+	// notice when one of them exits
+	close_all();
+
+	// The workers are reaped in the order in which they exit. A worker which
+	// dies (for example from a signal) cannot abort the barrier itself, so
+	// it is aborted as soon as the exit is seen, which stops the others. Only
+	// the workers are waited for (not every child of the process), so that
+	// the children of the caller are left alone.
+	bool failed = (pids.size() < workers);
+
+	std::vector <bool> reaped(pids.size(), false);
+
+	size_t running = pids.size();
+	while (running) {
+		size_t before = running;
+
+		for (size_t r = 0; r < pids.size(); r++) {
+			if (reaped[r])
+				continue;
+
+			int status;
+
+			pid_t pid = waitpid(pids[r], &status, WNOHANG);
+			if (pid == 0 || (pid < 0 && errno == EINTR))
+				continue;
+
+			reaped[r] = true;
+			running--;
+
+			if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) {
+				if (slots)
+					((SharedBarrier *) slots->data())->abort();
+
+				failed = true;
+			}
+		}
+
+		if (running == before)
+			usleep(1000);
+	}
+
+	if (failed)
+		throw worker_error();
+
+	DataParallelStatistics <T> stats;
+
+	stats._workers = workers;
+	stats._samples = epochs * ins.size();
+	stats._wall_time = elapsed_us(start);
+
+	if (stats._wall_time > 0)
+		stats._throughput = 1e6 * stats._samples/stats._wall_time;
+
+	for (size_t r = 0; r < workers; r++) {
+		stats._cost += T(record[r].cost);
+		stats._passed += record[r].passed;
+		stats._kernel_time = std::max(stats._kernel_time,
+				record[r].kernel_time);
+
+		stats._identical &= (record[r].checksum == record[0].checksum);
+	}
+
+	size_t off = 0;
+	for (size_t k = 0; k < dnn.size(); k++) {
+		Matrix <T> &W = dnn.layers()[k].mat();
+
+		std::copy(weights + off, weights + off + W.size(), W[0]);
+
+		off += W.size();
+	}
+
+	return stats;
+}
+
+}
+
+}
+
+#endif		// Does not support AVR
+
+#endif
@@ -4,6 +4,8 @@
 #ifndef __AVR
 
 // C/C++ headers
+#include <algorithm>
+#include <numeric>
 #include <vector>
 
 // Engine headers
@@ -14,6 +16,52 @@ namespace zhetapi {
 template <class T>
 using DataSet = std::vector <Vector <T>>;
 
+/**
+ * @brief Packs the samples [start, end) of a data set into a matrix, with one
+ * sample per row, for batched computation. The matrix is only reallocated if
+ * its dimensions change.
+ */
+template <class T>
+void to_matrix(const DataSet <T> &dset, size_t start, size_t end, Matrix <T> &out)
+{
+	if (start >= end) {
+		out.resize(0, 0);
+
+		return;
+	}
+
+	size_t rs = end - start;
+	size_t cs = dset[start].size();
+
+	out.resize(rs, cs);
+	for (size_t i = 0; i < rs; i++) {
+		T *row = out[i];
+
+		for (size_t j = 0; j < cs; j++)
+			row[j] = dset[start + i][j];
+	}
+}
+
+template <class T>
+Matrix <T> to_matrix(const DataSet <T> &dset, size_t start, size_t end)
+{
+	Matrix <T> out;
+
+	to_matrix(dset, start, end, out);
+
+	return out;
+}
+
+/**
+ * @brief Packs a data set into a matrix, with one sample per row, for batched
+ * computation.
+ */
+template <class T>
+Matrix <T> to_matrix(const DataSet <T> &dset)
+{
+	return to_matrix(dset, 0, dset.size());
+}
+
 template <class T>
 std::vector <DataSet <T>> split(const DataSet <T> &dset, size_t len)
 {
@@ -34,7 +82,258 @@ std::vector <DataSet <T>> split(const DataSet <T> &dset, size_t len)
 
 	return batched;
 }
-	
+
+template <class T>
+class DataBatch;
+
+/**
+ * @brief A data set stored as a single matrix, with one sample per row, so
+ * that the samples are not separate allocations.
+ *
+ * The samples are accessed through an order (a permutation of the rows), so
+ * that the data set can be shuffled without moving the samples. Batches are
+ * views of consecutive samples in this order, which are created in constant
+ * time, and are only copied when they are packed into the buffers of a
+ * training step (see to_matrix and Workspace::load).
+ */
+template <class T>
+class PackedDataSet {
+	Matrix <T>		_data;
+	std::vector <size_t>	_order;
+public:
+	PackedDataSet();
+	PackedDataSet(size_t, size_t);
+
+	explicit PackedDataSet(const DataSet <T> &);
+
+	size_t size() const;
+	size_t dimension() const;
+
+	// Samples in the current order
+	T *operator[](size_t);
+	const T *operator[](size_t) const;
+
+	Matrix <T> &data();
+	const Matrix <T> &data() const;
+
+	DataBatch <T> batch(size_t, size_t) const;
+
+	// Shuffling
+	const std::vector <size_t> &order() const;
+
+	template <class G>
+	void shuffle(G &);
+
+	void reorder(const std::vector <size_t> &);
+	void reset_order();
+
+	// Exceptions
+	class bad_order {};
+	class bad_dimensions {};
+};
+
+template <class T>
+PackedDataSet <T> ::PackedDataSet() {}
+
+/**
+ * @brief Creates a data set of samples of the given dimension, filled with
+ * zeros.
+ */
+template <class T>
+PackedDataSet <T> ::PackedDataSet(size_t samples, size_t dimension)
+		: _data(samples, dimension, T(0)), _order(samples)
+{
+	reset_order();
+}
+
+/**
+ * @brief Packs the samples of a data set, which must all have the same size
+ * (bad_dimensions is thrown otherwise).
+ */
+template <class T>
+PackedDataSet <T> ::PackedDataSet(const DataSet <T> &dset)
+		: _order(dset.size())
+{
+	for (size_t i = 1; i < dset.size(); i++) {
+		if (dset[i].size() != dset[0].size())
+			throw bad_dimensions();
+	}
+
+	to_matrix(dset, 0, dset.size(), _data);
+
+	reset_order();
+}
+
+template <class T>
+size_t PackedDataSet <T> ::size() const
+{
+	return _order.size();
+}
+
+template <class T>
+size_t PackedDataSet <T> ::dimension() const
+{
+	return _data.get_cols();
+}
+
+template <class T>
+T *PackedDataSet <T> ::operator[](size_t i)
+{
+	return _data[_order[i]];
+}
+
+template <class T>
+const T *PackedDataSet <T> ::operator[](size_t i) const
+{
+	return _data[_order[i]];
+}
+
+/**
+ * @return the samples, in the order in which they were stored (independent of
+ * shuffling).
+ */
+template <class T>
+Matrix <T> &PackedDataSet <T> ::data()
+{
+	return _data;
+}
+
+template <class T>
+const Matrix <T> &PackedDataSet <T> ::data() const
+{
+	return _data;
+}
+
+/**
+ * @return a view of the samples [start, end) in the current order. The range
+ * is clipped to the data set, so the batch is empty if start is past the end.
+ */
+template <class T>
+DataBatch <T> PackedDataSet <T> ::batch(size_t start, size_t end) const
+{
+	end = std::min(end, size());
+	start = std::min(start, end);
+
+	return DataBatch <T> (this, start, end);
+}
+
+template <class T>
+const std::vector <size_t> &PackedDataSet <T> ::order() const
+{
+	return _order;
+}
+
+/**
+ * @brief Shuffles the order of the samples (the samples are not moved).
+ *
+ * The order can be shared with another data set, such as the targets of the
+ * samples, with reorder.
+ */
+template <class T>
+template <class G>
+void PackedDataSet <T> ::shuffle(G &gen)
+{
+	std::shuffle(_order.begin(), _order.end(), gen);
+}
+
+/**
+ * @brief Sets the order of the samples, which must be a permutation of
+ * [0, size()) (bad_order is thrown otherwise).
+ */
+template <class T>
+void PackedDataSet <T> ::reorder(const std::vector <size_t> &order)
+{
+	size_t n = _order.size();
+	if (order.size() != n)
+		throw bad_order();
+
+	std::vector <bool> seen(n, false);
+	for (size_t i : order) {
+		if (i >= n || seen[i])
+			throw bad_order();
+
+		seen[i] = true;
+	}
+
+	_order = order;
+}
+
+template <class T>
+void PackedDataSet <T> ::reset_order()
+{
+	std::iota(_order.begin(), _order.end(), 0);
+}
+
+/**
+ * @brief Shuffles a data set and its targets with the same permutation.
+ */
+template <class T, class G>
+void shuffle(PackedDataSet <T> &ins, PackedDataSet <T> &outs, G &gen)
+{
+	ins.shuffle(gen);
+	outs.reorder(ins.order());
+}
+
+/**
+ * @brief A view of the consecutive samples [start, end) of a PackedDataSet,
+ * which is only valid as long as the data set and its order are unchanged.
+ */
+template <class T>
+class DataBatch {
+	const PackedDataSet <T> *	_set	= nullptr;
+
+	size_t				_start	= 0;
+	size_t				_end	= 0;
+public:
+	DataBatch() {}
+
+	DataBatch(const PackedDataSet <T> *set, size_t start, size_t end)
+			: _set(set), _start(start), _end(end) {}
+
+	size_t size() const {
+		return _end - _start;
+	}
+
+	size_t dimension() const {
+		return _set->dimension();
+	}
+
+	const T *operator[](size_t i) const {
+		return (*_set)[_start + i];
+	}
+};
+
+/**
+ * @brief Copies the samples [start, end) of a batch into a matrix, with one
+ * sample per row. The matrix is only reallocated if its dimensions change.
+ */
+template <class T>
+void to_matrix(const DataBatch <T> &batch, size_t start, size_t end, Matrix <T> &out)
+{
+	if (start >= end) {
+		out.resize(0, 0);
+
+		return;
+	}
+
+	size_t rs = end - start;
+	size_t cs = batch.dimension();
+
+	out.resize(rs, cs);
+	for (size_t i = 0; i < rs; i++)
+		std::copy(batch[start + i], batch[start + i] + cs, out[i]);
+}
+
+template <class T>
+Matrix <T> to_matrix(const DataBatch <T> &batch)
+{
+	Matrix <T> out;
+
+	to_matrix(batch, 0, batch.size(), out);
+
+	return out;
+}
+
 }
 
 #else
@@ -20,6 +20,7 @@
 
 // Engine headers
 #include "dataset.hpp"
+#include "model_file.hpp"
 
 #endif		// Does not support AVR
 
@@ -62,6 +63,24 @@ namespace ml {
 template <class T>
 using DNNGrad = Vector <Matrix <T>>;
 
+#ifndef __AVR	// Does not support AVR
+
+/**
+ * @brief Buffers for the const inference methods of DNN (the input, and the
+ * outputs of each layer). The buffers are sized for the largest batch so far,
+ * and are only reallocated for a larger batch (or another network). A scratch
+ * can be shared between networks but not between threads.
+ */
+template <class T>
+struct InferenceScratch {
+	std::vector <Matrix <T>>	buffers;
+
+	// Largest batch the buffers were sized for
+	size_t				rows	= 0;
+};
+
+#endif		// Does not support AVR
+
 /**
  * @brief Neural network class
  */
@@ -85,6 +104,10 @@ private:
 	Matrix <T> *		_Acache	= nullptr;
 	Matrix <T> *		_Zcache	= nullptr;
 
+	// Layers between activation checkpoints during training (see
+	// Workspace), 0 to keep every activation
+	size_t			_checkpoint	= 0;
+
 	// Variadic constructor helper
 	size_t fill(size_t, const Layer <T> &);
 
@@ -113,6 +136,10 @@ public:
 	AVR_IGNORE(void save(const std::string &));
 	AVR_IGNORE(void load(const std::string &));
 
+	// Versioned binary format, whose weights are used in place (mapped)
+	AVR_IGNORE(void save_model(const std::string &));
+	AVR_IGNORE(void load_model(const ModelFile &));
+
 	// void load_json(const std::string &);
 
 	// Properties
@@ -123,10 +150,16 @@ public:
 	void enable_dropout() const;
 	void disable_dropout() const;
 
+	void set_checkpoint_interval(size_t);
+	size_t checkpoint_interval() const;
+
 	// TODO: private?
 	Vector <T> *acache() const;
 	Vector <T> *zcache() const;
 
+	Matrix <T> *Acache() const;
+	Matrix <T> *Zcache() const;
+
 	Layer <T> *layers();
 
 	// Miscellaneous
@@ -137,6 +170,17 @@ public:
 
 	Vector <T> compute(const Vector <T> &);
 
+	// Batched computation (one input per row)
+	AVR_IGNORE(Matrix <T> compute(const Matrix <T> &));
+
+	// Const inference, which can be called from several threads at once
+	// (with thread local buffers, or buffers from the caller)
+	AVR_IGNORE(Vector <T> infer(const Vector <T> &) const);
+	AVR_IGNORE(Vector <T> infer(const Vector <T> &, InferenceScratch <T> &) const);
+
+	AVR_IGNORE(Matrix <T> infer(const Matrix <T> &) const);
+	AVR_IGNORE(const Matrix <T> &infer(const Matrix <T> &, InferenceScratch <T> &) const);
+
 	void apply_gradient(Matrix <T> *);
 
 	Matrix <T> *jacobian(const Vector <T> &);
@@ -154,7 +198,7 @@ DNN <T> ::DNN() {}
 template <class T>
 DNN <T> ::DNN(const DNN &other) :
 		_size(other._size), _isize(other._isize),
-		_osize(other._osize)
+		_osize(other._osize), _checkpoint(other._checkpoint)
 {
 	_layers = new Layer <T> [_size];
 
@@ -227,6 +271,8 @@ DNN <T> &DNN <T> ::operator=(const DNN <T> &other)
 		_isize = other._isize;
 		_osize = other._osize;
 
+		_checkpoint = other._checkpoint;
+
 		_layers = new Layer <T> [_size];
 		for (size_t i = 0; i < _size; i++)
 			_layers[i] = other._layers[i];
@@ -301,7 +347,7 @@ void DNN <T> ::init_cache()
 template <class T>
 void DNN <T> ::save(const std::string &file)
 {
-	std::ofstream fout(file);
+	std::ofstream fout(file, std::ios::binary);
 
 	fout.write((char *) &_size, sizeof(size_t));
 	fout.write((char *) &_isize, sizeof(size_t));
@@ -317,7 +363,7 @@ void DNN <T> ::load(const std::string &file)
 	// Clear the current members
 	clear();
 
-	std::ifstream fin(file);
+	std::ifstream fin(file, std::ios::binary);
 
 	fin.read((char *) &_size, sizeof(size_t));
 	fin.read((char *) &_isize, sizeof(size_t));
@@ -326,6 +372,145 @@ void DNN <T> ::load(const std::string &file)
 	_layers = new Layer <T> [_size];
 	for (size_t i = 0; i < _size; i++)
 		_layers[i].read(fin);
+
+	init_cache();
+}
+
+/**
+ * @brief Saves the network in the binary model format (see ModelFile), with
+ * the weights of each layer in a blob aligned to ModelFile::alignment bytes.
+ *
+ * @param file the path of the file.
+ */
+template <class T>
+void DNN <T> ::save_model(const std::string &file)
+{
+	std::vector <LayerDescriptor> descs(_size);
+
+	ModelHeader header {};
+
+	memcpy(header.magic, ModelFile::magic, sizeof(header.magic));
+	header.version = ModelFile::version;
+	header.endianness = ModelFile::endianness;
+	header.scalar = sizeof(T);
+	header.layers = _size;
+	header.input = _isize;
+	header.output = _osize;
+
+	std::ofstream fout(file, std::ios::binary | std::ios::trunc);
+
+	// The header and the descriptors are written once the offsets are known
+	std::vector <char> zeros(ModelFile::alignment, 0);
+
+	fout.write((char *) &header, sizeof(header));
+	fout.write((char *) descs.data(), sizeof(LayerDescriptor) * _size);
+
+	for (size_t i = 0; i < _size; i++) {
+		descs[i].activation = fout.tellp();
+		_layers[i].write_activation(fout);
+		descs[i].activation_size = (size_t) fout.tellp() - descs[i].activation;
+	}
+
+	for (size_t i = 0; i < _size; i++) {
+		size_t pos = fout.tellp();
+		size_t pad = (ModelFile::alignment - pos % ModelFile::alignment)
+			% ModelFile::alignment;
+
+		fout.write(zeros.data(), pad);
+
+		Matrix <T> &mat = _layers[i].mat();
+
+		descs[i].rows = mat.get_rows();
+		descs[i].cols = mat.get_cols();
+		descs[i].weights = pos + pad;
+
+		fout.write((const char *) mat[0], sizeof(T) * mat.size());
+	}
+
+	header.length = fout.tellp();
+
+	fout.seekp(sizeof(ModelHeader));
+	fout.write((char *) descs.data(), sizeof(LayerDescriptor) * _size);
+	fout.close();
+
+	// Checksum of everything after the header
+	std::fstream fio(file, std::ios::binary | std::ios::in | std::ios::out);
+
+	std::vector <char> buffer(1 << 16);
+
+	uint64_t hash = ModelFile::checksum(nullptr, 0);
+
+	fio.seekg(sizeof(ModelHeader));
+	while (fio.read(buffer.data(), buffer.size()) || fio.gcount()) {
+		hash = ModelFile::checksum((const unsigned char *) buffer.data(),
+				fio.gcount(), hash);
+	}
+
+	header.checksum = hash;
+
+	fio.clear();
+	fio.seekp(0);
+	fio.write((char *) &header, sizeof(header));
+}
+
+/**
+ * @brief Loads a network from a mapped model file. The weight matrices of the
+ * layers point into the mapping (nothing is copied), so the file must outlive
+ * the network. Copies of the network own their weights.
+ *
+ * @param model the mapped file.
+ */
+template <class T>
+void DNN <T> ::load_model(const ModelFile &model)
+{
+	const ModelHeader &header = model.header();
+
+	if (header.scalar != sizeof(T))
+		throw ModelFile::bad_header();
+
+	for (size_t i = 0; i < header.layers; i++) {
+		const LayerDescriptor &desc = model.layer(i);
+
+		size_t fan_in = i ? model.layer(i - 1).rows : header.input;
+
+		if (desc.cols != fan_in + 1
+				|| (i + 1 == header.layers && desc.rows != header.output))
+			throw ModelFile::bad_header();
+	}
+
+	// The activations are read first, so that a corrupt record leaves the
+	// network unchanged
+	std::vector <Activation <T> *> acts;
+
+	try {
+		for (size_t i = 0; i < header.layers; i++) {
+			const LayerDescriptor &desc = model.layer(i);
+
+			acts.push_back(Activation <T> ::load(model.at(desc.activation),
+					desc.activation_size));
+		}
+	} catch (...) {
+		for (Activation <T> *act : acts)
+			delete act;
+
+		throw;
+	}
+
+	clear();
+
+	_size = header.layers;
+	_isize = header.input;
+	_osize = header.output;
+
+	_layers = new Layer <T> [_size];
+	for (size_t i = 0; i < _size; i++) {
+		const LayerDescriptor &desc = model.layer(i);
+
+		_layers[i].map((T *) model.at(desc.weights), desc.rows, desc.cols,
+				acts[i]);
+	}
+
+	init_cache();
 }
 
 #endif		// Does not support AVR
@@ -349,6 +534,25 @@ size_t DNN <T> ::output_size() const
 	return _osize;
 }
 
+/**
+ * @brief Sets the number of layers between the activations kept by the
+ * batched training steps. The activations in between are recomputed during the
+ * backward pass, which trades about one more forward pass for the memory of
+ * the activations (see Workspace). An interval of 0 or 1 keeps every
+ * activation.
+ */
+template <class T>
+void DNN <T> ::set_checkpoint_interval(size_t interval)
+{
+	_checkpoint = interval;
+}
+
+template <class T>
+size_t DNN <T> ::checkpoint_interval() const
+{
+	return _checkpoint;
+}
+
 template <class T>
 void DNN <T> ::enable_dropout() const
 {
@@ -382,6 +586,18 @@ Vector <T> *DNN <T> ::zcache() const
 	return _zcache;
 }
 
+template <class T>
+Matrix <T> *DNN <T> ::Acache() const
+{
+	return _Acache;
+}
+
+template <class T>
+Matrix <T> *DNN <T> ::Zcache() const
+{
+	return _Zcache;
+}
+
 /*
 template <class T>
 void DNN <T> ::load_json(const std::string &file)
@@ -446,14 +662,145 @@ Vector <T> DNN <T> ::operator()(const Vector <T> &in)
 template <class T>
 Vector <T> DNN <T> ::compute(const Vector <T> &in)
 {
-	Vector <T> tmp = in;
+	if (!_size)
+		return in;
 
-	for (size_t i = 0; i < _size; i++)
+	// Results are moved between layers, not copied
+	Vector <T> tmp = _layers[0].forward_propogate(in);
+
+	for (size_t i = 1; i < _size; i++)
+		tmp = _layers[i].forward_propogate(tmp);
+
+	return tmp;
+}
+
+#ifndef __AVR	// Does not support AVR
+
+template <class T>
+Matrix <T> DNN <T> ::compute(const Matrix <T> &in)
+{
+	if (!_size)
+		return in;
+
+	if (in.get_cols() != _isize)
+		throw bad_io_dimensions();
+
+	Matrix <T> tmp = _layers[0].forward_propogate(in);
+
+	for (size_t i = 1; i < _size; i++)
 		tmp = _layers[i].forward_propogate(tmp);
 
 	return tmp;
 }
 
+/*
+ * Inference does not modify the network (dropout is not applied, and the
+ * caches are not used), so a single network can serve several threads without
+ * locks. The outputs of the layers go to the buffers of a scratch: the methods
+ * without one use a scratch local to the calling thread.
+ */
+template <class T>
+Vector <T> DNN <T> ::infer(const Vector <T> &in) const
+{
+	static thread_local InferenceScratch <T> scratch;
+
+	return infer(in, scratch);
+}
+
+template <class T>
+Vector <T> DNN <T> ::infer(const Vector <T> &in, InferenceScratch <T> &scratch) const
+{
+	if (in.size() != _isize)
+		throw bad_io_dimensions();
+
+	if (!_size)
+		return in;
+
+	// The input goes through the first buffer, as a single row
+	std::vector <Matrix <T>> &buffers = scratch.buffers;
+	if (buffers.size() < _size + 1)
+		buffers.resize(_size + 1);
+
+	Matrix <T> &X = buffers[0];
+
+	X.resize(1, _isize);
+	for (size_t i = 0; i < _isize; i++)
+		X[0][i] = in[i];
+
+	const Matrix <T> &Y = infer(X, scratch);
+
+	// Slice of the output (copied on return)
+	Vector <T> out(_osize, const_cast <T *> (Y[0]));
+
+	return Vector <T> (out);
+}
+
+template <class T>
+Matrix <T> DNN <T> ::infer(const Matrix <T> &in) const
+{
+	static thread_local InferenceScratch <T> scratch;
+
+	return Matrix <T> (infer(in, scratch));
+}
+
+/**
+ * @brief Computes the outputs of the network for a batch of inputs (one per
+ * row), without allocating once the scratch has seen a batch at least as
+ * large.
+ *
+ * @return the outputs, which are stored in the scratch (and are valid until
+ * its next use).
+ */
+template <class T>
+const Matrix <T> &DNN <T> ::infer(const Matrix <T> &in, InferenceScratch <T> &scratch) const
+{
+	if (in.get_cols() != _isize)
+		throw bad_io_dimensions();
+
+	if (!_size)
+		return in;
+
+	std::vector <Matrix <T>> &buffers = scratch.buffers;
+	if (buffers.size() < _size + 1)
+		buffers.resize(_size + 1);
+
+	// Smaller batches use the first rows of the buffers, which are only
+	// reallocated for a larger batch or for the layers of another network
+	// (keeping every buffer sized for the largest batch)
+	size_t rows = in.get_rows();
+
+	bool fits = (rows <= scratch.rows);
+	for (size_t i = 0; fits && i < _size; i++) {
+		fits = (buffers[i + 1].get_dimensions().second
+				== _layers[i].get_fan_out());
+	}
+
+	if (!fits) {
+		scratch.rows = std::max(rows, scratch.rows);
+
+		for (size_t j = 1; j < buffers.size(); j++) {
+			size_t cols = (j <= _size) ? _layers[j - 1].get_fan_out()
+				: buffers[j].get_dimensions().second;
+
+			buffers[j].resize(scratch.rows, cols);
+		}
+	}
+
+	for (size_t i = 0; i < _size; i++)
+		buffers[i + 1].set_rows(rows);
+
+	const Matrix <T> *X = &in;
+	for (size_t i = 0; i < _size; i++) {
+		_layers[i].infer(*X, buffers[i + 1]);
+
+		X = &buffers[i + 1];
+	}
+
+	return *X;
+}
+
+#endif		// Does not support AVR
+
 template <class T>
 Matrix <T> *DNN <T> ::jacobian(const Vector <T> &in)
 {
@@ -33,12 +33,17 @@ public:
 		OPT_Default,
 		OPT_SE,
 		OPT_MSE,
+		OPT_CE,
+		OPT_DCE
 	};
 
 	// TODO: Add a vector <double> constructor for JSON
 	__cuda_dual__
 	Erf();
 
+	__cuda_dual__
+	virtual ~Erf() {}
+
 	__cuda_dual__
 	Vector <T> compute(const Vector <T> &, const Vector <T> &) const;
 
@@ -51,6 +56,16 @@ public:
 	__cuda_dual__
 	int get_erf_type() const;
 
+#ifndef ZHP_CUDA
+
+	// Batched computation, with one pair of vectors per row
+	Matrix <T> batch_compute(const Matrix <T> &, const Matrix <T> &) const;
+
+	virtual void batch_compute(const Matrix <T> &, const Matrix <T> &,
+			Matrix <T> &) const;
+
+#endif
+
 	template <class U>
 	__cuda_dual__
 	friend Erf <U> *copy(Erf <U> *);
@@ -100,6 +115,50 @@ int Erf <T> ::get_erf_type() const
 	return kind;
 }
 
+/**
+ * @brief Computes the error (or its derivative) for each pair of rows of two
+ * matrices.
+ */
+template <class T>
+Matrix <T> Erf <T> ::batch_compute(const Matrix <T> &comp, const Matrix <T> &in) const
+{
+	Matrix <T> out;
+
+	batch_compute(comp, in, out);
+
+	return out;
+}
+
+/**
+ * @brief Same as batch_compute(comp, in), with the result written to out,
+ * which is only reallocated if its dimensions change. Errors which override
+ * this method do not allocate.
+ */
+template <class T>
+void Erf <T> ::batch_compute(const Matrix <T> &comp, const Matrix <T> &in,
+		Matrix <T> &out) const
+{
+	if (comp.get_dimensions() != in.get_dimensions())
+		throw dimension_mismatch();
+
+	size_t rs = comp.get_rows();
+	size_t cs = comp.get_cols();
+
+	for (size_t i = 0; i < rs; i++) {
+		// Slices of the rows (not copied)
+		Vector <T> a(cs, const_cast <T *> (comp[i]));
+		Vector <T> b(cs, const_cast <T *> (in[i]));
+
+		Vector <T> y = compute(a, b);
+		if (i == 0)
+			out.resize(rs, y.size());
+
+		T *dst = out[i];
+		for (size_t j = 0; j < y.size(); j++)
+			dst[j] = y[j];
+	}
+}
+
 #endif
 
 }
@@ -0,0 +1,369 @@
+#ifndef EXPRESSION_H_
+#define EXPRESSION_H_
+
+// C/C++ headers
+#include <cmath>
+#include <cstddef>
+
+// Engine headers
+#include "core/parallel.hpp"
+
+/**
+ * @file expression.hpp
+ * @brief Lazily evaluated elementwise arithmetic on matrices and vectors
+ * (expression templates).
+ *
+ * Wrapping an operand with zhetapi::lazy opts into lazy evaluation: any chain
+ * of +, -, scalar *, scalar /, shur and inv_shur built from lazy operands is
+ * represented as a lightweight expression object, and is only evaluated when
+ * it is assigned to a Matrix or Vector, or reduced (sum, norm). Evaluation is
+ * a single fused loop with no intermediate matrices. For example,
+ *
+ * 	M = beta * lazy(M) - (1 - beta) * lazy(J);
+ *
+ * reads M and J once and writes M once, where the eager version allocates and
+ * traverses three temporaries. The eager operators on Matrix and Vector are
+ * unchanged.
+ *
+ * Every operation is elementwise, so assigning an expression to one of its own
+ * operands is safe.
+ */
+
+namespace zhetapi {
+
+template <class T>
+class Matrix;
+
+/**
+ * @brief Base of all expressions (CRTP), with component type T.
+ */
+template <class T, class E>
+class Expression {
+public:
+	const E &derived() const
+	{
+		return static_cast <const E &> (*this);
+	}
+
+	T operator[](size_t i) const
+	{
+		return derived().eval(i);
+	}
+
+	size_t get_rows() const
+	{
+		return derived().get_rows();
+	}
+
+	size_t get_cols() const
+	{
+		return derived().get_cols();
+	}
+
+	size_t size() const
+	{
+		return get_rows() * get_cols();
+	}
+
+	/**
+	 * @brief Evaluates every component into an array of size() elements.
+	 */
+	void evaluate(T *out) const
+	{
+		const E &e = derived();
+
+		parallel::for_range(size(),
+			[&](size_t start, size_t end) {
+				for (size_t i = start; i < end; i++)
+					out[i] = e.eval(i);
+			}
+		);
+	}
+
+	/**
+	 * @return the sum of the components, in order.
+	 */
+	T sum() const
+	{
+		const E &e = derived();
+
+		T acc = 0;
+
+		size_t n = size();
+		for (size_t i = 0; i < n; i++)
+			acc += e.eval(i);
+
+		return acc;
+	}
+
+	/**
+	 * @return the Euclidean (Frobenius) norm, as in Matrix::norm.
+	 */
+	T norm() const
+	{
+		const E &e = derived();
+
+		T acc = 0;
+
+		size_t n = size();
+		for (size_t i = 0; i < n; i++) {
+			T x = e.eval(i);
+
+			acc += x * x;
+		}
+
+		return std::sqrt(acc);
+	}
+};
+
+/**
+ * @brief Leaf of an expression: refers to the components of a matrix or
+ * vector, without copying them.
+ */
+template <class T>
+class TerminalExpression : public Expression <T, TerminalExpression <T>> {
+	const T *	_array;
+	size_t		_rows;
+	size_t		_cols;
+public:
+	explicit TerminalExpression(const Matrix <T> &mat)
+			: _array(mat[0]),
+			_rows(mat.get_rows()),
+			_cols(mat.get_cols()) {}
+
+	T eval(size_t i) const
+	{
+		return _array[i];
+	}
+
+	size_t get_rows() const
+	{
+		return _rows;
+	}
+
+	size_t get_cols() const
+	{
+		return _cols;
+	}
+};
+
+/**
+ * @brief Elementwise operation between two expressions of the same
+ * dimensions.
+ */
+template <class T, class L, class R, class Op>
+class BinaryExpression : public Expression <T, BinaryExpression <T, L, R, Op>> {
+	L	_left;
+	R	_right;
+public:
+	BinaryExpression(const L &left, const R &right)
+			: _left(left), _right(right)
+	{
+		if (left.get_rows() != right.get_rows()
+				|| left.get_cols() != right.get_cols())
+			throw typename Matrix <T> ::dimension_mismatch();
+	}
+
+	T eval(size_t i) const
+	{
+		return Op::apply(_left.eval(i), _right.eval(i));
+	}
+
+	size_t get_rows() const
+	{
+		return _left.get_rows();
+	}
+
+	size_t get_cols() const
+	{
+		return _left.get_cols();
+	}
+};
+
+/**
+ * @brief Elementwise operation between an expression and a scalar, with the
+ * scalar as the left operand if Left is true.
+ */
+template <class T, class E, class Op, bool Left>
+class ScalarExpression : public Expression <T, ScalarExpression <T, E, Op, Left>> {
+	E	_expr;
+	T	_scalar;
+public:
+	ScalarExpression(const E &expr, const T &scalar)
+			: _expr(expr), _scalar(scalar) {}
+
+	T eval(size_t i) const
+	{
+		return Left ? Op::apply(_scalar, _expr.eval(i))
+			: Op::apply(_expr.eval(i), _scalar);
+	}
+
+	size_t get_rows() const
+	{
+		return _expr.get_rows();
+	}
+
+	size_t get_cols() const
+	{
+		return _expr.get_cols();
+	}
+};
+
+// Elementwise operations
+struct expr_add {
+	template <class T>
+	static T apply(const T &a, const T &b)
+	{
+		return a + b;
+	}
+};
+
+struct expr_sub {
+	template <class T>
+	static T apply(const T &a, const T &b)
+	{
+		return a - b;
+	}
+};
+
+struct expr_mul {
+	template <class T>
+	static T apply(const T &a, const T &b)
+	{
+		return a * b;
+	}
+};
+
+struct expr_div {
+	template <class T>
+	static T apply(const T &a, const T &b)
+	{
+		return a / b;
+	}
+};
+
+struct expr_pow {
+	template <class T>
+	static T apply(const T &a, const T &b)
+	{
+		return std::pow(a, b);
+	}
+};
+
+// Prevents deduction of T from a scalar operand, so that (for example) an int
+// can scale an expression of doubles
+template <class T>
+struct expr_scalar {
+	using type = T;
+};
+
+/**
+ * @brief Opts into lazy evaluation for a matrix or vector. The result refers
+ * to the components of the argument, which must outlive it.
+ */
+template <class T>
+TerminalExpression <T> lazy(const Matrix <T> &mat)
+{
+	return TerminalExpression <T> (mat);
+}
+
+template <class T, class L, class R>
+BinaryExpression <T, L, R, expr_add> operator+(const Expression <T, L> &a,
+		const Expression <T, R> &b)
+{
+	return BinaryExpression <T, L, R, expr_add> (a.derived(), b.derived());
+}
+
+template <class T, class L, class R>
+BinaryExpression <T, L, R, expr_sub> operator-(const Expression <T, L> &a,
+		const Expression <T, R> &b)
+{
+	return BinaryExpression <T, L, R, expr_sub> (a.derived(), b.derived());
+}
+
+/**
+ * @brief Lazy elementwise (Hadamard) product.
+ */
+template <class T, class L, class R>
+BinaryExpression <T, L, R, expr_mul> shur(const Expression <T, L> &a,
+		const Expression <T, R> &b)
+{
+	return BinaryExpression <T, L, R, expr_mul> (a.derived(), b.derived());
+}
+
+/**
+ * @brief Lazy elementwise division.
+ */
+template <class T, class L, class R>
+BinaryExpression <T, L, R, expr_div> inv_shur(const Expression <T, L> &a,
+		const Expression <T, R> &b)
+{
+	return BinaryExpression <T, L, R, expr_div> (a.derived(), b.derived());
+}
+
+template <class T, class E>
+ScalarExpression <T, E, expr_mul, true> operator*(
+		const typename expr_scalar <T> ::type &k,
+		const Expression <T, E> &e)
+{
+	return ScalarExpression <T, E, expr_mul, true> (e.derived(), k);
+}
+
+template <class T, class E>
+ScalarExpression <T, E, expr_mul, false> operator*(const Expression <T, E> &e,
+		const typename expr_scalar <T> ::type &k)
+{
+	return ScalarExpression <T, E, expr_mul, false> (e.derived(), k);
+}
+
+template <class T, class E>
+ScalarExpression <T, E, expr_div, false> operator/(const Expression <T, E> &e,
+		const typename expr_scalar <T> ::type &k)
+{
+	return ScalarExpression <T, E, expr_div, false> (e.derived(), k);
+}
+
+/**
+ * @brief Adds a scalar to every component.
+ */
+template <class T, class E>
+ScalarExpression <T, E, expr_add, false> operator+(const Expression <T, E> &e,
+		const typename expr_scalar <T> ::type &k)
+{
+	return ScalarExpression <T, E, expr_add, false> (e.derived(), k);
+}
+
+template <class T, class E>
+ScalarExpression <T, E, expr_add, true> operator+(
+		const typename expr_scalar <T> ::type &k,
+		const Expression <T, E> &e)
+{
+	return ScalarExpression <T, E, expr_add, true> (e.derived(), k);
+}
+
+template <class T, class E>
+ScalarExpression <T, E, expr_sub, false> operator-(const Expression <T, E> &e,
+		const typename expr_scalar <T> ::type &k)
+{
+	return ScalarExpression <T, E, expr_sub, false> (e.derived(), k);
+}
+
+template <class T, class E>
+ScalarExpression <T, E, expr_mul, true> operator-(const Expression <T, E> &e)
+{
+	return ScalarExpression <T, E, expr_mul, true> (e.derived(), T(-1));
+}
+
+/**
+ * @brief Raises every component to the given power, as in Matrix::pow.
+ */
+template <class T, class E>
+ScalarExpression <T, E, expr_pow, false> epow(const Expression <T, E> &e,
+		const typename expr_scalar <T> ::type &k)
+{
+	return ScalarExpression <T, E, expr_pow, false> (e.derived(), k);
+}
+
+}
+
+#endif
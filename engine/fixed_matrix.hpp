@@ -0,0 +1,549 @@
+#ifndef FIXED_MATRIX_H_
+#define FIXED_MATRIX_H_
+
+// C/C++ headers
+#include <cstddef>
+#include <initializer_list>
+
+// Engine headers
+#include "fixed_vector.hpp"
+
+namespace zhetapi {
+
+/**
+ * @brief A matrix whose dimensions are known at compile time, with components
+ * stored (row-major) on the stack. Nothing is allocated, the loops have
+ * constant bounds (so that the compiler unrolls them), and every operation is
+ * constexpr. Determinants and inverses have closed forms up to 4 x 4, and use
+ * Gaussian elimination for larger sizes.
+ *
+ * @tparam T the type of each component.
+ * @tparam R the number of rows.
+ * @tparam C the number of columns.
+ */
+template <class T, size_t R, size_t C>
+class FixedMatrix {
+	T _array[R * C] {};
+public:
+	constexpr FixedMatrix() {}
+	constexpr explicit FixedMatrix(const T &);
+	constexpr FixedMatrix(std::initializer_list <std::initializer_list <T>>);
+
+	static constexpr size_t get_rows()
+	{
+		return R;
+	}
+
+	static constexpr size_t get_cols()
+	{
+		return C;
+	}
+
+	static constexpr size_t size()
+	{
+		return R * C;
+	}
+
+	constexpr T &operator()(size_t, size_t);
+	constexpr const T &operator()(size_t, size_t) const;
+
+	constexpr T *operator[](size_t);
+	constexpr const T *operator[](size_t) const;
+
+	constexpr FixedVector <T, C> row(size_t) const;
+	constexpr FixedVector <T, R> column(size_t) const;
+
+	constexpr FixedMatrix <T, C, R> transpose() const;
+
+	constexpr FixedMatrix &operator+=(const FixedMatrix &);
+	constexpr FixedMatrix &operator-=(const FixedMatrix &);
+
+	constexpr FixedMatrix &operator*=(const T &);
+	constexpr FixedMatrix &operator/=(const T &);
+
+	static constexpr FixedMatrix identity();
+};
+
+/**
+ * @brief Constructs a matrix with every component set to x.
+ */
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix <T, R, C> ::FixedMatrix(const T &x)
+{
+	for (size_t i = 0; i < R * C; i++)
+		_array[i] = x;
+}
+
+/**
+ * @brief Constructs a matrix from a list of rows. Missing components are set
+ * to zero.
+ */
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix <T, R, C> ::FixedMatrix(std::initializer_list <std::initializer_list <T>> rows)
+{
+	size_t i = 0;
+	for (const auto &row : rows) {
+		size_t j = 0;
+		for (const T &x : row) {
+			if (i < R && j < C)
+				_array[i * C + j] = x;
+
+			j++;
+		}
+
+		i++;
+	}
+}
+
+template <class T, size_t R, size_t C>
+constexpr T &FixedMatrix <T, R, C> ::operator()(size_t i, size_t j)
+{
+	return _array[i * C + j];
+}
+
+template <class T, size_t R, size_t C>
+constexpr const T &FixedMatrix <T, R, C> ::operator()(size_t i, size_t j) const
+{
+	return _array[i * C + j];
+}
+
+template <class T, size_t R, size_t C>
+constexpr T *FixedMatrix <T, R, C> ::operator[](size_t i)
+{
+	return &_array[i * C];
+}
+
+template <class T, size_t R, size_t C>
+constexpr const T *FixedMatrix <T, R, C> ::operator[](size_t i) const
+{
+	return &_array[i * C];
+}
+
+template <class T, size_t R, size_t C>
+constexpr FixedVector <T, C> FixedMatrix <T, R, C> ::row(size_t i) const
+{
+	FixedVector <T, C> out;
+	for (size_t j = 0; j < C; j++)
+		out[j] = _array[i * C + j];
+
+	return out;
+}
+
+template <class T, size_t R, size_t C>
+constexpr FixedVector <T, R> FixedMatrix <T, R, C> ::column(size_t j) const
+{
+	FixedVector <T, R> out;
+	for (size_t i = 0; i < R; i++)
+		out[i] = _array[i * C + j];
+
+	return out;
+}
+
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix <T, C, R> FixedMatrix <T, R, C> ::transpose() const
+{
+	FixedMatrix <T, C, R> out;
+	for (size_t i = 0; i < R; i++) {
+		for (size_t j = 0; j < C; j++)
+			out(j, i) = _array[i * C + j];
+	}
+
+	return out;
+}
+
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix <T, R, C> &FixedMatrix <T, R, C> ::operator+=(const FixedMatrix &other)
+{
+	for (size_t i = 0; i < R * C; i++)
+		_array[i] += other._array[i];
+
+	return *this;
+}
+
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix <T, R, C> &FixedMatrix <T, R, C> ::operator-=(const FixedMatrix &other)
+{
+	for (size_t i = 0; i < R * C; i++)
+		_array[i] -= other._array[i];
+
+	return *this;
+}
+
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix <T, R, C> &FixedMatrix <T, R, C> ::operator*=(const T &k)
+{
+	for (size_t i = 0; i < R * C; i++)
+		_array[i] *= k;
+
+	return *this;
+}
+
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix <T, R, C> &FixedMatrix <T, R, C> ::operator/=(const T &k)
+{
+	for (size_t i = 0; i < R * C; i++)
+		_array[i] /= k;
+
+	return *this;
+}
+
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix <T, R, C> FixedMatrix <T, R, C> ::identity()
+{
+	static_assert(R == C, "Identity matrices must be square");
+
+	FixedMatrix out;
+	for (size_t i = 0; i < R; i++)
+		out(i, i) = T(1);
+
+	return out;
+}
+
+// Arithmetic
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix <T, R, C> operator+(const FixedMatrix <T, R, C> &a, const FixedMatrix <T, R, C> &b)
+{
+	FixedMatrix <T, R, C> out = a;
+	out += b;
+
+	return out;
+}
+
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix <T, R, C> operator-(const FixedMatrix <T, R, C> &a, const FixedMatrix <T, R, C> &b)
+{
+	FixedMatrix <T, R, C> out = a;
+	out -= b;
+
+	return out;
+}
+
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix <T, R, C> operator*(const FixedMatrix <T, R, C> &a, const T &k)
+{
+	FixedMatrix <T, R, C> out = a;
+	out *= k;
+
+	return out;
+}
+
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix <T, R, C> operator*(const T &k, const FixedMatrix <T, R, C> &a)
+{
+	return a * k;
+}
+
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix <T, R, C> operator/(const FixedMatrix <T, R, C> &a, const T &k)
+{
+	FixedMatrix <T, R, C> out = a;
+	out /= k;
+
+	return out;
+}
+
+template <class T, size_t R, size_t K, size_t C>
+constexpr FixedMatrix <T, R, C> operator*(const FixedMatrix <T, R, K> &a, const FixedMatrix <T, K, C> &b)
+{
+	FixedMatrix <T, R, C> out;
+	for (size_t i = 0; i < R; i++) {
+		for (size_t k = 0; k < K; k++) {
+			T x = a(i, k);
+
+			for (size_t j = 0; j < C; j++)
+				out(i, j) += x * b(k, j);
+		}
+	}
+
+	return out;
+}
+
+template <class T, size_t R, size_t C, class V>
+constexpr FixedVector <T, R> operator*(const FixedMatrix <T, R, C> &a, const FixedVectorBase <T, C, V> &x)
+{
+	FixedVector <T, R> out;
+	for (size_t i = 0; i < R; i++) {
+		T acc = 0;
+		for (size_t j = 0; j < C; j++)
+			acc += a(i, j) * x.get(j);
+
+		out[i] = acc;
+	}
+
+	return out;
+}
+
+template <class T, size_t R, size_t C>
+constexpr bool operator==(const FixedMatrix <T, R, C> &a, const FixedMatrix <T, R, C> &b)
+{
+	for (size_t i = 0; i < R; i++) {
+		for (size_t j = 0; j < C; j++) {
+			if (a(i, j) != b(i, j))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+template <class T, size_t R, size_t C>
+constexpr bool operator!=(const FixedMatrix <T, R, C> &a, const FixedMatrix <T, R, C> &b)
+{
+	return !(a == b);
+}
+
+// Determinants: closed forms for small sizes, elimination otherwise
+template <class T>
+constexpr T determinant(const FixedMatrix <T, 1, 1> &a)
+{
+	return a(0, 0);
+}
+
+template <class T>
+constexpr T determinant(const FixedMatrix <T, 2, 2> &a)
+{
+	return a(0, 0) * a(1, 1) - a(0, 1) * a(1, 0);
+}
+
+template <class T>
+constexpr T determinant(const FixedMatrix <T, 3, 3> &a)
+{
+	return a(0, 0) * (a(1, 1) * a(2, 2) - a(1, 2) * a(2, 1))
+		- a(0, 1) * (a(1, 0) * a(2, 2) - a(1, 2) * a(2, 0))
+		+ a(0, 2) * (a(1, 0) * a(2, 1) - a(1, 1) * a(2, 0));
+}
+
+// 2 x 2 minors of the top and bottom pairs of rows of a 4 x 4 matrix, shared
+// by its determinant and inverse
+template <class T>
+struct fixed_minors4 {
+	T s[6] {};
+	T c[6] {};
+
+	constexpr fixed_minors4(const FixedMatrix <T, 4, 4> &a)
+	{
+		s[0] = a(0, 0) * a(1, 1) - a(1, 0) * a(0, 1);
+		s[1] = a(0, 0) * a(1, 2) - a(1, 0) * a(0, 2);
+		s[2] = a(0, 0) * a(1, 3) - a(1, 0) * a(0, 3);
+		s[3] = a(0, 1) * a(1, 2) - a(1, 1) * a(0, 2);
+		s[4] = a(0, 1) * a(1, 3) - a(1, 1) * a(0, 3);
+		s[5] = a(0, 2) * a(1, 3) - a(1, 2) * a(0, 3);
+
+		c[5] = a(2, 2) * a(3, 3) - a(3, 2) * a(2, 3);
+		c[4] = a(2, 1) * a(3, 3) - a(3, 1) * a(2, 3);
+		c[3] = a(2, 1) * a(3, 2) - a(3, 1) * a(2, 2);
+		c[2] = a(2, 0) * a(3, 3) - a(3, 0) * a(2, 3);
+		c[1] = a(2, 0) * a(3, 2) - a(3, 0) * a(2, 2);
+		c[0] = a(2, 0) * a(3, 1) - a(3, 0) * a(2, 1);
+	}
+
+	constexpr T determinant() const
+	{
+		return s[0] * c[5] - s[1] * c[4] + s[2] * c[3]
+			+ s[3] * c[2] - s[4] * c[1] + s[5] * c[0];
+	}
+};
+
+template <class T>
+constexpr T determinant(const FixedMatrix <T, 4, 4> &a)
+{
+	return fixed_minors4 <T> (a).determinant();
+}
+
+template <class T>
+constexpr T fixed_abs(const T &x)
+{
+	return (x < T(0)) ? -x : x;
+}
+
+template <class T, size_t N>
+constexpr T determinant(const FixedMatrix <T, N, N> &a)
+{
+	FixedMatrix <T, N, N> lu = a;
+
+	T det = T(1);
+	for (size_t k = 0; k < N; k++) {
+		size_t p = k;
+		for (size_t i = k + 1; i < N; i++) {
+			if (fixed_abs(lu(i, k)) > fixed_abs(lu(p, k)))
+				p = i;
+		}
+
+		if (lu(p, k) == T(0))
+			return T(0);
+
+		if (p != k) {
+			for (size_t j = 0; j < N; j++) {
+				T t = lu(k, j);
+				lu(k, j) = lu(p, j);
+				lu(p, j) = t;
+			}
+
+			det = -det;
+		}
+
+		det *= lu(k, k);
+		for (size_t i = k + 1; i < N; i++) {
+			T l = lu(i, k) / lu(k, k);
+
+			for (size_t j = k + 1; j < N; j++)
+				lu(i, j) -= l * lu(k, j);
+		}
+	}
+
+	return det;
+}
+
+// Inverses: closed forms for small sizes, elimination otherwise. Singular
+// matrices yield non-finite components (as in division by zero).
+template <class T>
+constexpr FixedMatrix <T, 1, 1> inverse(const FixedMatrix <T, 1, 1> &a)
+{
+	return FixedMatrix <T, 1, 1> {{T(1) / a(0, 0)}};
+}
+
+template <class T>
+constexpr FixedMatrix <T, 2, 2> inverse(const FixedMatrix <T, 2, 2> &a)
+{
+	T det = determinant(a);
+
+	return FixedMatrix <T, 2, 2> {
+		{a(1, 1), -a(0, 1)},
+		{-a(1, 0), a(0, 0)}
+	} / det;
+}
+
+template <class T>
+constexpr FixedMatrix <T, 3, 3> inverse(const FixedMatrix <T, 3, 3> &a)
+{
+	// Adjugate over determinant
+	FixedMatrix <T, 3, 3> adj {
+		{
+			a(1, 1) * a(2, 2) - a(1, 2) * a(2, 1),
+			a(0, 2) * a(2, 1) - a(0, 1) * a(2, 2),
+			a(0, 1) * a(1, 2) - a(0, 2) * a(1, 1)
+		},
+		{
+			a(1, 2) * a(2, 0) - a(1, 0) * a(2, 2),
+			a(0, 0) * a(2, 2) - a(0, 2) * a(2, 0),
+			a(0, 2) * a(1, 0) - a(0, 0) * a(1, 2)
+		},
+		{
+			a(1, 0) * a(2, 1) - a(1, 1) * a(2, 0),
+			a(0, 1) * a(2, 0) - a(0, 0) * a(2, 1),
+			a(0, 0) * a(1, 1) - a(0, 1) * a(1, 0)
+		}
+	};
+
+	T det = a(0, 0) * adj(0, 0) + a(0, 1) * adj(1, 0) + a(0, 2) * adj(2, 0);
+
+	return adj / det;
+}
+
+template <class T>
+constexpr FixedMatrix <T, 4, 4> inverse(const FixedMatrix <T, 4, 4> &a)
+{
+	fixed_minors4 <T> m(a);
+
+	const T *s = m.s;
+	const T *c = m.c;
+
+	FixedMatrix <T, 4, 4> adj {
+		{
+			a(1, 1) * c[5] - a(1, 2) * c[4] + a(1, 3) * c[3],
+			-a(0, 1) * c[5] + a(0, 2) * c[4] - a(0, 3) * c[3],
+			a(3, 1) * s[5] - a(3, 2) * s[4] + a(3, 3) * s[3],
+			-a(2, 1) * s[5] + a(2, 2) * s[4] - a(2, 3) * s[3]
+		},
+		{
+			-a(1, 0) * c[5] + a(1, 2) * c[2] - a(1, 3) * c[1],
+			a(0, 0) * c[5] - a(0, 2) * c[2] + a(0, 3) * c[1],
+			-a(3, 0) * s[5] + a(3, 2) * s[2] - a(3, 3) * s[1],
+			a(2, 0) * s[5] - a(2, 2) * s[2] + a(2, 3) * s[1]
+		},
+		{
+			a(1, 0) * c[4] - a(1, 1) * c[2] + a(1, 3) * c[0],
+			-a(0, 0) * c[4] + a(0, 1) * c[2] - a(0, 3) * c[0],
+			a(3, 0) * s[4] - a(3, 1) * s[2] + a(3, 3) * s[0],
+			-a(2, 0) * s[4] + a(2, 1) * s[2] - a(2, 3) * s[0]
+		},
+		{
+			-a(1, 0) * c[3] + a(1, 1) * c[1] - a(1, 2) * c[0],
+			a(0, 0) * c[3] - a(0, 1) * c[1] + a(0, 2) * c[0],
+			-a(3, 0) * s[3] + a(3, 1) * s[1] - a(3, 2) * s[0],
+			a(2, 0) * s[3] - a(2, 1) * s[1] + a(2, 2) * s[0]
+		}
+	};
+
+	return adj / m.determinant();
+}
+
+template <class T, size_t N>
+constexpr FixedMatrix <T, N, N> inverse(const FixedMatrix <T, N, N> &a)
+{
+	// Gauss-Jordan elimination on [A | I]
+	FixedMatrix <T, N, N> lu = a;
+	FixedMatrix <T, N, N> inv = FixedMatrix <T, N, N> ::identity();
+
+	for (size_t k = 0; k < N; k++) {
+		size_t p = k;
+		for (size_t i = k + 1; i < N; i++) {
+			if (fixed_abs(lu(i, k)) > fixed_abs(lu(p, k)))
+				p = i;
+		}
+
+		if (p != k) {
+			for (size_t j = 0; j < N; j++) {
+				T t = lu(k, j);
+				lu(k, j) = lu(p, j);
+				lu(p, j) = t;
+
+				t = inv(k, j);
+				inv(k, j) = inv(p, j);
+				inv(p, j) = t;
+			}
+		}
+
+		T pivot = lu(k, k);
+		for (size_t j = 0; j < N; j++) {
+			lu(k, j) /= pivot;
+			inv(k, j) /= pivot;
+		}
+
+		for (size_t i = 0; i < N; i++) {
+			if (i == k)
+				continue;
+
+			T l = lu(i, k);
+			for (size_t j = 0; j < N; j++) {
+				lu(i, j) -= l * lu(k, j);
+				inv(i, j) -= l * inv(k, j);
+			}
+		}
+	}
+
+	return inv;
+}
+
+// Aliases
+template <class T>
+using Mat2 = FixedMatrix <T, 2, 2>;
+
+template <class T>
+using Mat3 = FixedMatrix <T, 3, 3>;
+
+template <class T>
+using Mat4 = FixedMatrix <T, 4, 4>;
+
+using Mat2f = Mat2 <float>;
+using Mat2d = Mat2 <double>;
+
+using Mat3f = Mat3 <float>;
+using Mat3d = Mat3 <double>;
+
+using Mat4f = Mat4 <float>;
+using Mat4d = Mat4 <double>;
+
+}
+
+#endif
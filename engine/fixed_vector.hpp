@@ -5,377 +5,303 @@
 #include <cmath>
 #include <cassert>
 #include <cstdlib>
-
-// Engine headers
-#include "vector_type.hpp"
+#include <initializer_list>
 
 namespace zhetapi {
 
-// FixedVector class
-template <class T, size_t N>
-class FixedVector : public VectorType <T> {
-	T _array[N];
+/**
+ * @brief Common interface of the fixed size vectors, with components stored on
+ * the stack. The interface is resolved at compile time (CRTP) instead of
+ * through virtual methods, so that every operation can be inlined (and
+ * vectorized) by the compiler, and so that the vectors carry no vtable.
+ *
+ * @tparam T the type of each component.
+ * @tparam N the number of components.
+ * @tparam V the derived vector type, which provides operator[].
+ */
+template <class T, size_t N, class V>
+class FixedVectorBase {
 public:
-	size_t size() const override;
-
-	T &get(size_t) override;
-	const T &get(size_t) const override;
-
-	T &operator[](size_t) override;
-	const T &operator[](size_t) const override;
-
-	FixedVector &operator+=(const VectorType <T> &) override;
-	FixedVector &operator-=(const VectorType <T> &) override;
-
-	FixedVector &operator*=(const T &) override;
-	FixedVector &operator/=(const T &) override;
+	constexpr V &derived()
+	{
+		return static_cast <V &> (*this);
+	}
+
+	constexpr const V &derived() const
+	{
+		return static_cast <const V &> (*this);
+	}
+
+	static constexpr size_t size()
+	{
+		return N;
+	}
+
+	constexpr T &get(size_t i)
+	{
+		return derived()[i];
+	}
+
+	constexpr const T &get(size_t i) const
+	{
+		return derived()[i];
+	}
+
+	T norm() const;
+	V normalized() const;
+
+	constexpr V &operator+=(const V &);
+	constexpr V &operator-=(const V &);
+
+	constexpr V &operator*=(const T &);
+	constexpr V &operator/=(const T &);
 };
 
-template <class T, size_t N>
-size_t FixedVector <T, N> ::size() const
-{
-	return N;
-}
-
-template <class T, size_t N>
-T &FixedVector <T, N> ::get(size_t i)
+template <class T, size_t N, class V>
+T FixedVectorBase <T, N, V> ::norm() const
 {
-	return _array[i];
-}
-
-template <class T, size_t N>
-const T &FixedVector <T, N> ::get(size_t i) const
-{
-	return _array[i];
+	return std::sqrt(inner(derived(), derived()));
 }
 
-template <class T, size_t N>
-T &FixedVector <T, N> ::operator[](size_t i)
+template <class T, size_t N, class V>
+V FixedVectorBase <T, N, V> ::normalized() const
 {
-	return _array[i];
-}
+	V out = derived();
+	out /= norm();
 
-template <class T, size_t N>
-const T &FixedVector <T, N> ::operator[](size_t i) const
-{
-	return _array[i];
+	return out;
 }
 
-template <class T, size_t N>
-FixedVector <T, N> &FixedVector <T, N> ::operator+=(const VectorType <T> &other)
+template <class T, size_t N, class V>
+constexpr V &FixedVectorBase <T, N, V> ::operator+=(const V &other)
 {
-	assert(other.size() == N);
 	for (size_t i = 0; i < N; i++)
-		_array[i] += other[i];
+		derived()[i] += other[i];
 
-	return *this;
+	return derived();
 }
 
-template <class T, size_t N>
-FixedVector <T, N> &FixedVector <T, N> ::operator-=(const VectorType <T> &other)
+template <class T, size_t N, class V>
+constexpr V &FixedVectorBase <T, N, V> ::operator-=(const V &other)
 {
-	assert(other.size() == N);
 	for (size_t i = 0; i < N; i++)
-		_array[i] -= other[i];
+		derived()[i] -= other[i];
 
-	return *this;
+	return derived();
 }
 
-template <class T, size_t N>
-FixedVector <T, N> &FixedVector <T, N> ::operator*=(const T &k)
+template <class T, size_t N, class V>
+constexpr V &FixedVectorBase <T, N, V> ::operator*=(const T &k)
 {
 	for (size_t i = 0; i < N; i++)
-		_array[i] *= k;
+		derived()[i] *= k;
 
-	return *this;
+	return derived();
 }
 
-template <class T, size_t N>
-FixedVector <T, N> &FixedVector <T, N> ::operator/=(const T &k)
+template <class T, size_t N, class V>
+constexpr V &FixedVectorBase <T, N, V> ::operator/=(const T &k)
 {
 	assert(k != 0);
 	for (size_t i = 0; i < N; i++)
-		_array[i] /= k;
+		derived()[i] /= k;
 
-	return *this;
+	return derived();
 }
 
-// FixedVector for 3D
-template <class T>
-class FixedVector <T, 3> : public VectorType <T> {
-public:
-	T x, y, z;
-
-	FixedVector(const T & = T(), const T & = T(), const T & = T());
-
-	size_t size() const override;
-
-	T &get(size_t) override;
-	const T &get(size_t) const override;
-
-	T &operator[](size_t) override;
-	const T &operator[](size_t) const override;
-
-	T norm() const override;
-	FixedVector normalized() const;
-
-	FixedVector &operator+=(const VectorType <T> &) override;
-	FixedVector &operator-=(const VectorType <T> &) override;
-
-	FixedVector &operator+=(const FixedVector &);
-	FixedVector &operator-=(const FixedVector &);
-
-	FixedVector &operator*=(const T &) override;
-	FixedVector &operator/=(const T &) override;
-};
-
-template <class T>
-FixedVector <T, 3> ::FixedVector(const T &xp, const T &yp, const T &zp)
-		: x(xp), y(yp), z(zp) {}
-
-template <class T>
-size_t FixedVector <T, 3> ::size() const
+// Arithmetic for all fixed size vectors
+template <class T, size_t N, class V>
+constexpr V operator+(const FixedVectorBase <T, N, V> &a, const FixedVectorBase <T, N, V> &b)
 {
-	return 3;
-}
+	V out = a.derived();
+	out += b.derived();
 
-template <class T>
-T &FixedVector <T, 3> ::get(size_t i)
-{
-	return (i == 0) ? x : ((i == 1) ? y : z);
+	return out;
 }
 
-template <class T>
-const T &FixedVector <T, 3> ::get(size_t i) const
+template <class T, size_t N, class V>
+constexpr V operator-(const FixedVectorBase <T, N, V> &a, const FixedVectorBase <T, N, V> &b)
 {
-	return (i == 0) ? x : ((i == 1) ? y : z);
-}
+	V out = a.derived();
+	out -= b.derived();
 
-template <class T>
-T &FixedVector <T, 3> ::operator[](size_t i)
-{
-	return (i == 0) ? x : ((i == 1) ? y : z);
+	return out;
 }
 
-template <class T>
-const T &FixedVector <T, 3> ::operator[](size_t i) const
+template <class T, size_t N, class V>
+constexpr V operator-(const FixedVectorBase <T, N, V> &a)
 {
-	return (i == 0) ? x : ((i == 1) ? y : z);
-}
+	V out = a.derived();
+	out *= T(-1);
 
-template <class T>
-T FixedVector <T, 3> ::norm() const
-{
-	return std::sqrt(x * x + y * y + z * z);
+	return out;
 }
 
-template <class T>
-FixedVector <T, 3> FixedVector <T, 3> ::normalized() const
+template <class T, size_t N, class V>
+constexpr V operator*(const FixedVectorBase <T, N, V> &a, const T &k)
 {
-	T n = norm();
-	return FixedVector <T, 3> {x/n, y/n, z/n};
+	V out = a.derived();
+	out *= k;
+
+	return out;
 }
 
-template <class T>
-FixedVector <T, 3> &FixedVector <T, 3> ::operator+=(const VectorType <T> &other)
+template <class T, size_t N, class V>
+constexpr V operator*(const T &k, const FixedVectorBase <T, N, V> &a)
 {
-	assert(other.size() == 3);
-
-	x += other[0];
-	y += other[1];
-	z += other[2];
-
-	return *this;
+	return a * k;
 }
 
-template <class T>
-FixedVector <T, 3> &FixedVector <T, 3> ::operator-=(const VectorType <T> &other)
+template <class T, size_t N, class V>
+constexpr V operator/(const FixedVectorBase <T, N, V> &a, const T &k)
 {
-	assert(other.size() == 3);
-
-	x -= other[0];
-	y -= other[1];
-	z -= other[2];
+	V out = a.derived();
+	out /= k;
 
-	return *this;
+	return out;
 }
 
-template <class T>
-FixedVector <T, 3> &FixedVector <T, 3> ::operator+=(const FixedVector &other)
+template <class T, size_t N, class V>
+constexpr bool operator==(const FixedVectorBase <T, N, V> &a, const FixedVectorBase <T, N, V> &b)
 {
-	x += other.x;
-	y += other.y;
-	z += other.z;
+	for (size_t i = 0; i < N; i++) {
+		if (a.get(i) != b.get(i))
+			return false;
+	}
 
-	return *this;
+	return true;
 }
 
-template <class T>
-FixedVector <T, 3> &FixedVector <T, 3> ::operator-=(const FixedVector &other)
+template <class T, size_t N, class V>
+constexpr bool operator!=(const FixedVectorBase <T, N, V> &a, const FixedVectorBase <T, N, V> &b)
 {
-	x -= other.x;
-	y -= other.y;
-	z -= other.z;
-
-	return *this;
+	return !(a == b);
 }
 
-template <class T>
-FixedVector <T, 3> &FixedVector <T, 3> ::operator*=(const T &k)
+template <class T, size_t N, class V>
+constexpr T inner(const FixedVectorBase <T, N, V> &a, const FixedVectorBase <T, N, V> &b)
 {
-	x *= k;
-	y *= k;
-	z *= k;
+	T sum = 0;
+	for (size_t i = 0; i < N; i++)
+		sum += a.get(i) * b.get(i);
 
-	return *this;
+	return sum;
 }
 
-template <class T>
-FixedVector <T, 3> &FixedVector <T, 3> ::operator/=(const T &k)
-{
-	assert(k != 0);
+// FixedVector class
+template <class T, size_t N>
+class FixedVector : public FixedVectorBase <T, N, FixedVector <T, N>> {
+	T _array[N] {};
+public:
+	constexpr FixedVector() {}
+	constexpr FixedVector(std::initializer_list <T>);
 
-	x /= k;
-	y /= k;
-	z /= k;
+	constexpr T &operator[](size_t);
+	constexpr const T &operator[](size_t) const;
+};
 
-	return *this;
+/**
+ * @brief Constructs a vector from a list of components. Missing components are
+ * set to zero.
+ */
+template <class T, size_t N>
+constexpr FixedVector <T, N> ::FixedVector(std::initializer_list <T> list)
+{
+	size_t i = 0;
+	for (const T &x : list) {
+		if (i < N)
+			_array[i++] = x;
+	}
 }
 
-// Optimized dot product
-template <class T>
-T dot(const FixedVector <T, 3> &a, const FixedVector <T, 3> &b)
+template <class T, size_t N>
+constexpr T &FixedVector <T, N> ::operator[](size_t i)
 {
-	return a.x * b.x + a.y * b.y + a.z * b.z;
+	return _array[i];
 }
 
-template <class T>
-FixedVector <T, 3> cross(const FixedVector <T, 3> &a, const FixedVector <T, 3> &b)
+template <class T, size_t N>
+constexpr const T &FixedVector <T, N> ::operator[](size_t i) const
 {
-	return {
-		a.y * b.z - a.z * b.y,
-		a.z * b.x - a.x * b.z,
-		a.x * b.y - a.y * b.x
-	};
+	return _array[i];
 }
 
-// FixedVector for 2D
+// FixedVector for 3D
 template <class T>
-class FixedVector <T, 2> : public VectorType <T> {
+class FixedVector <T, 3> : public FixedVectorBase <T, 3, FixedVector <T, 3>> {
 public:
-	T x, y;
-
-	size_t size() const override;
-
-	T &get(size_t) override;
-	const T &get(size_t) const override;
-
-	T &operator[](size_t) override;
-	const T &operator[](size_t) const override;
-
-	FixedVector &operator+=(const VectorType <T> &) override;
-	FixedVector &operator-=(const VectorType <T> &) override;
+	T x, y, z;
 
-	FixedVector &operator+=(const FixedVector &);
-	FixedVector &operator-=(const FixedVector &);
+	constexpr FixedVector(const T & = T(), const T & = T(), const T & = T());
 
-	FixedVector &operator*=(const T &) override;
-	FixedVector &operator/=(const T &) override;
+	constexpr T &operator[](size_t);
+	constexpr const T &operator[](size_t) const;
 };
 
 template <class T>
-size_t FixedVector <T, 2> ::size() const
-{
-	return 2;
-}
-
-template <class T>
-T &FixedVector <T, 2> ::get(size_t i)
-{
-	return (i == 0) ? x : y;
-}
+constexpr FixedVector <T, 3> ::FixedVector(const T &xp, const T &yp, const T &zp)
+		: x(xp), y(yp), z(zp) {}
 
 template <class T>
-const T &FixedVector <T, 2> ::get(size_t i) const
+constexpr T &FixedVector <T, 3> ::operator[](size_t i)
 {
-	return (i == 0) ? x : y;
+	return (i == 0) ? x : ((i == 1) ? y : z);
 }
 
 template <class T>
-T &FixedVector <T, 2> ::operator[](size_t i)
+constexpr const T &FixedVector <T, 3> ::operator[](size_t i) const
 {
-	return (i == 0) ? x : y;
+	return (i == 0) ? x : ((i == 1) ? y : z);
 }
 
+// Optimized inner product
 template <class T>
-const T &FixedVector <T, 2> ::operator[](size_t i) const
+constexpr T inner(const FixedVector <T, 3> &a, const FixedVector <T, 3> &b)
 {
-	return (i == 0) ? x : y;
+	return a.x * b.x + a.y * b.y + a.z * b.z;
 }
 
 template <class T>
-FixedVector <T, 2> &FixedVector <T, 2> ::operator+=(const VectorType <T> &other)
+constexpr FixedVector <T, 3> cross(const FixedVector <T, 3> &a, const FixedVector <T, 3> &b)
 {
-	assert(other.size() == 2);
-
-	x += other[0];
-	y += other[1];
-
-	return *this;
+	return {
+		a.y * b.z - a.z * b.y,
+		a.z * b.x - a.x * b.z,
+		a.x * b.y - a.y * b.x
+	};
 }
 
+// FixedVector for 2D
 template <class T>
-FixedVector <T, 2> &FixedVector <T, 2> ::operator-=(const VectorType <T> &other)
-{
-	assert(other.size() == 2);
-
-	x -= other[0];
-	y -= other[1];
+class FixedVector <T, 2> : public FixedVectorBase <T, 2, FixedVector <T, 2>> {
+public:
+	T x, y;
 
-	return *this;
-}
+	constexpr FixedVector(const T & = T(), const T & = T());
 
-template <class T>
-FixedVector <T, 2> &FixedVector <T, 2> ::operator+=(const FixedVector &other)
-{
-	x += other.x;
-	y += other.y;
-
-	return *this;
-}
+	constexpr T &operator[](size_t);
+	constexpr const T &operator[](size_t) const;
+};
 
 template <class T>
-FixedVector <T, 2> &FixedVector <T, 2> ::operator-=(const FixedVector &other)
-{
-	x -= other.x;
-	y -= other.y;
-
-	return *this;
-}
+constexpr FixedVector <T, 2> ::FixedVector(const T &xp, const T &yp)
+		: x(xp), y(yp) {}
 
 template <class T>
-FixedVector <T, 2> &FixedVector <T, 2> ::operator*=(const T &k)
+constexpr T &FixedVector <T, 2> ::operator[](size_t i)
 {
-	x *= k;
-	y *= k;
-
-	return *this;
+	return (i == 0) ? x : y;
 }
 
 template <class T>
-FixedVector <T, 2> &FixedVector <T, 2> ::operator/=(const T &k)
+constexpr const T &FixedVector <T, 2> ::operator[](size_t i) const
 {
-	assert(k != 0);
-
-	x /= k;
-	y /= k;
-
-	return *this;
+	return (i == 0) ? x : y;
 }
 
-// Optimized dot product
+// Optimized inner product
 template <class T>
-T dot(const FixedVector <T, 2> &a, const FixedVector <T, 2> &b)
+constexpr T inner(const FixedVector <T, 2> &a, const FixedVector <T, 2> &b)
 {
 	return a.x * b.x + a.y * b.y;
 }
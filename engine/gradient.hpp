@@ -4,8 +4,11 @@
 #ifndef __AVR	// Does not support AVR
 
 // C/C++ headers
-#include <mutex>
-#include <thread>
+#include <algorithm>
+#include <type_traits>
+
+// Engine headers
+#include "profiler.hpp"
 
 #endif		// Does not support AVR
 
@@ -36,7 +39,7 @@ Vector <T> simple_compute(
 	return tmp;
 }
 
-template <class T>
+template <class T, class A = T>
 Vector <T> simple_compute_cached(
 		Layer <T> *layers,
 		size_t size,
@@ -51,9 +54,10 @@ Vector <T> simple_compute_cached(
 	while (i < size) {
 		a[i] = tmp.append_above(T (1));
 
-		layers[i].forward_propogate(tmp, prv);
+		layers[i].template forward_propogate <A> (tmp, prv);
 		
-		z[i++] = layers[i]._dact->compute(prv);
+		z[i] = layers[i]._dact->compute(prv);
+		i++;
 	}
 
 	a[i] = tmp;
@@ -100,7 +104,7 @@ Matrix <T> *jacobian_kernel(
 }
 
 // Jacobian during the processing of input to output
-template <class T>
+template <class T, class A = T>
 Matrix <T> *jacobian_kernel(
 		Layer <T> *layers,
 		size_t size,
@@ -111,7 +115,7 @@ Matrix <T> *jacobian_kernel(
 		Vector <T> &delta)
 {
 	// Compute the actual value
-	Vector <T> actual = simple_compute_cached(layers, size, a, z, in);
+	Vector <T> actual = simple_compute_cached <T, A> (layers, size, a, z, in);
 
 	// Construction the Jacobian using backpropogation
 	Matrix <T> *J = new Matrix <T> [size];
@@ -120,7 +124,7 @@ Matrix <T> *jacobian_kernel(
 		if (i < size - 1) {
 			delta = AVR_SWITCH(
 				rmt_and_mult(layers[i + 1]._mat, delta),
-				std::move(rmt_and_mult(layers[i + 1]._mat, delta))
+				std::move(rmt_and_mult <T, A> (layers[i + 1]._mat, delta))
 			);
 		}
 
@@ -191,7 +195,19 @@ Matrix <T> *jacobian_kernel_check(
 	return J;
 }
 
+/*
+ * Whether the gradients use the fused softmax and cross entropy delta (see
+ * batch_softmax_ce_delta) for the output layer, instead of the derivative of
+ * the error followed by that of the activation.
+ */
 template <class T>
+bool softmax_cross_entropy(const Layer <T> &out, const Erf <T> *dcost)
+{
+	return out._act->get_activation_type() == Activation <T> ::AT_Softmax
+		&& dcost->get_erf_type() == Erf <T> ::OPT_DCE;
+}
+
+template <class T, class A = T>
 Matrix <T> *simple_gradient(
 		Layer <T> *layers,
 		size_t size,
@@ -202,7 +218,7 @@ Matrix <T> *simple_gradient(
 		Erf <T> *cost)
 {
 	// Compute the actual value
-	Vector <T> actual = simple_compute_cached(layers, size, a, z, in);
+	Vector <T> actual = simple_compute_cached <T, A> (layers, size, a, z, in);
 
 	// Get the derivative of the cost
 	Erf <T> *dcost = cost->derivative();
@@ -210,17 +226,25 @@ Matrix <T> *simple_gradient(
 	// Construction the Jacobian using backpropogation
 	Matrix <T> *J = new Matrix <T> [size];
 
-	Vector <T> delta = dcost->compute(out, actual);
+	// Same output delta as the batched gradients
+	bool fused = softmax_cross_entropy(layers[size - 1], dcost);
+
+	Vector <T> delta;
+	if (fused)
+		delta = softmax_ce_delta(out, actual);
+	else
+		delta = dcost->compute(out, actual);
 	
-	for (int i = size - 1; i >= 0; i--) {
+	for (size_t i = size; i-- > 0; ) {
 		if (i < size - 1) {
 			delta = AVR_SWITCH(
 				rmt_and_mult(layers[i + 1]._mat, delta),
-				std::move(rmt_and_mult(layers[i + 1]._mat, delta))
+				std::move(rmt_and_mult <T, A> (layers[i + 1]._mat, delta))
 			);
 		}
 
-		delta.stable_shur(z[i]);
+		if (!fused || i < size - 1)
+			delta.stable_shur(z[i]);
 
 		J[i] = AVR_SWITCH(
 			vvt_mult(delta, a[i]),
@@ -237,8 +261,258 @@ Matrix <T> *simple_gradient(
 
 #ifndef __AVR	// Does not support AVR
 
-// TODO: Should there be an alternative for DataSet?
+// Thrown when activations with dropout would have to be recomputed
+class bad_checkpointing {};
+
+// Batched counterpart of simple_compute_cached: each row of the input is a
+// sample, and the caches hold a matrix (one row per sample) for each layer
+template <class T>
+Matrix <T> batch_compute_cached(
+		Layer <T> *layers,
+		size_t size,
+		Matrix <T> *A,
+		Matrix <T> *Z,
+		const Matrix <T> &in)
+{
+	A[0] = in;
+	for (size_t i = 0; i < size; i++) {
+		Matrix <T> prv = batch_apt_and_mult(layers[i]._mat, A[i]);
+
+		A[i + 1] = layers[i]._act->batch_compute(prv);
+		if (layers[i]._dp_enable && layers[i]._dropout > 0)
+			A[i + 1].nullify(layers[i]._dropout, layers[i]._unit);
+
+		Z[i] = layers[i]._dact->batch_compute(prv);
+	}
+
+	return A[size];
+}
+
+/*
+ * Batched counterpart of simple_batch_gradient: the batch (one sample per row
+ * of ins and outs) goes through each layer as a single matrix product, and the
+ * gradient of each layer is a single matrix product of the deltas and the
+ * cached inputs. Returns the average gradient over the batch.
+ */
+template <class T>
+Matrix <T> *batch_gradient(
+		Layer <T> *layers,
+		size_t size,
+		Matrix <T> *A,
+		Matrix <T> *Z,
+		const Matrix <T> &ins,
+		const Matrix <T> &outs,
+		Erf <T> *cost)
+{
+	size_t ds = ins.get_rows();
+
+	// Compute the actual values
+	Matrix <T> actual = batch_compute_cached(layers, size, A, Z, ins);
+
+	// Get the derivative of the cost
+	Erf <T> *dcost = cost->derivative();
+
+	// Construction the Jacobian using backpropogation
+	Matrix <T> *J = new Matrix <T> [size];
+
+	bool fused = softmax_cross_entropy(layers[size - 1], dcost);
+
+	Matrix <T> delta;
+	if (fused)
+		batch_softmax_ce_delta(outs, actual, delta);
+	else
+		dcost->batch_compute(outs, actual, delta);
+
+	for (size_t i = size; i-- > 0; ) {
+		if (i < size - 1)
+			delta = batch_rmt_and_mult(layers[i + 1]._mat, delta);
+
+		if (!fused || i < size - 1)
+			delta.stable_shur(Z[i]);
+
+		J[i] = batch_vvt_mult(delta, A[i]);
+		J[i] /= T(ds);
+	}
+
+	// Free resources
+	delete dcost;
+
+	return J;
+}
+
+/*
+ * Allocation-free counterpart of batch_gradient, on preallocated buffers (see
+ * workspace.hpp). The inputs are read from A[0] and the targets from Y. The
+ * caches A and Z, the deltas D and the gradients J are overwritten in place,
+ * and keep their dimensions from one batch to the next. The gradients are
+ * summed over the batch, not averaged. The phases are recorded into prof, if
+ * it is not null (see profiler.hpp).
+ *
+ * With an interval k > 1, only the inputs of every k-th layer (and the output)
+ * are expected to be kept from the forward pass; the buffers of the layers in
+ * between may be shared between segments of k layers, and the deltas between
+ * layers two apart (see Workspace::set_checkpoint_interval). Each segment but
+ * the last one is recomputed from its checkpoint before going backward through
+ * it. Dropout cannot be recomputed (the masks are random), so it is rejected.
+ */
+template <class T>
+void batch_gradient_sum(
+		Layer <T> *layers,
+		size_t size,
+		Matrix <T> *A,
+		Matrix <T> *Z,
+		Matrix <T> *D,
+		const Matrix <T> &Y,
+		Erf <T> *dcost,
+		Matrix <T> *J,
+		Profiler *prof,
+		size_t interval)
+{
+	// Layers per segment (a single segment without checkpointing)
+	size_t k = (interval > 1 && interval < size) ? interval : size;
+
+	if (k < size) {
+		for (size_t i = 0; i < size; i++) {
+			if (layers[i]._dp_enable && layers[i]._dropout > 0)
+				throw bad_checkpointing();
+		}
+	}
+
+	// The derivative of the output layer is not needed with the fused
+	// softmax and cross entropy
+	bool fused = softmax_cross_entropy(layers[size - 1], dcost);
+
+	double n = A[0].get_rows();
+
+	// Z holds the linear outputs until they are activated (the activation
+	// itself is skipped when only the derivative is needed)
+	auto forward = [&](size_t i, bool activate) {
+		double outs = n * layers[i]._mat.get_rows();
+
+		{
+			ProfileSection ps(prof, i, PROF_Forward,
+					2 * outs * layers[i]._mat.get_cols());
+
+			batch_apt_and_mult(layers[i]._mat, A[i], Z[i]);
+		}
+
+		ProfileSection ps(prof, i, PROF_Activation, 2 * outs);
+
+		if (activate) {
+			layers[i]._act->batch_compute(Z[i], A[i + 1]);
+			if (layers[i]._dp_enable && layers[i]._dropout > 0)
+				A[i + 1].nullify(layers[i]._dropout, layers[i]._unit);
+		}
+
+		if (!fused || i < size - 1)
+			layers[i]._dact->batch_compute(Z[i], Z[i]);
+	};
+
+	// Forward pass
+	for (size_t i = 0; i < size; i++)
+		forward(i, true);
+
+	// Backward pass
+	{
+		ProfileSection ps(prof, size - 1, PROF_Backward,
+				n * layers[size - 1]._mat.get_rows());
+
+		if (fused)
+			batch_softmax_ce_delta(Y, A[size], D[size - 1]);
+		else
+			dcost->batch_compute(Y, A[size], D[size - 1]);
+	}
+
+	for (size_t end = size; end > 0; ) {
+		size_t start = ((end - 1)/k) * k;
+
+		// The last segment is still in the buffers; the output of the
+		// others is a checkpoint, which is not recomputed
+		if (end < size) {
+			for (size_t i = start; i < end; i++)
+				forward(i, i + 1 < end);
+		}
+
+		for (size_t i = end; i-- > start; ) {
+			double outs = n * layers[i]._mat.get_rows();
+
+			{
+				double flops = (i < size - 1)
+					? 2 * n * layers[i + 1]._mat.get_rows()
+						* layers[i + 1]._mat.get_cols()
+					: 0;
+
+				ProfileSection ps(prof, i, PROF_Backward, flops + outs);
+
+				if (i < size - 1)
+					batch_rmt_and_mult(layers[i + 1]._mat, D[i + 1], D[i]);
+
+				if (!fused || i < size - 1)
+					D[i].stable_shur(Z[i]);
+			}
+
+			ProfileSection ps(prof, i, PROF_Gradient,
+					2 * outs * layers[i]._mat.get_cols());
+
+			batch_vvt_mult(D[i], A[i], J[i]);
+		}
+
+		end = start;
+	}
+}
+
+/**
+ * @brief Adds a gradient into an accumulator, which may have a wider type than
+ * the gradient. An empty accumulator takes the dimensions of the gradient.
+ */
+template <class A, class T>
+void accumulate_gradient(Matrix <A> &acc, const Matrix <T> &J)
+{
+	if (acc.get_dimensions() != J.get_dimensions()) {
+		acc = Matrix <A> (J);
+
+		return;
+	}
+
+	size_t n = J.get_rows() * J.get_cols();
+
+	A *dst = acc[0];
+	const T *src = J[0];
+
+	for (size_t i = 0; i < n; i++)
+		dst[i] += A(src[i]);
+}
+
+// Averages accumulated gradients, converting them to the parameter type
 template <class T>
+Matrix <T> *average_gradient(Matrix <T> *acc, size_t size, size_t n, std::true_type)
+{
+	for (size_t i = 0; i < size; i++)
+		acc[i] /= T(n);
+
+	return acc;
+}
+
+template <class T, class A>
+Matrix <T> *average_gradient(Matrix <A> *acc, size_t size, size_t n, std::false_type)
+{
+	Matrix <T> *J = new Matrix <T> [size];
+	for (size_t i = 0; i < size; i++)
+		J[i] = Matrix <T> (acc[i] / A(n));
+
+	delete[] acc;
+
+	return J;
+}
+
+/*
+ * The batch gradients are summed in A, which can be wider than the type of the
+ * network (mixed precision: float parameters and activations with double
+ * dot products and gradient sums). The average is returned in T.
+ *
+ * TODO: Should there be an alternative for DataSet?
+ */
+template <class T, class A = T>
 Matrix <T> *simple_batch_gradient(
 		Layer <T> *layers,
 		size_t size,
@@ -250,109 +524,174 @@ Matrix <T> *simple_batch_gradient(
 {
 	size_t ds = ins.size();
 
-	Matrix <T> *J = simple_gradient(
-			layers,
-			size,
-			a,
-			z,
-			ins[0],
-			outs[0],
-			cost);
-
-	for (size_t i = 1; i < ds; i++) {
-		Matrix <T> *Q = nullptr;
-
-		Q = simple_gradient(layers, size, a,
+	Matrix <A> *J = new Matrix <A> [size];
+	for (size_t i = 0; i < ds; i++) {
+		Matrix <T> *Q = simple_gradient <T, A> (layers, size, a,
 					z, ins[i], outs[i], cost);
 
 		for (size_t k = 0; k < size; k++)
-			J[k] += Q[k];
+			accumulate_gradient(J[k], Q[k]);
 
 		delete[] Q;
 	}
 
-	for (size_t i = 0; i < size; i++)
-		J[i] /= T(ds);
-
-	return J;
+	return average_gradient <T> (J, size, ds, std::is_same <T, A> ());
 }
 
+// Sums the gradients of the samples [start, end) into acc, in one batched pass
 template <class T>
-Matrix <T> *simple_multithreaded_batch_gradient(
+void chunk_gradient(
 		Layer <T> *layers,
 		size_t size,
 		const DataSet <T> &ins,
 		const DataSet <T> &outs,
 		Erf <T> *cost,
-		size_t threads)
+		size_t start,
+		size_t end,
+		Matrix <T> *acc,
+		std::true_type)
 {
-	size_t ds = ins.size();
-
-
-	Vector <T> *ta = new Vector <T> [size + 1];
-	Vector <T> *tz = new Vector <T> [size];
-
-	Matrix <T> *J = simple_gradient(layers, size, ta,
-			tz, ins[0], outs[0], cost);
-
-	std::mutex task_mtx;
-	std::mutex addm_mtx;
+	Matrix <T> *A = new Matrix <T> [size + 1];
+	Matrix <T> *Z = new Matrix <T> [size];
 
-	size_t task = 1;
-	auto ftn = [&]() {
-		Vector <T> *a = new Vector <T> [size + 1]; 
-		Vector <T> *z = new Vector <T> [size]; 
-		
-		Matrix <T> *Q;
-		int t;
+	Matrix <T> *Q = batch_gradient(layers, size, A, Z,
+			to_matrix(ins, start, end),
+			to_matrix(outs, start, end),
+			cost);
 
-		while (true) {
-			t = -1;
+	// batch_gradient averages over the chunk
+	for (size_t k = 0; k < size; k++) {
+		Q[k] *= T(end - start);
 
-			task_mtx.lock();
+		acc[k] = std::move(Q[k]);
+	}
 
-			if (task < ds) {
-				t = task;
+	delete[] Q;
+	delete[] A;
+	delete[] Z;
+}
 
-				task++;
-			}
+// Sums the gradients of the samples [start, end) into acc, one sample at a time
+template <class T, class A>
+void chunk_gradient(
+		Layer <T> *layers,
+		size_t size,
+		const DataSet <T> &ins,
+		const DataSet <T> &outs,
+		Erf <T> *cost,
+		size_t start,
+		size_t end,
+		Matrix <A> *acc,
+		std::false_type)
+{
+	Vector <T> *a = new Vector <T> [size + 1];
+	Vector <T> *z = new Vector <T> [size];
 
-			task_mtx.unlock();
+	for (size_t i = start; i < end; i++) {
+		Matrix <T> *Q = simple_gradient <T, A> (layers, size, a,
+				z, ins[i], outs[i], cost);
 
-			if (t < 0)
-				break;
+		for (size_t k = 0; k < size; k++)
+			accumulate_gradient(acc[k], Q[k]);
 
-			Q = simple_gradient(layers, size, a,
-					z, ins[t], outs[t], cost);
-			
-			addm_mtx.lock();
+		delete[] Q;
+	}
 
-			for (size_t k = 0; k < size; k++)
-				J[k] += Q[k];
+	delete[] a;
+	delete[] z;
+}
 
-			addm_mtx.unlock();
+/**
+ * @brief Combines the gradient sums of each chunk into sums[0], adding pairs
+ * of chunks at a time (a tree reduction). Each level of the tree is run on the
+ * pool, and no two tasks touch the same buffer, so no locks are needed.
+ */
+template <class A>
+void reduce_gradients(ThreadPool &pool, Matrix <A> **sums, size_t chunks, size_t size)
+{
+	// The tasks capture a single pointer, which std::function stores
+	// without allocating
+	struct {
+		Matrix <A> **	sums;
+		size_t		chunks;
+		size_t		size;
+		size_t		stride;
+	} level {sums, chunks, size, 1};
+
+	auto *lp = &level;
+	for (; level.stride < chunks; level.stride *= 2) {
+		size_t pairs = (chunks + 2 * level.stride - 1)/(2 * level.stride);
+
+		pool.run(pairs * size,
+			[lp](size_t t) {
+				size_t i = 2 * lp->stride * (t / lp->size);
+				size_t k = t % lp->size;
+				size_t j = i + lp->stride;
+
+				// Empty chunks contribute nothing
+				if (j < lp->chunks && lp->sums[j][k].get_rows())
+					accumulate_gradient(lp->sums[i][k], lp->sums[j][k]);
+			}
+		);
+	}
+}
 
-			delete[] Q;
+/*
+ * The samples are split into one contiguous chunk per thread of the pool, and
+ * each thread sums the gradients of its chunk into its own buffers (with a
+ * single batched pass when T and A are the same). The sums are then combined
+ * with reduce_gradients and averaged. The same pool should be reused across
+ * batches, so that no threads are created during training.
+ */
+template <class T, class A = T>
+Matrix <T> *simple_multithreaded_batch_gradient(
+		Layer <T> *layers,
+		size_t size,
+		const DataSet <T> &ins,
+		const DataSet <T> &outs,
+		Erf <T> *cost,
+		ThreadPool &pool)
+{
+	size_t ds = ins.size();
+	size_t chunks = std::max(std::min(pool.size(), ds), (size_t) 1);
+
+	Matrix <A> **sums = new Matrix <A> *[chunks];
+	for (size_t i = 0; i < chunks; i++)
+		sums[i] = new Matrix <A> [size];
+
+	pool.run(chunks,
+		[&](size_t i) {
+			chunk_gradient <T> (layers, size, ins, outs, cost,
+					(ds * i)/chunks,
+					(ds * (i + 1))/chunks,
+					sums[i],
+					std::is_same <T, A> ());
 		}
+	);
 
-		delete[] a;
-		delete[] z;
-	};
+	reduce_gradients(pool, sums, chunks, size);
 
-	std::thread *army = new std::thread[threads];
-	for (size_t i = 0; i < threads; i++)
-		army[i] = std::thread(ftn);
+	Matrix <A> *J = sums[0];
+	for (size_t i = 1; i < chunks; i++)
+		delete[] sums[i];
 
-	for (size_t i = 0; i < threads; i++)
-		army[i].join();
+	delete[] sums;
 
-	for (size_t i = 0; i < size; i++)
-		J[i] /= T(ds);
-	
-	delete[] ta;
-	delete[] tz;
+	return average_gradient <T> (J, size, ds, std::is_same <T, A> ());
+}
 
-	return J;
+// Same as above, on the pool of the calling thread (see ThreadPool::local)
+template <class T, class A = T>
+Matrix <T> *simple_multithreaded_batch_gradient(
+		Layer <T> *layers,
+		size_t size,
+		const DataSet <T> &ins,
+		const DataSet <T> &outs,
+		Erf <T> *cost,
+		size_t threads)
+{
+	return simple_multithreaded_batch_gradient <T, A> (layers, size,
+			ins, outs, cost, ThreadPool::local(threads));
 }
 
 #endif		// Does not support AVR
@@ -0,0 +1,137 @@
+#ifndef IDX_H_
+#define IDX_H_
+
+#ifndef __AVR	// Does not support AVR
+
+// C/C++ headers
+#include <cstddef>
+#include <string>
+
+// Engine headers
+#include "matrix.hpp"
+#include "tensor.hpp"
+
+namespace zhetapi {
+
+/**
+ * @brief Reader for the IDX files of unsigned bytes (idx1-ubyte, idx3-ubyte,
+ * etc.), as used by MNIST.
+ *
+ * The file is memory-mapped (privately, so that it is never modified) instead
+ * of being read: opening it only parses the header, the pages of the samples
+ * are read when they are first accessed, and processes which open the same
+ * file share them through the page cache. The header is validated (the magic
+ * number, the type of the components and the size of the file), and the sizes
+ * are decoded as big-endian numbers whatever the byte order of the host.
+ *
+ * The first dimension is the number of samples. Samples are available as
+ * tensors which point into the mapping (and are only valid for as long as the
+ * IDXFile), or can be converted and scaled directly into the rows of a
+ * floating point matrix, for batches.
+ */
+class IDXFile {
+	int		_fd		= -1;
+
+	unsigned char *	_map		= nullptr;
+	size_t		_length	= 0;
+
+	// Components of the first sample
+	unsigned char *	_data		= nullptr;
+
+	size_t		_samples	= 0;
+
+	// Dimensions of each sample (a single component for idx1 files)
+	size_t *	_shape		= nullptr;
+	size_t		_dims		= 0;
+	size_t		_stride	= 0;
+
+	void close();
+public:
+	explicit IDXFile(const std::string &);
+
+	IDXFile(const IDXFile &) = delete;
+	IDXFile &operator=(const IDXFile &) = delete;
+
+	~IDXFile();
+
+	size_t size() const;
+	size_t sample_size() const;
+	size_t dimensions() const;
+	size_t dim_size(size_t) const;
+
+	const unsigned char *data() const;
+	const unsigned char *sample(size_t) const;
+
+	Tensor <unsigned char> operator[](size_t) const;
+
+	template <class T>
+	void convert(size_t, T *, T = T(1)) const;
+
+	template <class T>
+	void convert(size_t, size_t, Matrix <T> &, T = T(1)) const;
+
+	template <class T>
+	void one_hot(size_t, size_t, size_t, Matrix <T> &) const;
+
+	// Exceptions
+	class bad_file {};
+	class bad_header {};
+	class bad_index {};
+};
+
+/**
+ * @brief Converts a sample to floating point, multiplying each component by a
+ * scale (for example 1/255 to normalize pixels).
+ *
+ * @param i the index of the sample.
+ * @param dst the destination, with room for sample_size() components.
+ * @param scale the factor applied to each component.
+ */
+template <class T>
+void IDXFile::convert(size_t i, T *dst, T scale) const
+{
+	const unsigned char *src = sample(i);
+
+	for (size_t j = 0; j < _stride; j++)
+		dst[j] = T(src[j]) * scale;
+}
+
+/**
+ * @brief Converts the samples [start, end) into the rows of a matrix, in a
+ * single pass over the mapping.
+ */
+template <class T>
+void IDXFile::convert(size_t start, size_t end, Matrix <T> &out, T scale) const
+{
+	if (start > end || end > _samples)
+		throw bad_index();
+
+	out.resize(end - start, _stride);
+	for (size_t i = start; i < end; i++)
+		convert(i, out[i - start], scale);
+}
+
+/**
+ * @brief Expands the labels [start, end) (a file of single bytes) into one-hot
+ * rows of a matrix with the given number of classes.
+ */
+template <class T>
+void IDXFile::one_hot(size_t start, size_t end, size_t classes, Matrix <T> &out) const
+{
+	if (start > end || end > _samples || _stride != 1)
+		throw bad_index();
+
+	out.resize(end - start, classes);
+	for (size_t i = start; i < end; i++) {
+		T *row = out[i - start];
+
+		for (size_t j = 0; j < classes; j++)
+			row[j] = T(_data[i] == j);
+	}
+}
+
+}
+
+#endif		// Does not support AVR
+
+#endif
@@ -127,10 +127,14 @@ public:
 	size_t height() const;
 	size_t channels() const;
 
+#ifndef ZHP_NO_GUI
+
 	// For SFML
 	sf::Image sfml_image() const;
 	sf::Texture sfml_texture() const;
 
+#endif
+
 	// Pixel value setter
 	void set(const pixel &, const Color &);			// Color
 	void set(const pixel &, size_t, byte);
@@ -146,6 +150,9 @@ public:
 	Image channel(size_t) const;
 	Image crop(const pixel &, const pixel &) const;
 
+	// Non-owning view of a crop (no copies)
+	MatrixView <const byte> crop_view(const pixel &, const pixel &) const;
+
 	const unsigned char *const raw() const;
 
 	unsigned char **row_bytes() const;
@@ -31,6 +31,8 @@ using InitFtn = AVR_SWITCH(
 template <class T>
 class Erf;
 
+class Profiler;
+
 // FIXME: Dropout should not be active during inference phase
 template <class T = double>
 class Layer {
@@ -46,7 +48,7 @@ class Layer {
 
 	// Dropout is off by default
 	long double		_dropout	= 0;
-	bool			_dp_enable	= false;
+	mutable bool		_dp_enable	= false;
 
 	void clear();
 
@@ -69,6 +71,8 @@ public:
 
 	Matrix <T> &mat() {return _mat;}
 
+	const Activation <T> *activation() const {return _act;}
+
 	// Getters and setters
 	size_t get_fan_in() const;
 	size_t get_fan_out() const;
@@ -83,13 +87,24 @@ public:
 	AVR_IGNORE(void write(std::ofstream &) const);
 	AVR_IGNORE(void read(std::ifstream &));
 
+	// Weights stored outside of the layer (see DNN::load_model)
+	AVR_IGNORE(void write_activation(std::ofstream &) const);
+	AVR_IGNORE(void map(T *, size_t, size_t, Activation <T> *));
+
 	// Initialize
 	void initialize();
 
 	// Computation
 	Vector <T> forward_propogate(const Vector <T> &);
 
-	// Computation with dropout
+	// Batched computation (one input per row)
+	AVR_IGNORE(Matrix <T> forward_propogate(const Matrix <T> &));
+
+	// Batched computation without dropout, into preallocated outputs
+	AVR_IGNORE(void infer(const Matrix <T> &, Matrix <T> &) const);
+
+	// Computation with dropout (sums accumulated in A)
+	template <class A = T>
 	void forward_propogate(Vector <T> &, Vector <T> &);
 	
 	void apply_gradient(const Matrix <T> &);
@@ -98,7 +113,7 @@ public:
 	void print() const;
 
 	// Friend functions
-	template <class U>
+	template <class U, class A>
 	friend Vector <U> simple_compute_cached(
 		Layer <U> *,
 		size_t,
@@ -117,7 +132,7 @@ public:
 		const Vector <U> &
 	);
 
-	template <class U>
+	template <class U, class A>
 	friend Matrix <U> *jacobian_kernel(
 		Layer <U> *,
 		size_t,
@@ -137,7 +152,7 @@ public:
 		Erf <U> *
 	);
 	
-	template <class U>
+	template <class U, class A>
 	friend Matrix <U> *simple_gradient(
 		Layer <U> *,
 		size_t,
@@ -148,6 +163,43 @@ public:
 		Erf <U> *
 	);
 
+	template <class U>
+	friend Matrix <U> batch_compute_cached(
+		Layer <U> *,
+		size_t,
+		Matrix <U> *,
+		Matrix <U> *,
+		const Matrix <U> &
+	);
+
+	template <class U>
+	friend Matrix <U> *batch_gradient(
+		Layer <U> *,
+		size_t,
+		Matrix <U> *,
+		Matrix <U> *,
+		const Matrix <U> &,
+		const Matrix <U> &,
+		Erf <U> *
+	);
+
+	template <class U>
+	friend bool softmax_cross_entropy(const Layer <U> &, const Erf <U> *);
+
+	template <class U>
+	friend void batch_gradient_sum(
+		Layer <U> *,
+		size_t,
+		Matrix <U> *,
+		Matrix <U> *,
+		Matrix <U> *,
+		const Matrix <U> &,
+		Erf <U> *,
+		Matrix <U> *,
+		Profiler *,
+		size_t
+	);
+
 	Layer <T> &operator+=(const Matrix <T> &);
 
 	template <class U>
@@ -288,11 +340,46 @@ void Layer <T> ::read(std::ifstream &fin)
 	fin.read((char *) &r, sizeof(size_t));
 	fin.read((char *) &c, sizeof(size_t));
 
+	_fan_out = r;
+	_fan_in = c - 1;
+
 	_mat = Matrix <T> (r, c, T(0));
 
 	_mat.read(fin);
 
+	clear();
+
 	_act = Activation <T> ::load(fin);
+	_dact = _act->derivative();
+}
+
+template <class T>
+void Layer <T> ::write_activation(std::ofstream &fout) const
+{
+	_act->write(fout);
+}
+
+/**
+ * @brief Makes the layer use weights which are stored elsewhere (and which
+ * must outlive the layer), without copying them.
+ *
+ * @param weights the weights, as a rows x cols matrix (with the bias column).
+ * @param rows the number of outputs.
+ * @param cols the number of inputs plus one.
+ * @param act the activation, which is taken over by the layer.
+ */
+template <class T>
+void Layer <T> ::map(T *weights, size_t rows, size_t cols, Activation <T> *act)
+{
+	_fan_out = rows;
+	_fan_in = cols - 1;
+
+	_mat = Matrix <T> (rows, cols, weights);
+
+	clear();
+
+	_act = act;
+	_dact = _act->derivative();
 }
 
 #endif		// Does not support AVR
@@ -309,19 +396,48 @@ template <class T>
 inline Vector <T> Layer <T> ::forward_propogate(const Vector <T> &in)
 {
 	if (!_dp_enable)
-		return _act->compute(_mat * in.append_above(T (1)));
+		return _act->compute(apt_and_mult(_mat, in));
 
-	Vector <T> out = _act->compute(_mat * in.append_above(T (1)));
+	Vector <T> out = _act->compute(apt_and_mult(_mat, in));
 	if (_dropout > 0)
 		out.nullify(_dropout, _unit);
 
 	return out;
 }
 
+#ifndef __AVR	// Does not support AVR
+
+template <class T>
+inline Matrix <T> Layer <T> ::forward_propogate(const Matrix <T> &in)
+{
+	Matrix <T> out = _act->batch_compute(batch_apt_and_mult(_mat, in));
+	if (_dp_enable && _dropout > 0)
+		out.nullify(_dropout, _unit);
+
+	return out;
+}
+
+/**
+ * @brief Computes the outputs of the layer for a batch of inputs (one per row)
+ * into out, which is only reallocated if its dimensions are not already
+ * correct. Dropout is never applied and the layer is left untouched, so that
+ * several threads can call this method at the same time.
+ */
+template <class T>
+inline void Layer <T> ::infer(const Matrix <T> &in, Matrix <T> &out) const
+{
+	batch_apt_and_mult(_mat, in, out);
+
+	_act->batch_compute(out, out);
+}
+
+#endif		// Does not support AVR
+
 template <class T>
+template <class A>
 inline void Layer <T> ::forward_propogate(Vector <T> &in1, Vector <T> &in2)
 {
-	in2 = apt_and_mult(_mat, in1);
+	in2 = apt_and_mult <T, A> (_mat, in1);
 	in1 = _act->compute(in2);
 
 	// Apply dropout (only if necessary)
@@ -477,6 +477,237 @@ LQ <T> lq_decompose(const Matrix <T> &A)
 	return LQ <T> (qr.q().transpose(), qr.r().transpose());
 }
 
+/**
+ * @brief Represents an LU factorization with partial pivoting, A = PLU, where P
+ * is a permutation matrix, L is a unit lower triangular matrix and U is an
+ * upper triangular matrix. Besides the three factors, the compact form of the
+ * factorization is kept so that solves and determinants are O(n^2) and O(n)
+ * respectively.
+ *
+ * Meant for floating point and rational types. Integral types should use the
+ * fraction-free routines (solve, Matrix::determinant) instead.
+ *
+ * @tparam T the type of each component of the matrices.
+ */
+template <class T>
+class LU : public MatrixFactorization <T, 3> {
+	std::vector <T>		_lu;
+	std::vector <size_t>	_piv;
+	int			_sign;
+public:
+	LU(const Matrix <T> &, const Matrix <T> &, const Matrix <T> &,
+			const std::vector <T> &,
+			const std::vector <size_t> &,
+			int);
+
+	/**
+	 * @return P, the permutation matrix.
+	 */
+	Matrix <T> p() const {
+		return this->_terms[0];
+	}
+
+	/**
+	 * @return L, the unit lower triangular matrix.
+	 */
+	Matrix <T> l() const {
+		return this->_terms[1];
+	}
+
+	/**
+	 * @return U, the upper triangular matrix.
+	 */
+	Matrix <T> u() const {
+		return this->_terms[2];
+	}
+
+	/**
+	 * @return the row permutation: row i of P^T A is row pivots()[i] of A.
+	 */
+	const std::vector <size_t> &pivots() const {
+		return _piv;
+	}
+
+	T determinant() const;
+
+	Vector <T> solve(const Vector <T> &) const;
+	Matrix <T> solve(const Matrix <T> &) const;
+
+	Matrix <T> inverse() const;
+};
+
+/**
+ * @brief Constructs an LU factorization from its factors and compact form.
+ * Use lu_decompose to compute the factorization of a matrix.
+ */
+template <class T>
+LU <T> ::LU(const Matrix <T> &P, const Matrix <T> &L, const Matrix <T> &U,
+		const std::vector <T> &lu,
+		const std::vector <size_t> &piv,
+		int sign)
+		: MatrixFactorization <T, 3> (P, L, U),
+		_lu(lu), _piv(piv), _sign(sign) {}
+
+/**
+ * @return the determinant of the factorized matrix.
+ */
+template <class T>
+T LU <T> ::determinant() const
+{
+	size_t n = _piv.size();
+
+	T det = T(_sign);
+	for (size_t i = 0; i < n; i++)
+		det *= _lu[i * n + i];
+
+	return det;
+}
+
+/**
+ * @brief Solves Ax = b, where A is the factorized matrix.
+ *
+ * @param b the right hand side.
+ *
+ * @return the solution x.
+ */
+template <class T>
+Vector <T> LU <T> ::solve(const Vector <T> &b) const
+{
+	size_t n = _piv.size();
+
+	if (b.size() != n)
+		throw typename Matrix <T> ::dimension_mismatch();
+
+	Vector <T> x = b;
+	lu_solve(n, _lu.data(), _piv.data(), &x[0], 1);
+
+	return x;
+}
+
+/**
+ * @brief Solves AX = B, where A is the factorized matrix.
+ *
+ * @param B the right hand side.
+ *
+ * @return the solution X.
+ */
+template <class T>
+Matrix <T> LU <T> ::solve(const Matrix <T> &B) const
+{
+	size_t n = _piv.size();
+
+	if (B.get_rows() != n)
+		throw typename Matrix <T> ::dimension_mismatch();
+
+	Matrix <T> X = B;
+	lu_solve(n, _lu.data(), _piv.data(), X[0], X.get_cols());
+
+	return X;
+}
+
+/**
+ * @return the inverse of the factorized matrix.
+ */
+template <class T>
+Matrix <T> LU <T> ::inverse() const
+{
+	return solve(Matrix <T> ::identity(_piv.size()));
+}
+
+/**
+ * @brief Performs LU factorization with partial pivoting, in O(n^3)
+ * operations.
+ *
+ * @param A the (square) matrix to be factorized.
+ *
+ * @return an LU factorization object containing P, L and U.
+ */
+template <class T>
+LU <T> lu_decompose(const Matrix <T> &A)
+{
+	if (A.get_rows() != A.get_cols())
+		throw typename Matrix <T> ::dimension_mismatch();
+
+	size_t n = A.get_rows();
+
+	std::vector <T> lu(A[0], A[0] + n * n);
+	std::vector <size_t> piv(n);
+
+	int sign = lu_factor(n, lu.data(), piv.data());
+
+	Matrix <T> P(n, n, T(0));
+	Matrix <T> L(n, n, T(0));
+	Matrix <T> U(n, n, T(0));
+
+	for (size_t i = 0; i < n; i++) {
+		P[piv[i]][i] = T(1);
+		L[i][i] = T(1);
+
+		for (size_t j = 0; j < i; j++)
+			L[i][j] = lu[i * n + j];
+
+		for (size_t j = i; j < n; j++)
+			U[i][j] = lu[i * n + j];
+	}
+
+	return LU <T> (P, L, U, lu, piv, sign);
+}
+
+// Solves for floating point types with LU, and exactly otherwise
+template <class T>
+Matrix <T> solve(const Matrix <T> &A, const Matrix <T> &B, std::true_type)
+{
+	return lu_decompose(A).solve(B);
+}
+
+template <class T>
+Matrix <T> solve(const Matrix <T> &A, const Matrix <T> &B, std::false_type)
+{
+	size_t n = A.get_rows();
+
+	Matrix <T> X = B;
+
+	T det;
+	if (!bareiss_solve(n, A[0], X[0], X.get_cols(), det))
+		throw typename Matrix <T> ::singular_matrix();
+
+	return X / det;
+}
+
+/**
+ * @brief Solves the linear system AX = B. Uses LU factorization with partial
+ * pivoting for floating point types, and fraction-free (Bareiss) elimination
+ * otherwise, which is exact for rational types. For the latter, a singular
+ * matrix of coefficients throws Matrix::singular_matrix.
+ *
+ * @param A the (square) matrix of coefficients.
+ * @param B the right hand side.
+ *
+ * @return the solution X.
+ */
+template <class T>
+Matrix <T> solve(const Matrix <T> &A, const Matrix <T> &B)
+{
+	if (A.get_rows() != A.get_cols() || A.get_rows() != B.get_rows())
+		throw typename Matrix <T> ::dimension_mismatch();
+
+	return solve(A, B, std::is_floating_point <T> ());
+}
+
+/**
+ * @brief Solves the linear system Ax = b (see the matrix version).
+ *
+ * @param A the (square) matrix of coefficients.
+ * @param b the right hand side.
+ *
+ * @return the solution x.
+ */
+template <class T>
+Vector <T> solve(const Matrix <T> &A, const Vector <T> &b)
+{
+	return Vector <T> (solve(A, static_cast <const Matrix <T> &> (b)));
+}
+
 /**
  * @brief Performs the QR algorithm to compute the eigenvalues of a square
  * matrix.
@@ -30,6 +30,15 @@
 
 #include "cuda/essentials.cuh"
 
+#ifndef __AVR
+
+#include "core/elimination.hpp"
+#include "core/gemm.hpp"
+#include "core/view.hpp"
+#include "expression.hpp"
+
+#endif
+
 // Redeclare minor as a matrix operation
 #ifdef minor
 
@@ -60,6 +69,16 @@ namespace zhetapi {
 template <class T>
 class Vector;
 
+template <class T>
+class Matrix;
+
+// Kernels (core/kernels.hpp), whose sums are accumulated in A
+template <class T, class A = T>
+Vector <T> apt_and_mult(const Matrix <T> &, const Vector <T> &);
+
+template <class T, class A = T>
+Vector <T> rmt_and_mult(const Matrix <T> &, const Vector <T> &);
+
 /**
  * @brief A matrix with components of type T.
  *
@@ -71,9 +90,14 @@ protected:
 	// TODO: Remove later (REMOOOOOVE)
 	size_t  _rows	= 0;
 	size_t  _cols	= 0;
+
+	// Components allocated, when set_rows has used fewer rows (0 if all
+	// of them are used)
+	size_t	_capacity = 0;
 public:
 	__cuda_dual__ Matrix();
 	__cuda_dual__ Matrix(const Matrix &);
+	__cuda_dual__ Matrix(Matrix &&) noexcept;
 	__cuda_dual__ Matrix(const Vector <T> &);
 
 	// Scaled
@@ -114,6 +138,17 @@ public:
 	template <class A>
 	__cuda_dual__ explicit Matrix(const Matrix <A> &);
 
+#ifndef __AVR
+
+	// Evaluation of lazy expressions
+	template <class E>
+	Matrix(const Expression <T, E> &);
+
+	// Copies the components of a view
+	Matrix(const MatrixView <const T> &);
+
+#endif
+
 	// Methods
 	inline T &get(size_t, size_t);
 	inline const T &get(size_t, size_t) const;
@@ -122,6 +157,9 @@ public:
 
 	void resize(size_t, size_t);
 
+	// Fewer (or back up to as many) rows as were allocated, in place
+	void set_rows(size_t);
+
 	psize_t get_dimensions() const;
 
 	Matrix slice(const psize_t &, const psize_t &) const;
@@ -130,6 +168,26 @@ public:
 
 	Vector <T> get_column(size_t) const;
 
+#ifndef __AVR
+
+	// Strided views (no copies)
+	MatrixView <T> view();
+	MatrixView <const T> view() const;
+
+	MatrixView <T> block(size_t, size_t, size_t, size_t);
+	MatrixView <const T> block(size_t, size_t, size_t, size_t) const;
+
+	MatrixView <T> row_view(size_t);
+	MatrixView <const T> row_view(size_t) const;
+
+	MatrixView <T> row_range(size_t, size_t);
+	MatrixView <const T> row_range(size_t, size_t) const;
+
+	MatrixView <T> column_view(size_t);
+	MatrixView <const T> column_view(size_t) const;
+
+#endif
+
 	// Rading from a binary file (TODO: unignore later)
 	AVR_IGNORE(void write(std::ofstream &) const;)
 	AVR_IGNORE(void read(std::ifstream &);)
@@ -202,10 +260,10 @@ public:
 	static Matrix identity(size_t);
 
 	// Miscellaneous functions
-	template <class U>
+	template <class U, class A>
 	friend Vector <U> apt_and_mult(const Matrix <U> &, const Vector <U> &);
 
-	template <class U>
+	template <class U, class A>
 	friend Vector <U> rmt_and_mult(const Matrix <U> &, const Vector <U> &);
 
 	template <class U>
@@ -213,11 +271,21 @@ public:
 
 	// TODO: just use the Tensor one
 	class dimension_mismatch {};
+	class singular_matrix {};
+	class bad_rows {};
 protected:
 	// TODO: Looks ugly here
 	T determinant(const Matrix &) const;
 public:
 	const Matrix &operator=(const Matrix &);
+	const Matrix &operator=(Matrix &&) noexcept;
+
+#ifndef __AVR
+
+	template <class E>
+	const Matrix &operator=(const Expression <T, E> &);
+
+#endif
 
 	T *operator[](size_t);
 	const T *operator[](size_t) const;
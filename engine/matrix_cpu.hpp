@@ -89,6 +89,152 @@ Matrix <T> ::Matrix(const std::initializer_list <std::initializer_list <T>> &sq)
 	}
 }
 
+/**
+ * @brief Evaluates a lazy expression (see expression.hpp) into a new matrix, in
+ * a single pass.
+ *
+ * @param expr the expression to evaluate.
+ */
+template <class T>
+template <class E>
+Matrix <T> ::Matrix(const Expression <T, E> &expr)
+		: Tensor <T> (expr.get_rows(), expr.get_cols()),
+		_rows(expr.get_rows()), _cols(expr.get_cols())
+{
+	expr.evaluate(this->_array);
+}
+
+/**
+ * @brief Evaluates a lazy expression into this matrix. The components are
+ * overwritten in place if the sizes match, so the expression may refer to
+ * this matrix.
+ *
+ * @param expr the expression to evaluate.
+ */
+template <class T>
+template <class E>
+const Matrix <T> &Matrix <T> ::operator=(const Expression <T, E> &expr)
+{
+	if (_rows == expr.get_rows() && _cols == expr.get_cols())
+		expr.evaluate(this->_array);
+	else
+		*this = Matrix <T> (expr);
+
+	return *this;
+}
+
+/**
+ * @brief Constructs a matrix from the components of a view (which may be
+ * strided, or a transpose).
+ *
+ * @param v the view to copy from.
+ */
+template <class T>
+Matrix <T> ::Matrix(const MatrixView <const T> &v)
+		: Tensor <T> (v.get_rows(), v.get_cols()),
+		_rows(v.get_rows()), _cols(v.get_cols())
+{
+	copy(v, view());
+}
+
+/**
+ * @return a view of the entire matrix.
+ */
+template <class T>
+MatrixView <T> Matrix <T> ::view()
+{
+	return MatrixView <T> (this->_array, 0, _rows, _cols, _cols);
+}
+
+template <class T>
+MatrixView <const T> Matrix <T> ::view() const
+{
+	return MatrixView <const T> (this->_array, 0, _rows, _cols, _cols);
+}
+
+/**
+ * @brief Views a sub-block of the matrix, without copying it.
+ *
+ * @param i the first row of the block.
+ * @param j the first column of the block.
+ * @param rs the number of rows of the block.
+ * @param cs the number of columns of the block.
+ */
+template <class T>
+MatrixView <T> Matrix <T> ::block(size_t i, size_t j, size_t rs, size_t cs)
+{
+	if (i + rs > _rows || j + cs > _cols)
+		throw dimension_mismatch();
+
+	return view().block(i, j, rs, cs);
+}
+
+template <class T>
+MatrixView <const T> Matrix <T> ::block(size_t i, size_t j, size_t rs, size_t cs) const
+{
+	if (i + rs > _rows || j + cs > _cols)
+		throw dimension_mismatch();
+
+	return view().block(i, j, rs, cs);
+}
+
+/**
+ * @brief Views a row of the matrix (as a 1 x cols view).
+ */
+template <class T>
+MatrixView <T> Matrix <T> ::row_view(size_t i)
+{
+	return block(i, 0, 1, _cols);
+}
+
+template <class T>
+MatrixView <const T> Matrix <T> ::row_view(size_t i) const
+{
+	return block(i, 0, 1, _cols);
+}
+
+/**
+ * @brief Views the rows [start, end) of the matrix, for example a batch of
+ * samples stored one per row. The rows are contiguous, so the view can be
+ * passed directly to the GEMM kernels.
+ *
+ * @param start the first row of the range.
+ * @param end one past the last row of the range.
+ */
+template <class T>
+MatrixView <T> Matrix <T> ::row_range(size_t start, size_t end)
+{
+	if (start > end)
+		throw dimension_mismatch();
+
+	return block(start, 0, end - start, _cols);
+}
+
+template <class T>
+MatrixView <const T> Matrix <T> ::row_range(size_t start, size_t end) const
+{
+	if (start > end)
+		throw dimension_mismatch();
+
+	return block(start, 0, end - start, _cols);
+}
+
+/**
+ * @brief Views a column of the matrix (as a rows x 1 view), without copying
+ * it as get_column does.
+ */
+template <class T>
+MatrixView <T> Matrix <T> ::column_view(size_t j)
+{
+	return block(0, j, _rows, 1);
+}
+
+template <class T>
+MatrixView <const T> Matrix <T> ::column_view(size_t j) const
+{
+	return block(0, j, _rows, 1);
+}
+
 template <class T>
 Matrix <T> ::Matrix(size_t rs, size_t cs, std::function <T (size_t)> gen)
                 : _rows(rs), _cols(cs), Tensor <T> (rs, cs)
@@ -161,32 +307,12 @@ Matrix <T> Matrix <T> ::append_above(const Matrix &m)
 {
 	assert(_cols == m._cols);
 
-	size_t t_rows = _rows;
-	size_t m_rows = m._rows;
-
-	std::vector <std::vector <T>> row;
-
-	std::vector <T> total;
+	Matrix <T> out(m._rows + _rows, _cols);
 
-	for (size_t i = 0; i < m_rows; i++) {
-		total.clear();
+	copy(m.view(), out.block(0, 0, m._rows, _cols));
+	copy(view(), out.block(m._rows, 0, _rows, _cols));
 
-		for (size_t j = 0; j < _cols; j++)
-			total.push_back(m[i][j]);
-
-		row.push_back(total);
-	}
-
-	for (size_t i = 0; i < t_rows; i++) {
-		total.clear();
-
-		for (size_t j = 0; j < _cols; j++)
-			total.push_back(this->_array[i][j]);
-
-		row.push_back(total);
-	}
-
-	return Matrix(row);
+	return out;
 }
 
 template <class T>
@@ -194,32 +320,12 @@ Matrix <T> Matrix <T> ::append_below(const Matrix &m)
 {
 	assert(_cols == m._cols);
 
-	size_t t_rows = _rows;
-	size_t m_rows = m._rows;
-
-	std::vector <std::vector <T>> row;
-
-	std::vector <T> total;
-
-	for (size_t i = 0; i < t_rows; i++) {
-		total.clear();
-
-		for (size_t j = 0; j < _cols; j++)
-			total.push_back(this->_array[i][j]);
-
-		row.push_back(total);
-	}
-
-	for (size_t i = 0; i < m_rows; i++) {
-		total.clear();
-
-		for (size_t j = 0; j < _cols; j++)
-			total.push_back(m[i][j]);
+	Matrix <T> out(_rows + m._rows, _cols);
 
-		row.push_back(total);
-	}
+	copy(view(), out.block(0, 0, _rows, _cols));
+	copy(m.view(), out.block(_rows, 0, m._rows, _cols));
 
-	return Matrix(row);
+	return out;
 }
 
 template <class T>
@@ -227,28 +333,12 @@ Matrix <T> Matrix <T> ::append_left(const Matrix &m)
 {
 	assert(_rows == m._rows);
 
-	size_t t_cols = _cols;
-	size_t m_cols = m._cols;
-
-	std::vector <std::vector <T>> row;
+	Matrix <T> out(_rows, m._cols + _cols);
 
-	std::vector <T> total;
-
-	for (size_t i = 0; i < _rows; i++) {
-		total.clear();
+	copy(m.view(), out.block(0, 0, _rows, m._cols));
+	copy(view(), out.block(0, m._cols, _rows, _cols));
 
-		for (size_t j = 0; j < m_cols; j++)
-			total.push_back(m[i][j]);
-
-		row.push_back(total);
-	}
-
-	for (size_t i = 0; i < _rows; i++) {
-		for (size_t j = 0; j < t_cols; j++)
-			row[i].push_back(this->_array[i][j]);
-	}
-
-	return Matrix(row);
+	return out;
 }
 
 template <class T>
@@ -256,28 +346,12 @@ Matrix <T> Matrix <T> ::append_right(const Matrix &m)
 {
 	assert(_rows == m._rows);
 
-	size_t t_cols = _cols;
-	size_t m_cols = m._cols;
-
-	std::vector <std::vector <T>> row;
+	Matrix <T> out(_rows, _cols + m._cols);
 
-	std::vector <T> total;
+	copy(view(), out.block(0, 0, _rows, _cols));
+	copy(m.view(), out.block(0, _cols, _rows, m._cols));
 
-	for (size_t i = 0; i < _rows; i++) {
-		total.clear();
-
-		for (size_t j = 0; j < t_cols; j++)
-			total.push_back(this->_array[i][j]);
-
-		row.push_back(total);
-	}
-
-	for (size_t i = 0; i < _rows; i++) {
-		for (size_t j = 0; j < m_cols; j++)
-			row[i].push_back(m[i][j]);
-	}
-
-	return Matrix(row);
+	return out;
 }
 
 template <class T>
@@ -367,6 +441,69 @@ std::ostream &operator<<(std::ostream &os, const Matrix <T> &mat)
 	return os;
 }
 
+/**
+ * @brief Product of two (possibly strided or transposed) views. Views with
+ * contiguous rows or columns (such as transposes) are passed to the GEMM
+ * kernels directly; other views are packed into a contiguous copy first.
+ */
+template <class T, class U>
+Matrix <typename std::remove_const <T> ::type> operator*(
+		const MatrixView <T> &A,
+		const MatrixView <U> &B)
+{
+	using R = typename std::remove_const <T> ::type;
+
+	static_assert(std::is_same <R, typename std::remove_const <U> ::type> ::value,
+			"Products of views require the same component type");
+
+	if (A.get_cols() != B.get_rows())
+		throw typename Matrix <R> ::dimension_mismatch();
+
+	size_t m = A.get_rows();
+	size_t n = B.get_cols();
+	size_t k = A.get_cols();
+
+	Matrix <R> C(m, n, R(0));
+
+	Matrix <R> pa;
+	Matrix <R> pb;
+
+	const R *a = A.data();
+	const R *b = B.data();
+
+	blas::transpose_flag ta = blas::no_trans;
+	blas::transpose_flag tb = blas::no_trans;
+
+	size_t lda = A.row_stride();
+	size_t ldb = B.row_stride();
+
+	if (!A.row_major()) {
+		if (A.row_stride() == 1) {
+			ta = blas::trans;
+			lda = A.col_stride();
+		} else {
+			pa = Matrix <R> (MatrixView <const R> (A));
+			a = pa[0];
+			lda = k;
+		}
+	}
+
+	if (!B.row_major()) {
+		if (B.row_stride() == 1) {
+			tb = blas::trans;
+			ldb = B.col_stride();
+		} else {
+			pb = Matrix <R> (MatrixView <const R> (B));
+			b = pb[0];
+			ldb = n;
+		}
+	}
+
+	blas::gemm(ta, tb, m, n, k, R(1), a, lda, b, ldb, R(0), C[0], n);
+
+	return C;
+}
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+#ifndef MODEL_FILE_H_
+#define MODEL_FILE_H_
+
+#ifndef __AVR	// Does not support AVR
+
+// C/C++ headers
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace zhetapi {
+
+namespace ml {
+
+/*
+ * Binary model format (see DNN::save_model and DNN::load_model). All offsets
+ * are from the start of the file, and the numbers are in the byte order of
+ * the machine which wrote the file (which is recorded in the header).
+ *
+ *	header			64 bytes
+ *	layer descriptors	64 bytes per layer
+ *	activations		the records of Activation::write
+ *	weights			one blob per layer, aligned to 64 bytes
+ *
+ * The checksum is the 64-bit FNV-1a hash of everything after the header.
+ */
+struct ModelHeader {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	endianness;
+	uint32_t	scalar;		// Size of the components
+	uint32_t	reserved;
+	uint64_t	layers;
+	uint64_t	input;
+	uint64_t	output;
+	uint64_t	length;		// Size of the file
+	uint64_t	checksum;
+};
+
+struct LayerDescriptor {
+	uint64_t	rows;
+	uint64_t	cols;
+	uint64_t	weights;	// Offset of the weights
+	uint64_t	activation;	// Offset of the activation record
+	uint64_t	activation_size;
+	uint64_t	reserved[3];
+};
+
+static_assert(sizeof(ModelHeader) == 64, "Unexpected padding in ModelHeader");
+static_assert(sizeof(LayerDescriptor) == 64, "Unexpected padding in LayerDescriptor");
+
+/**
+ * @brief A model file mapped into memory (privately, so that the file is never
+ * modified). The header and the descriptors are validated when the file is
+ * opened, and the checksum as well if requested (which reads the whole file).
+ *
+ * Networks loaded from the file (DNN::load_model) use the weights in the
+ * mapping directly, so the file must outlive them; processes which load the
+ * same file share its pages until they modify the weights.
+ */
+class ModelFile {
+	int			_fd		= -1;
+
+	unsigned char *		_map		= nullptr;
+	size_t			_length	= 0;
+
+	void close();
+public:
+	explicit ModelFile(const std::string &, bool = false);
+
+	ModelFile(const ModelFile &) = delete;
+	ModelFile &operator=(const ModelFile &) = delete;
+
+	~ModelFile();
+
+	const ModelHeader &header() const;
+	const LayerDescriptor &layer(size_t) const;
+
+	unsigned char *at(uint64_t) const;
+
+	static uint64_t checksum(const unsigned char *, size_t,
+			uint64_t = 14695981039346656037ULL);
+
+	static const char		magic[8];
+	static const uint32_t		version;
+	static const uint32_t		endianness;
+	static const size_t		alignment;
+
+	// Exceptions
+	class bad_file {};
+	class bad_header {};
+	class bad_checksum {};
+};
+
+}
+
+}
+
+#endif		// Does not support AVR
+
+#endif
@@ -4,6 +4,10 @@
 // Engine headers
 #include "dataset.hpp"
 #include "gradient.hpp"
+#include "layer.hpp"
+
+#include "core/parallel.hpp"
+#include "core/simd.hpp"
 
 namespace zhetapi {
 
@@ -19,18 +23,95 @@ protected:
 
 	// Functions
 	Optimizer(T);
+
+	template <class F>
+	void fuse(Layer <T> *, Matrix <T> *, size_t, const F &);
 public:
+	virtual ~Optimizer() {}
+
 	void register_size(size_t);
 	void set_learning_rate(T);
 	
+	// Turns the gradients into the updates of the parameters, in place (the
+	// array that is passed is returned, so that it can be preallocated)
 	virtual Matrix <T> *update(
 			Matrix <T> *,
 			size_t) = 0;
+
+	// Updates the parameters of each layer directly (the gradients are
+	// left in an unspecified state)
+	virtual void step(Layer <T> *, Matrix <T> *, size_t);
 };
 
+/**
+ * @brief Adds the update u of the components [i, i + P::width) to the
+ * parameters w, or stores it into the gradient g when there are no parameters
+ * (for Optimizer::update). Used by the fused optimizer kernels.
+ */
+template <class P, class T>
+inline void emit_update(const P &u, T *w, T *g, size_t i)
+{
+	if (w)
+		(P::load(w + i) + u).store(w + i);
+	else
+		u.store(g + i);
+}
+
 template <class T>
 Optimizer <T> ::Optimizer(T lr) : _eta(lr) {}
 
+/**
+ * @brief Runs a fused kernel on every layer, with the layers split across
+ * threads. The kernel is called as kernel(i, w, g, n) for layer i, where w
+ * points to the parameters of the layer (or is null if layers is null), g to
+ * its gradient and n is the number of components.
+ *
+ * When profiling, each call is recorded in the optimizer phase of its layer,
+ * with an estimate of two operations per component (the update itself varies
+ * with the optimizer).
+ */
+template <class T>
+template <class F>
+void Optimizer <T> ::fuse(Layer <T> *layers, Matrix <T> *J, size_t size, const F &kernel)
+{
+	size_t work = 0;
+	for (size_t i = 0; i < size; i++)
+		work += J[i].size();
+
+	Profiler *prof = Profiler::current();
+
+	parallel::for_range(size, work,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++) {
+				T *w = layers ? layers[i].mat()[0] : nullptr;
+
+				ProfileSection ps(prof, i, PROF_Optimizer,
+						2.0 * J[i].size());
+
+				kernel(i, w, J[i][0], J[i].size());
+			}
+		}
+	);
+}
+
+/**
+ * @brief Default fused update: the update of the gradients followed by a
+ * second pass which adds them to the parameters. Optimizers which work on
+ * each component independently override this with a single pass.
+ */
+template <class T>
+void Optimizer <T> ::step(Layer <T> *layers, Matrix <T> *J, size_t size)
+{
+	J = update(J, size);
+
+	for (size_t i = 0; i < size; i++) {
+		ProfileSection ps(Profiler::current(), i, PROF_Optimizer,
+				J[i].size());
+
+		layers[i].apply_gradient(J[i]);
+	}
+}
+
 template <class T>
 void Optimizer <T> ::register_size(size_t size)
 {
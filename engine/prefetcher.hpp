@@ -0,0 +1,245 @@
+#ifndef PREFETCHER_H_
+#define PREFETCHER_H_
+
+#ifndef __AVR	// Does not support AVR
+
+// C/C++ headers
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Engine headers
+#include "matrix.hpp"
+
+namespace zhetapi {
+
+/**
+ * @brief Prepares the batches of a training session on background threads,
+ * while the previous batches are trained on.
+ *
+ * The batches are produced by a loader, which reads, decodes and normalizes
+ * the batch with a given index into the matrices of a slot (one sample per
+ * row, for the inputs and for the targets). There is a fixed number of slots
+ * (two by default, for double buffering), which bounds the memory used: a
+ * loader only starts on a batch when its slot has been released, so that the
+ * producers wait for the consumer instead of running ahead of it. Since only
+ * the batches in the slots are in memory, the data set can be larger than the
+ * memory (the loader reads each batch from its source when it is needed).
+ *
+ * The batches are handed out in the order of their indices, whatever the
+ * number of loading threads. With several threads, the loader is called
+ * concurrently (for different batches and slots). An exception thrown by the
+ * loader is rethrown to the consumer by next.
+ *
+ * The batches of several epochs can be produced by a single prefetcher, by
+ * mapping the index of a batch to its epoch (and shuffling in the loader).
+ */
+template <class T>
+class Prefetcher {
+public:
+	struct Batch {
+		Matrix <T>	ins;
+		Matrix <T>	outs;
+
+		size_t		index	= 0;
+	};
+
+	using Loader = std::function <void (size_t, Batch &)>;
+private:
+	struct Slot {
+		Batch	batch;
+
+		bool	ready	= false;
+	};
+
+	Loader				_loader;
+
+	size_t				_batches	= 0;
+	size_t				_nslots	= 0;
+
+	Slot *				_slots		= nullptr;
+
+	std::vector <std::thread>	_threads;
+
+	std::mutex			_lock;
+
+	std::condition_variable		_filled;
+	std::condition_variable		_freed;
+
+	// Next batch to load, next batch to hand out, and number of batches
+	// released by the consumer
+	size_t				_issued	= 0;
+	size_t				_consumed	= 0;
+	size_t				_released	= 0;
+
+	// Number of times the consumer had to wait for a batch
+	size_t				_stalls	= 0;
+
+	std::exception_ptr		_error;
+
+	bool				_stop		= false;
+
+	void produce();
+public:
+	Prefetcher(size_t, const Loader &, size_t = 2, size_t = 1);
+
+	Prefetcher(const Prefetcher &) = delete;
+	Prefetcher &operator=(const Prefetcher &) = delete;
+
+	~Prefetcher();
+
+	size_t batches() const;
+	size_t stalls() const;
+
+	const Batch *next();
+};
+
+/**
+ * @brief Starts loading the first batches.
+ *
+ * @param batches the number of batches.
+ * @param loader the function which fills a batch, given its index.
+ * @param slots the maximum number of batches in memory (at least 2, so that a
+ * batch can be loaded while another one is used).
+ * @param threads the number of loading threads.
+ */
+template <class T>
+Prefetcher <T> ::Prefetcher(size_t batches, const Loader &loader, size_t slots, size_t threads)
+		: _loader(loader), _batches(batches),
+		_nslots(std::max(slots, (size_t) 2))
+{
+	_slots = new Slot[_nslots];
+
+	threads = std::max(std::min(threads, _nslots), (size_t) 1);
+	for (size_t i = 0; i < threads; i++)
+		_threads.emplace_back(&Prefetcher::produce, this);
+}
+
+/**
+ * @brief Stops the loading threads (batches which are being loaded are
+ * finished first).
+ */
+template <class T>
+Prefetcher <T> ::~Prefetcher()
+{
+	{
+		std::lock_guard <std::mutex> guard(_lock);
+
+		_stop = true;
+	}
+
+	_freed.notify_all();
+
+	for (std::thread &thread : _threads)
+		thread.join();
+
+	delete[] _slots;
+}
+
+template <class T>
+void Prefetcher <T> ::produce()
+{
+	while (true) {
+		size_t k;
+
+		{
+			std::unique_lock <std::mutex> lock(_lock);
+
+			// Backpressure: wait for the slot of the next batch
+			_freed.wait(lock,
+				[&]() {
+					return _stop || _issued >= _batches
+						|| _issued < _released + _nslots;
+				}
+			);
+
+			if (_stop || _issued >= _batches)
+				return;
+
+			k = _issued++;
+		}
+
+		Slot &slot = _slots[k % _nslots];
+
+		try {
+			slot.batch.index = k;
+
+			_loader(k, slot.batch);
+		} catch (...) {
+			std::lock_guard <std::mutex> guard(_lock);
+
+			if (!_error)
+				_error = std::current_exception();
+		}
+
+		{
+			std::lock_guard <std::mutex> guard(_lock);
+
+			slot.ready = true;
+		}
+
+		_filled.notify_all();
+	}
+}
+
+template <class T>
+size_t Prefetcher <T> ::batches() const
+{
+	return _batches;
+}
+
+template <class T>
+size_t Prefetcher <T> ::stalls() const
+{
+	return _stalls;
+}
+
+/**
+ * @brief Releases the batch returned by the last call (which must not be used
+ * anymore), and waits for the next one.
+ *
+ * @return the next batch, or null once all the batches have been handed out.
+ */
+template <class T>
+const typename Prefetcher <T> ::Batch *Prefetcher <T> ::next()
+{
+	std::unique_lock <std::mutex> lock(_lock);
+
+	if (_consumed > _released) {
+		_slots[_released % _nslots].ready = false;
+		_released = _consumed;
+
+		_freed.notify_all();
+	}
+
+	if (_consumed >= _batches)
+		return nullptr;
+
+	Slot &slot = _slots[_consumed % _nslots];
+
+	if (!slot.ready && !_error) {
+		_stalls++;
+
+		_filled.wait(lock,
+			[&]() {
+				return slot.ready || _error;
+			}
+		);
+	}
+
+	if (_error)
+		std::rethrow_exception(_error);
+
+	_consumed++;
+
+	return &slot.batch;
+}
+
+}
+
+#endif		// Does not support AVR
+
+#endif
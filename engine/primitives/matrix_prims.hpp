@@ -137,6 +137,8 @@ Matrix <T> Matrix <T> ::slice(const psize_t &start, const psize_t &end) const
 	/* Slicing is inclusive of the last
 	 * Vector passed.
 	 */
+#ifdef __AVR
+
 	return Matrix <T> (
 		end.first - start.first + 1,
 		end.second - start.second + 1,
@@ -144,6 +146,16 @@ Matrix <T> Matrix <T> ::slice(const psize_t &start, const psize_t &end) const
 			return this->_array[_cols * (i + start.first) + j + start.second];
 		}
 	);
+
+#else
+
+	// Single copy out of a view of the block
+	return Matrix <T> (block(start.first, start.second,
+			end.first - start.first + 1,
+			end.second - start.second + 1));
+
+#endif
+
 }
 
 /*
@@ -162,11 +174,26 @@ const T &Matrix <T> ::get(size_t row, size_t col) const
 template <class T>
 Vector <T> Matrix <T> ::get_column(size_t r) const
 {
+
+#ifdef __AVR
+
 	return Vector <T> (_rows,
 		[&](size_t i) {
 			return this->_array[_cols * i + r];
 		}
 	);
+
+#else
+
+	// Single copy out of a view of the column
+	Vector <T> out(_rows);
+
+	copy(column_view(r), out.view());
+
+	return out;
+
+#endif
+
 }
 
 template <class T>
@@ -239,6 +266,8 @@ T Matrix <T> ::cofactor(size_t i, size_t j) const
 	return cofactor({i, j});
 }
 
+#ifdef __AVR
+
 template <class T>
 Matrix <T> Matrix <T> ::inverse() const
 {
@@ -251,6 +280,47 @@ Matrix <T> Matrix <T> ::adjugate() const
 	return cofactor().transpose();
 }
 
+#else
+
+/**
+ * @brief Computes the inverse with LU factorization (floating point types), or
+ * as the adjugate divided by the determinant, both computed exactly with
+ * fraction-free elimination (all other types).
+ *
+ * @return the inverse of the matrix.
+ */
+template <class T>
+Matrix <T> Matrix <T> ::inverse() const
+{
+	assert(_rows == _cols);
+
+	Matrix <T> out(_rows, _cols);
+	if (!linalg::lu_inverse(_rows, this->_array, out._array))
+		return adjugate() / determinant();
+
+	return out;
+}
+
+/**
+ * @brief Computes the adjugate (transpose of the cofactor matrix). Uses
+ * elimination for nonsingular matrices, and cofactors otherwise.
+ *
+ * @return the adjugate of the matrix.
+ */
+template <class T>
+Matrix <T> Matrix <T> ::adjugate() const
+{
+	assert(_rows == _cols);
+
+	Matrix <T> out(_rows, _cols);
+	if (!linalg::lu_adjugate(_rows, this->_array, out._array))
+		return cofactor().transpose();
+
+	return out;
+}
+
+#endif
+
 template <class T>
 Matrix <T> Matrix <T> ::cofactor() const
 {
@@ -424,6 +494,13 @@ T Matrix <T> ::determinant(const Matrix <T> &a) const
 	 */
 	assert((a._rows == a._cols) && (a._rows > 0));
 
+#ifndef __AVR
+
+	// O(n^3) elimination (exact for integral and rational types)
+	return linalg::lu_determinant(a._rows, a._array);
+
+#else
+
 	size_t n;
 	size_t t;
 
@@ -453,6 +530,8 @@ T Matrix <T> ::determinant(const Matrix <T> &a) const
 	}
 
 	return det;
+
+#endif
 }
 
 template <class T>
@@ -464,6 +543,23 @@ Matrix <T> ::Matrix(const Matrix <T> &other)
 		this->_array[i] = other._array[i];
 }
 
+/**
+ * @brief Move constructor. Takes over the components of the other matrix,
+ * which is left empty.
+ *
+ * @param other the reference matrix (to be moved from).
+ */
+template <class T>
+Matrix <T> ::Matrix(Matrix <T> &&other) noexcept
+		: Tensor <T> (std::move(other)),
+		_rows(other._rows), _cols(other._cols),
+		_capacity(other._capacity)
+{
+	other._rows = 0;
+	other._cols = 0;
+	other._capacity = 0;
+}
+
 template <class T>
 template <class A>
 Matrix <T> ::Matrix(const Matrix <A> &other)
@@ -527,6 +623,7 @@ const Matrix <T> &Matrix <T> ::operator=(const Matrix <T> &other)
 
 		_rows = other._rows;
 		_cols = other._cols;
+		_capacity = 0;
 
 		this->_size = _rows * _cols;
 
@@ -544,12 +641,37 @@ const Matrix <T> &Matrix <T> ::operator=(const Matrix <T> &other)
 	return *this;
 }
 
+/**
+ * @brief Move assignment operator. Releases the current components and takes
+ * over those of the other matrix.
+ *
+ * @param other the reference matrix (to be moved from).
+ */
+template <class T>
+const Matrix <T> &Matrix <T> ::operator=(Matrix <T> &&other) noexcept
+{
+	if (this != &other) {
+		Tensor <T> ::operator=(std::move(other));
+
+		_rows = other._rows;
+		_cols = other._cols;
+		_capacity = other._capacity;
+
+		other._rows = 0;
+		other._cols = 0;
+		other._capacity = 0;
+	}
+
+	return *this;
+}
+
 template <class T>
 void Matrix <T> ::resize(size_t rs, size_t cs)
 {
 	if (rs != _rows || cs != _cols) {
 		_rows = rs;
 		_cols = cs;
+		_capacity = 0;
 
 		this->_size = rs * cs;
 
@@ -567,6 +689,29 @@ void Matrix <T> ::resize(size_t rs, size_t cs)
 	}
 }
 
+/**
+ * @brief Changes the number of rows without reallocating: the matrix keeps its
+ * components and uses the first rs rows. The components must have been
+ * allocated for at least rs rows (by the constructor or by resize), so that a
+ * buffer sized for its largest use can be used for smaller ones; bad_rows is
+ * thrown otherwise.
+ */
+template <class T>
+void Matrix <T> ::set_rows(size_t rs)
+{
+	assert(this->_dim);
+
+	size_t capacity = (_capacity > this->_size) ? _capacity : this->_size;
+	if (rs * _cols > capacity)
+		throw bad_rows();
+
+	_rows = rs;
+	_capacity = capacity;
+
+	this->_size = rs * _cols;
+	this->_dim[0] = rs;
+}
+
 template <class T>
 T *Matrix <T> ::operator[](size_t i)
 {
@@ -620,8 +765,15 @@ void Matrix <T> ::stable_shur(const Matrix <T> &other)
 		&& (other.get_cols() == _cols)))
 		throw typename Matrix <T> ::dimension_mismatch();
 
-	for (size_t i = 0; i < this->_size; i++)
-		this->_array[i] *= other._array[i];
+	T *arr = this->_array;
+	const T *brr = other._array;
+
+	parallel::for_range(this->_size,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				arr[i] *= brr[i];
+		}
+	);
 }
 
 template <class T>
@@ -639,10 +791,15 @@ void Matrix <T> ::operator+=(const Matrix <T> &other)
 {
 	assert(_rows == other._rows && _cols == other._cols);
 
-	for (size_t i = 0; i < _rows; i++) {
-		for (size_t j = 0; j < _cols; j++)
-			this->_array[i * _cols + j] += other._array[i * _cols + j];
-	}
+	T *arr = this->_array;
+	const T *brr = other._array;
+
+	parallel::for_range(this->_size,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				arr[i] += brr[i];
+		}
+	);
 }
 
 template <class T>
@@ -650,25 +807,42 @@ void Matrix <T> ::operator-=(const Matrix <T> &other)
 {
 	assert(_rows == other._rows && _cols == other._cols);
 
-	for (size_t i = 0; i < _rows; i++) {
-		for (size_t j = 0; j < _cols; j++)
-			this->_array[i * _cols + j] -= other._array[i * _cols + j];
-	}
+	T *arr = this->_array;
+	const T *brr = other._array;
+
+	parallel::for_range(this->_size,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				arr[i] -= brr[i];
+		}
+	);
 }
 
 // TODO: Remove as it is done in tensor already
 template <class T>
 void Matrix <T> ::operator*=(const T &x)
 {
-	for (size_t i = 0; i < this->_size; i++)
-		this->_array[i] *= x;
+	T *arr = this->_array;
+
+	parallel::for_range(this->_size,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				arr[i] *= x;
+		}
+	);
 }
 
 template <class T>
 void Matrix <T> ::operator/=(const T &x)
 {
-	for (size_t i = 0; i < this->_size; i++)
-		this->_array[i] /= x;
+	T *arr = this->_array;
+
+	parallel::for_range(this->_size,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				arr[i] /= x;
+		}
+	);
 }
 
 template <class T>
@@ -687,6 +861,83 @@ Matrix <T> operator-(const Matrix <T> &a, const Matrix <T> &b)
 	return c;
 }
 
+/*
+ * Rvalue overloads: when an operand is a temporary which owns its components,
+ * the result is computed in place and the buffer of the temporary is moved
+ * into the result, instead of allocating a new matrix. Slices are never
+ * modified, since their components belong to another object.
+ */
+template <class T>
+Matrix <T> operator+(Matrix <T> &&a, const Matrix <T> &b)
+{
+	if (a.sliced())
+		return a + b;
+
+	a += b;
+	return std::move(a);
+}
+
+template <class T>
+Matrix <T> operator+(const Matrix <T> &a, Matrix <T> &&b)
+{
+	if (b.sliced())
+		return a + b;
+
+	b += a;
+	return std::move(b);
+}
+
+template <class T>
+Matrix <T> operator+(Matrix <T> &&a, Matrix <T> &&b)
+{
+	if (a.sliced())
+		return a + std::move(b);
+
+	a += b;
+	return std::move(a);
+}
+
+template <class T>
+Matrix <T> operator-(Matrix <T> &&a, const Matrix <T> &b)
+{
+	if (a.sliced())
+		return a - b;
+
+	a -= b;
+	return std::move(a);
+}
+
+template <class T>
+Matrix <T> operator-(const Matrix <T> &a, Matrix <T> &&b)
+{
+	if (b.sliced())
+		return a - b;
+
+	assert(a.get_dimensions() == b.get_dimensions());
+
+	const T *arr = a[0];
+	T *brr = b[0];
+
+	parallel::for_range(b.size(),
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				brr[i] = arr[i] - brr[i];
+		}
+	);
+
+	return std::move(b);
+}
+
+template <class T>
+Matrix <T> operator-(Matrix <T> &&a, Matrix <T> &&b)
+{
+	if (a.sliced())
+		return a - std::move(b);
+
+	a -= b;
+	return std::move(a);
+}
+
 /*
 template <class T>
 Matrix <T> operator*(const Matrix <T> &A, const Matrix <T> &B)
@@ -725,25 +976,37 @@ Matrix <T> operator*(const Matrix <T> &A, const Matrix <U> &B)
 			throw typename Matrix <T> ::dimension_mismatch()
 	);
 
-        size_t rs = A._rows;
-        size_t cs = B._cols;
+	size_t rs = A._rows;
+	size_t cs = B._cols;
 
-        size_t kmax = B._rows;
+	size_t kmax = B._rows;
 
-        inline_init_mat(C, rs, cs);
+	inline_init_mat(C, rs, cs);
 
-        for (size_t i = 0; i < rs; i++) {
-                const T *Ar = A[i];
-                T *Cr = C[i];
+#ifdef __AVR
 
-                for (size_t k = 0; k < kmax; k++) {
-                        const U *Br = B[k];
+	for (size_t i = 0; i < rs; i++) {
+		const T *Ar = A[i];
+		T *Cr = C[i];
 
-                        T a = Ar[k];
-                        for (size_t j = 0; j < cs; j++)
-                                Cr[j] += T(a * Br[j]);
-                }
-        }
+		for (size_t k = 0; k < kmax; k++) {
+			const U *Br = B[k];
+
+			T a = Ar[k];
+			for (size_t j = 0; j < cs; j++)
+				Cr[j] += T(a * Br[j]);
+		}
+	}
+
+#else
+
+	// Blocked SIMD kernels for float and double, plain loop otherwise
+	blas::gemm(rs, cs, kmax,
+			A._array, A._cols,
+			B._array, B._cols,
+			C._array, cs);
+
+#endif
 
 	return C;
 }
@@ -751,11 +1014,9 @@ Matrix <T> operator*(const Matrix <T> &A, const Matrix <U> &B)
 template <class T>
 Matrix <T> operator*(const Matrix <T> &a, const T &scalar)
 {
-	return Matrix <T> (a._rows, a._cols,
-		[&](size_t i, size_t j) {
-			return a[i][j] * scalar;
-		}
-	);
+	Matrix <T> c = a;
+	c *= scalar;
+	return c;
 }
 
 template <class T>
@@ -764,14 +1025,38 @@ Matrix <T> operator*(const T &scalar, const Matrix <T> &a)
 	return a * scalar;
 }
 
+template <class T>
+Matrix <T> operator*(Matrix <T> &&a, const T &scalar)
+{
+	if (a.sliced())
+		return a * scalar;
+
+	a *= scalar;
+	return std::move(a);
+}
+
+template <class T>
+Matrix <T> operator*(const T &scalar, Matrix <T> &&a)
+{
+	return std::move(a) * scalar;
+}
+
 template <class T>
 Matrix <T> operator/(const Matrix <T> &a, const T &scalar)
 {
-	return Matrix <T> (a._rows, a._cols,
-		[&](size_t i, size_t j) {
-			return a[i][j] / scalar;
-		}
-	);
+	Matrix <T> c = a;
+	c /= scalar;
+	return c;
+}
+
+template <class T>
+Matrix <T> operator/(Matrix <T> &&a, const T &scalar)
+{
+	if (a.sliced())
+		return a / scalar;
+
+	a /= scalar;
+	return std::move(a);
 }
 
 template <class T>
@@ -803,11 +1088,9 @@ Matrix <T> shur(const Matrix <T> &a, const Matrix <T> &b)
 		&& (a.get_cols() == b.get_cols())))
 		throw typename Matrix <T> ::dimension_mismatch();
 
-	return Matrix <T> (a.get_rows(), b.get_cols(),
-		[&](size_t i, size_t j) {
-			return a[i][j] * b[i][j];
-		}
-	);
+	Matrix <T> c = a;
+	c.stable_shur(b);
+	return c;
 }
 
 template <class T>
@@ -817,11 +1100,91 @@ Matrix <T> inv_shur(const Matrix <T> &a, const Matrix <T> &b)
 		&& (a.get_cols() == b.get_cols())))
 		throw typename Matrix <T> ::dimension_mismatch();
 
-	return Matrix <T> (a.get_rows(), b.get_cols(),
-		[&](size_t i, size_t j) {
-			return a[i][j] / b[i][j];
+	Matrix <T> c = a;
+	return inv_shur(std::move(c), b);
+}
+
+template <class T>
+Matrix <T> shur(Matrix <T> &&a, const Matrix <T> &b)
+{
+	if (a.sliced())
+		return shur(a, b);
+
+	a.stable_shur(b);
+	return std::move(a);
+}
+
+template <class T>
+Matrix <T> shur(const Matrix <T> &a, Matrix <T> &&b)
+{
+	if (b.sliced())
+		return shur(a, b);
+
+	b.stable_shur(a);
+	return std::move(b);
+}
+
+template <class T>
+Matrix <T> shur(Matrix <T> &&a, Matrix <T> &&b)
+{
+	if (a.sliced())
+		return shur(a, std::move(b));
+
+	a.stable_shur(b);
+	return std::move(a);
+}
+
+template <class T>
+Matrix <T> inv_shur(Matrix <T> &&a, const Matrix <T> &b)
+{
+	if (a.sliced())
+		return inv_shur(a, b);
+
+	if (a.get_dimensions() != b.get_dimensions())
+		throw typename Matrix <T> ::dimension_mismatch();
+
+	T *arr = a[0];
+	const T *brr = b[0];
+
+	parallel::for_range(a.size(),
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				arr[i] /= brr[i];
 		}
 	);
+
+	return std::move(a);
+}
+
+template <class T>
+Matrix <T> inv_shur(const Matrix <T> &a, Matrix <T> &&b)
+{
+	if (b.sliced())
+		return inv_shur(a, b);
+
+	if (a.get_dimensions() != b.get_dimensions())
+		throw typename Matrix <T> ::dimension_mismatch();
+
+	const T *arr = a[0];
+	T *brr = b[0];
+
+	parallel::for_range(b.size(),
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				brr[i] = arr[i] / brr[i];
+		}
+	);
+
+	return std::move(b);
+}
+
+template <class T>
+Matrix <T> inv_shur(Matrix <T> &&a, Matrix <T> &&b)
+{
+	if (a.sliced())
+		return inv_shur(a, std::move(b));
+
+	return inv_shur(std::move(a), b);
 }
 
 // Computes A * B + C
@@ -22,7 +22,7 @@ Tensor <T> ::Tensor() {}
  */
 template <class T>
 Tensor <T> ::Tensor(const Tensor <T> &other)
-		: _size(other._size), _dims(other._dims)
+		: _dims(other._dims), _size(other._size)
 {
 	// Faster for homogenous types
 	_dim = new size_t[_dims];
@@ -32,6 +32,19 @@ Tensor <T> ::Tensor(const Tensor <T> &other)
 	memcpy(_array, other._array, sizeof(T) * _size);
 }
 
+/**
+ * @brief Move constructor. Takes over the buffers of the other Tensor
+ * (including their ownership, so that slices remain slices), leaving the other
+ * Tensor empty.
+ *
+ * @param other the reference tensor (to be moved from).
+ */
+template <class T>
+Tensor <T> ::Tensor(Tensor <T> &&other) noexcept
+{
+	steal(other);
+}
+
 /**
  * @brief Heterogenous (with respect to the component type) copy constructor.
  *
@@ -40,7 +53,7 @@ Tensor <T> ::Tensor(const Tensor <T> &other)
 template <class T>
 template <class A>
 Tensor <T> ::Tensor(const Tensor <A> &other)
-		: _size(other._size), _dims(other._dims)
+		: _dims(other._dims), _size(other._size)
 {
 	_dim = new size_t[_dims];
 	memcpy(_dim, other._dim, sizeof(size_t) * _dims);
@@ -76,14 +89,16 @@ Tensor <T> ::Tensor(size_t rows, size_t cols)
  */
 template <class T>
 Tensor <T> ::Tensor(size_t dims, size_t *dim, size_t size, T *array, bool slice)
-		: _dims(dims), _dim(dim), _size(size), _array(array),
-		_dim_sliced(slice), _arr_sliced(slice) {}
+		: _dims(dims), _dim(dim), _dim_sliced(slice), _size(size),
+		_array(array), _arr_sliced(slice) {}
 
 template <class T>
 template <class A>
 Tensor <T> &Tensor <T> ::operator=(const Tensor <A> &other)
 {
 	if (this != &other) {
+		clear();
+
 		_dims = other._dims;
 		_size = other._size;
 
@@ -103,6 +118,8 @@ Tensor <T> &Tensor <T> ::operator=(const Tensor <T> &other)
 {
 	// Faster version for homogenous types (memcpy is faster)
 	if (this != &other) {
+		clear();
+
 		_dims = other._dims;
 		_size = other._size;
 
@@ -116,6 +133,23 @@ Tensor <T> &Tensor <T> ::operator=(const Tensor <T> &other)
 	return *this;
 }
 
+/**
+ * @brief Move assignment operator. Releases the current buffers and takes over
+ * the buffers of the other Tensor.
+ *
+ * @param other the reference tensor (to be moved from).
+ */
+template <class T>
+Tensor <T> &Tensor <T> ::operator=(Tensor <T> &&other) noexcept
+{
+	if (this != &other) {
+		clear();
+		steal(other);
+	}
+
+	return *this;
+}
+
 /**
  * @brief Deconstructor.
  */
@@ -128,8 +162,12 @@ Tensor <T> ::~Tensor()
 template <class T>
 void Tensor <T> ::clear()
 {
-	if (!_array && !_dim)
+	if (!_array && !_dim) {
+		_dim_sliced = false;
+		_arr_sliced = false;
+
 		return;
+	}
 
 	if (!_dim_sliced) {
 
@@ -167,6 +205,111 @@ void Tensor <T> ::clear()
 
 	_array = nullptr;
 	_dim = nullptr;
+
+	_dim_sliced = false;
+	_arr_sliced = false;
+}
+
+/**
+ * @brief Takes over the buffers (and their slice flags) of another Tensor,
+ * whose members are reset so that its destruction is a no-op. Assumes that
+ * this Tensor has already been cleared.
+ *
+ * @param other the Tensor whose buffers are to be taken.
+ */
+template <class T>
+__cuda_dual__
+void Tensor <T> ::steal(Tensor <T> &other)
+{
+	_dims = other._dims;
+	_dim = other._dim;
+	_dim_sliced = other._dim_sliced;
+
+	_size = other._size;
+	_array = other._array;
+	_arr_sliced = other._arr_sliced;
+
+#ifdef __CUDACC__
+
+	_arena = other._arena;
+	_on_device = other._on_device;
+
+	other._arena = nullptr;
+	other._on_device = false;
+
+#endif
+
+	other._dims = 0;
+	other._dim = nullptr;
+	other._dim_sliced = false;
+
+	other._size = 0;
+	other._array = nullptr;
+	other._arr_sliced = false;
+}
+
+/**
+ * @brief Checks whether the components of the Tensor are borrowed from another
+ * object (in which case they are not deallocated by this Tensor).
+ *
+ * @return \c true if the Tensor does not own its components, and \c false
+ * otherwise.
+ */
+template <class T>
+bool Tensor <T> ::sliced() const
+{
+	return _arr_sliced;
+}
+
+/**
+ * @brief Indexes the first dimension of the Tensor, without copying. The
+ * result has one fewer dimension and refers to the components (and the
+ * dimension sizes) of this Tensor, so it is only valid while this Tensor is
+ * alive and unchanged in shape. Assigning to the components of the result
+ * modifies this Tensor.
+ *
+ * Throws bad_dimensions if the Tensor has fewer than two dimensions (there
+ * would be no dimension sizes left for the result), and index_out_of_bounds
+ * if \p i is not less than the size of the first dimension.
+ *
+ * @param i the index along the first dimension.
+ *
+ * @return the sub-tensor at index i.
+ */
+template <class T>
+Tensor <T> Tensor <T> ::operator[](size_t i)
+{
+	if (_dims < 2)
+		throw bad_dimensions();
+
+	if (i >= _dim[0])
+		throw index_out_of_bounds();
+
+	size_t stride = _size / _dim[0];
+
+	return Tensor <T> (_dims - 1, _dim + 1, stride, _array + i * stride, true);
+}
+
+/**
+ * @brief Read-only version of the index operator above. The result is a
+ * sub-tensor of const components, so it can be read from but not assigned to.
+ *
+ * @param i the index along the first dimension.
+ *
+ * @return the sub-tensor at index i.
+ */
+template <class T>
+Tensor <const T> Tensor <T> ::operator[](size_t i) const
+{
+	if (_dims < 2)
+		throw bad_dimensions();
+
+	if (i >= _dim[0])
+		throw index_out_of_bounds();
+
+	size_t stride = _size / _dim[0];
+
+	return Tensor <const T> (_dims - 1, _dim + 1, stride, _array + i * stride, true);
 }
 
 /**
@@ -81,6 +81,39 @@ Vector <T> ::Vector(const Matrix <T> &other)
 		this->_array[i] = other[0][i];
 }
 
+/**
+ * @brief Move constructor.
+ *
+ * @param other the reference vector (to be moved from).
+ */
+template <class T>
+Vector <T> ::Vector(Vector &&other) noexcept
+		: Matrix <T> (static_cast <Matrix <T> &&> (other)) {}
+
+// Checks whether a matrix can be taken over by a vector
+template <class T>
+bool is_column(const Matrix <T> &mat)
+{
+	return (mat.dimensions() == 1)
+		|| (mat.dimensions() == 2 && mat.dim_size(1) == 1);
+}
+
+/**
+ * @brief Move constructor from a matrix. If the matrix is a column matrix, its
+ * components are taken over without copying; otherwise this behaves like the
+ * copy constructor from a matrix.
+ *
+ * @param other the reference matrix (to be moved from).
+ */
+template <class T>
+Vector <T> ::Vector(Matrix <T> &&other)
+{
+	if (is_column(other))
+		Matrix <T> ::operator=(std::move(other));
+	else
+		Matrix <T> ::operator=(Vector(static_cast <const Matrix <T> &> (other)));
+}
+
 // Assignment operators
 template <class T>
 Vector <T> &Vector <T> ::operator=(const Vector <T> &other)
@@ -118,6 +151,36 @@ Vector <T> &Vector <T> ::operator=(const Matrix <T> &other)
 	return *this;
 }
 
+/**
+ * @brief Move assignment operator.
+ *
+ * @param other the reference vector (to be moved from).
+ */
+template <class T>
+Vector <T> &Vector <T> ::operator=(Vector <T> &&other) noexcept
+{
+	Matrix <T> ::operator=(static_cast <Matrix <T> &&> (other));
+
+	return *this;
+}
+
+/**
+ * @brief Move assignment operator from a matrix. Column matrices are taken over
+ * without copying, anything else is copied as with the copy assignment.
+ *
+ * @param other the reference matrix (to be moved from).
+ */
+template <class T>
+Vector <T> &Vector <T> ::operator=(Matrix <T> &&other)
+{
+	if (!is_column(other))
+		return *this = static_cast <const Matrix <T> &> (other);
+
+	Matrix <T> ::operator=(std::move(other));
+
+	return *this;
+}
+
 /**
  * @brief Indexing operator.
  *
@@ -410,8 +473,7 @@ Vector <T> operator*(const Vector <T> &a, const T &b)
 {
 	Vector <T> out = a;
 
-	for (size_t i = 0; i < a.size(); i++)
-		out[i] *= b;
+	out *= b;
 
 	return out;
 }
@@ -421,8 +483,7 @@ Vector <T> operator*(const T &b, const Vector <T> &a)
 {
 	Vector <T> out = a;
 
-	for (size_t i = 0; i < a.size(); i++)
-		out[i] *= b;
+	out *= b;
 
 	return out;
 }
@@ -432,8 +493,7 @@ Vector <T> operator/(const Vector <T> &a, const T &b)
 {
 	Vector <T> out = a;
 
-	for (size_t i = 0; i < a.size(); i++)
-		out[i] /= b;
+	out /= b;
 
 	return out;
 }
@@ -443,12 +503,107 @@ Vector <T> operator/(const T &b, const Vector <T> &a)
 {
 	Vector <T> out = a;
 
-	for (size_t i = 0; i < a.size(); i++)
-		out[i] /= b;
+	out /= b;
 
 	return out;
 }
 
+/*
+ * Rvalue overloads: temporaries which own their components are modified in
+ * place and moved into the result (see the corresponding matrix operators).
+ */
+template <class T>
+Vector <T> operator+(Vector <T> &&a, const Vector <T> &b)
+{
+	if (a.sliced())
+		return a + b;
+
+	a += b;
+	return std::move(a);
+}
+
+template <class T>
+Vector <T> operator+(const Vector <T> &a, Vector <T> &&b)
+{
+	if (b.sliced())
+		return a + b;
+
+	b += a;
+	return std::move(b);
+}
+
+template <class T>
+Vector <T> operator+(Vector <T> &&a, Vector <T> &&b)
+{
+	if (a.sliced())
+		return a + std::move(b);
+
+	a += b;
+	return std::move(a);
+}
+
+template <class T>
+Vector <T> operator-(Vector <T> &&a, const Vector <T> &b)
+{
+	if (a.sliced())
+		return a - b;
+
+	a -= b;
+	return std::move(a);
+}
+
+template <class T>
+Vector <T> operator-(const Vector <T> &a, Vector <T> &&b)
+{
+	if (b.sliced())
+		return a - b;
+
+	assert(a.size() == b.size());
+
+	for (size_t i = 0; i < b.size(); i++)
+		b[i] = a[i] - b[i];
+
+	return std::move(b);
+}
+
+template <class T>
+Vector <T> operator-(Vector <T> &&a, Vector <T> &&b)
+{
+	if (a.sliced())
+		return a - std::move(b);
+
+	a -= b;
+	return std::move(a);
+}
+
+template <class T>
+Vector <T> operator*(Vector <T> &&a, const T &b)
+{
+	if (a.sliced())
+		return a * b;
+
+	a *= b;
+
+	return std::move(a);
+}
+
+template <class T>
+Vector <T> operator*(const T &b, Vector <T> &&a)
+{
+	return std::move(a) * b;
+}
+
+template <class T>
+Vector <T> operator/(Vector <T> &&a, const T &b)
+{
+	if (a.sliced())
+		return a / b;
+
+	a /= b;
+
+	return std::move(a);
+}
+
 // Static methods
 template <class T>
 Vector <T> Vector <T> ::one(size_t size)
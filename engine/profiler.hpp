@@ -0,0 +1,182 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#ifndef __AVR	// Does not support AVR
+
+// C/C++ headers
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace zhetapi {
+
+namespace ml {
+
+// Phases of a training step
+enum profile_phase {
+	PROF_Forward,		// Products of the forward pass
+	PROF_Activation,	// Activations and their derivatives (and dropout)
+	PROF_Backward,		// Deltas (cost derivative and backpropagation)
+	PROF_Gradient,		// Weight gradients, their reduction and average
+	PROF_Optimizer,		// Updates of the optimizer, applied to the weights
+	PROF_Phases
+};
+
+// Measurements of a phase of a layer, summed over every call
+struct ProfileRecord {
+	double	time	= 0;	// Microseconds (summed over threads)
+	double	flops	= 0;	// Estimated floating point operations
+	size_t	bytes	= 0;	// Bytes allocated (see Profiler::set_allocation_counter)
+	size_t	calls	= 0;
+};
+
+/**
+ * @brief Opt-in instrumentation of the batched training steps (the workspace
+ * path of train_dataset_perf and the fused optimizers), which records the time,
+ * the estimated number of floating point operations and the bytes allocated by
+ * each phase of each layer.
+ *
+ * A profiler collects data while it is installed with a Profiler::Scope, on
+ * the thread which runs the training (the threads it hands work to record into
+ * the same profiler). When no profiler is installed, the instrumented code
+ * only loads a null pointer. Times are summed over the threads which run the
+ * chunks of a batch, so that they add up to the CPU time of the phases, not to
+ * the wall time.
+ *
+ * There is no portable way to observe allocations, so the bytes are measured
+ * with a counter provided by the program (usually fed by a replacement of the
+ * global operator new), and are zero without one.
+ */
+class Profiler {
+public:
+	using clock = std::chrono::steady_clock;
+
+	// Returns the number of bytes allocated so far by the calling thread
+	using AllocationCounter = size_t (*)();
+private:
+	size_t				_layers	= 0;
+
+	std::vector <ProfileRecord>	_records;
+
+	mutable std::mutex		_lock;
+
+	static Profiler *&installed();
+	static std::atomic <AllocationCounter> &counter();
+public:
+	explicit Profiler(size_t);
+
+	size_t layers() const;
+
+	void record(size_t, profile_phase, double, double, size_t);
+
+	template <class F>
+	void record_shared(profile_phase, clock::time_point, size_t, F, double);
+	void reset();
+
+	ProfileRecord get(size_t, profile_phase) const;
+
+	ProfileRecord layer_total(size_t) const;
+	ProfileRecord phase_total(profile_phase) const;
+	ProfileRecord total() const;
+
+	void print(std::ostream &) const;
+
+	static Profiler *current();
+
+	static void set_allocation_counter(AllocationCounter);
+	static size_t allocated();
+
+	static const char *phase_name(profile_phase);
+
+	// Installs a profiler on the calling thread for the lifetime of the scope
+	class Scope {
+		Profiler *	_previous;
+	public:
+		explicit Scope(Profiler &);
+
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+		~Scope();
+	};
+};
+
+/**
+ * @brief Records a phase which ran over every layer at once (such as the
+ * reduction of the gradients of the chunks of a batch), from the given start
+ * to now. The time and the operations are split between the layers in
+ * proportion to their weights.
+ *
+ * @param phase the phase.
+ * @param start the start of the phase.
+ * @param layers the number of layers of the network.
+ * @param weight returns the weight of a layer (such as its number of
+ * parameters), given its index.
+ * @param ops the operations per unit of weight.
+ */
+template <class F>
+void Profiler::record_shared(profile_phase phase, clock::time_point start,
+		size_t layers, F weight, double ops)
+{
+	double us = std::chrono::duration <double, std::micro>
+		(clock::now() - start).count();
+
+	double total = 0;
+	for (size_t k = 0; k < layers; k++)
+		total += weight(k);
+
+	for (size_t k = 0; k < layers; k++) {
+		double share = weight(k);
+
+		record(k, phase, us * share/total, ops * share, 0);
+	}
+}
+
+/**
+ * @brief Measures a phase of a layer from its construction to its
+ * destruction, if a profiler is given (it does nothing otherwise).
+ */
+class ProfileSection {
+	Profiler *		_profiler;
+
+	size_t			_layer;
+	profile_phase		_phase;
+	double			_flops;
+
+	Profiler::clock::time_point	_start;
+	size_t			_bytes	= 0;
+public:
+	ProfileSection(Profiler *profiler, size_t layer, profile_phase phase,
+			double flops)
+			: _profiler(profiler), _layer(layer), _phase(phase),
+			_flops(flops) {
+		if (_profiler) {
+			_bytes = Profiler::allocated();
+			_start = Profiler::clock::now();
+		}
+	}
+
+	ProfileSection(const ProfileSection &) = delete;
+	ProfileSection &operator=(const ProfileSection &) = delete;
+
+	~ProfileSection() {
+		if (_profiler) {
+			double us = std::chrono::duration <double, std::micro>
+				(Profiler::clock::now() - _start).count();
+
+			_profiler->record(_layer, _phase, us, _flops,
+					Profiler::allocated() - _bytes);
+		}
+	}
+};
+
+}
+
+}
+
+#endif		// Does not support AVR
+
+#endif
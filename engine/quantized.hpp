@@ -0,0 +1,461 @@
+#ifndef QUANTIZED_H_
+#define QUANTIZED_H_
+
+#ifndef __AVR	// Does not support AVR
+
+// C/C++ headers
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Engine headers
+#include "dataset.hpp"
+#include "dnn.hpp"
+#include "training.hpp"
+
+#include "core/int8.hpp"
+
+namespace zhetapi {
+
+namespace ml {
+
+/**
+ * @brief A network whose weights are quantized to 8-bit integers, for
+ * inference only (post-training quantization).
+ *
+ * Each row of a weight matrix (the weights of an output, and its bias) is
+ * scaled by its own factor, so that its largest component maps to 127. The
+ * inputs of each layer are quantized with a single factor per layer, which is
+ * calibrated from the largest input seen by the layer on a sample of the data.
+ * The products are computed on 8-bit integers and accumulated in 32-bit
+ * integers (see blas::gemm_s8), and the activations are computed in T on the
+ * rescaled sums. Inputs beyond the calibrated range are clamped.
+ */
+template <class T>
+class QuantizedDNN {
+	struct QLayer {
+		size_t			rows		= 0;
+		size_t			cols		= 0;	// Without the bias
+
+		std::vector <int8_t>	weights;		// rows x cols
+		std::vector <int8_t>	bias;
+		std::vector <T>		scales;		// Per row
+
+		T			in_scale	= 1;
+
+		Activation <T> *	act		= nullptr;
+	};
+
+	std::vector <QLayer>	_layers;
+
+	size_t			_isize	= 0;
+	size_t			_osize	= 0;
+
+	void clear();
+
+	static int8_t quantize(T x, T inv);
+public:
+	QuantizedDNN();
+	QuantizedDNN(DNN <T> &, const DataSet <T> &);
+
+	QuantizedDNN(const QuantizedDNN &) = delete;
+	QuantizedDNN &operator=(const QuantizedDNN &) = delete;
+
+	~QuantizedDNN();
+
+	size_t size() const;
+	size_t input_size() const;
+	size_t output_size() const;
+
+	size_t bytes() const;
+
+	Vector <T> infer(const Vector <T> &) const;
+	Matrix <T> infer(const Matrix <T> &) const;
+
+	void save(const std::string &) const;
+	void load(const std::string &);
+
+	// Exceptions
+	class bad_file {};
+};
+
+template <class T>
+QuantizedDNN <T> ::QuantizedDNN() {}
+
+/**
+ * @brief Quantizes a network.
+ *
+ * @param dnn the network.
+ * @param calibration sample inputs, from which the range of the inputs of each
+ * layer is measured.
+ */
+template <class T>
+QuantizedDNN <T> ::QuantizedDNN(DNN <T> &dnn, const DataSet <T> &calibration)
+		: _layers(dnn.size()), _isize(dnn.input_size()),
+		_osize(dnn.output_size())
+{
+	Layer <T> *layers = dnn.layers();
+
+	// Largest input of each layer on the calibration data
+	std::vector <T> range(dnn.size(), T(0));
+
+	if (calibration.size()) {
+		Matrix <T> X = to_matrix(calibration);
+
+		InferenceScratch <T> scratch;
+
+		dnn.infer(X, scratch);
+
+		// The outputs of layer i are in buffers[i + 1]
+		for (size_t i = 0; i < dnn.size(); i++) {
+			const Matrix <T> &A = i ? scratch.buffers[i] : X;
+
+			for (size_t j = 0; j < A.size(); j++)
+				range[i] = std::max(range[i], T(std::fabs(A[0][j])));
+		}
+	}
+
+	for (size_t i = 0; i < dnn.size(); i++) {
+		QLayer &q = _layers[i];
+
+		const Matrix <T> &M = layers[i].mat();
+
+		q.rows = M.get_rows();
+		q.cols = M.get_cols() - 1;
+
+		q.weights.resize(q.rows * q.cols);
+		q.bias.resize(q.rows);
+		q.scales.resize(q.rows);
+
+		q.in_scale = (range[i] > 0) ? range[i]/T(127) : T(1);
+
+		for (size_t r = 0; r < q.rows; r++) {
+			const T *row = M[r];
+
+			// The bias column is part of the row
+			T mx = 0;
+			for (size_t c = 0; c <= q.cols; c++)
+				mx = std::max(mx, T(std::fabs(row[c])));
+
+			T scale = (mx > 0) ? mx/T(127) : T(1);
+
+			q.scales[r] = scale;
+			q.bias[r] = quantize(row[0], T(1)/scale);
+
+			for (size_t c = 0; c < q.cols; c++)
+				q.weights[r * q.cols + c] = quantize(row[c + 1], T(1)/scale);
+		}
+
+		q.act = layers[i].activation()->copy();
+	}
+}
+
+template <class T>
+QuantizedDNN <T> ::~QuantizedDNN()
+{
+	clear();
+}
+
+template <class T>
+void QuantizedDNN <T> ::clear()
+{
+	for (QLayer &q : _layers)
+		delete q.act;
+
+	_layers.clear();
+}
+
+// Rounds x * inv to the nearest integer in [-127, 127]
+template <class T>
+int8_t QuantizedDNN <T> ::quantize(T x, T inv)
+{
+	T q = std::round(x * inv);
+
+	return int8_t(std::min(T(127), std::max(T(-127), q)));
+}
+
+template <class T>
+size_t QuantizedDNN <T> ::size() const
+{
+	return _layers.size();
+}
+
+template <class T>
+size_t QuantizedDNN <T> ::input_size() const
+{
+	return _isize;
+}
+
+template <class T>
+size_t QuantizedDNN <T> ::output_size() const
+{
+	return _osize;
+}
+
+/**
+ * @return the size of the quantized parameters (weights, biases and scales).
+ */
+template <class T>
+size_t QuantizedDNN <T> ::bytes() const
+{
+	size_t total = 0;
+	for (const QLayer &q : _layers) {
+		total += q.weights.size() + q.bias.size()
+			+ sizeof(T) * (q.scales.size() + 1);
+	}
+
+	return total;
+}
+
+template <class T>
+Vector <T> QuantizedDNN <T> ::infer(const Vector <T> &in) const
+{
+	Matrix <T> X(1, in.size());
+	for (size_t i = 0; i < in.size(); i++)
+		X[0][i] = in[i];
+
+	Matrix <T> Y = infer(X);
+
+	// Slice of the output (copied on return)
+	Vector <T> out(Y.get_cols(), Y[0]);
+
+	return Vector <T> (out);
+}
+
+/**
+ * @brief Batched inference, with one input per row. The layers are
+ * independent of the call, so several threads can run inference at once.
+ */
+template <class T>
+Matrix <T> QuantizedDNN <T> ::infer(const Matrix <T> &in) const
+{
+	if (in.get_cols() != _isize)
+		throw typename DNN <T> ::bad_io_dimensions();
+
+	size_t n = in.get_rows();
+
+	Matrix <T> A = in;
+	Matrix <T> Z;
+
+	std::vector <int8_t> Xq;
+	std::vector <int32_t> acc;
+
+	for (const QLayer &q : _layers) {
+		Xq.resize(n * q.cols);
+		acc.resize(n * q.rows);
+
+		T inv = T(1)/q.in_scale;
+
+		const T *src = A[0];
+		for (size_t j = 0; j < n * q.cols; j++)
+			Xq[j] = quantize(src[j], inv);
+
+		blas::gemm_s8(n, q.rows, q.cols, Xq.data(), q.cols,
+				q.weights.data(), q.cols, acc.data(), q.rows);
+
+		// Rescale the sums and add the biases
+		Z.resize(n, q.rows);
+		for (size_t i = 0; i < n; i++) {
+			T *z = Z[i];
+
+			const int32_t *a = &acc[i * q.rows];
+			for (size_t r = 0; r < q.rows; r++) {
+				z[r] = q.scales[r] * (q.in_scale * T(a[r])
+					+ T(q.bias[r]));
+			}
+		}
+
+		q.act->batch_compute(Z, A);
+	}
+
+	return A;
+}
+
+/*
+ * Compact binary form: a header (magic, sizeof(T), the number of layers and
+ * the input size), then for each layer its dimensions, the input scale, the
+ * row scales, the quantized biases and weights, and the record of its
+ * activation (see Activation::write).
+ */
+template <class T>
+void QuantizedDNN <T> ::save(const std::string &file) const
+{
+	std::ofstream fout(file, std::ios::binary);
+
+	uint64_t header[4] = {0x38514d5a50485aULL, sizeof(T),
+		_layers.size(), _isize};
+
+	fout.write((const char *) header, sizeof(header));
+
+	for (const QLayer &q : _layers) {
+		uint64_t dims[2] = {q.rows, q.cols};
+
+		fout.write((const char *) dims, sizeof(dims));
+		fout.write((const char *) &q.in_scale, sizeof(T));
+		fout.write((const char *) q.scales.data(), sizeof(T) * q.rows);
+		fout.write((const char *) q.bias.data(), q.rows);
+		fout.write((const char *) q.weights.data(), q.rows * q.cols);
+
+		q.act->write(fout);
+	}
+}
+
+/**
+ * @brief Loads a network written by save. The sizes read from the file are
+ * checked against its length and against each other before anything is
+ * allocated, and bad_file is thrown (leaving this network unchanged) if the
+ * file is truncated or corrupt.
+ */
+template <class T>
+void QuantizedDNN <T> ::load(const std::string &file)
+{
+	std::ifstream fin(file, std::ios::binary | std::ios::ate);
+	if (!fin)
+		throw bad_file();
+
+	uint64_t length = fin.tellg();
+	fin.seekg(0);
+
+	uint64_t header[4];
+	if (!fin.read((char *) header, sizeof(header))
+			|| header[0] != 0x38514d5a50485aULL
+			|| header[1] != sizeof(T)
+			|| header[3] > UINT32_MAX)
+		throw bad_file();
+
+	// Each layer holds at least its dimensions, its input scale and the
+	// lengths in its activation record
+	uint64_t least = 2 * sizeof(uint64_t) + sizeof(T) + 2 * sizeof(size_t);
+
+	if (header[2] > (length - sizeof(header))/least)
+		throw bad_file();
+
+	std::vector <QLayer> layers(header[2]);
+
+	auto discard = [&]() {
+		for (QLayer &q : layers)
+			delete q.act;
+	};
+
+	try {
+		uint64_t fan_in = header[3];
+
+		for (QLayer &q : layers) {
+			uint64_t dims[2];
+
+			if (!fin.read((char *) dims, sizeof(dims)))
+				throw bad_file();
+
+			uint64_t left = length - (uint64_t) fin.tellg();
+
+			// The scales, biases and weights of the layer must be in
+			// the file (the product is compared by division, so that
+			// it cannot wrap)
+			if (!dims[0] || dims[0] > UINT32_MAX || dims[1] != fan_in
+					|| left < sizeof(T)
+					|| dims[1] + sizeof(T) + 1
+						> (left - sizeof(T))/dims[0])
+				throw bad_file();
+
+			q.rows = dims[0];
+			q.cols = dims[1];
+
+			fan_in = q.rows;
+
+			q.scales.resize(q.rows);
+			q.bias.resize(q.rows);
+			q.weights.resize(q.rows * q.cols);
+
+			fin.read((char *) &q.in_scale, sizeof(T));
+			fin.read((char *) q.scales.data(), sizeof(T) * q.rows);
+			fin.read((char *) q.bias.data(), q.rows);
+			fin.read((char *) q.weights.data(), q.rows * q.cols);
+
+			if (!fin)
+				throw bad_file();
+
+			q.act = Activation <T> ::load(fin);
+		}
+	} catch (const typename Activation <T> ::bad_record &) {
+		discard();
+
+		throw bad_file();
+	} catch (...) {
+		discard();
+
+		throw;
+	}
+
+	clear();
+
+	_layers.swap(layers);
+	_isize = header[3];
+	_osize = _layers.empty() ? _isize : _layers.back().rows;
+}
+
+/**
+ * @brief Differences between the outputs of a network and of its quantized
+ * version on a data set (see quantization_error).
+ */
+template <class T>
+struct QuantizationError {
+	T	max_error	= 0;	// Largest difference of an output
+	T	mean_error	= 0;	// Mean of the norms of the differences
+
+	size_t	passed		= 0;	// Passed by the network
+	size_t	quantized_passed = 0;	// Passed by the quantized network
+};
+
+template <class T>
+QuantizationError <T> quantization_error(
+		const DNN <T> &dnn,
+		const QuantizedDNN <T> &qdnn,
+		const DataSet <T> &ins,
+		const DataSet <T> &outs,
+		Comparator <T> cmp = _def_cmp <T>)
+{
+	QuantizationError <T> err;
+
+	if (ins.empty())
+		return err;
+
+	Matrix <T> X = to_matrix(ins);
+
+	Matrix <T> P = dnn.infer(X);
+	Matrix <T> Q = qdnn.infer(X);
+
+	for (size_t i = 0; i < ins.size(); i++) {
+		// Slices of the rows (not copied)
+		Vector <T> p(P.get_cols(), P[i]);
+		Vector <T> q(Q.get_cols(), Q[i]);
+
+		T sq = 0;
+		for (size_t j = 0; j < p.size(); j++) {
+			T d = std::fabs(p[j] - q[j]);
+
+			err.max_error = std::max(err.max_error, d);
+			sq += d * d;
+		}
+
+		err.mean_error += std::sqrt(sq);
+
+		err.passed += cmp(p, outs[i]);
+		err.quantized_passed += cmp(q, outs[i]);
+	}
+
+	err.mean_error /= T(ins.size());
+
+	return err;
+}
+
+}
+
+}
+
+#endif		// Does not support AVR
+
+#endif
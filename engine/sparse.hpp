@@ -2,43 +2,480 @@
 #define SPARSE_H_
 
 // C++ headers
+#include <algorithm>
 #include <cstdlib>
+#include <vector>
 
 // Engine headers
 #include "matrix.hpp"
+#include "vector.hpp"
+
+#include "core/parallel.hpp"
 
 namespace zhetapi {
 
+/**
+ * @brief Represents a sparse matrix in compressed sparse row (CSR) form: the
+ * nonzero components of each row are stored contiguously, sorted by column,
+ * and offsets[i] is the position of the first nonzero of row i.
+ *
+ * The compressed sparse column (CSC) form of a matrix is the CSR form of its
+ * transpose, so the transpose method also serves as the conversion to CSC.
+ *
+ * Products with vectors, dense matrices and other sparse matrices are split
+ * across threads by blocks of rows (see parallel::for_range).
+ *
+ * @tparam T the type of each component.
+ */
 template <class T>
 class SparseMatrix {
-	struct elem {
-		elem *	_next = nullptr;	// Next element
-		size_t	_ci = 0;		// Column index
-	};
+	size_t			_rows = 0;
+	size_t			_cols = 0;
 
-	elem **	_rows = nullptr;
+	std::vector <size_t>	_offsets;
+	std::vector <size_t>	_indices;
+	std::vector <T>		_values;
 public:
 	SparseMatrix();
-	SparseMatrix(const Matrix <T> &, T);
+	SparseMatrix(size_t, size_t);
+	SparseMatrix(const Matrix <T> &);
+	SparseMatrix(size_t, size_t,
+			const std::vector <size_t> &,
+			const std::vector <size_t> &,
+			const std::vector <T> &);
+
+	size_t get_rows() const;
+	size_t get_cols() const;
+
+	size_t nonzeros() const;
+	double density() const;
+
+	// Compressed arrays
+	const std::vector <size_t> &offsets() const;
+	const std::vector <size_t> &indices() const;
+	const std::vector <T> &values() const;
+
+	T operator()(size_t, size_t) const;
+
+	Matrix <T> dense() const;
+	SparseMatrix transpose() const;
+
+	template <class U>
+	friend Vector <U> operator*(const SparseMatrix <U> &, const Vector <U> &);
+
+	template <class U>
+	friend Matrix <U> operator*(const SparseMatrix <U> &, const Matrix <U> &);
+
+	template <class U>
+	friend Matrix <U> operator*(const Matrix <U> &, const SparseMatrix <U> &);
+
+	template <class U>
+	friend SparseMatrix <U> operator*(const SparseMatrix <U> &,
+			const SparseMatrix <U> &);
+
+	class dimension_mismatch {};
+	class bad_indices {};
 };
 
+/**
+ * @brief Default constructor, for an empty (0 x 0) matrix.
+ */
 template <class T>
-SparseMatrix <T> ::SparseMatrix() {}
+SparseMatrix <T> ::SparseMatrix() : _offsets(1, 0) {}
 
+/**
+ * @brief Constructs a matrix of the given dimensions with no nonzero
+ * components.
+ *
+ * @param rs the number of rows.
+ * @param cs the number of columns.
+ */
 template <class T>
-SparseMatrix <T> ::SparseMatrix(const Matrix <T> &mat, T exc)
+SparseMatrix <T> ::SparseMatrix(size_t rs, size_t cs)
+		: _rows(rs), _cols(cs), _offsets(rs + 1, 0) {}
+
+/**
+ * @brief Compresses a dense matrix, omitting its zero components.
+ *
+ * @param mat the dense matrix.
+ */
+template <class T>
+SparseMatrix <T> ::SparseMatrix(const Matrix <T> &mat)
+		: _rows(mat.get_rows()), _cols(mat.get_cols()),
+		_offsets(mat.get_rows() + 1, 0)
 {
-	size_t rs = mat.get_rows();
-	size_t cs = mat.get_cols();
+	for (size_t i = 0; i < _rows; i++) {
+		const T *row = mat[i];
+
+		for (size_t j = 0; j < _cols; j++) {
+			if (row[j] != T(0)) {
+				_indices.push_back(j);
+				_values.push_back(row[j]);
+			}
+		}
+
+		_offsets[i + 1] = _indices.size();
+	}
+}
+
+/**
+ * @brief Constructs a matrix from its compressed arrays, which are copied.
+ * The column indices of each row must be in range and strictly increasing
+ * (otherwise bad_indices is thrown).
+ *
+ * @param rs the number of rows.
+ * @param cs the number of columns.
+ * @param offsets the rs + 1 offsets of each row into indices and values.
+ * @param indices the column index of each nonzero.
+ * @param values the value of each nonzero.
+ */
+template <class T>
+SparseMatrix <T> ::SparseMatrix(size_t rs, size_t cs,
+		const std::vector <size_t> &offsets,
+		const std::vector <size_t> &indices,
+		const std::vector <T> &values)
+		: _rows(rs), _cols(cs), _offsets(offsets),
+		_indices(indices), _values(values)
+{
+	if (_offsets.size() != rs + 1
+			|| _indices.size() != _values.size()
+			|| _offsets[0] != 0
+			|| _offsets[rs] != _indices.size())
+		throw dimension_mismatch();
 
-	_rows = new elem[rs];
 	for (size_t i = 0; i < rs; i++) {
-		_rows[i] = new elem;
+		if (_offsets[i] > _offsets[i + 1])
+			throw dimension_mismatch();
 
-		for (size_t i = 0; i < cs; i++) {
+		for (size_t k = _offsets[i]; k < _offsets[i + 1]; k++) {
+			if (_indices[k] >= cs
+					|| (k > _offsets[i] && _indices[k] <= _indices[k - 1]))
+				throw bad_indices();
+		}
+	}
+}
 
+template <class T>
+size_t SparseMatrix <T> ::get_rows() const
+{
+	return _rows;
+}
+
+template <class T>
+size_t SparseMatrix <T> ::get_cols() const
+{
+	return _cols;
+}
+
+/**
+ * @return the number of stored (nonzero) components.
+ */
+template <class T>
+size_t SparseMatrix <T> ::nonzeros() const
+{
+	return _values.size();
+}
+
+/**
+ * @return the fraction of components which are stored.
+ */
+template <class T>
+double SparseMatrix <T> ::density() const
+{
+	if (!_rows || !_cols)
+		return 0;
+
+	return double(_values.size())/(double(_rows) * _cols);
+}
+
+template <class T>
+const std::vector <size_t> &SparseMatrix <T> ::offsets() const
+{
+	return _offsets;
+}
+
+template <class T>
+const std::vector <size_t> &SparseMatrix <T> ::indices() const
+{
+	return _indices;
+}
+
+template <class T>
+const std::vector <T> &SparseMatrix <T> ::values() const
+{
+	return _values;
+}
+
+/**
+ * @brief Indexes a component, in O(log k) time for k nonzeros in the row.
+ *
+ * @param i the row of the component.
+ * @param j the column of the component.
+ *
+ * @return the component, or zero if it is not stored.
+ */
+template <class T>
+T SparseMatrix <T> ::operator()(size_t i, size_t j) const
+{
+	auto begin = _indices.begin() + _offsets[i];
+	auto end = _indices.begin() + _offsets[i + 1];
+
+	auto it = std::lower_bound(begin, end, j);
+	if (it == end || *it != j)
+		return T(0);
+
+	return _values[it - _indices.begin()];
+}
+
+/**
+ * @return the dense form of the matrix.
+ */
+template <class T>
+Matrix <T> SparseMatrix <T> ::dense() const
+{
+	Matrix <T> out(_rows, _cols, T(0));
+
+	for (size_t i = 0; i < _rows; i++) {
+		T *row = out[i];
+
+		for (size_t k = _offsets[i]; k < _offsets[i + 1]; k++)
+			row[_indices[k]] = _values[k];
+	}
+
+	return out;
+}
+
+/**
+ * @brief Transposes the matrix in O(rows + cols + nonzeros) time. The CSR
+ * arrays of the result are the CSC arrays of this matrix.
+ *
+ * @return the transpose of the matrix.
+ */
+template <class T>
+SparseMatrix <T> SparseMatrix <T> ::transpose() const
+{
+	SparseMatrix out(_cols, _rows);
+
+	size_t nnz = _values.size();
+
+	out._indices.resize(nnz);
+	out._values.resize(nnz);
+
+	// Count the nonzeros of each column
+	for (size_t k = 0; k < nnz; k++)
+		out._offsets[_indices[k] + 1]++;
+
+	for (size_t j = 0; j < _cols; j++)
+		out._offsets[j + 1] += out._offsets[j];
+
+	// Scattering rows in order keeps the indices sorted
+	std::vector <size_t> next(out._offsets.begin(), out._offsets.end() - 1);
+	for (size_t i = 0; i < _rows; i++) {
+		for (size_t k = _offsets[i]; k < _offsets[i + 1]; k++) {
+			size_t p = next[_indices[k]]++;
+
+			out._indices[p] = i;
+			out._values[p] = _values[k];
+		}
+	}
+
+	return out;
+}
+
+/**
+ * @brief Sparse matrix-vector product.
+ */
+template <class T>
+Vector <T> operator*(const SparseMatrix <T> &A, const Vector <T> &x)
+{
+	if (A._cols != x.size())
+		throw typename SparseMatrix <T> ::dimension_mismatch();
+
+	Vector <T> out(A._rows, T(0));
+
+	const size_t *offsets = A._offsets.data();
+	const size_t *indices = A._indices.data();
+	const T *values = A._values.data();
+
+	const T *xa = &x[0];
+	T *oa = &out[0];
+
+	parallel::for_range(A._rows, A.nonzeros(),
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++) {
+				T acc = T(0);
+				for (size_t k = offsets[i]; k < offsets[i + 1]; k++)
+					acc += values[k] * xa[indices[k]];
+
+				oa[i] = acc;
+			}
+		}
+	);
+
+	return out;
+}
+
+/**
+ * @brief Product of a sparse matrix with a dense matrix.
+ */
+template <class T>
+Matrix <T> operator*(const SparseMatrix <T> &A, const Matrix <T> &B)
+{
+	if (A._cols != B.get_rows())
+		throw typename SparseMatrix <T> ::dimension_mismatch();
+
+	size_t n = B.get_cols();
+
+	Matrix <T> out(A._rows, n, T(0));
+
+	parallel::for_range(A._rows, A.nonzeros() * n,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++) {
+				T *ci = out[i];
+
+				for (size_t k = A._offsets[i]; k < A._offsets[i + 1]; k++) {
+					const T *bk = B[A._indices[k]];
+					T a = A._values[k];
+
+					for (size_t j = 0; j < n; j++)
+						ci[j] += a * bk[j];
+				}
+			}
+		}
+	);
+
+	return out;
+}
+
+/**
+ * @brief Product of a dense matrix with a sparse matrix.
+ */
+template <class T>
+Matrix <T> operator*(const Matrix <T> &A, const SparseMatrix <T> &B)
+{
+	if (A.get_cols() != B._rows)
+		throw typename SparseMatrix <T> ::dimension_mismatch();
+
+	size_t m = A.get_rows();
+
+	Matrix <T> out(m, B._cols, T(0));
+
+	// Row i of the product is a combination of the rows of B
+	parallel::for_range(m, B.nonzeros() * m,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++) {
+				const T *ai = A[i];
+				T *ci = out[i];
+
+				for (size_t r = 0; r < B._rows; r++) {
+					T a = ai[r];
+					if (a == T(0))
+						continue;
+
+					for (size_t k = B._offsets[r]; k < B._offsets[r + 1]; k++)
+						ci[B._indices[k]] += a * B._values[k];
+				}
+			}
 		}
+	);
+
+	return out;
+}
+
+/**
+ * @brief Product of two sparse matrices, with Gustavson's algorithm. A
+ * symbolic pass counts the nonzeros of each row of the product, and a numeric
+ * pass fills them in. Both are split by blocks of rows.
+ */
+template <class T>
+SparseMatrix <T> operator*(const SparseMatrix <T> &A, const SparseMatrix <T> &B)
+{
+	if (A._cols != B._rows)
+		throw typename SparseMatrix <T> ::dimension_mismatch();
+
+	size_t m = A._rows;
+	size_t n = B._cols;
+
+	// Estimate of the work for the threshold
+	size_t work = 0;
+	for (size_t k = 0; k < A.nonzeros(); k++) {
+		size_t r = A._indices[k];
+
+		work += B._offsets[r + 1] - B._offsets[r];
 	}
+
+	SparseMatrix <T> out(m, n);
+
+	// Symbolic pass
+	parallel::for_range(m, work,
+		[&](size_t start, size_t end) {
+			// Marks the last row in which each column was seen
+			std::vector <size_t> mark(n, m);
+
+			for (size_t i = start; i < end; i++) {
+				size_t count = 0;
+
+				for (size_t ka = A._offsets[i]; ka < A._offsets[i + 1]; ka++) {
+					size_t r = A._indices[ka];
+
+					for (size_t kb = B._offsets[r]; kb < B._offsets[r + 1]; kb++) {
+						size_t j = B._indices[kb];
+
+						if (mark[j] != i) {
+							mark[j] = i;
+							count++;
+						}
+					}
+				}
+
+				out._offsets[i + 1] = count;
+			}
+		}
+	);
+
+	for (size_t i = 0; i < m; i++)
+		out._offsets[i + 1] += out._offsets[i];
+
+	out._indices.resize(out._offsets[m]);
+	out._values.resize(out._offsets[m]);
+
+	// Numeric pass
+	parallel::for_range(m, work,
+		[&](size_t start, size_t end) {
+			std::vector <T> acc(n, T(0));
+			std::vector <size_t> mark(n, m);
+
+			for (size_t i = start; i < end; i++) {
+				size_t *cols = out._indices.data() + out._offsets[i];
+				size_t count = 0;
+
+				for (size_t ka = A._offsets[i]; ka < A._offsets[i + 1]; ka++) {
+					size_t r = A._indices[ka];
+					T a = A._values[ka];
+
+					for (size_t kb = B._offsets[r]; kb < B._offsets[r + 1]; kb++) {
+						size_t j = B._indices[kb];
+
+						if (mark[j] != i) {
+							mark[j] = i;
+							acc[j] = T(0);
+							cols[count++] = j;
+						}
+
+						acc[j] += a * B._values[kb];
+					}
+				}
+
+				std::sort(cols, cols + count);
+
+				T *vals = out._values.data() + out._offsets[i];
+				for (size_t k = 0; k < count; k++)
+					vals[k] = acc[cols[k]];
+			}
+		}
+	);
+
+	return out;
 }
 
 }
@@ -17,6 +17,18 @@ public:
 	Vector <T> compute(const Vector <T> &x) const {
 		return Vector <T> (x.size(), _alpha);
 	}
+
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		T alpha = _alpha;
+
+		batch_map(X, out, [alpha](T) {return alpha;});
+	}
+
+#endif
 };
 
 // ReLU activation class
@@ -31,6 +43,16 @@ public:
 		}
 		return Vector <T> (x.size(), arr, false);
 	}
+
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		batch_map(X, out, [](T x) {return (x > 0) ? T(1) : T(0);});
+	}
+
+#endif
 };
 
 // Leaky ReLU activation class
@@ -47,6 +69,18 @@ public:
 			}
 		);
 	}
+
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		T alpha = _alpha;
+
+		batch_map(X, out, [alpha](T x) {return (x < 0) ? alpha : T(1);});
+	}
+
+#endif
 };
 
 // Sigmoid activation class
@@ -59,13 +93,29 @@ public:
 	Vector <T> compute(const Vector <T> &x) const {
 		return Vector <T> (x.size(),
 			[&](size_t i) {
-				T tmp = 1.0/(1.0 + exp(-x[i]));
+				T tmp = T(1)/(T(1) + std::exp(-x[i]));
 
 				return tmp * (T (1.0) - tmp);
 			}
 		);
 	}
 
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		batch_simd_map(X, out,
+			[](auto x) {
+				auto tmp = simd::sigmoid(x);
+
+				return tmp * (decltype(x)::set(1) - tmp);
+			}
+		);
+	}
+
+#endif
+
 #else
 
 	_host_ _device_
@@ -94,8 +144,81 @@ public:
 		return Vector <T> (x.size(), [&](size_t i) {return
 				_d_scaled_sigmoid(x[i], _alpha);});
 	}
+
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		T alpha = _alpha;
+
+		batch_map(X, out, [alpha](T x) {return _d_scaled_sigmoid(x, alpha);});
+	}
+
+#endif
 };
 
+// Hyperbolic tangent activation class
+template <class T>
+class _DTanh : public Activation <T> {
+public:
+	Vector <T> compute(const Vector <T> &x) const {
+		return Vector <T> (x.size(),
+			[&](size_t i) {
+				T tmp = std::tanh(x[i]);
+
+				return T(1) - tmp * tmp;
+			}
+		);
+	}
+
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		batch_simd_map(X, out,
+			[](auto x) {
+				auto tmp = simd::tanh(x);
+
+				return decltype(x)::set(1) - tmp * tmp;
+			}
+		);
+	}
+
+#endif
+};
+
+#ifndef __AVR
+
+/*
+ * Writes exp(x - max(x)) for the n components of x into y (which may be x),
+ * and returns their sum. Shared by softmax and its derivative.
+ */
+template <class T>
+T softmax_exp(const T *x, T *y, size_t n)
+{
+	T _max = x[0];
+	for (size_t j = 1; j < n; j++)
+		_max = (_max > x[j]) ? _max : x[j];
+
+	simd::for_each <T> (n,
+		[&](auto p, size_t j) {
+			using P = decltype(p);
+
+			simd::exp(P::load(x + j) - P::set(_max)).store(y + j);
+		}
+	);
+
+	T _sum = 0;
+	for (size_t j = 0; j < n; j++)
+		_sum += y[j];
+
+	return _sum;
+}
+
+#endif
+
 // Probability activation class
 template <class T>
 class _DSoftmax : public Activation <T> {
@@ -108,16 +231,44 @@ public:
 
 		T _sum = 0;
 		for (size_t i = 0; i < x.size(); i++)
-			_sum += exp(x[i] - _max);
+			_sum += std::exp(x[i] - _max);
 
 		return Vector <T> (x.size(),
 			[&](size_t i) {
-				return exp(x[i] - _max)
-					* (_sum - exp(x[i] - _max))
+				return std::exp(x[i] - _max)
+					* (_sum - std::exp(x[i] - _max))
 					/ (_sum * _sum);
 			}
 		);
 	}
+
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	// Row by row, without temporaries
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		size_t rs = X.get_rows();
+		size_t cs = X.get_cols();
+
+		out.resize(rs, cs);
+		for (size_t i = 0; i < rs; i++) {
+			T _sum = softmax_exp(X[i], out[i], cs);
+
+			simd::for_each <T> (cs,
+				[&](auto p, size_t j) {
+					using P = decltype(p);
+
+					P e = P::load(out[i] + j);
+
+					(e * (P::set(_sum) - e) / P::set(_sum * _sum))
+						.store(out[i] + j);
+				}
+			);
+		}
+	}
+
+#endif
 };
 
 }
@@ -55,6 +55,18 @@ public:
 		);
 	}
 
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		T alpha = _alpha;
+
+		batch_map(X, out, [alpha](T x) {return x * alpha;});
+	}
+
+#endif
+
 	Activation <T> *derivative() const {
 		return new _DLinear <T> (_alpha);
 	}
@@ -111,6 +123,20 @@ public:
 		return Vector <T> (x.size(), arr, false);
 	}
 
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		batch_simd_map(X, out,
+			[](auto x) {
+				return simd::max(x, decltype(x)::set(0));
+			}
+		);
+	}
+
+#endif
+
 	Activation <T> *derivative() const {
 		return new _DReLU <T> ();
 	}
@@ -157,6 +183,18 @@ public:
 		);
 	}
 
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		T alpha = _alpha;
+
+		batch_map(X, out, [alpha](T x) {return (x > 0) ? x : alpha * x;});
+	}
+
+#endif
+
 	Activation <T> *derivative() const {
 		return new _DLeakyReLU <T> (_alpha);
 	}
@@ -179,11 +217,21 @@ public:
 	Vector <T> compute(const Vector <T> &x) const {
 		return Vector <T> (x.size(),
 			[&](size_t i) {
-				return 1/(1 + exp(-x[i]));
+				return T(1)/(T(1) + std::exp(-x[i]));
 			}
 		);
 	}
 
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		batch_simd_map(X, out, [](auto x) {return simd::sigmoid(x);});
+	}
+
+#endif
+
 	Activation <T> *derivative() const {
 		return new _DSigmoid <T> ();
 	}
@@ -219,15 +267,59 @@ public:
 				_scaled_sigmoid(x[i], _alpha);});
 	}
 
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		T alpha = _alpha;
+
+		batch_map(X, out, [alpha](T x) {return _scaled_sigmoid(x, alpha);});
+	}
+
+#endif
+
 	Activation <T> *derivative() const {
 		return new _DScaledSigmoid <T> (_alpha);
 	}
 };
 
+template <class T>
+class Tanh : public Activation <T> {
+public:
+	Tanh() : Activation <T> (Activation <T> ::AT_Tanh, {}) {}
+
+	Activation <T> *copy() const {
+		return new Tanh();
+	}
+
+	Vector <T> compute(const Vector <T> &x) const {
+		return Vector <T> (x.size(),
+			[&](size_t i) {
+				return std::tanh(x[i]);
+			}
+		);
+	}
+
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		batch_simd_map(X, out, [](auto x) {return simd::tanh(x);});
+	}
+
+#endif
+
+	Activation <T> *derivative() const {
+		return new _DTanh <T> ();
+	}
+};
+
 template <class T>
 class Softmax : public Activation <T> {
 public:
-	Softmax() : Activation <T> ({}) {}
+	Softmax() : Activation <T> (Activation <T> ::AT_Softmax, {}) {}
 
 	__cuda_dual__
 	Activation <T> *copy() const {
@@ -242,15 +334,40 @@ public:
 
 		T _sum = 0;
 		for (size_t i = 0; i < x.size(); i++)
-			_sum += exp(x[i] - _max);
+			_sum += std::exp(x[i] - _max);
 
 		return Vector <T> (x.size(),
 			[&](size_t i) {
-				return exp(x[i] - _max)/_sum;
+				return std::exp(x[i] - _max)/_sum;
 			}
 		);
 	}
 
+#ifndef __AVR
+
+	using Activation <T> ::batch_compute;
+
+	// Row by row, without temporaries
+	void batch_compute(const Matrix <T> &X, Matrix <T> &out) const {
+		size_t rs = X.get_rows();
+		size_t cs = X.get_cols();
+
+		out.resize(rs, cs);
+		for (size_t i = 0; i < rs; i++) {
+			T _sum = softmax_exp(X[i], out[i], cs);
+
+			simd::for_each <T> (cs,
+				[&](auto p, size_t j) {
+					using P = decltype(p);
+
+					(P::load(out[i] + j) / P::set(_sum)).store(out[i] + j);
+				}
+			);
+		}
+	}
+
+#endif
+
 	Activation <T> *derivative() const {
 		return new _DSoftmax <T> ();
 	}
@@ -265,14 +382,14 @@ public:
 		for (size_t i = 1; i < x.size(); i++)
 			_max = (_max > x[i]) ? _max : x[i];
 
-		T _sum;
+		T _sum = 0;
 		for (size_t i = 0; i < x.size(); i++)
-			_sum += exp(x[i] - _max);
+			_sum += std::exp(x[i] - _max);
 
 		T _acc = 0;
 		return Vector <T> (x.size(),
 			[&](size_t i) {
-				_acc += exp(x[i] - _max)/_sum;
+				_acc += std::exp(x[i] - _max)/_sum;
 
 				return _acc;
 			}
@@ -296,6 +413,7 @@ void ZhetapiInit()
 	_zhp_register_activation(ReLU, T, load_relu <T>);
 	_zhp_register_activation(Sigmoid, T, load_sigmoid <T>);
 	_zhp_register_activation(Softmax, T, load_softmax <T>);
+	_zhp_register_activation(Tanh, T, load_tanh <T>);
 }
 
 #endif
@@ -318,6 +436,10 @@ Activation <T> *copy(Activation <T> *act)
 		return new ReLU <T> ();
 	case Activation <T> ::AT_Sigmoid:
 		return new Sigmoid <T> ();
+	case Activation <T> ::AT_Softmax:
+		return new Softmax <T> ();
+	case Activation <T> ::AT_Tanh:
+		return new Tanh <T> ();
 	}
 
 	return nullptr;
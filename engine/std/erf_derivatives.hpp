@@ -13,6 +13,31 @@ public:
 	Vector <T> operator()(const Vector <T> &comp, const Vector <T> &in) const {
 		return -T(2) * (comp - in);
 	}
+
+#ifndef ZHP_CUDA
+
+	using Erf <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &comp, const Matrix <T> &in,
+			Matrix <T> &out) const {
+		if (comp.get_dimensions() != in.get_dimensions())
+			throw typename Erf <T> ::dimension_mismatch();
+
+		out.resize(comp.get_rows(), comp.get_cols());
+
+		size_t n = comp.get_rows() * comp.get_cols();
+
+		T k = T(-2);
+
+		const T *a = comp[0];
+		const T *b = in[0];
+		T *dst = out[0];
+
+		for (size_t i = 0; i < n; i++)
+			dst[i] = k * (a[i] - b[i]);
+	}
+
+#endif
 };
 
 // M squared error
@@ -23,6 +48,83 @@ public:
 	Vector <T> operator()(const Vector <T> &comp, const Vector <T> &in) const {
 		return -T(2)/T(comp.size()) * (comp - in);
 	}
+
+#ifndef ZHP_CUDA
+
+	using Erf <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &comp, const Matrix <T> &in,
+			Matrix <T> &out) const {
+		if (comp.get_dimensions() != in.get_dimensions())
+			throw typename Erf <T> ::dimension_mismatch();
+
+		out.resize(comp.get_rows(), comp.get_cols());
+
+		size_t n = comp.get_rows() * comp.get_cols();
+
+		T k = T(-2)/T(comp.get_cols());
+
+		const T *a = comp[0];
+		const T *b = in[0];
+		T *dst = out[0];
+
+		for (size_t i = 0; i < n; i++)
+			dst[i] = k * (a[i] - b[i]);
+	}
+
+#endif
+};
+
+/*
+ * Cross entropy, with the predictions clamped away from zero as in
+ * CrossEntropy. When it follows a softmax, the gradients skip this
+ * derivative and use the fused kernels softmax_ce_delta and
+ * batch_softmax_ce_delta instead (the kind of the derivative is how they
+ * recognize it).
+ */
+template <class T>
+class _DCE : public Erf <T> {
+public:
+	_DCE() {
+		this->kind = Erf <T> ::OPT_DCE;
+	}
+
+	Vector <T> operator()(const Vector <T> &comp, const Vector <T> &in) const {
+		Erf <T> ::assert_size(comp, in);
+
+		T tiny = std::numeric_limits <T> ::min();
+
+		return Vector <T> (comp.size(),
+			[&](size_t i) {
+				return -comp[i]/((in[i] > tiny) ? in[i] : tiny);
+			}
+		);
+	}
+
+#ifndef ZHP_CUDA
+
+	using Erf <T> ::batch_compute;
+
+	void batch_compute(const Matrix <T> &comp, const Matrix <T> &in,
+			Matrix <T> &out) const {
+		if (comp.get_dimensions() != in.get_dimensions())
+			throw typename Erf <T> ::dimension_mismatch();
+
+		out.resize(comp.get_rows(), comp.get_cols());
+
+		size_t n = comp.get_rows() * comp.get_cols();
+
+		const T *a = comp[0];
+		const T *b = in[0];
+		T *dst = out[0];
+
+		T tiny = std::numeric_limits <T> ::min();
+
+		for (size_t i = 0; i < n; i++)
+			dst[i] = -a[i]/((b[i] > tiny) ? b[i] : tiny);
+	}
+
+#endif
 };
 
 }
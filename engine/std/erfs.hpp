@@ -1,6 +1,10 @@
 #ifndef STD_ERFS_H_
 #define STD_ERFS_H_
 
+// C/C++ headers
+#include <cmath>
+#include <limits>
+
 // Engine headers
 #include "../erf.hpp"
 #include "../std/erf_derivatives.hpp"
@@ -71,6 +75,32 @@ public:
 	}
 };
 
+// Cross entropy between a target distribution and a predicted one, usually the
+// output of a softmax (the predictions are clamped away from zero)
+template <class T>
+class CrossEntropy : public Erf <T> {
+public:
+	CrossEntropy() {
+		this->kind = Erf <T> ::OPT_CE;
+	}
+
+	Vector <T> operator()(const Vector <T> &comp, const Vector <T> &in) const {
+		Erf <T> ::assert_size(comp, in);
+
+		T tiny = std::numeric_limits <T> ::min();
+		T sum = 0;
+
+		for (size_t i = 0; i < comp.size(); i++)
+			sum -= comp[i] * std::log((in[i] > tiny) ? in[i] : tiny);
+
+		return Vector <T> (1, sum);
+	}
+
+	Erf <T> *derivative() const {
+		return new _DCE <T> ();
+	}
+};
+
 // Copy base activations
 template <class T>
 __cuda_dual__
@@ -83,6 +113,8 @@ Erf <T> *copy(Erf <T> *opt)
 		return new SE <T> ();
 	case Erf <T> ::OPT_MSE:
 		return new MSE <T> ();
+	case Erf <T> ::OPT_CE:
+		return new CrossEntropy <T> ();
 	}
 
 	return nullptr;
@@ -2,11 +2,14 @@
 #define STD_FILTERS_H_
 
 // Engine headrers
+#include "activation.hpp"
 #include "filter.hpp"
 #include "matrix.hpp"
 #include "vector.hpp"
 #include "image.hpp"
 
+#include "core/conv.hpp"
+
 #include "std/initializers.hpp"
 
 namespace zhetapi {
@@ -60,7 +63,17 @@ public:
 		// Move shur/stable shur to tensor base
 		*delin[0] = shur(delin[0]->cast_to_vector(), _zcache);
 
-		Matrix <T> J = delin[0]->cast_to_vector() * _acache.transpose();
+		Vector <T> delta = delin[0]->cast_to_vector();
+
+		// J = delta * a^T, without building a^T
+		size_t rs = delta.size();
+		size_t cs = _acache.size();
+
+		Matrix <T> J(rs, cs);
+
+		blas::gemm(blas::no_trans, blas::trans, rs, cs, 1,
+				T(1), &delta[0], 1, &_acache[0], 1,
+				T(0), J[0], cs);
 
 		// Use the kernel function here
 		*grads[0] = J;
@@ -81,90 +94,141 @@ public:
 	for (int i = 0; i < w; i++) {	\
 	for (int j = 0; j < h; j++)
 
-// Assumes that the input tensor is an image
+/**
+ * @brief Convolution of the color channels of an image with one or more
+ * filters, with a stride and zero padding (see blas::conv2d for the engine).
+ * The remaining channels (such as the alpha channel) are copied from the input
+ * pixel at the position of the output pixel times the stride.
+ *
+ * By default, the padding keeps the size of the image (divided by the
+ * stride): (k - 1)/2 zeros before and k/2 zeros after each dimension of size
+ * k of the filters, so that filters of even size are off center by half a
+ * pixel, towards the end.
+ *
+ * This is an image filter, not a layer of a network (it has no gradient), so
+ * it is not a Filter.
+ */
 template <class T>
-class Convolution : public Filter <T> {
-	Matrix <T>	_filter;
-	size_t		_dim;
-	
+class Convolution {
+	std::vector <Matrix <T>>	_filters;
+
+	size_t				_stride		= 1;
+	int				_padding	= -1;	// Same padding if negative
+
 	// Type aliases
 	using byte = image::byte;
-	using mbyte = Matrix <byte>;
-	using vbyte = Vector <byte>;
-	using vfilt = Vector <T>;
 public:
-	Convolution(const Matrix <T> &filter)
-			: _filter(filter), 
-			_dim(filter.get_rows()) {}
+	Convolution(const Matrix <T> &filter, size_t stride = 1, int padding = -1)
+			: _filters({filter}), _stride(stride ? stride : 1),
+			_padding(padding) {}
+
+	// Filters of the same size, applied in a single pass
+	Convolution(const std::vector <Matrix <T>> &filters, size_t stride = 1,
+			int padding = -1)
+			: _filters(filters), _stride(stride ? stride : 1),
+			_padding(padding) {}
 
-	// Assume equal padding for now
 	image::Image process(const image::Image &in, int depth = -1) {
-		image::Image out = in;
+		return process_all(in, depth)[0];
+	}
 
-		int w = in.width();
-		int h = in.height();
-		int c = in.channels();
+	// One image per filter
+	std::vector <image::Image> process_all(const image::Image &in, int depth = -1) {
+		blas::ConvShape s = shape(in, depth);
 
-		// depth = c;
-		// Choose color channels only
-		if (depth < 0)
-			depth = (c > 1) ? c - 1 : c;
+		size_t nfilters = _filters.size();
+
+		std::vector <T> flt(nfilters * s.krows * s.kcols);
+		for (size_t f = 0; f < nfilters; f++) {
+			if (_filters[f].get_rows() != s.krows
+					|| _filters[f].get_cols() != s.kcols)
+				throw bad_filters();
+
+			const T *src = _filters[f][0];
+			std::copy(src, src + s.krows * s.kcols,
+					&flt[f * s.krows * s.kcols]);
+		}
+
+		std::vector <T> conv(nfilters * s.orows * s.ocols * s.depth);
 
-		int n = (_dim - 1)/2;
+		const byte *data = in.raw();
 
-		byte *data = in._array;
+		blas::conv2d(s, data, flt.data(), nfilters, conv.data());
 
-		using namespace std;
-		for_img(x, y, w, h) {
-			vbyte t(depth, byte(0));
-			
-			int ymin = y - n;
-			int ymax = y + n;
+		std::vector <image::Image> outs;
 
-			int xmin = x - n;
-			int xmax = x + n;
+		std::vector <byte> bytes(s.orows * s.ocols * s.channels);
+		for (size_t f = 0; f < nfilters; f++) {
+			const T *src = &conv[f * s.orows * s.ocols * s.depth];
 
-			Vector <T> tmp(depth, T(0));
-			for (int k = 0; k < _dim; k++) {
-				size_t ti = x + k - n;
+			for (size_t r = 0; r < s.orows; r++) {
+				for (size_t c = 0; c < s.ocols; c++) {
+					byte *px = &bytes[(r * s.ocols + c) * s.channels];
 
-				if (xmin + k < 0 || xmin + k >= h)
-					continue;
+					const T *v = &src[(r * s.ocols + c) * s.depth];
+					for (size_t ch = 0; ch < s.depth; ch++)
+						px[ch] = std::min(std::max(v[ch], T(0)), T(255));
 
-				size_t off = ymin;
-				size_t len = _dim;
+					size_t ir = std::min(r * s.stride, s.rows - 1);
+					size_t ic = std::min(c * s.stride, s.cols - 1);
 
-				if (ymin < 0) {
-					off = 0;
-					len += ymin;
+					const byte *ipx = &data[(ir * s.cols + ic) * s.channels];
+					for (size_t ch = s.depth; ch < s.channels; ch++)
+						px[ch] = ipx[ch];
 				}
+			}
 
-				if (ymax >= w)
-					len -= (ymax - w + 1);
+			outs.push_back(image::Image(bytes.data(), s.ocols, s.orows,
+					s.channels));
+		}
 
-				size_t i = c * ((x + k - n) * w + off);
+		return outs;
+	}
 
-				byte *img = &(data[i]);
-				T *flt = &(_filter[k][off - ymin]);
-				
-				for (size_t ch = 0; ch < depth; ch++) {
-					T s = 0;
+	// Geometry of the convolution of an image
+	blas::ConvShape shape(const image::Image &in, int depth = -1) const {
+		if (_filters.empty())
+			throw bad_filters();
 
-					for (size_t i = 0; i < len; i++)
-						s += flt[i] * ((T) img[i * c + ch]);
+		blas::ConvShape s;
 
-					tmp[ch] += s;
-				}
-			}
-			
-			for (size_t i = 0; i < depth; i++)
-				t[i] = (tmp[i] > 0) ? tmp[i] : 0;
+		// The pixels are stored row after row: height rows of width
+		// pixels (as in the constructors of image::Image)
+		s.rows = in.height();
+		s.cols = in.width();
+		s.channels = in.channels();
+
+		// Choose color channels only
+		if (depth < 0)
+			depth = (s.channels > 1) ? s.channels - 1 : s.channels;
+
+		s.depth = std::min((size_t) depth, s.channels);
+
+		s.krows = _filters[0].get_rows();
+		s.kcols = _filters[0].get_cols();
 
-			out.set({x, y}, t);
-		}}
+		s.stride = _stride;
 
-		return out;
+		if (_padding < 0) {
+			s.pad_rows = (s.krows - 1)/2;
+			s.pad_cols = (s.kcols - 1)/2;
+			s.pad_rows_after = s.krows/2;
+			s.pad_cols_after = s.kcols/2;
+		} else {
+			s.pad_rows = s.pad_rows_after = _padding;
+			s.pad_cols = s.pad_cols_after = _padding;
+		}
+
+		s.orows = blas::conv_output(s.rows, s.krows, s.stride,
+				s.pad_rows, s.pad_rows_after);
+		s.ocols = blas::conv_output(s.cols, s.kcols, s.stride,
+				s.pad_cols, s.pad_cols_after);
+
+		return s;
 	}
+
+	// Exceptions
+	class bad_filters {};
 };
 
 }
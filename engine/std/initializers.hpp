@@ -39,8 +39,9 @@ struct RandomInitializer {
 
 #ifndef __AVR	// Does not support AVR
 
-std::random_device	_rd;
-std::mt19937		_mt(_rd());
+// Internal linkage, so that the header can be included in several sources
+static std::random_device	_rd;
+static std::mt19937		_mt(_rd());
 
 template <class T>
 struct LeCun {
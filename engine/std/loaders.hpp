@@ -20,6 +20,9 @@ class Sigmoid;
 template <class T>
 class Softmax;
 
+template <class T>
+class Tanh;
+
 // Loaders
 template <class T>
 Activation <T> *load_linear(const std::vector <T> &args)
@@ -45,6 +48,12 @@ Activation <T> *load_softmax(const std::vector <T> &args)
 	return new Softmax <T> ();
 }
 
+template <class T>
+Activation <T> *load_tanh(const std::vector <T> &args)
+{
+	return new Tanh <T> ();
+}
+
 }
 
 }
@@ -8,50 +8,92 @@ namespace zhetapi {
 
 namespace ml {
 
-// TODO: Cache a and z vectors in the class itself
-// In general cache as much data as possible
-// Instead of creating a new gradient, modify the one passed
-
 /*
  * This header contains the standard optimizers.
  *
  * Preferably use one optimizer per neural network.
+ *
+ * Each optimizer has a static kernel which updates a single layer in one pass
+ * over its parameters w, its gradient g and the state of the optimizer,
+ * several components at a time (see core/simd.hpp). When w is null, the
+ * update is written into g instead of being added to w. The layers are
+ * updated in parallel (see Optimizer::fuse).
  */
 
+// Resizes the state of an optimizer (a matrix per layer) to the dimensions of
+// the gradients, filling new matrices with zeros
+template <class T>
+void fit_state(Matrix <T> *S, Matrix <T> *J, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		std::pair <size_t, size_t> odim = J[i].get_dimensions();
+
+		if (S[i].get_dimensions() != odim)
+			S[i] = Matrix <T> (odim.first, odim.second, T(0));
+	}
+}
+
 template <class T>
 class SGD : public Optimizer <T> {
+	void run(Layer <T> *layers, Matrix <T> *J, size_t size)
+	{
+		this->register_size(size);
+
+		T eta = this->_eta;
+		this->fuse(layers, J, size,
+			[&](size_t i, T *w, T *g, size_t n) {
+				kernel(n, w, g, eta);
+			}
+		);
+	}
 public:
 	SGD(T eta = 0.001) : Optimizer <T> (eta) {}
 
+	// w <- w - eta * g
+	static void kernel(size_t n, T *w, T *g, T eta)
+	{
+		simd::for_each <T> (n,
+			[&](auto p, size_t i) {
+				using P = decltype(p);
+
+				emit_update(P::load(g + i) * P::set(-eta), w, g, i);
+			}
+		);
+	}
+
 	Matrix <T> *update(Matrix <T> *J, size_t size)
 	{
-		this->register_size(size);
-		for (size_t i = 0; i < size; i++)
-			J[i] *= -1 * this->_eta;
-		
+		run(nullptr, J, size);
+
 		return J;
 	}
+
+	void step(Layer <T> *layers, Matrix <T> *J, size_t size)
+	{
+		run(layers, J, size);
+	}
 };
 
-/*
- * TODO: Cache J in the optimizer itself so that we do not need to repeatedly
- * allocate and free the gradient.
- */
 template <class T>
 class Momentum : public Optimizer <T> {
+	void run(Layer <T> *layers, Matrix <T> *J, size_t size)
+	{
+		prepare(J, size);
+
+		T eta = this->_eta;
+		T mu = _mu;
+		this->fuse(layers, J, size,
+			[&](size_t i, T *w, T *g, size_t n) {
+				kernel(n, w, g, _M[i][0], eta, mu);
+			}
+		);
+	}
+protected:
 	T		_mu	= 0;
 
 	Matrix <T> *	_M	= nullptr;
-public:
-	Momentum(T eta = 0.001, T mu = 0.9)
-			: Optimizer <T> (eta),
-			_mu(mu) {}
 
-	~Momentum() {
-		delete[] _M;
-	}
-
-	Matrix <T> *update(Matrix <T> *J, size_t size)
+	void prepare(Matrix <T> *J, size_t size)
 	{
 		this->register_size(size);
 		if (this->_switch) {
@@ -59,143 +101,108 @@ public:
 
 			_M = new Matrix <T> [size];
 		}
-		
-		Matrix <T> *Jo = new Matrix <T> [size];
-		for (size_t i = 0; i < size; i++) {
-			std::pair <size_t, size_t> odim = J[i].get_dimensions();
-
-			if (_M[i].get_dimensions() != odim)
-				_M[i] = Matrix <T> (odim.first, odim.second, T(0));
-			
-			Jo[i] = _M[i] = _mu * _M[i] - this->_eta * J[i];
-		}
-
-		delete[] J;
 
-		return Jo;
+		fit_state(_M, J, size);
 	}
-};
-
-// TODO: Fix the whole raw gradient requirement with Nesterov
-
-// TODO: Inherit Nesterov from Momentum
-/*
-template <class T>
-class Nesterov : public Optimizer <T> {
-	T		_mu;
-
-	Matrix <T> *	_M = nullptr;
 public:
-	Nesterov(T eta = 0.001, T mu = 0.9)
+	Momentum(T eta = 0.001, T mu = 0.9)
 			: Optimizer <T> (eta),
 			_mu(mu) {}
 
-	~Nesterov() {
+	~Momentum() {
 		delete[] _M;
 	}
 
-	Layer <T> *adjusted(Layer <T> *layers, size_t size)
+	// m <- mu * m - eta * g, w <- w + m
+	static void kernel(size_t n, T *w, T *g, T *m, T eta, T mu)
 	{
-		Layer <T> *adj = new Layer <T> [size];
-		
-		for (size_t i = 0; i < size; i++)
-			adj[i] = layers[i];
+		simd::for_each <T> (n,
+			[&](auto p, size_t i) {
+				using P = decltype(p);
 
-		if (size != this->_size)
-			return adj;
+				P mi = P::set(mu) * P::load(m + i)
+					- P::set(eta) * P::load(g + i);
 
-		for (size_t i = 0; i < size; i++) {
-			size_t rs = layers[i].get_fan_out();
-			size_t cs = layers[i].get_fan_in() + 1;
+				mi.store(m + i);
 
-			if (_M[i].get_dimensions() != std::make_pair(rs, cs))
-				_M[i] = Matrix <T> (rs, cs, T(0));
+				emit_update(mi, w, g, i);
+			}
+		);
+	}
 
-			adj[i] += _mu * _M[i];
-		}
+	Matrix <T> *update(Matrix <T> *J, size_t size)
+	{
+		run(nullptr, J, size);
 
-		return adj;
+		return J;
 	}
 
-	Matrix <T> *raw_gradient(
-				Layer <T> *layers,
-				size_t size,
-				const Vector <T> &in,
-				const Vector <T> &out,
-				Erf <T> *cost) override
+	void step(Layer <T> *layers, Matrix <T> *J, size_t size)
 	{
-		Layer <T> *adj = adjusted(layers, size);
+		run(layers, J, size);
+	}
+};
 
-		Matrix <T> *Delta = Optimizer <T> ::raw_gradient(
-				adj,
-				size,
-				in,
-				out,
-				cost);
+/*
+ * Nesterov momentum, in the form which only needs the gradient at the current
+ * parameters (the parameters are kept at the look-ahead point): the velocity
+ * is updated as for momentum, and the update is mu * m - eta * g.
+ */
+template <class T>
+class Nesterov : public Momentum <T> {
+	void run(Layer <T> *layers, Matrix <T> *J, size_t size)
+	{
+		this->prepare(J, size);
 
-		delete[] adj;
+		Matrix <T> *M = this->_M;
 
-		return Delta;
+		T eta = this->_eta;
+		T mu = this->_mu;
+		this->fuse(layers, J, size,
+			[&](size_t i, T *w, T *g, size_t n) {
+				kernel(n, w, g, M[i][0], eta, mu);
+			}
+		);
 	}
+public:
+	Nesterov(T eta = 0.001, T mu = 0.9)
+			: Momentum <T> (eta, mu) {}
 
-	Matrix <T> *raw_batch_gradient(
-				Layer <T> *layers,
-				size_t size,
-				const DataSet <T> &ins,
-				const DataSet <T> &outs,
-				Erf <T> *cost) override
+	// m <- mu * m - eta * g, w <- w + mu * m - eta * g
+	static void kernel(size_t n, T *w, T *g, T *m, T eta, T mu)
 	{
-		Layer <T> *adj = adjusted(layers, size);
+		simd::for_each <T> (n,
+			[&](auto p, size_t i) {
+				using P = decltype(p);
 
-		Matrix <T> *Delta = Optimizer <T> ::raw_batch_gradient(
-				adj,
-				size,
-				ins,
-				outs,
-				cost);
+				P dg = P::set(eta) * P::load(g + i);
+				P mi = P::set(mu) * P::load(m + i) - dg;
 
-		delete[] adj;
+				mi.store(m + i);
 
-		return Delta;
+				emit_update(P::set(mu) * mi - dg, w, g, i);
+			}
+		);
 	}
 
 	Matrix <T> *update(Matrix <T> *J, size_t size)
 	{
-		this->register_size(size);
-		if (this->_switch) {
-			delete[] _M;
-
-			_M = new Matrix <T> [size];
-		}
-		
-		Matrix <T> *Jo = new Matrix <T> [size];
-		for (size_t i = 0; i < size; i++) {
-			std::pair <size_t, size_t> odim = J[i].get_dimensions();
-
-			if (_M[i].get_dimensions() != odim)
-				_M[i] = Matrix <T> (odim.first, odim.second, T(0));
-			
-			Jo[i] = _M[i] = _mu * _M[i] - this->_eta * J[i];
-		}
+		run(nullptr, J, size);
 
-		delete[] J;
+		return J;
+	}
 
-		return Jo;
+	void step(Layer <T> *layers, Matrix <T> *J, size_t size)
+	{
+		run(layers, J, size);
 	}
-}; */
+};
 
 template <class T>
 class AdaGrad : public Optimizer <T> {
 	Matrix <T> *	_S = nullptr;
-public:
-	AdaGrad(T eta = 0.001)
-			: Optimizer <T> (eta) {}
 
-	~AdaGrad() {
-		delete[] _S;
-	}
-
-	Matrix <T> *update(Matrix <T> *J, size_t size)
+	void run(Layer <T> *layers, Matrix <T> *J, size_t size)
 	{
 		this->register_size(size);
 		if (this->_switch) {
@@ -204,28 +211,53 @@ public:
 			_S = new Matrix <T> [size];
 		}
 
-		Matrix <T> tmp;
-		for (size_t i = 0; i < size; i++) {
-			// Correct matrix size if necessary
-			std::pair <size_t, size_t> odim = J[i].get_dimensions();
+		fit_state(_S, J, size);
 
-			if (_S[i].get_dimensions() != odim)
-				_S[i] = Matrix <T> (odim.first, odim.second, T(0));
+		T eta = this->_eta;
+		this->fuse(layers, J, size,
+			[&](size_t i, T *w, T *g, size_t n) {
+				kernel(n, w, g, _S[i][0], eta);
+			}
+		);
+	}
+public:
+	AdaGrad(T eta = 0.001)
+			: Optimizer <T> (eta) {}
 
-			Matrix <T> e = Matrix <T> (odim.first, odim.second, epsilon);
+	~AdaGrad() {
+		delete[] _S;
+	}
 
-			_S[i] = _S[i] + shur(J[i], J[i]);
+	// s <- s + g^2, w <- w - eta * g / sqrt(s + epsilon)
+	static void kernel(size_t n, T *w, T *g, T *s, T eta)
+	{
+		simd::for_each <T> (n,
+			[&](auto p, size_t i) {
+				using P = decltype(p);
 
-			tmp = _S[i] + e;
+				P gi = P::load(g + i);
+				P si = P::load(s + i) + gi * gi;
 
-			tmp.pow(0.5);
+				si.store(s + i);
 
-			J[i] = inv_shur((-1 * this->_eta) * J[i], tmp);
-		}
+				emit_update((P::set(-eta) * gi)
+					/ sqrt(si + P::set(epsilon)), w, g, i);
+			}
+		);
+	}
+
+	Matrix <T> *update(Matrix <T> *J, size_t size)
+	{
+		run(nullptr, J, size);
 
 		return J;
 	}
 
+	void step(Layer <T> *layers, Matrix <T> *J, size_t size)
+	{
+		run(layers, J, size);
+	}
+
 	static const T epsilon;
 };
 
@@ -237,16 +269,8 @@ class RMSProp : public Optimizer <T> {
 	T		_beta;
 
 	Matrix <T> *	_S = nullptr;
-public:
-	RMSProp(T eta = 0.001, T beta = 0.9)
-			: Optimizer <T> (eta),
-			_beta(beta) {}
 
-	~RMSProp() {
-		delete[] _S;
-	}
-
-	Matrix <T> *update(Matrix <T> *J, size_t size)
+	void run(Layer <T> *layers, Matrix <T> *J, size_t size)
 	{
 		this->register_size(size);
 		if (this->_switch) {
@@ -255,28 +279,55 @@ public:
 			_S = new Matrix <T> [size];
 		}
 
-		Matrix <T> tmp;
-		for (size_t i = 0; i < size; i++) {
-			// Correct matrix size if necessary
-			std::pair <size_t, size_t> odim = J[i].get_dimensions();
+		fit_state(_S, J, size);
 
-			if (_S[i].get_dimensions() != odim)
-				_S[i] = Matrix <T> (odim.first, odim.second, T(0));
+		T eta = this->_eta;
+		T beta = _beta;
+		this->fuse(layers, J, size,
+			[&](size_t i, T *w, T *g, size_t n) {
+				kernel(n, w, g, _S[i][0], eta, beta);
+			}
+		);
+	}
+public:
+	RMSProp(T eta = 0.001, T beta = 0.9)
+			: Optimizer <T> (eta),
+			_beta(beta) {}
 
-			// TODO: Replace with element wise addition operation
-			Matrix <T> e = Matrix <T> (odim.first, odim.second, epsilon);
+	~RMSProp() {
+		delete[] _S;
+	}
 
-			_S[i] = _beta * _S[i] + (1 - _beta) * shur(J[i], J[i]);
+	// s <- beta * s + (1 - beta) * g^2, w <- w - eta * g / sqrt(s + epsilon)
+	static void kernel(size_t n, T *w, T *g, T *s, T eta, T beta)
+	{
+		simd::for_each <T> (n,
+			[&](auto p, size_t i) {
+				using P = decltype(p);
 
-			tmp = _S[i] + e;
+				P gi = P::load(g + i);
+				P si = P::set(beta) * P::load(s + i)
+					+ P::set(1 - beta) * (gi * gi);
 
-			tmp.pow(0.5);
+				si.store(s + i);
 
-			J[i] = inv_shur((-1 * this->_eta) * J[i], tmp);
-		}
+				emit_update((P::set(-eta) * gi)
+					/ sqrt(si + P::set(epsilon)), w, g, i);
+			}
+		);
+	}
+
+	Matrix <T> *update(Matrix <T> *J, size_t size)
+	{
+		run(nullptr, J, size);
 
 		return J;
 	}
+
+	void step(Layer <T> *layers, Matrix <T> *J, size_t size)
+	{
+		run(layers, J, size);
+	}
 	
 	static const T epsilon;
 };
@@ -290,84 +341,98 @@ class Adam : public Optimizer <T> {
 	T		_beta2;
 
 	Matrix <T> *	_M	= nullptr;
-	Matrix <T> *	_Mh	= nullptr;
 	Matrix <T> *	_S	= nullptr;
-	Matrix <T> *	_Sh	= nullptr;
 
 	size_t		_iter	= 1;
-public:
-	Adam(T eta = 0.001, T beta1 = 0.9, T beta2 = 0.999)
-			: Optimizer <T> (eta),
-			_beta1(beta1),
-			_beta2(beta2) {}
 
-	~Adam() {
-		delete[] _M;
-		delete[] _Mh;
-		delete[] _S;
-		delete[] _Sh;
-	}
-	
 	// TODO: reset if the layers pointer is different
 	// from the cashed pointer
-	Matrix <T> *update(Matrix <T> *J, size_t size)
+	void run(Layer <T> *layers, Matrix <T> *J, size_t size)
 	{
 		this->register_size(size);
-		using namespace std;
 		if (this->_switch)
 			reset(size);
 
-		Matrix <T> tmp;
-		for (size_t i = 0; i < size; i++) {
-			// Correct matrix size if necessary
-			std::pair <size_t, size_t> odim = J[i].get_dimensions();
-
-			// Resize the matrices if necessary
-			resize(odim, i);
+		fit_state(_M, J, size);
+		fit_state(_S, J, size);
 
-			Matrix <T> e = Matrix <T> (odim.first, odim.second, epsilon);
+		// Bias corrections
+		T c1 = T(1 - std::pow(_beta1, _iter));
+		T c2 = T(1 - std::pow(_beta2, _iter));
 
-			_M[i] = _beta1 * _M[i] - (1 - _beta1) * J[i];
-			_S[i] = _beta2 * _S[i] + (1 - _beta2) * shur(J[i], J[i]);
+		T eta = this->_eta;
+		T beta1 = _beta1;
+		T beta2 = _beta2;
+		this->fuse(layers, J, size,
+			[&](size_t i, T *w, T *g, size_t n) {
+				kernel(n, w, g, _M[i][0], _S[i][0],
+						eta, beta1, beta2, c1, c2);
+			}
+		);
 
-			_Mh[i] = _M[i] / T(1 - pow(_beta1, _iter));
-			_Sh[i] = _S[i] / T(1 - pow(_beta2, _iter));
-
-			tmp = _Sh[i] + e;
+		_iter++;
+	}
+public:
+	Adam(T eta = 0.001, T beta1 = 0.9, T beta2 = 0.999)
+			: Optimizer <T> (eta),
+			_beta1(beta1),
+			_beta2(beta2) {}
 
-			tmp.pow(0.5);
+	~Adam() {
+		delete[] _M;
+		delete[] _S;
+	}
 
-			J[i] = inv_shur(this->_eta * _Mh[i], tmp);
-		}
+	/*
+	 * m <- beta1 * m - (1 - beta1) * g
+	 * s <- beta2 * s + (1 - beta2) * g^2
+	 * w <- w + eta * (m / c1) / sqrt(s / c2 + epsilon)
+	 *
+	 * where c1 and c2 are the bias corrections.
+	 */
+	static void kernel(size_t n, T *w, T *g, T *m, T *s,
+			T eta, T beta1, T beta2, T c1, T c2)
+	{
+		simd::for_each <T> (n,
+			[&](auto p, size_t i) {
+				using P = decltype(p);
+
+				P gi = P::load(g + i);
+				P mi = P::set(beta1) * P::load(m + i)
+					- P::set(1 - beta1) * gi;
+				P si = P::set(beta2) * P::load(s + i)
+					+ P::set(1 - beta2) * (gi * gi);
+
+				mi.store(m + i);
+				si.store(s + i);
+
+				emit_update((P::set(eta) * (mi / P::set(c1)))
+					/ sqrt(si / P::set(c2) + P::set(epsilon)),
+					w, g, i);
+			}
+		);
+	}
 
-		_iter++;
+	Matrix <T> *update(Matrix <T> *J, size_t size)
+	{
+		run(nullptr, J, size);
 
 		return J;
 	}
+
+	void step(Layer <T> *layers, Matrix <T> *J, size_t size)
+	{
+		run(layers, J, size);
+	}
 	
 	void reset(size_t size) {
 		delete[] _M;
-		delete[] _Mh;
 		delete[] _S;
-		delete[] _Sh;
 
 		_iter = 1;
 
 		_M = new Matrix <T> [size];
-		_Mh = new Matrix <T> [size];
 		_S = new Matrix <T> [size];
-		_Sh = new Matrix <T> [size];
-	}
-
-	inline void resize(const std::pair <size_t, size_t> &odim, size_t i) {
-		if (_M[i].get_dimensions() != odim)
-			_M[i] = Matrix <T> (odim.first, odim.second, T(0));
-		if (_Mh[i].get_dimensions() != odim)
-			_Mh[i] = Matrix <T> (odim.first, odim.second, T(0));
-		if (_S[i].get_dimensions() != odim)
-			_S[i] = Matrix <T> (odim.first, odim.second, T(0));
-		if (_Sh[i].get_dimensions() != odim)
-			_Sh[i] = Matrix <T> (odim.first, odim.second, T(0));
 	}
 
 	static const T epsilon;
@@ -20,6 +20,7 @@
 // Engine headers
 #include "cuda/essentials.cuh"
 #include "avr/essentials.hpp"
+#include "core/parallel.hpp"
 
 namespace zhetapi {
 
@@ -83,6 +84,7 @@ public:
 	// Essential constructors
 	Tensor();
 	Tensor(const Tensor &);
+	Tensor(Tensor &&) noexcept;
 
 	template <class A>
 	Tensor(const Tensor <A> &);
@@ -96,6 +98,7 @@ public:
 
 	// Indexing
 	Tensor <T> operator[](size_t);
+	Tensor <const T> operator[](size_t) const;
 
 	AVR_IGNORE(T &operator[](const std::vector <size_t> &));
 	AVR_IGNORE(const T &operator[](const std::vector <size_t> &) const);
@@ -108,9 +111,14 @@ public:
 	// TODO: private?
 	__cuda_dual__
 	void clear();
+protected:
+	__cuda_dual__
+	void steal(Tensor &);
+public:
 
 	// Properties
 	bool good() const;
+	bool sliced() const;
 
 	// Actions
 	AVR_IGNORE(void nullify(long double, const Interval <1> &));
@@ -132,6 +140,7 @@ public:
 	Tensor &operator=(const Tensor <A> &);
 
 	Tensor &operator=(const Tensor &);
+	Tensor &operator=(Tensor &&) noexcept;
 
 	~Tensor();
 
@@ -158,6 +167,7 @@ public:
 	// Dimension mismatch exception
 	class dimension_mismatch {};
 	class bad_dimensions {};
+	class index_out_of_bounds {};
 
 #ifdef __CUDACC__
 
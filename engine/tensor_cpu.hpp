@@ -127,15 +127,27 @@ const T &Tensor <T> ::operator[](const std::vector <size_t> &indices) const
 template <class T>
 void Tensor <T> ::operator*=(const T &x)
 {
-	for (size_t i = 0; i < _size; i++)
-		_array[i] *= x;
+	T *arr = _array;
+
+	parallel::for_range(_size,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				arr[i] *= x;
+		}
+	);
 }
 
 template <class T>
 void Tensor <T> ::operator/=(const T &x)
 {
-	for (size_t i = 0; i < _size; i++)
-		_array[i] /= x;
+	T *arr = _array;
+
+	parallel::for_range(_size,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				arr[i] /= x;
+		}
+	);
 }
 
 // Printing functions
@@ -7,8 +7,10 @@
 #include "dnn.hpp"
 #include "erf.hpp"
 #include "optimizer.hpp"
+#include "prefetcher.hpp"
+#include "workspace.hpp"
 
-#include "std/linalg.hpp"
+#include "linalg.hpp"
 
 namespace zhetapi {
 
@@ -37,9 +39,19 @@ template <class T>
 struct PerformanceStatistics {
 	T	_cost		= T(0);
 	size_t	_passed	= 0;
+
+	// Microseconds spent computing the gradients and updating the
+	// parameters (without the statistics); see Profiler for a breakdown
 	double	_kernel_time	= 0;
 };
 
+// Microseconds elapsed since a time point
+inline double elapsed_us(Profiler::clock::time_point start)
+{
+	return std::chrono::duration <double, std::micro>
+		(Profiler::clock::now() - start).count();
+}
+
 // Fitting a single I/O pair
 template <class T>
 void fit(
@@ -49,24 +61,25 @@ void fit(
 		Erf <T> *erf,
 		Optimizer <T> *opt)
 {
-	Erf <T> *derf = erf->derivative();
+	if (in.size() != dnn.input_size() || out.size() != dnn.output_size())
+		throw typename DNN <T> ::bad_io_dimensions();
 
-	// Use cached compute later
-	Vector <T> actual = dnn(in);
-	Vector <T> delta = derf->compute(out, actual);
+	// Same gradient as one sample of a batch
+	Matrix <T> *J = simple_gradient(dnn.layers(), dnn.size(),
+			dnn.acache(), dnn.zcache(), in, out, erf);
 
-	Matrix <T> *J;
-	
-	J = dnn.jacobian_delta(in, delta);	
-	J = opt->update(J, dnn.size());
-
-	dnn.apply_gradient(J);
+	opt->step(dnn.layers(), J, dnn.size());
 
 	delete[] J;
-	delete derf;
 }
 
-template <class T>
+/*
+ * Fitting a batch of I/O pairs. The batch gradient (and the dot products of
+ * the forward and backward passes) are accumulated in A: fit <float, double>
+ * trains a float network in mixed precision. Otherwise, the whole batch goes
+ * through the network at once, with matrix products for each layer.
+ */
+template <class T, class A = T>
 void fit(
 		DNN <T> &dnn,
 		const DataSet <T> &ins,
@@ -89,19 +102,93 @@ void fit(
 	Matrix <T> *J;
 	
 	// Put batch gradient (multithread and etc) in dnn method (batch jacobian)
-	J = simple_batch_gradient(dnn.layers(),
-		dnn.size(), dnn.acache(), dnn.zcache(),
-		ins, outs, erf
-	);
+	if (std::is_same <T, A> ::value) {
+		J = batch_gradient(dnn.layers(),
+			dnn.size(), dnn.Acache(), dnn.Zcache(),
+			to_matrix(ins), to_matrix(outs), erf
+		);
+	} else {
+		J = simple_batch_gradient <T, A> (dnn.layers(),
+			dnn.size(), dnn.acache(), dnn.zcache(),
+			ins, outs, erf
+		);
+	}
 
-	J = opt->update(J, dnn.size());
+	opt->step(dnn.layers(), J, dnn.size());
 
-	dnn.apply_gradient(J);
+	delete[] J;
+}
+
+/*
+ * Fitting a batch of I/O pairs with preallocated buffers: once the workspace
+ * has seen a batch of the same size, a training step does not allocate (as
+ * long as the optimizer updates the gradients in place). The batch is either
+ * a DataSet or a DataBatch.
+ */
+template <class T, class S>
+void fit(
+		DNN <T> &dnn,
+		const S &ins,
+		const S &outs,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		Workspace <T> &ws)
+{
+	ws.load(ins, outs);
+
+	Matrix <T> *J = workspace_gradient(dnn.layers(), ws, erf);
+
+	opt->step(dnn.layers(), J, dnn.size());
+}
+
+/*
+ * Fitting a batch of I/O pairs on the threads of a pool, which is meant to be
+ * created once for a training session and reused for each batch.
+ */
+template <class T, class A = T>
+void multithreaded_fit(
+		DNN <T> &dnn,
+		const DataSet <T> &ins,
+		const DataSet <T> &outs,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		ThreadPool &pool)
+{
+	Matrix <T> *J;
+	
+	J = simple_multithreaded_batch_gradient <T, A> (
+			dnn.layers(),
+			dnn.size(),
+			ins,
+			outs,
+			erf,
+			pool);
+	opt->step(dnn.layers(), J, dnn.size());
 
 	delete[] J;
 }
 
-template <class T>
+// Same as above, with each chunk of the workspace computed on the pool
+template <class T, class S>
+void multithreaded_fit(
+		DNN <T> &dnn,
+		const S &ins,
+		const S &outs,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		Workspace <T> &ws,
+		ThreadPool &pool)
+{
+	ws.load(ins, outs);
+
+	Matrix <T> *J = workspace_gradient(dnn.layers(), ws, erf, &pool);
+
+	opt->step(dnn.layers(), J, dnn.size());
+}
+
+// Same as above, on the pool of the calling thread (see ThreadPool::local),
+// so that the threads are only created on the first call
+template <class T, class A = T>
 void multithreaded_fit(
 		DNN <T> &dnn,
 		const DataSet <T> &ins,
@@ -122,20 +209,8 @@ void multithreaded_fit(
 	if (!_cost)
 		throw null_loss_function(); */
 
-	Matrix <T> *J;
-	
-	J = simple_multithreaded_batch_gradient(
-			dnn.layers(),
-			dnn.size(),
-			ins,
-			outs,
-			erf,
-			threads);
-	J = opt->update(J, dnn.size());
-
-	dnn.apply_gradient(J);
-
-	delete[] J;
+	multithreaded_fit <T, A> (dnn, ins, outs, erf, opt,
+			ThreadPool::local(threads));
 }
 
 // Non-statistical methods (without performance statistics)
@@ -164,21 +239,22 @@ void train_dataset(
 }
 
 // Statistical counterparts of the above (with performance metrics)
-template <class T>
+template <class T, class A = T>
 PerformanceStatistics <T> train_mini_batch_perf(
 		DNN <T> &dnn,
 		const DataSet <T> &ins,
 		const DataSet <T> &outs,
 		Erf <T> *erf,
 		Optimizer <T> *opt,
-		Comparator <T> cmp = _def_cmp <T>,
-		Display::type display = 0,
-		size_t threads = 1)
+		Comparator <T> cmp,
+		Display::type display,
+		ThreadPool &pool,
+		Workspace <T> &ws)
 {
 	assert(ins.size() == outs.size());
 
 	PerformanceStatistics <T> ns;
-	Vector <double> to;
+	Vector <T> to;
 	T perr;
 	size_t n;
 
@@ -191,13 +267,24 @@ PerformanceStatistics <T> train_mini_batch_perf(
 		ns._cost += erf->compute(to, outs[i]).x();
 		ns._passed += cmp(to, outs[i]);
 
-		perr += fabs((to - outs[i]).norm() / outs[i].norm());
+		perr += fabs((lazy(to) - lazy(outs[i])).norm() / outs[i].norm());
 	}
 
-	if (threads > 1)
-		multithreaded_fit(dnn, ins, outs, erf, opt, threads);
-	else
-		fit(dnn, ins, outs, erf, opt);
+	Profiler::clock::time_point start = Profiler::clock::now();
+
+	// The workspace does not support mixed precision
+	if (!std::is_same <T, A> ::value) {
+		if (pool.size() > 1)
+			multithreaded_fit <T, A> (dnn, ins, outs, erf, opt, pool);
+		else
+			fit <T, A> (dnn, ins, outs, erf, opt);
+	} else if (pool.size() > 1) {
+		multithreaded_fit(dnn, ins, outs, erf, opt, ws, pool);
+	} else {
+		fit(dnn, ins, outs, erf, opt, ws);
+	}
+
+	ns._kernel_time = elapsed_us(start);
 
 	perr /= n;
 	if (display & Display::batch) {
@@ -211,7 +298,33 @@ PerformanceStatistics <T> train_mini_batch_perf(
 	return ns;
 }
 
-template <class T>
+// Same as above, on the pool of the calling thread (see ThreadPool::local),
+// so that the threads are only created on the first call
+template <class T, class A = T>
+PerformanceStatistics <T> train_mini_batch_perf(
+		DNN <T> &dnn,
+		const DataSet <T> &ins,
+		const DataSet <T> &outs,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		Comparator <T> cmp = _def_cmp <T>,
+		Display::type display = 0,
+		size_t threads = 1)
+{
+	ThreadPool &pool = ThreadPool::local(threads);
+	Workspace <T> ws(dnn, std::is_same <T, A> ::value ? ins.size() : 0,
+			pool.size());
+
+	return train_mini_batch_perf <T, A> (dnn, ins, outs, erf, opt,
+			cmp, display, pool, ws);
+}
+
+/*
+ * The pool and the training buffers are shared by every batch of the data set
+ * (and across epochs by the caller), so the threads and buffers are only
+ * created once.
+ */
+template <class T, class A = T>
 PerformanceStatistics <T> train_dataset_perf(
 		DNN <T> &dnn,
 		const DataSet <T> &ins,
@@ -219,8 +332,9 @@ PerformanceStatistics <T> train_dataset_perf(
 		size_t batch_size,
 		Erf <T> *erf,
 		Optimizer <T> *opt,
-		Display::type display = 0,
-		size_t threads = 1,
+		Display::type display,
+		ThreadPool &pool,
+		Workspace <T> &ws,
 		Comparator <T> cmp = _def_cmp <T>)
 {
 	assert(ins.size() == outs.size());
@@ -234,22 +348,263 @@ PerformanceStatistics <T> train_dataset_perf(
 	
 	n = input_batches.size();
 	for (size_t i = 0; i < n; i++) {
-		bs = train_mini_batch_perf(dnn,
+		bs = train_mini_batch_perf <T, A> (dnn,
 				input_batches[i],
 				output_batches[i],
 				erf,
 				opt,
 				cmp,
 				display,
-				threads);
+				pool,
+				ws);
+
+		ns._cost += bs._cost;
+		ns._passed += bs._passed;
+		ns._kernel_time += bs._kernel_time;
+	}
+
+	return ns;
+}
+
+template <class T, class A = T>
+PerformanceStatistics <T> train_dataset_perf(
+		DNN <T> &dnn,
+		const DataSet <T> &ins,
+		const DataSet <T> &outs,
+		size_t batch_size,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		Display::type display,
+		ThreadPool &pool,
+		Comparator <T> cmp = _def_cmp <T>)
+{
+	// Buffers are only allocated if they are used (not in mixed precision)
+	Workspace <T> ws(dnn, std::is_same <T, A> ::value ? batch_size : 0,
+			pool.size());
+
+	return train_dataset_perf <T, A> (dnn, ins, outs, batch_size, erf,
+			opt, display, pool, ws, cmp);
+}
+
+// Same as above, on the pool of the calling thread (see ThreadPool::local),
+// so that the threads are only created on the first call
+template <class T, class A = T>
+PerformanceStatistics <T> train_dataset_perf(
+		DNN <T> &dnn,
+		const DataSet <T> &ins,
+		const DataSet <T> &outs,
+		size_t batch_size,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		Display::type display = 0,
+		size_t threads = 1,
+		Comparator <T> cmp = _def_cmp <T>)
+{
+	return train_dataset_perf <T, A> (dnn, ins, outs, batch_size, erf,
+			opt, display, ThreadPool::local(threads), cmp);
+}
+
+/*
+ * Training on a batch of a PackedDataSet (or on a batch packed into matrices,
+ * one sample per row): the batch is copied once into the workspace, and the
+ * statistics come from a single batched inference (without dropout) on the
+ * copied inputs, in the scratch of the workspace. Mixed precision is not
+ * supported.
+ */
+template <class T, class S>
+PerformanceStatistics <T> train_mini_batch_perf(
+		DNN <T> &dnn,
+		const S &ins,
+		const S &outs,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		Comparator <T> cmp,
+		Display::type display,
+		ThreadPool &pool,
+		Workspace <T> &ws)
+{
+	PerformanceStatistics <T> ns;
+	T perr;
+	size_t n;
+
+	ws.load(ins, outs);
+
+	perr = 0;
+	n = ws.batch();
+
+	// Performance statistics first
+	for (size_t c = 0; c < ws.active(); c++) {
+		typename Workspace <T> ::Chunk &ch = ws[c];
+
+		const Matrix <T> &P = dnn.infer(ch.A[0], ws.scratch());
+
+		for (size_t i = 0; i < P.get_rows(); i++) {
+			// Slices of the rows (not copied)
+			Vector <T> to(P.get_cols(), const_cast <T *> (P[i]));
+			Vector <T> out(ch.Y.get_cols(), ch.Y[i]);
+
+			ns._cost += erf->compute(to, out).x();
+			ns._passed += cmp(to, out);
+
+			perr += fabs((lazy(to) - lazy(out)).norm() / out.norm());
+		}
+	}
+
+	Profiler::clock::time_point start = Profiler::clock::now();
+
+	Matrix <T> *J = workspace_gradient(dnn.layers(), ws, erf,
+			(pool.size() > 1) ? &pool : nullptr);
+
+	opt->step(dnn.layers(), J, dnn.size());
+
+	ns._kernel_time = elapsed_us(start);
+
+	perr /= n;
+	if (display & Display::batch) {
+		std::cout << "Batch done:"
+			<< " %-err = " << 100 * perr << "%"
+			<< " %-passed = " << (100.0 * ns._passed)/n << "%"
+			<< " #passed = " << ns._passed
+			<< std::endl;
+	}
+
+	return ns;
+}
+
+/*
+ * Training on a PackedDataSet, in batches of consecutive samples in the order
+ * of the data sets (which can be shuffled between epochs with shuffle, without
+ * moving the samples). The batches are views, so no sample is copied apart
+ * from the copy into the training buffers.
+ */
+template <class T>
+PerformanceStatistics <T> train_dataset_perf(
+		DNN <T> &dnn,
+		const PackedDataSet <T> &ins,
+		const PackedDataSet <T> &outs,
+		size_t batch_size,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		Display::type display,
+		ThreadPool &pool,
+		Workspace <T> &ws,
+		Comparator <T> cmp = _def_cmp <T>)
+{
+	assert(ins.size() == outs.size());
+
+	PerformanceStatistics <T> ns;
+	PerformanceStatistics <T> bs;
+
+	for (size_t i = 0; i < ins.size(); i += batch_size) {
+		bs = train_mini_batch_perf(dnn,
+				ins.batch(i, i + batch_size),
+				outs.batch(i, i + batch_size),
+				erf,
+				opt,
+				cmp,
+				display,
+				pool,
+				ws);
+
+		ns._cost += bs._cost;
+		ns._passed += bs._passed;
+		ns._kernel_time += bs._kernel_time;
+	}
+
+	return ns;
+}
+
+template <class T>
+PerformanceStatistics <T> train_dataset_perf(
+		DNN <T> &dnn,
+		const PackedDataSet <T> &ins,
+		const PackedDataSet <T> &outs,
+		size_t batch_size,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		Display::type display,
+		ThreadPool &pool,
+		Comparator <T> cmp = _def_cmp <T>)
+{
+	Workspace <T> ws(dnn, batch_size, pool.size());
+
+	return train_dataset_perf(dnn, ins, outs, batch_size, erf, opt,
+			display, pool, ws, cmp);
+}
+
+// Same as above, on the pool of the calling thread (see ThreadPool::local),
+// so that the threads are only created on the first call
+template <class T>
+PerformanceStatistics <T> train_dataset_perf(
+		DNN <T> &dnn,
+		const PackedDataSet <T> &ins,
+		const PackedDataSet <T> &outs,
+		size_t batch_size,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		Display::type display = 0,
+		size_t threads = 1,
+		Comparator <T> cmp = _def_cmp <T>)
+{
+	return train_dataset_perf(dnn, ins, outs, batch_size, erf, opt,
+			display, ThreadPool::local(threads), cmp);
+}
+
+/*
+ * Training on the batches of a Prefetcher, which are loaded in the background
+ * while the previous batches are trained on. Every batch which is left in the
+ * prefetcher is trained on (the prefetcher is usually created for a number of
+ * epochs, see Prefetcher).
+ */
+template <class T>
+PerformanceStatistics <T> train_prefetched_perf(
+		DNN <T> &dnn,
+		Prefetcher <T> &batches,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		Display::type display,
+		ThreadPool &pool,
+		Workspace <T> &ws,
+		Comparator <T> cmp = _def_cmp <T>)
+{
+	PerformanceStatistics <T> ns;
+	PerformanceStatistics <T> bs;
+
+	while (const typename Prefetcher <T> ::Batch *batch = batches.next()) {
+		bs = train_mini_batch_perf(dnn,
+				batch->ins,
+				batch->outs,
+				erf,
+				opt,
+				cmp,
+				display,
+				pool,
+				ws);
 
 		ns._cost += bs._cost;
-		ns._passed += bs._cost;
+		ns._passed += bs._passed;
+		ns._kernel_time += bs._kernel_time;
 	}
 
 	return ns;
 }
 
+template <class T>
+PerformanceStatistics <T> train_prefetched_perf(
+		DNN <T> &dnn,
+		Prefetcher <T> &batches,
+		Erf <T> *erf,
+		Optimizer <T> *opt,
+		Display::type display,
+		ThreadPool &pool,
+		Comparator <T> cmp = _def_cmp <T>)
+{
+	Workspace <T> ws(dnn, 0, pool.size());
+
+	return train_prefetched_perf(dnn, batches, erf, opt, display, pool,
+			ws, cmp);
+}
+
 }
 
 }
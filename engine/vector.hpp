@@ -68,6 +68,9 @@ public:
 	Vector(const Vector &);
 	Vector(const Matrix <T> &);
 
+	Vector(Vector &&) noexcept;
+	Vector(Matrix <T> &&);
+
 	Vector(size_t);
 	Vector(size_t, T);
 	Vector(size_t, T *, bool = true);
@@ -90,10 +93,28 @@ public:
 	template <class A>
 	explicit Vector(const Vector <A> &);
 
+#ifndef __AVR
+
+	// Evaluation of lazy expressions
+	template <class E>
+	Vector(const Expression <T, E> &);
+
+#endif
+
 	// Assignment
 	Vector &operator=(const Vector &);
 	Vector &operator=(const Matrix <T> &);
 
+	Vector &operator=(Vector &&) noexcept;
+	Vector &operator=(Matrix <T> &&);
+
+#ifndef __AVR
+
+	template <class E>
+	Vector &operator=(const Expression <T, E> &);
+
+#endif
+
 	// Indexing
 	__cuda_dual__ inline T &get(size_t);
 	__cuda_dual__ inline const T &get(size_t) const;
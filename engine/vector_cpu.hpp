@@ -44,6 +44,36 @@ template <class T>
 Vector <T> ::Vector(size_t rs, std::function <T *(size_t)> gen)
 	        : Matrix <T> (rs, 1, gen) {}
 
+/**
+ * @brief Evaluates a lazy expression (see expression.hpp) into a new vector, in
+ * a single pass.
+ *
+ * @param expr the expression to evaluate.
+ */
+template <class T>
+template <class E>
+Vector <T> ::Vector(const Expression <T, E> &expr)
+		: Matrix <T> (expr) {}
+
+/**
+ * @brief Evaluates a lazy expression into this vector. The components are
+ * overwritten in place if the sizes match, so the expression may refer to
+ * this vector.
+ *
+ * @param expr the expression to evaluate.
+ */
+template <class T>
+template <class E>
+Vector <T> &Vector <T> ::operator=(const Expression <T, E> &expr)
+{
+	if (this->_size == expr.size())
+		expr.evaluate(this->_array);
+	else
+		Matrix <T> ::operator=(Matrix <T> (expr));
+
+	return *this;
+}
+
 /**
  * @brief Heterogenous copy constructor.
  *
@@ -129,8 +159,15 @@ Vector <T> Vector <T> ::normalized() const
 template <class T>
 void Vector <T> ::operator+=(const Vector <T> &a)
 {
-	for (size_t i = 0; i < this->_size; i++)
-		this->_array[i] += a._array[i];
+	T *arr = this->_array;
+	const T *brr = a._array;
+
+	parallel::for_range(this->_size,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				arr[i] += brr[i];
+		}
+	);
 }
 
 /**
@@ -143,8 +180,15 @@ void Vector <T> ::operator+=(const Vector <T> &a)
 template <class T>
 void Vector <T> ::operator-=(const Vector <T> &a)
 {
-	for (size_t i = 0; i < this->_size; i++)
-		this->_array[i] -= a._array[i];
+	T *arr = this->_array;
+	const T *brr = a._array;
+
+	parallel::for_range(this->_size,
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				arr[i] -= brr[i];
+		}
+	);
 }
 
 }
@@ -0,0 +1,567 @@
+#ifndef WORKSPACE_H_
+#define WORKSPACE_H_
+
+// Engine headers
+#include "dataset.hpp"
+#include "dnn.hpp"
+#include "erf.hpp"
+#include "gradient.hpp"
+
+#include "core/parallel.hpp"
+#include "core/segments.hpp"
+
+namespace zhetapi {
+
+namespace ml {
+
+/**
+ * @brief Preallocated buffers for the training steps of a network: the caches
+ * of the forward pass, the deltas of the backward pass and the gradients.
+ *
+ * A batch is split into contiguous chunks (one for each thread of a pool),
+ * and each chunk has its own set of buffers. The buffers are sized from the
+ * topology of the network, for the largest batch loaded so far (or the one
+ * given on creation). Smaller batches use the first rows of each buffer (see
+ * Matrix::set_rows), so once the largest batch has been seen, training steps
+ * do not allocate, even when the last batch of an epoch is shorter. The
+ * derivative of the cost function is also kept for as long as the same cost
+ * is used, and so are the buffers of the inference of the statistics.
+ *
+ * The workspace is meant to be created once for a training session, like the
+ * thread pool, and passed to each epoch.
+ *
+ * A workspace is tied to the topology of the network it was created for.
+ *
+ * With a checkpoint interval k > 1 (see DNN::set_checkpoint_interval), the
+ * buffers are laid out as described in core/segments.hpp, and the segments
+ * are recomputed during the backward pass (see batch_gradient_sum).
+ */
+template <class T>
+class Workspace {
+public:
+	// Buffers for a contiguous chunk [start, end) of a batch
+	struct Chunk {
+		Matrix <T> *	A	= nullptr;	// Inputs of each layer, and the output
+		Matrix <T> *	Z	= nullptr;	// Derivatives of the activations
+		Matrix <T> *	D	= nullptr;	// Deltas
+		Matrix <T> *	J	= nullptr;	// Gradient sums
+
+		Matrix <T>	Y;			// Targets
+
+		// Storage of the views, when checkpointing
+		std::vector <T>	shared;
+
+		size_t		start	= 0;
+		size_t		end	= 0;
+	};
+private:
+	size_t		_size		= 0;
+	size_t		_chunks	= 0;
+	size_t		_active	= 0;
+	size_t		_batch		= 0;
+
+	// Rows each chunk has buffers for
+	size_t		_capacity	= 0;
+
+	// Widths of the inputs of each layer (and of the output)
+	size_t *	_widths	= nullptr;
+
+	Chunk *		_chunk		= nullptr;
+
+	// Gradient sums of each chunk, for the reduction
+	Matrix <T> **	_sums		= nullptr;
+
+	const Erf <T> *	_erf		= nullptr;
+	int		_erf_type	= 0;
+	Erf <T> *	_derf		= nullptr;
+
+	// Checkpoint interval, and whether the buffers are views
+	size_t		_interval	= 0;
+	bool		_views		= false;
+
+	InferenceScratch <T>	_scratch;
+
+	void allocate(size_t);
+	void shape(size_t);
+
+	size_t elements(size_t, size_t &) const;
+	size_t chunk_rows(size_t) const;
+	size_t footprint(size_t) const;
+public:
+	Workspace(DNN <T> &, size_t = 0, size_t = 1);
+
+	Workspace(const Workspace &) = delete;
+	Workspace &operator=(const Workspace &) = delete;
+
+	~Workspace();
+
+	size_t size() const;
+	size_t chunks() const;
+	size_t active() const;
+	size_t batch() const;
+
+	void set_checkpoint_interval(size_t);
+	size_t checkpoint_interval() const;
+
+	size_t bytes() const;
+	size_t bytes(size_t) const;
+
+	Chunk &operator[](size_t);
+
+	Matrix <T> **sums();
+
+	InferenceScratch <T> &scratch();
+
+	template <class S>
+	void load(const S &, const S &);
+
+	void load(const Matrix <T> &, const Matrix <T> &);
+
+	Erf <T> *derivative(Erf <T> *);
+};
+
+/**
+ * @brief Creates the buffers for a network.
+ *
+ * @param dnn the network.
+ * @param batch the expected number of samples per batch, for which the buffers
+ * are allocated immediately (0 defers the allocation to the first batch).
+ * @param chunks the number of chunks a batch is split into, usually the
+ * number of threads that compute the gradient.
+ */
+template <class T>
+Workspace <T> ::Workspace(DNN <T> &dnn, size_t batch, size_t chunks)
+		: _size(dnn.size()), _chunks(chunks ? chunks : 1),
+		_interval(dnn.checkpoint_interval())
+{
+	Layer <T> *layers = dnn.layers();
+
+	_widths = new size_t[_size + 1];
+
+	_widths[0] = dnn.input_size();
+	for (size_t i = 0; i < _size; i++)
+		_widths[i + 1] = layers[i].get_fan_out();
+
+	_chunk = new Chunk[_chunks];
+	_sums = new Matrix <T> *[_chunks];
+
+	for (size_t c = 0; c < _chunks; c++) {
+		_chunk[c].A = new Matrix <T> [_size + 1];
+		_chunk[c].Z = new Matrix <T> [_size];
+		_chunk[c].D = new Matrix <T> [_size];
+		_chunk[c].J = new Matrix <T> [_size];
+
+		// The gradients only depend on the topology
+		for (size_t i = 0; i < _size; i++)
+			_chunk[c].J[i] = Matrix <T> (_widths[i + 1], _widths[i] + 1, T(0));
+
+		_sums[c] = _chunk[c].J;
+	}
+
+	if (batch)
+		shape(batch);
+}
+
+template <class T>
+Workspace <T> ::~Workspace()
+{
+	for (size_t c = 0; c < _chunks; c++) {
+		delete[] _chunk[c].A;
+		delete[] _chunk[c].Z;
+		delete[] _chunk[c].D;
+		delete[] _chunk[c].J;
+	}
+
+	delete[] _chunk;
+	delete[] _sums;
+	delete[] _widths;
+
+	delete _derf;
+}
+
+/*
+ * Number of components of the buffers of the activations and deltas of a
+ * chunk, per sample. When checkpointing, the components of the storage shared
+ * by the segments are also returned.
+ */
+template <class T>
+size_t Workspace <T> ::elements(size_t rows, size_t &shared) const
+{
+	size_t k = checkpoint_segment(_interval, _size);
+	if (k)
+		return checkpoint_elements(_widths, _size, k, rows, shared);
+
+	size_t total = 0;
+
+	shared = 0;
+	for (size_t i = 0; i <= _size; i++)
+		total += rows * _widths[i];
+
+	for (size_t i = 0; i < _size; i++)
+		total += 2 * rows * _widths[i + 1];
+
+	return total;
+}
+
+// Rows of the largest chunk of a batch of n samples
+template <class T>
+size_t Workspace <T> ::chunk_rows(size_t n) const
+{
+	size_t active = std::max(std::min(_chunks, n), (size_t) 1);
+
+	return (n + active - 1)/active;
+}
+
+// Sizes the buffers of every chunk for the given number of rows
+template <class T>
+void Workspace <T> ::allocate(size_t rows)
+{
+	size_t k = checkpoint_segment(_interval, _size);
+
+	for (size_t c = 0; c < _chunks; c++) {
+		Chunk &ch = _chunk[c];
+
+		// Views are replaced by buffers of their own (or new views)
+		if (_views || k) {
+			for (size_t i = 1; i <= _size; i++) {
+				ch.A[i] = Matrix <T> ();
+				ch.Z[i - 1] = Matrix <T> ();
+				ch.D[i - 1] = Matrix <T> ();
+			}
+		}
+
+		ch.Y.resize(rows, _widths[_size]);
+		ch.A[0].resize(rows, _widths[0]);
+
+		if (!k) {
+			std::vector <T> ().swap(ch.shared);
+
+			for (size_t i = 1; i <= _size; i++)
+				ch.A[i].resize(rows, _widths[i]);
+
+			for (size_t i = 0; i < _size; i++) {
+				ch.Z[i].resize(rows, _widths[i + 1]);
+				ch.D[i].resize(rows, _widths[i + 1]);
+			}
+
+			continue;
+		}
+
+		checkpoint_views(_widths, _size, k, rows, ch.shared,
+				ch.A, ch.Z, ch.D);
+	}
+
+	_views = k;
+	_capacity = rows;
+}
+
+/*
+ * Splits a batch of n samples into chunks, and sets the number of rows of
+ * their buffers (which are only reallocated if a chunk has more rows than
+ * ever before).
+ */
+template <class T>
+void Workspace <T> ::shape(size_t n)
+{
+	if (n == _batch)
+		return;
+
+	size_t rows = chunk_rows(n);
+	if (rows > _capacity)
+		allocate(rows);
+
+	_batch = n;
+	_active = std::max(std::min(_chunks, n), (size_t) 1);
+
+	for (size_t c = 0; c < _chunks; c++) {
+		Chunk &ch = _chunk[c];
+
+		if (c < _active) {
+			ch.start = (n * c)/_active;
+			ch.end = (n * (c + 1))/_active;
+		} else {
+			ch.start = ch.end = n;
+		}
+
+		rows = ch.end - ch.start;
+
+		ch.Y.set_rows(rows);
+		for (size_t i = 0; i <= _size; i++)
+			ch.A[i].set_rows(rows);
+
+		for (size_t i = 0; i < _size; i++) {
+			ch.Z[i].set_rows(rows);
+			ch.D[i].set_rows(rows);
+		}
+	}
+}
+
+template <class T>
+size_t Workspace <T> ::size() const
+{
+	return _size;
+}
+
+template <class T>
+size_t Workspace <T> ::chunks() const
+{
+	return _chunks;
+}
+
+/**
+ * @return the number of chunks which hold samples of the current batch (all
+ * of them, unless the batch has fewer samples than there are chunks).
+ */
+template <class T>
+size_t Workspace <T> ::active() const
+{
+	return _active;
+}
+
+template <class T>
+size_t Workspace <T> ::batch() const
+{
+	return _batch;
+}
+
+/**
+ * @brief Sets the checkpoint interval (see DNN::set_checkpoint_interval). The
+ * buffers are reallocated when the next batch is loaded.
+ */
+template <class T>
+void Workspace <T> ::set_checkpoint_interval(size_t interval)
+{
+	if (interval != _interval) {
+		_interval = interval;
+		_batch = 0;
+		_capacity = 0;
+	}
+}
+
+template <class T>
+size_t Workspace <T> ::checkpoint_interval() const
+{
+	return _interval;
+}
+
+// Size of the buffers (activations, deltas, targets and gradients) of every
+// chunk, for the given number of rows per chunk
+template <class T>
+size_t Workspace <T> ::footprint(size_t rows) const
+{
+	size_t total = 0;
+	for (size_t c = 0; c < _chunks; c++) {
+		size_t shared;
+		total += elements(rows, shared) + rows * _widths[_size];
+
+		for (size_t i = 0; i < _size; i++)
+			total += _chunk[c].J[i].size();
+	}
+
+	return total * sizeof(T);
+}
+
+/**
+ * @return the size of the buffers, as allocated for the largest batch so far.
+ */
+template <class T>
+size_t Workspace <T> ::bytes() const
+{
+	return footprint(_capacity);
+}
+
+/**
+ * @return the size of the buffers (activations, deltas, targets and
+ * gradients) for batches of up to the given size, with the current checkpoint
+ * interval.
+ */
+template <class T>
+size_t Workspace <T> ::bytes(size_t batch) const
+{
+	return footprint(chunk_rows(batch));
+}
+
+template <class T>
+typename Workspace <T> ::Chunk &Workspace <T> ::operator[](size_t i)
+{
+	return _chunk[i];
+}
+
+/**
+ * @return the gradient buffers of each chunk, as expected by reduce_gradients.
+ */
+template <class T>
+Matrix <T> **Workspace <T> ::sums()
+{
+	return _sums;
+}
+
+/**
+ * @return the buffers for the inference of the statistics of the batches
+ * (see DNN::infer), which live as long as the workspace.
+ */
+template <class T>
+InferenceScratch <T> &Workspace <T> ::scratch()
+{
+	return _scratch;
+}
+
+/**
+ * @brief Copies a batch into the input and target buffers of each chunk. The
+ * batch is either a DataSet or a DataBatch (a view of a PackedDataSet).
+ */
+template <class T>
+template <class S>
+void Workspace <T> ::load(const S &ins, const S &outs)
+{
+	if (ins.size() != outs.size())
+		throw typename DNN <T> ::bad_io_dimensions();
+
+	shape(ins.size());
+
+	for (size_t c = 0; c < _active; c++) {
+		Chunk &ch = _chunk[c];
+
+		to_matrix(ins, ch.start, ch.end, ch.A[0]);
+		to_matrix(outs, ch.start, ch.end, ch.Y);
+	}
+}
+
+/**
+ * @brief Copies a batch which is already packed into matrices (one sample per
+ * row, as produced by a Prefetcher) into the buffers of each chunk.
+ */
+template <class T>
+void Workspace <T> ::load(const Matrix <T> &ins, const Matrix <T> &outs)
+{
+	if (ins.get_rows() != outs.get_rows()
+			|| ins.get_cols() != _widths[0]
+			|| outs.get_cols() != _widths[_size])
+		throw typename DNN <T> ::bad_io_dimensions();
+
+	shape(ins.get_rows());
+
+	for (size_t c = 0; c < _active; c++) {
+		Chunk &ch = _chunk[c];
+
+		size_t rows = ch.end - ch.start;
+		if (!rows)
+			continue;
+
+		std::copy(ins[ch.start], ins[ch.start] + rows * _widths[0],
+				ch.A[0][0]);
+		std::copy(outs[ch.start], outs[ch.start] + rows * _widths[_size],
+				ch.Y[0]);
+	}
+}
+
+/**
+ * @return the derivative of the cost function, which is only recreated when a
+ * different cost function is passed.
+ */
+template <class T>
+Erf <T> *Workspace <T> ::derivative(Erf <T> *erf)
+{
+	if (erf != _erf || erf->get_erf_type() != _erf_type) {
+		delete _derf;
+
+		_erf = erf;
+		_erf_type = erf->get_erf_type();
+		_derf = erf->derivative();
+	}
+
+	return _derf;
+}
+
+/*
+ * Averages the gradient of the batch loaded into the workspace, computing the
+ * chunks on the pool (if any) and combining their sums with reduce_gradients.
+ * The result is stored in the workspace (in the buffers of the first chunk)
+ * and does not need to be freed. Nothing is allocated, unless the batch is
+ * larger than any before or the cost function changed since the last call.
+ */
+template <class T>
+Matrix <T> *workspace_gradient(
+		Layer <T> *layers,
+		Workspace <T> &ws,
+		Erf <T> *cost,
+		ThreadPool *pool = nullptr)
+{
+	size_t size = ws.size();
+	size_t active = ws.active();
+
+	Erf <T> *dcost = ws.derivative(cost);
+
+	// Null unless profiling (the threads of the pool record into the
+	// profiler of the caller)
+	Profiler *prof = Profiler::current();
+
+	if (pool && active > 1) {
+		// The task captures a single pointer (see reduce_gradients)
+		struct {
+			Layer <T> *	layers;
+			Workspace <T> *	ws;
+			Erf <T> *	dcost;
+			Profiler *	prof;
+		} job {layers, &ws, dcost, prof};
+
+		auto *jp = &job;
+		pool->run(active,
+			[jp](size_t c) {
+				typename Workspace <T> ::Chunk &ch = (*jp->ws)[c];
+
+				batch_gradient_sum(jp->layers, jp->ws->size(),
+						ch.A, ch.Z, ch.D, ch.Y,
+						jp->dcost, ch.J, jp->prof,
+						jp->ws->checkpoint_interval());
+			}
+		);
+
+		Profiler::clock::time_point start;
+		if (prof)
+			start = Profiler::clock::now();
+
+		reduce_gradients(*pool, ws.sums(), active, size);
+
+		// Split between the layers by their number of parameters
+		if (prof) {
+			prof->record_shared(PROF_Gradient, start, size,
+				[&](size_t k) {
+					return double(ws[0].J[k].size());
+				}, active - 1
+			);
+		}
+	} else {
+		for (size_t c = 0; c < active; c++) {
+			typename Workspace <T> ::Chunk &ch = ws[c];
+
+			batch_gradient_sum(layers, size, ch.A, ch.Z, ch.D,
+					ch.Y, dcost, ch.J, prof,
+					ws.checkpoint_interval());
+
+			if (c > 0) {
+				for (size_t k = 0; k < size; k++) {
+					ProfileSection ps(prof, k, PROF_Gradient,
+							ch.J[k].size());
+
+					accumulate_gradient(ws[0].J[k], ch.J[k]);
+				}
+			}
+		}
+	}
+
+	Matrix <T> *J = ws[0].J;
+	for (size_t k = 0; k < size; k++) {
+		ProfileSection ps(prof, k, PROF_Gradient, J[k].size());
+
+		J[k] /= T(ws.batch());
+	}
+
+	return J;
+}
+
+}
+
+}
+
+#endif
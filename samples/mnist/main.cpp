@@ -1,6 +1,8 @@
 // C/C++ headers
+#include <algorithm>
 #include <iostream>
-#include <fstream>
+#include <numeric>
+#include <random>
 #include <vector>
 
 // Engine standard headers
@@ -12,27 +14,27 @@
 #define ZHP_ENGINE_PATH "../../engine"
 
 // Engine headers
+#include <idx.hpp>
 #include <training.hpp>
 
 #define TRAIN_IMAGES	100
 #define VALID_IMAGES	10000
 #define SIZE		28
+#define BATCH		20
+#define EPOCHS		10000
 
 using namespace std;
 using namespace zhetapi;
 
-// Global variables
-ifstream train_images("train-images-idx3-ubyte", ios::binary);
-ifstream train_labels("train-labels-idx1-ubyte", ios::binary);
+// Global variables (the files are memory-mapped)
+IDXFile train_images("train-images-idx3-ubyte");
+IDXFile train_labels("train-labels-idx1-ubyte");
 
-ifstream valid_images("train-images-idx3-ubyte", ios::binary);
-ifstream valid_labels("train-labels-idx1-ubyte", ios::binary);
+IDXFile valid_images("t10k-images-idx3-ubyte");
+IDXFile valid_labels("t10k-labels-idx1-ubyte");
 
-DataSet <double> train_imgs;
-DataSet <double> train_exps;
-
-DataSet <double> valid_imgs;
-DataSet <double> valid_exps;
+Matrix <double> valid_imgs;
+Matrix <double> valid_exps;
 
 // Pass critique
 bool match(const Vector <double> &actual, const Vector <double> &expected)
@@ -46,21 +48,25 @@ bool match(const Vector <double> &actual, const Vector <double> &expected)
 	return (expected[mi] == 1);
 };
 
-// Reading images
-vector <double> read_image(ifstream &fin)
+// Decodes and normalizes a batch of training samples (in the order of the
+// current epoch) from the mapped files, for the prefetcher
+void load_batch(size_t start, const vector <size_t> &order,
+		Prefetcher <double> ::Batch &batch)
 {
-	vector <double> pixels;
+	size_t end = min(start + BATCH, (size_t) TRAIN_IMAGES);
 
-	int size = SIZE * SIZE;
-	for (int k = 0; k < size; k++) {
-		unsigned char temp = 0;
+	batch.ins.resize(end - start, SIZE * SIZE);
+	batch.outs.resize(end - start, 10);
 
-		fin.read((char*) &temp, sizeof(temp));
+	for (size_t i = start; i < end; i++) {
+		train_images.convert(order[i], batch.ins[i - start], 1.0/255);
 
-		pixels.push_back(temp);
-	}
+		unsigned char actual = *train_labels.sample(order[i]);
 
-	return pixels;
+		double *out = batch.outs[i - start];
+		for (size_t j = 0; j < 10; j++)
+			out[j] = (j == actual) ? 1.0 : 0.0;
+	}
 }
 
 // Main function
@@ -81,77 +87,42 @@ int main()
 		ml::Layer <double> (10, new ml::Softmax <double> (), ml::Xavier <double> (30))
 	});
 
-	// Temporary variable
-	unsigned int tmp;
-
-	// First 16 bytes
-	train_images.read((char *) &tmp, sizeof(tmp));
-	train_images.read((char *) &tmp, sizeof(tmp));
-	train_images.read((char *) &tmp, sizeof(tmp));
-	train_images.read((char *) &tmp, sizeof(tmp));
-
-	valid_images.read((char *) &tmp, sizeof(tmp));
-	valid_images.read((char *) &tmp, sizeof(tmp));
-	valid_images.read((char *) &tmp, sizeof(tmp));
-	valid_images.read((char *) &tmp, sizeof(tmp));
-
-	// First 8 bytes
-	train_labels.read((char *) &tmp, sizeof(tmp));
-	train_labels.read((char *) &tmp, sizeof(tmp));
-
-	valid_labels.read((char *) &tmp, sizeof(tmp));
-	valid_labels.read((char *) &tmp, sizeof(tmp));
-
-	// Extract training data
-	for (size_t i = 0; i < TRAIN_IMAGES; i++) {
-		Vector <double> in = read_image(train_images);
-
-		unsigned char actual;
+	// Validation data, converted in a single pass
+	valid_images.convert(0, VALID_IMAGES, valid_imgs, 1.0/255);
+	valid_labels.one_hot(0, VALID_IMAGES, 10, valid_exps);
 
-		train_labels.read((char *) &actual, sizeof(actual));
+	ml::Erf <double> *erf = new ml::MSE <double> ();
+	ml::Optimizer <double> *opt = new ml::SGD <double> ();// Adam <double> ();
 
-		Vector <double> exp(10,
-			[&](size_t i) {
-				return (i == actual) ? 1.0 : 0.0;
-			}
-		);
+	// Worker threads for the whole training session
+	ThreadPool pool(8);
 
-		train_imgs.push_back(in);
-		train_exps.push_back(exp);
-	}
+	// The training samples are read from the files in the background, a
+	// batch at a time (two batches are in memory at once), and shuffled for
+	// each epoch. The batches are loaded in order by a single thread.
+	size_t per_epoch = (TRAIN_IMAGES + BATCH - 1)/BATCH;
 
-	// Extract validation data
-	for (size_t i = 0; i < VALID_IMAGES; i++) {
-		Vector <double> in = read_image(valid_images);
+	vector <size_t> order(TRAIN_IMAGES);
+	iota(order.begin(), order.end(), 0);
 
-		unsigned char actual;
+	mt19937 gen(clock());
 
-		valid_labels.read((char *) &actual, sizeof(actual));
+	Prefetcher <double> batches(EPOCHS * per_epoch,
+		[&](size_t k, Prefetcher <double> ::Batch &batch) {
+			if (k % per_epoch == 0)
+				std::shuffle(order.begin(), order.end(), gen);
 
-		Vector <double> exp(10,
-			[&](size_t i) {
-				return (i == actual) ? 1.0 : 0.0;
-			}
-		);
-
-		valid_imgs.push_back(in);
-		valid_exps.push_back(exp);
-	}
+			load_batch((k % per_epoch) * BATCH, order, batch);
+		}
+	);
 
-	ml::Erf <double> *erf = new ml::MSE <double> ();
-	ml::Optimizer <double> *opt = new ml::SGD <double> ();// Adam <double> ();
-
-	for (int i = 0; i < 10000; i++) {
-		train_dataset_perf(model,
-				train_imgs,
-				train_exps,
-				20,
-				erf,
-				opt,
-				Display::batch,
-				8,
-				match);
-	}
+	train_prefetched_perf(model,
+			batches,
+			erf,
+			opt,
+			Display::batch,
+			pool,
+			match);
 
 	// Free resources
 	delete erf;
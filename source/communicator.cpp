@@ -0,0 +1,177 @@
+#include "../engine/communicator.hpp"
+
+// C/C++ headers
+#include <cerrno>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace zhetapi {
+
+namespace ml {
+
+// Shared region
+SharedRegion::SharedRegion(size_t size) : _size(size)
+{
+	void *map = mmap(nullptr, size ? size : 1, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (map == MAP_FAILED)
+		throw bad_map();
+
+	_data = map;
+}
+
+SharedRegion::~SharedRegion()
+{
+	munmap(_data, _size ? _size : 1);
+}
+
+void *SharedRegion::data() const
+{
+	return _data;
+}
+
+size_t SharedRegion::size() const
+{
+	return _size;
+}
+
+// Shared barrier (lock-free atomics are usable across processes)
+SharedBarrier::SharedBarrier(size_t parties)
+		: _count(0), _generation(0), _aborted(0), _parties(parties) {}
+
+/**
+ * @brief Waits until every party has reached the barrier. The waiting
+ * processes yield their processor, since there may be more of them than there
+ * are processors.
+ */
+void SharedBarrier::wait()
+{
+	if (_aborted)
+		throw aborted_error();
+
+	uint32_t gen = _generation.load();
+
+	if (_count.fetch_add(1) + 1 == _parties) {
+		_count = 0;
+		_generation++;
+
+		return;
+	}
+
+	while (_generation.load() == gen) {
+		if (_aborted)
+			throw aborted_error();
+
+		sched_yield();
+	}
+}
+
+void SharedBarrier::abort()
+{
+	_aborted = 1;
+}
+
+bool SharedBarrier::aborted() const
+{
+	return _aborted;
+}
+
+// Sockets
+void local_ring(size_t size, std::vector <int> &next, std::vector <int> &prev)
+{
+	next.assign(size, -1);
+	prev.assign(size, -1);
+
+	if (size < 2)
+		return;
+
+	// Pair i connects rank i to rank i + 1
+	for (size_t i = 0; i < size; i++) {
+		int fds[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+			for (size_t j = 0; j < size; j++) {
+				close_socket(next[j]);
+				close_socket(prev[j]);
+			}
+
+			throw socket_error();
+		}
+
+		next[i] = fds[0];
+		prev[(i + 1) % size] = fds[1];
+	}
+}
+
+/**
+ * @brief Writes n bytes to one socket while reading m bytes from another. The
+ * transfers are interleaved with poll, so that two processes exchanging more
+ * than the capacity of their sockets cannot block each other.
+ */
+void exchange(int out, const void *src, size_t n, int in, void *dst, size_t m)
+{
+	const char *sp = (const char *) src;
+	char *dp = (char *) dst;
+
+	while (n || m) {
+		struct pollfd fds[2];
+
+		nfds_t count = 0;
+		if (n)
+			fds[count++] = {out, POLLOUT, 0};
+		if (m)
+			fds[count++] = {in, POLLIN, 0};
+
+		if (poll(fds, count, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			throw socket_error();
+		}
+
+		for (nfds_t i = 0; i < count; i++) {
+			if (!fds[i].revents)
+				continue;
+
+			if (fds[i].fd == out && n) {
+				ssize_t k = send(out, sp, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+				if (k < 0 && errno != EAGAIN && errno != EINTR)
+					throw socket_error();
+
+				if (k > 0) {
+					sp += k;
+					n -= k;
+				}
+			} else if (fds[i].fd == in && m) {
+				ssize_t k = recv(in, dp, m, MSG_DONTWAIT);
+
+				// The peer is gone
+				if (k == 0)
+					throw socket_error();
+
+				if (k < 0 && errno != EAGAIN && errno != EINTR)
+					throw socket_error();
+
+				if (k > 0) {
+					dp += k;
+					m -= k;
+				}
+			}
+		}
+	}
+}
+
+void close_socket(int fd)
+{
+	if (fd >= 0)
+		close(fd);
+}
+
+}
+
+}
@@ -0,0 +1,182 @@
+#include "../engine/idx.hpp"
+
+// C/C++ headers
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zhetapi {
+
+// Type code of unsigned bytes in the magic number
+static const unsigned char IDX_UBYTE = 0x08;
+
+// Big-endian 32-bit integer
+static size_t read_be32(const unsigned char *p)
+{
+	return (size_t(p[0]) << 24) | (size_t(p[1]) << 16)
+		| (size_t(p[2]) << 8) | size_t(p[3]);
+}
+
+/**
+ * @brief Maps an IDX file and validates its header.
+ *
+ * @param path the path of the file.
+ */
+IDXFile::IDXFile(const std::string &path)
+{
+	_fd = open(path.c_str(), O_RDONLY);
+	if (_fd < 0)
+		throw bad_file();
+
+	struct stat st;
+	if (fstat(_fd, &st) < 0) {
+		close();
+
+		throw bad_file();
+	}
+
+	_length = st.st_size;
+
+	// Magic number: two zero bytes, the type and the number of dimensions
+	if (_length < 4) {
+		close();
+
+		throw bad_header();
+	}
+
+	void *map = mmap(nullptr, _length, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE, _fd, 0);
+
+	if (map == MAP_FAILED) {
+		_length = 0;
+		close();
+
+		throw bad_file();
+	}
+
+	_map = (unsigned char *) map;
+
+	size_t ndims = _map[3];
+	size_t header = 4 + 4 * ndims;
+
+	if (_map[0] || _map[1] || _map[2] != IDX_UBYTE || !ndims
+			|| _length < header) {
+		close();
+
+		throw bad_header();
+	}
+
+	_samples = read_be32(_map + 4);
+
+	_dims = (ndims > 1) ? ndims - 1 : 1;
+	_shape = new size_t[_dims];
+
+	// Every dimension of a sample is positive, and so is their product (which
+	// must not overflow)
+	_shape[0] = 1;
+	_stride = 1;
+	for (size_t i = 1; i < ndims; i++) {
+		size_t n = read_be32(_map + 4 + 4 * i);
+
+		if (!n || _stride > SIZE_MAX/n) {
+			close();
+
+			throw bad_header();
+		}
+
+		_shape[i - 1] = n;
+		_stride *= n;
+	}
+
+	// The file must hold every sample (trailing bytes are ignored)
+	if ((_length - header)/_stride < _samples) {
+		close();
+
+		throw bad_header();
+	}
+
+	_data = _map + header;
+
+	madvise(_map, _length, MADV_SEQUENTIAL);
+}
+
+IDXFile::~IDXFile()
+{
+	close();
+}
+
+void IDXFile::close()
+{
+	if (_map)
+		munmap(_map, _length);
+
+	if (_fd >= 0)
+		::close(_fd);
+
+	delete[] _shape;
+
+	_map = nullptr;
+	_data = nullptr;
+	_shape = nullptr;
+	_fd = -1;
+}
+
+/**
+ * @return the number of samples (the first dimension).
+ */
+size_t IDXFile::size() const
+{
+	return _samples;
+}
+
+/**
+ * @return the number of components of each sample.
+ */
+size_t IDXFile::sample_size() const
+{
+	return _stride;
+}
+
+/**
+ * @return the number of dimensions of each sample.
+ */
+size_t IDXFile::dimensions() const
+{
+	return _dims;
+}
+
+size_t IDXFile::dim_size(size_t i) const
+{
+	return _shape[i];
+}
+
+const unsigned char *IDXFile::data() const
+{
+	return _data;
+}
+
+const unsigned char *IDXFile::sample(size_t i) const
+{
+	if (i >= _samples)
+		throw bad_index();
+
+	return _data + i * _stride;
+}
+
+/**
+ * @brief A view of a sample (for example a 28 x 28 tensor for MNIST images),
+ * which does not copy the components. Writing to the view does not change the
+ * file.
+ *
+ * @param i the index of the sample.
+ */
+Tensor <unsigned char> IDXFile::operator[](size_t i) const
+{
+	return Tensor <unsigned char> (_dims, _shape, _stride,
+			const_cast <unsigned char *> (sample(i)));
+}
+
+}
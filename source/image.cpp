@@ -208,6 +208,8 @@ size_t Image::channels() const
 	return _dim[2];
 }
 
+#ifndef ZHP_NO_GUI
+
 sf::Image Image::sfml_image() const
 {
 	sf::Image image;
@@ -225,6 +227,8 @@ sf::Texture Image::sfml_texture() const
 	return texture;
 }
 
+#endif
+
 void Image::set(const pixel &px, const Color &c)
 {
 	size_t index = _dim[2] * (px.first * _dim[1] + px.second);
@@ -293,8 +297,45 @@ Image Image::channel(size_t channels) const
 	return out;
 }
 
-// Cropping images (from top-right to bottom-left)
+/**
+ * @brief Crops the image (from top-right to bottom-left). The crop holds the
+ * pixels (x, y) with tr.first <= x <= bl.first and tr.second <= y <= bl.second,
+ * and has width bl.first - tr.first + 1 and height bl.second - tr.second + 1,
+ * following the indexing of the pixels (see set).
+ *
+ * Earlier versions swapped the two extents, reading bl.second - tr.second + 1
+ * values of x and bl.first - tr.first + 1 values of y (and could read past the
+ * image); crops which are not square differ from those versions.
+ *
+ * @param tr the top-right pixel of the crop.
+ * @param bl the bottom-left pixel of the crop.
+ */
 Image Image::crop(const pixel &tr, const pixel &bl) const
+{
+	MatrixView <const byte> v = crop_view(tr, bl);
+
+	size_t n_width = bl.first - tr.first + 1;
+	size_t n_height = bl.second - tr.second + 1;
+
+	Image out(n_width, n_height, _dim[2]);
+
+	copy(v, MatrixView <byte> (out._array, 0, v.get_rows(), v.get_cols(),
+			v.get_cols()));
+
+	return out;
+}
+
+/**
+ * @brief Views the pixels of a crop without copying them. Each row of the view
+ * holds the channels of consecutive pixels, so that its shape is
+ * (bl.first - tr.first + 1) x (bl.second - tr.second + 1) * channels().
+ *
+ * @param tr the top-right pixel of the crop.
+ * @param bl the bottom-left pixel of the crop.
+ *
+ * @return a view into this image, valid while the image is alive.
+ */
+MatrixView <const byte> Image::crop_view(const pixel &tr, const pixel &bl) const
 {
 	if (bl <= tr)
 		throw bad_input_order();
@@ -302,24 +343,13 @@ Image Image::crop(const pixel &tr, const pixel &bl) const
 	if (!in_bounds(tr) || !in_bounds(bl))
 		throw out_of_bounds();
 
-	size_t s_index = tr.first * _dim[1] + tr.second;
-	// size_t e_index = bl.first * _dim[1] + bl.second;
+	size_t offset = _dim[2] * (tr.first * _dim[1] + tr.second);
 
-	size_t n_width = bl.first - tr.first + 1;
-	size_t n_height = bl.second - tr.second + 1;
-
-	byte **rows = new byte *[n_height];
-	for (size_t i = 0; i < n_height; i++) {
-		size_t k = _dim[2] * (s_index + i * _dim[1]);
-		rows[i] = &(_array[k]);
-	}
+	size_t rows = bl.first - tr.first + 1;
+	size_t cols = (bl.second - tr.second + 1) * _dim[2];
 
-	Image out(rows, n_width, n_height, _dim[2]);
-
-	// Free the memory
-	delete[] rows;
-
-	return out;
+	return MatrixView <const byte> (_array, offset, rows, cols,
+			_dim[1] * _dim[2]);
 }
 
 const unsigned char *const Image::raw() const
@@ -0,0 +1,153 @@
+#include "../engine/model_file.hpp"
+
+// C/C++ headers
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zhetapi {
+
+namespace ml {
+
+const char ModelFile::magic[8] = {'Z', 'H', 'P', 'M', 'O', 'D', 'E', 'L'};
+const uint32_t ModelFile::version = 1;
+const uint32_t ModelFile::endianness = 0x01020304;
+const size_t ModelFile::alignment = 64;
+
+/**
+ * @brief Maps a model file and validates its structure.
+ *
+ * @param path the path of the file.
+ * @param verify whether to check the checksum.
+ */
+ModelFile::ModelFile(const std::string &path, bool verify)
+{
+	_fd = open(path.c_str(), O_RDONLY);
+	if (_fd < 0)
+		throw bad_file();
+
+	struct stat st;
+	if (fstat(_fd, &st) < 0) {
+		close();
+
+		throw bad_file();
+	}
+
+	if ((size_t) st.st_size < sizeof(ModelHeader)) {
+		close();
+
+		throw bad_header();
+	}
+
+	void *map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE, _fd, 0);
+
+	if (map == MAP_FAILED) {
+		close();
+
+		throw bad_file();
+	}
+
+	_map = (unsigned char *) map;
+	_length = st.st_size;
+
+	const ModelHeader &h = header();
+
+	if (memcmp(h.magic, magic, sizeof(magic))
+			|| h.version != version
+			|| h.endianness != endianness
+			|| h.length != _length
+			|| h.layers > (_length - sizeof(ModelHeader))/sizeof(LayerDescriptor)) {
+		close();
+
+		throw bad_header();
+	}
+
+	// Every record must be inside the file, and the weights aligned
+	for (size_t i = 0; i < h.layers; i++) {
+		const LayerDescriptor &d = layer(i);
+
+		if (d.rows > UINT32_MAX || d.cols > UINT32_MAX
+				|| !h.scalar || h.scalar > 16
+				|| d.weights % alignment || d.weights > _length
+				|| d.activation > _length
+				|| d.activation_size > _length - d.activation) {
+			close();
+
+			throw bad_header();
+		}
+
+		// Components which fit after the weights (the product of the
+		// dimensions is compared by division, so that it cannot wrap)
+		uint64_t room = (_length - d.weights)/h.scalar;
+
+		if (d.rows && d.cols > room/d.rows) {
+			close();
+
+			throw bad_header();
+		}
+	}
+
+	if (verify && h.checksum != checksum(_map + sizeof(ModelHeader),
+			_length - sizeof(ModelHeader))) {
+		close();
+
+		throw bad_checksum();
+	}
+}
+
+ModelFile::~ModelFile()
+{
+	close();
+}
+
+void ModelFile::close()
+{
+	if (_map)
+		munmap(_map, _length);
+
+	if (_fd >= 0)
+		::close(_fd);
+
+	_map = nullptr;
+	_fd = -1;
+}
+
+const ModelHeader &ModelFile::header() const
+{
+	return *((const ModelHeader *) _map);
+}
+
+const LayerDescriptor &ModelFile::layer(size_t i) const
+{
+	return ((const LayerDescriptor *) (_map + sizeof(ModelHeader)))[i];
+}
+
+/**
+ * @return a pointer to the given offset of the file.
+ */
+unsigned char *ModelFile::at(uint64_t offset) const
+{
+	return _map + offset;
+}
+
+/**
+ * @brief 64-bit FNV-1a hash of a buffer, which can be computed in several
+ * parts by passing the hash of the previous parts.
+ */
+uint64_t ModelFile::checksum(const unsigned char *data, size_t n, uint64_t hash)
+{
+	for (size_t i = 0; i < n; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+}
+
+}
@@ -0,0 +1,201 @@
+#include "../engine/profiler.hpp"
+
+// C/C++ headers
+#include <iomanip>
+#include <string>
+
+namespace zhetapi {
+
+namespace ml {
+
+Profiler::Profiler(size_t layers)
+		: _layers(layers), _records(layers * PROF_Phases) {}
+
+Profiler *&Profiler::installed()
+{
+	static thread_local Profiler *profiler = nullptr;
+
+	return profiler;
+}
+
+std::atomic <Profiler::AllocationCounter> &Profiler::counter()
+{
+	static std::atomic <AllocationCounter> ctr(nullptr);
+
+	return ctr;
+}
+
+size_t Profiler::layers() const
+{
+	return _layers;
+}
+
+/**
+ * @brief Adds a measurement to a phase of a layer. Can be called from several
+ * threads at once.
+ */
+void Profiler::record(size_t layer, profile_phase phase, double time,
+		double flops, size_t bytes)
+{
+	if (layer >= _layers)
+		return;
+
+	std::lock_guard <std::mutex> guard(_lock);
+
+	ProfileRecord &r = _records[layer * PROF_Phases + phase];
+
+	r.time += time;
+	r.flops += flops;
+	r.bytes += bytes;
+	r.calls++;
+}
+
+void Profiler::reset()
+{
+	std::lock_guard <std::mutex> guard(_lock);
+
+	for (ProfileRecord &r : _records)
+		r = ProfileRecord();
+}
+
+ProfileRecord Profiler::get(size_t layer, profile_phase phase) const
+{
+	std::lock_guard <std::mutex> guard(_lock);
+
+	return _records[layer * PROF_Phases + phase];
+}
+
+static void add(ProfileRecord &dst, const ProfileRecord &src)
+{
+	dst.time += src.time;
+	dst.flops += src.flops;
+	dst.bytes += src.bytes;
+	dst.calls += src.calls;
+}
+
+ProfileRecord Profiler::layer_total(size_t layer) const
+{
+	ProfileRecord total;
+	for (size_t p = 0; p < PROF_Phases; p++)
+		add(total, get(layer, (profile_phase) p));
+
+	return total;
+}
+
+ProfileRecord Profiler::phase_total(profile_phase phase) const
+{
+	ProfileRecord total;
+	for (size_t i = 0; i < _layers; i++)
+		add(total, get(i, phase));
+
+	return total;
+}
+
+ProfileRecord Profiler::total() const
+{
+	ProfileRecord total;
+	for (size_t i = 0; i < _layers; i++)
+		add(total, layer_total(i));
+
+	return total;
+}
+
+/**
+ * @brief Prints a table of the phases of each layer (time, share of the total
+ * time, GFLOP/s and bytes allocated), followed by the totals of each phase.
+ */
+void Profiler::print(std::ostream &os) const
+{
+	double all = total().time;
+
+	std::ios::fmtflags flags = os.flags();
+	std::streamsize precision = os.precision();
+
+	auto row = [&](const std::string &label, const ProfileRecord &r) {
+		double share = (all > 0) ? 100 * r.time/all : 0;
+		double gflops = (r.time > 0) ? r.flops/(r.time * 1e3) : 0;
+
+		os << std::left << std::setw(24) << label << std::right
+			<< std::setw(14) << std::fixed << std::setprecision(1) << r.time
+			<< std::setw(9) << share << "%"
+			<< std::setw(12) << std::setprecision(3) << gflops
+			<< std::setw(14) << r.bytes
+			<< std::setw(10) << r.calls << std::endl;
+	};
+
+	os << std::left << std::setw(24) << "phase" << std::right
+		<< std::setw(14) << "time (us)"
+		<< std::setw(10) << "share"
+		<< std::setw(12) << "GFLOP/s"
+		<< std::setw(14) << "bytes"
+		<< std::setw(10) << "calls" << std::endl;
+
+	for (size_t i = 0; i < _layers; i++) {
+		for (size_t p = 0; p < PROF_Phases; p++) {
+			row("layer " + std::to_string(i) + " "
+				+ phase_name((profile_phase) p),
+				get(i, (profile_phase) p));
+		}
+	}
+
+	for (size_t p = 0; p < PROF_Phases; p++)
+		row(std::string("total ") + phase_name((profile_phase) p),
+			phase_total((profile_phase) p));
+
+	row("total", total());
+
+	os.flags(flags);
+	os.precision(precision);
+}
+
+/**
+ * @return the profiler installed by the calling thread, or null if profiling
+ * is disabled.
+ */
+Profiler *Profiler::current()
+{
+	return installed();
+}
+
+/**
+ * @brief Sets the function which returns the number of bytes allocated by the
+ * calling thread (null to stop measuring allocations).
+ */
+void Profiler::set_allocation_counter(AllocationCounter ctr)
+{
+	counter().store(ctr);
+}
+
+size_t Profiler::allocated()
+{
+	AllocationCounter ctr = counter().load(std::memory_order_relaxed);
+
+	return ctr ? ctr() : 0;
+}
+
+const char *Profiler::phase_name(profile_phase phase)
+{
+	static const char *names[] = {
+		"forward",
+		"activation",
+		"backward",
+		"gradient",
+		"optimizer"
+	};
+
+	return names[phase];
+}
+
+Profiler::Scope::Scope(Profiler &profiler) : _previous(installed())
+{
+	installed() = &profiler;
+}
+
+Profiler::Scope::~Scope()
+{
+	installed() = _previous;
+}
+
+}
+
+}
@@ -150,4 +150,155 @@ TEST(act_sigmoid)
 					0.119202922022}
 			}
 		});
-}
\ No newline at end of file
+}
+
+TEST(act_tanh)
+{
+	return act_general(oss,
+		"tanh",
+		{
+			new Tanh <double> ()
+		},
+		{
+			Vector <double> {0.5, 2, 0, 4},
+			Vector <double> {1, -1, 3, -2}
+		},
+		{
+			{
+				Vector <double> {
+					0.46211715726,
+					0.964027580076,
+					0,
+					0.999329299739},
+				Vector <double> {
+					0.761594155956,
+					-0.761594155956,
+					0.995054753687,
+					-0.964027580076}
+			}
+		});
+}
+
+// Largest difference between the batched (vectorized) activation and the
+// activation of each row, relative to the largest component of the row (or to
+// each component if relative is set)
+template <class T>
+static T batch_difference(Activation <T> *act, const Matrix <T> &X,
+		bool relative = false)
+{
+	Matrix <T> out = act->batch_compute(X);
+
+	T diff = 0;
+	for (size_t i = 0; i < X.get_rows(); i++) {
+		Vector <T> row(X.get_cols(), const_cast <T *> (X[i]));
+		Vector <T> y = act->compute(row);
+
+		T scale = 1;
+		for (size_t j = 0; j < y.size(); j++)
+			scale = std::max(scale, T(fabs(y[j])));
+
+		for (size_t j = 0; j < y.size(); j++) {
+			T s = scale;
+			if (relative && y[j] != 0)
+				s = T(fabs(y[j]));
+
+			diff = std::max(diff, T(fabs(out[i][j] - y[j]))/s);
+		}
+	}
+
+	return diff;
+}
+
+// Whether the batched activation of each component is the same for every
+// number of columns (so wherever the component falls in the packs)
+template <class T>
+static bool batch_width_independent(Activation <T> *act, const Matrix <T> &X)
+{
+	Matrix <T> full = act->batch_compute(X);
+
+	for (size_t w = 1; w < X.get_cols(); w++) {
+		Matrix <T> part(X.get_rows(), w,
+			[&](size_t i, size_t j) {
+				return X[i][j];
+			}
+		);
+
+		Matrix <T> out = act->batch_compute(part);
+		for (size_t i = 0; i < X.get_rows(); i++) {
+			for (size_t j = 0; j < w; j++) {
+				if (out[i][j] != full[i][j])
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+template <class T>
+static bool act_batched_general(ostringstream &oss, T epsilon, T relative)
+{
+	static const char *names[] = {
+		"relu", "sigmoid", "tanh", "softmax"
+	};
+
+	Activation <T> *acts[] = {
+		new ReLU <T> (),
+		new Sigmoid <T> (),
+		new Tanh <T> (),
+		new Softmax <T> ()
+	};
+
+	// Odd number of columns for the partial packs, and large inputs for the
+	// saturation of the exponential
+	Matrix <T> X(9, 13,
+		[&](size_t i, size_t j) {
+			return T(sin(double(i * 13 + j)) * ((i % 3) ? 5 : 1000));
+		}
+	);
+
+	// Inputs from 1e-7 to 1 in magnitude, on which the errors are measured
+	// relative to each component
+	Matrix <T> S(9, 13,
+		[&](size_t i, size_t j) {
+			return T(sin(double(i * 13 + j)) * pow(10.0, -double(i % 8)));
+		}
+	);
+
+	bool pass = true;
+	for (size_t k = 0; k < 4; k++) {
+		Activation <T> *dact = acts[k]->derivative();
+
+		T diff = batch_difference(acts[k], X);
+		T ddiff = batch_difference(dact, X);
+		T sdiff = batch_difference(acts[k], S, true);
+
+		oss << "Difference for " << names[k] << ": " << diff
+			<< " (derivative: " << ddiff << ", relative on small"
+			<< " inputs: " << sdiff << ")" << endl;
+
+		pass &= (diff <= epsilon && ddiff <= epsilon && sdiff <= relative);
+
+		// Softmax depends on the whole row
+		if (k < 3 && !(batch_width_independent(acts[k], X)
+				&& batch_width_independent(dact, X))) {
+			oss << "Batched " << names[k] << " depends on the number"
+				<< " of columns." << endl;
+
+			pass = false;
+		}
+
+		delete dact;
+		delete acts[k];
+	}
+
+	return pass;
+}
+
+TEST(act_batched)
+{
+	bool dpass = act_batched_general <double> (oss, 1e-15, 1e-15);
+	bool fpass = act_batched_general <float> (oss, 1e-6, 1e-6);
+
+	return dpass && fpass;
+}
@@ -0,0 +1,322 @@
+#include "port.hpp"
+
+#include <random>
+
+#include "../../engine/std/filters.hpp"
+
+// Image of size rows x cols x channels with varied bytes
+static vector <unsigned char> conv_image(size_t rows, size_t cols, size_t channels)
+{
+	vector <unsigned char> img(rows * cols * channels);
+	for (size_t i = 0; i < img.size(); i++)
+		img[i] = (i * 37 + (i >> 5) * 11) % 256;
+
+	return img;
+}
+
+template <class T>
+static bool conv_matches(const zhetapi::blas::ConvShape &s, size_t nfilters,
+		size_t threads, ostringstream &oss)
+{
+	using namespace zhetapi;
+
+	vector <unsigned char> img = conv_image(s.rows, s.cols, s.channels);
+
+	// Arbitrary (non-dyadic) weights, so that any change in the order of the
+	// sums shows up in the outputs
+	std::mt19937 gen(11);
+	std::uniform_real_distribution <double> dist(-1, 1);
+
+	vector <T> flt(nfilters * s.krows * s.kcols);
+	for (size_t i = 0; i < flt.size(); i++)
+		flt[i] = T(dist(gen));
+
+	size_t n = nfilters * s.orows * s.ocols * s.depth;
+
+	vector <T> ref(n);
+	vector <T> out(n, T(-1));
+
+	blas::conv2d_scalar(s, img.data(), flt.data(), nfilters, ref.data());
+
+	// The result does not depend on the number of threads (nor on whether
+	// the pool was free to run the blocks in parallel)
+	blas::conv2d(s, img.data(), flt.data(), nfilters, out.data(), threads);
+
+	if (ref != out) {
+		oss << "Convolution of " << s.rows << " x " << s.cols
+			<< " image (stride " << s.stride << ", " << nfilters
+			<< " filters, " << threads << " threads) differs from"
+			<< " the reference." << endl;
+
+		return false;
+	}
+
+	return true;
+}
+
+TEST(conv_kernels)
+{
+	using namespace zhetapi;
+
+	// Same padding, as used by ml::Convolution
+	blas::ConvShape s;
+
+	s.rows = s.cols = 48;
+	s.channels = 4;
+	s.depth = 3;
+	s.krows = s.kcols = 5;
+	s.pad_rows = s.pad_cols = 2;
+	s.pad_rows_after = s.pad_cols_after = 2;
+	s.orows = blas::conv_output(s.rows, 5, 1, 2, 2);
+	s.ocols = blas::conv_output(s.cols, 5, 1, 2, 2);
+
+	if (s.orows != 48 || s.ocols != 48) {
+		oss << "Wrong size of the output with same padding." << endl;
+
+		return false;
+	}
+
+	if (!conv_matches <double> (s, 1, 1, oss)
+			|| !conv_matches <float> (s, 1, 4, oss))
+		return false;
+
+	// Rectangular image, stride, padding and several filters
+	s.rows = 37;
+	s.cols = 50;
+	s.channels = 3;
+	s.krows = 3;
+	s.kcols = 4;
+	s.stride = 2;
+	s.pad_rows = 1;
+	s.pad_cols = 0;
+	s.pad_rows_after = 2;
+	s.pad_cols_after = 1;
+	s.orows = blas::conv_output(s.rows, s.krows, s.stride, 1, 2);
+	s.ocols = blas::conv_output(s.cols, s.kcols, s.stride, 0, 1);
+
+	if (s.orows != 19 || s.ocols != 24) {
+		oss << "Wrong size of the strided output." << endl;
+
+		return false;
+	}
+
+	if (!conv_matches <double> (s, 3, 1, oss)
+			|| !conv_matches <double> (s, 3, 4, oss)
+			|| !conv_matches <float> (s, 2, 3, oss))
+		return false;
+
+	// Benchmark: 4 filters of size 5 x 5 on a 256 x 256 RGBA image (only
+	// with --bench)
+	if (benchmarks) {
+		s.rows = s.cols = 256;
+		s.channels = 4;
+		s.depth = 3;
+		s.krows = s.kcols = 5;
+		s.stride = 1;
+		s.pad_rows = s.pad_cols = 2;
+		s.pad_rows_after = s.pad_cols_after = 2;
+		s.orows = s.ocols = 256;
+
+		vector <unsigned char> img = conv_image(s.rows, s.cols, s.channels);
+		vector <float> flt(4 * 25, 0.04f);
+		vector <float> out(4 * s.orows * s.ocols * s.depth);
+
+		tpoint start = clk.now();
+		blas::conv2d_scalar(s, img.data(), flt.data(), 4, out.data());
+		double scalar = chrono::duration <double> (clk.now() - start).count();
+
+		start = clk.now();
+		blas::conv2d(s, img.data(), flt.data(), 4, out.data());
+		double lowered = chrono::duration <double> (clk.now() - start).count();
+
+		oss << "Scalar convolution: " << scalar * 1e3 << " ms" << endl;
+		oss << "Lowered convolution: " << lowered * 1e3 << " ms ("
+			<< parallel::get_threads() << " threads, "
+			<< scalar/lowered << "x)" << endl;
+	}
+
+	return true;
+}
+
+// Byte at row r, column c and channel ch of the convolution of an image with a
+// filter, with the given stride and padding before the first row and column
+static unsigned char conv_pixel(const zhetapi::image::Image &in,
+		const zhetapi::Matrix <double> &k, size_t r, size_t c, size_t ch,
+		size_t stride, size_t pr, size_t pc)
+{
+	const unsigned char *data = in.raw();
+
+	// Each row of the filter is summed before it is added to the total, as
+	// in blas::conv2d_scalar
+	double total = 0;
+	for (size_t kr = 0; kr < k.get_rows(); kr++) {
+		long ir = long(r * stride + kr) - long(pr);
+		if (ir < 0 || ir >= long(in.height()))
+			continue;
+
+		double sum = 0;
+		for (size_t kc = 0; kc < k.get_cols(); kc++) {
+			long ic = long(c * stride + kc) - long(pc);
+			if (ic < 0 || ic >= long(in.width()))
+				continue;
+
+			sum += k[kr][kc] * data[(ir * in.width() + ic)
+				* in.channels() + ch];
+		}
+
+		total += sum;
+	}
+
+	return std::min(std::max(total, 0.0), 255.0);
+}
+
+// Compares every pixel of out with the reference, and the alpha channel with
+// the input pixel at the position times the stride
+static bool conv_filter_matches(const zhetapi::image::Image &in,
+		const zhetapi::image::Image &out,
+		const zhetapi::Matrix <double> &k, size_t stride, size_t pr,
+		size_t pc, ostringstream &oss)
+{
+	const unsigned char *idata = in.raw();
+	const unsigned char *odata = out.raw();
+
+	for (size_t r = 0; r < out.height(); r++) {
+		for (size_t c = 0; c < out.width(); c++) {
+			const unsigned char *px = &odata[(r * out.width() + c) * 4];
+
+			for (size_t ch = 0; ch < 3; ch++) {
+				unsigned char ref = conv_pixel(in, k, r, c, ch,
+						stride, pr, pc);
+
+				if (px[ch] != ref) {
+					oss << "Pixel (" << r << ", " << c << ") channel "
+						<< ch << " is " << int(px[ch]) << " instead of "
+						<< int(ref) << "." << endl;
+
+					return false;
+				}
+			}
+
+			size_t ir = std::min(r * stride, in.height() - 1);
+			size_t ic = std::min(c * stride, in.width() - 1);
+
+			if (px[3] != idata[(ir * in.width() + ic) * 4 + 3]) {
+				oss << "Alpha of pixel (" << r << ", " << c
+					<< ") was not copied from the input." << endl;
+
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+TEST(conv_filter)
+{
+	using namespace zhetapi;
+
+	// Non-square RGBA image (7 rows of 10 pixels)
+	vector <unsigned char> bytes = conv_image(7, 10, 4);
+
+	image::Image in(bytes.data(), 10, 7, 4);
+
+	// Non-dyadic weights (whose sums are rounded), with negative ones (for
+	// the clamping at 0) and large ones (for the clamping at 255)
+	Matrix <double> k3(3, 3,
+		[](size_t i, size_t j) {
+			return double(int((i * 3 + j) * 7 % 9) - 3)/7;
+		}
+	);
+
+	Matrix <double> k4(4, 4,
+		[](size_t i, size_t j) {
+			return double(int((i * 4 + j) * 5 % 11) - 4)/3;
+		}
+	);
+
+	// Same padding: 1 before and 1 after for the 3 x 3 filter
+	ml::Convolution <double> same(k3);
+
+	image::Image out = same.process(in);
+
+	if (out.width() != 10 || out.height() != 7 || out.channels() != 4) {
+		oss << "Same padding changed the size of the image." << endl;
+
+		return false;
+	}
+
+	if (!conv_filter_matches(in, out, k3, 1, 1, 1, oss))
+		return false;
+
+	// Even filter: 1 before and 2 after
+	ml::Convolution <double> even(k4);
+
+	out = even.process(in);
+
+	if (out.width() != 10 || out.height() != 7) {
+		oss << "Same padding changed the size of the image (even"
+			<< " filter)." << endl;
+
+		return false;
+	}
+
+	if (!conv_filter_matches(in, out, k4, 1, 1, 1, oss))
+		return false;
+
+	// Several filters, with a stride and explicit padding
+	vector <Matrix <double>> filters {k3, k3 * 2.0};
+
+	ml::Convolution <double> strided(filters, 2, 1);
+
+	vector <image::Image> outs = strided.process_all(in);
+
+	if (outs.size() != 2) {
+		oss << "Expected one image per filter." << endl;
+
+		return false;
+	}
+
+	for (size_t f = 0; f < 2; f++) {
+		if (outs[f].width() != 5 || outs[f].height() != 4) {
+			oss << "Wrong size of the strided output: "
+				<< outs[f].width() << " x " << outs[f].height()
+				<< endl;
+
+			return false;
+		}
+
+		if (!conv_filter_matches(in, outs[f], k3 * double(f + 1), 2, 1, 1, oss))
+			return false;
+	}
+
+	// Grayscale image of width 4 and height 2, with a horizontal filter:
+	// each pixel plus ten times its right neighbour
+	unsigned char gray[] {
+		1, 2, 3, 4,
+		5, 6, 7, 8
+	};
+
+	ml::Convolution <double> right(Matrix <double> (1, 2,
+		[](size_t i, size_t j) {
+			return j ? 10.0 : 1.0;
+		}
+	));
+
+	out = right.process(image::Image(gray, 4, 2));
+
+	unsigned char expected[] {
+		21, 32, 43, 4,
+		65, 76, 87, 8
+	};
+
+	if (out.width() != 4 || out.height() != 2 || out.channels() != 1
+			|| !std::equal(expected, expected + 8, out.raw())) {
+		oss << "Horizontal filter not applied along the rows of a"
+			<< " non-square image." << endl;
+
+		return false;
+	}
+
+	return true;
+}
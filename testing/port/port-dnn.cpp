@@ -0,0 +1,1387 @@
+#include "port.hpp"
+
+#include <cstdio>
+#include <random>
+
+#include "../../engine/checkpoint.hpp"
+#include "../../engine/data_parallel.hpp"
+#include "../../engine/profiler.hpp"
+#include "../../engine/training.hpp"
+#include "../../engine/std/optimizers.hpp"
+
+using namespace zhetapi;
+using namespace zhetapi::ml;
+
+// Copies the weights of one network into another of a different precision
+template <class T, class U>
+static void copy_weights(DNN <T> &dst, DNN <U> &src)
+{
+	for (size_t i = 0; i < src.size(); i++)
+		dst.layers()[i].mat() = Matrix <T> (src.layers()[i].mat());
+}
+
+// Trains a network on a fixed set of batches, accumulating gradients in A
+template <class T, class A>
+static Vector <T> train_network(DNN <T> &model, size_t epochs)
+{
+	DataSet <T> ins;
+	DataSet <T> outs;
+
+	for (size_t i = 0; i < 64; i++) {
+		ins.push_back(Vector <T> (8,
+			[&](size_t j) {
+				return T((i * 5 + j * 3) % 17) / T(17);
+			}
+		));
+
+		outs.push_back(Vector <T> (4,
+			[&](size_t j) {
+				return T(i % 4 == j);
+			}
+		));
+	}
+
+	Erf <T> *erf = new MSE <T> ();
+	Optimizer <T> *opt = new SGD <T> (0.5);
+
+	for (size_t i = 0; i < epochs; i++)
+		train_dataset_perf <T, A> (model, ins, outs, 16, erf, opt);
+
+	delete erf;
+	delete opt;
+
+	return model(ins[5]);
+}
+
+// Duration of forward passes in each precision (only measured with --bench)
+static void time_precisions(ostringstream &oss)
+{
+	const size_t iters = 200;
+
+	DNN <double> dlarge(512, {
+		Layer <double> (512, new ReLU <double> ()),
+		Layer <double> (512, new ReLU <double> ())
+	});
+
+	DNN <float> flarge(512, {
+		Layer <float> (512, new ReLU <float> ()),
+		Layer <float> (512, new ReLU <float> ())
+	});
+
+	Vector <double> din(512, 0.5);
+	Vector <float> fin(512, 0.5f);
+
+	tpoint start = clk.now();
+	for (size_t i = 0; i < iters; i++)
+		din = dlarge(din) / 512.0;
+	double tdouble = chrono::duration <double> (clk.now() - start).count();
+
+	start = clk.now();
+	for (size_t i = 0; i < iters; i++)
+		fin = flarge(fin) / 512.0f;
+	double tfloat = chrono::duration <double> (clk.now() - start).count();
+
+	oss << "Double forward passes: " << tdouble * 1e3 << " ms" << endl;
+	oss << "Float forward passes: " << tfloat * 1e3 << " ms" << endl;
+}
+
+TEST(dnn_precision)
+{
+	DNN <double> dmodel(8, {
+		Layer <double> (16, new Sigmoid <double> ()),
+		Layer <double> (16, new ReLU <double> ()),
+		Layer <double> (4, new Softmax <double> ())
+	});
+
+	DNN <float> fmodel(8, {
+		Layer <float> (16, new Sigmoid <float> ()),
+		Layer <float> (16, new ReLU <float> ()),
+		Layer <float> (4, new Softmax <float> ())
+	});
+
+	DNN <float> mmodel = fmodel;
+
+	copy_weights(fmodel, dmodel);
+	copy_weights(mmodel, dmodel);
+
+	Vector <double> dout = train_network <double, double> (dmodel, 20);
+	Vector <float> fout = train_network <float, float> (fmodel, 20);
+	Vector <float> mout = train_network <float, double> (mmodel, 20);
+
+	double ferr = (Vector <double> (fout) - dout).norm();
+	double merr = (Vector <double> (mout) - dout).norm();
+
+	oss << "Double: " << dout << endl;
+	oss << "Float: " << fout << " (error " << ferr << ")" << endl;
+	oss << "Mixed: " << mout << " (error " << merr << ")" << endl;
+
+	if (ferr > 1e-3 || merr > 1e-3) {
+		oss << "Reduced precision training diverged from double." << endl;
+
+		return false;
+	}
+
+	// Saving and loading a float network
+	const char *file = "zhp_dnn_precision.bin";
+
+	fmodel.save(file);
+
+	DNN <float> loaded;
+	loaded.load(file);
+
+	remove(file);
+
+	Vector <float> in(8, 0.25f);
+	if (loaded(in) != fmodel(in)) {
+		oss << "Loaded network differs from the saved network." << endl;
+
+		return false;
+	}
+
+	// Training must work on a loaded network
+	train_network <float, double> (loaded, 1);
+
+	if (benchmarks)
+		time_precisions(oss);
+
+	return true;
+}
+
+TEST(dnn_batched)
+{
+	DNN <double> model(12, {
+		Layer <double> (16, new Sigmoid <double> ()),
+		Layer <double> (8, new ReLU <double> ()),
+		Layer <double> (5, new Softmax <double> ())
+	});
+
+	DataSet <double> ins;
+	DataSet <double> outs;
+
+	for (size_t i = 0; i < 37; i++) {
+		ins.push_back(Vector <double> (12,
+			[&](size_t j) {
+				return sin(double(i * 12 + j));
+			}
+		));
+
+		outs.push_back(Vector <double> (5,
+			[&](size_t j) {
+				return double(i % 5 == j);
+			}
+		));
+	}
+
+	// Inference
+	Matrix <double> batch = model.compute(to_matrix(ins));
+	for (size_t i = 0; i < ins.size(); i++) {
+		Vector <double> out = model(ins[i]);
+
+		for (size_t j = 0; j < out.size(); j++) {
+			if (fabs(batch[i][j] - out[j]) > 1e-12) {
+				oss << "Batched output differs for sample " << i << "." << endl;
+
+				return false;
+			}
+		}
+	}
+
+	// Gradients
+	Erf <double> *erf = new MSE <double> ();
+
+	Matrix <double> *J1 = simple_batch_gradient(model.layers(), model.size(),
+			model.acache(), model.zcache(), ins, outs, erf);
+	Matrix <double> *J2 = batch_gradient(model.layers(), model.size(),
+			model.Acache(), model.Zcache(), to_matrix(ins),
+			to_matrix(outs), erf);
+
+	bool same = true;
+	for (size_t i = 0; i < model.size(); i++) {
+		double diff = max_difference(J1[i], J2[i]);
+
+		oss << "Gradient difference for layer " << i << ": " << diff << endl;
+		if (J1[i].get_dimensions() != J2[i].get_dimensions() || diff > 1e-12)
+			same = false;
+	}
+
+	delete[] J1;
+	delete[] J2;
+
+	if (!same) {
+		oss << "Batched gradient differs from the per-sample gradient." << endl;
+
+		return false;
+	}
+
+	// The same agreement on a larger network, whose throughputs are only
+	// printed with --bench
+	const size_t samples = 128;
+
+	DNN <double> large(784, {
+		Layer <double> (128, new Sigmoid <double> ()),
+		Layer <double> (10, new Softmax <double> ())
+	});
+
+	DataSet <double> lins;
+	DataSet <double> louts;
+
+	for (size_t i = 0; i < samples; i++) {
+		lins.push_back(Vector <double> (784, double(i % 7) / 7.0));
+		louts.push_back(Vector <double> (10, double(i % 2)));
+	}
+
+	tpoint start = clk.now();
+	J1 = simple_batch_gradient(large.layers(), large.size(),
+			large.acache(), large.zcache(), lins, louts, erf);
+	double tsimple = chrono::duration <double> (clk.now() - start).count();
+
+	start = clk.now();
+	J2 = batch_gradient(large.layers(), large.size(),
+			large.Acache(), large.Zcache(), to_matrix(lins),
+			to_matrix(louts), erf);
+	double tbatch = chrono::duration <double> (clk.now() - start).count();
+
+	if (benchmarks) {
+		oss << "Per-sample gradient (" << samples << " samples): "
+			<< samples / tsimple << " samples/s" << endl;
+		oss << "Batched gradient (" << samples << " samples): "
+			<< samples / tbatch << " samples/s" << endl;
+	}
+
+	same = true;
+	for (size_t i = 0; i < large.size(); i++)
+		same &= (max_difference(J1[i], J2[i]) < 1e-10);
+
+	delete[] J1;
+	delete[] J2;
+	delete erf;
+
+	return same;
+}
+
+// Throughput of an epoch of training with each number of threads (only
+// measured with --bench)
+static void time_threaded_training(ostringstream &oss, Erf <double> *erf)
+{
+	const size_t samples = 512;
+
+	DataSet <double> lins;
+	DataSet <double> louts;
+
+	for (size_t i = 0; i < samples; i++) {
+		lins.push_back(Vector <double> (256, double(i % 7) / 7.0));
+		louts.push_back(Vector <double> (10, double(i % 2)));
+	}
+
+	Optimizer <double> *opt = new SGD <double> (0.01);
+
+	for (size_t threads : {1, 2, 4}) {
+		DNN <double> large(256, {
+			Layer <double> (128, new Sigmoid <double> ()),
+			Layer <double> (10, new Softmax <double> ())
+		});
+
+		ThreadPool tpool(threads);
+
+		tpoint start = clk.now();
+		train_dataset_perf(large, lins, louts, 128, erf, opt, 0, tpool);
+		double t = chrono::duration <double> (clk.now() - start).count();
+
+		oss << "Training with " << threads << " thread(s): "
+			<< samples / t << " samples/s" << endl;
+	}
+
+	delete opt;
+}
+
+TEST(dnn_multithreaded)
+{
+	DNN <double> dmodel(10, {
+		Layer <double> (12, new Sigmoid <double> ()),
+		Layer <double> (6, new Softmax <double> ())
+	});
+
+	DNN <float> fmodel(10, {
+		Layer <float> (12, new Sigmoid <float> ()),
+		Layer <float> (6, new Softmax <float> ())
+	});
+
+	copy_weights(fmodel, dmodel);
+
+	DataSet <double> dins;
+	DataSet <double> douts;
+
+	for (size_t i = 0; i < 29; i++) {
+		dins.push_back(Vector <double> (10,
+			[&](size_t j) {
+				return cos(double(i * 10 + j));
+			}
+		));
+
+		douts.push_back(Vector <double> (6,
+			[&](size_t j) {
+				return double(i % 6 == j);
+			}
+		));
+	}
+
+	DataSet <float> fins(dins.begin(), dins.end());
+	DataSet <float> fouts(douts.begin(), douts.end());
+
+	Erf <double> *derf = new MSE <double> ();
+	Erf <float> *ferf = new MSE <float> ();
+
+	ThreadPool pool(4);
+
+	// Chunked gradients must match the serial gradient, also when there
+	// are fewer samples than threads
+	for (size_t n : {29, 3}) {
+		DataSet <double> ins(dins.begin(), dins.begin() + n);
+		DataSet <double> outs(douts.begin(), douts.begin() + n);
+
+		Matrix <double> *J1 = simple_batch_gradient(dmodel.layers(),
+				dmodel.size(), dmodel.acache(), dmodel.zcache(),
+				ins, outs, derf);
+		Matrix <double> *J2 = simple_multithreaded_batch_gradient(
+				dmodel.layers(), dmodel.size(), ins, outs, derf, pool);
+
+		DataSet <float> mins(fins.begin(), fins.begin() + n);
+		DataSet <float> mouts(fouts.begin(), fouts.begin() + n);
+
+		Matrix <float> *J3 = simple_batch_gradient <float, double> (
+				fmodel.layers(), fmodel.size(),
+				fmodel.acache(), fmodel.zcache(),
+				mins, mouts, ferf);
+		Matrix <float> *J4 = simple_multithreaded_batch_gradient <float, double> (
+				fmodel.layers(), fmodel.size(), mins, mouts, ferf, pool);
+
+		bool same = true;
+		for (size_t i = 0; i < dmodel.size(); i++) {
+			double ddiff = max_difference(J1[i], J2[i]);
+			float mdiff = max_difference(J3[i], J4[i]);
+
+			oss << "Gradient difference for layer " << i << " (" << n
+				<< " samples): " << ddiff << " (double), "
+				<< mdiff << " (mixed)" << endl;
+
+			if (ddiff > 1e-12 || mdiff > 1e-6)
+				same = false;
+		}
+
+		delete[] J1;
+		delete[] J2;
+		delete[] J3;
+		delete[] J4;
+
+		if (!same) {
+			oss << "Multithreaded gradient differs from the serial gradient." << endl;
+
+			return false;
+		}
+	}
+
+	// The overloads which take a number of threads share the pool of the
+	// calling thread instead of creating threads on each call
+	ThreadPool &local = ThreadPool::local(4);
+	if (local.size() != 4 || &ThreadPool::local(4) != &local
+			|| &ThreadPool::local(2) == &local
+			|| &ThreadPool::local(4) != &local) {
+		oss << "Pool of the calling thread not reused." << endl;
+
+		return false;
+	}
+
+	delete ferf;
+
+	if (benchmarks)
+		time_threaded_training(oss, derf);
+
+	delete derf;
+
+	return true;
+}
+
+// Reference update of a single component, with the formulas of the original
+// (unfused) optimizers; m and s are the state of the optimizer
+static double reference_update(int kind, double g, double &m, double &s, size_t iter)
+{
+	const double eta = 0.01;
+	const double mu = 0.9;
+	const double beta = 0.9;
+	const double beta1 = 0.9;
+	const double beta2 = 0.999;
+	const double eps = 1e-10;
+
+	switch (kind) {
+	case 0:
+		return -eta * g;
+	case 1:
+		m = mu * m - eta * g;
+		return m;
+	case 2:
+		m = mu * m - eta * g;
+		return mu * m - eta * g;
+	case 3:
+		s = s + g * g;
+		return (-eta * g) / pow(s + eps, 0.5);
+	case 4:
+		s = beta * s + (1 - beta) * g * g;
+		return (-eta * g) / pow(s + eps, 0.5);
+	case 5:
+		m = beta1 * m - (1 - beta1) * g;
+		s = beta2 * s + (1 - beta2) * g * g;
+		return (eta * (m / (1 - pow(beta1, iter))))
+			/ pow(s / (1 - pow(beta2, iter)) + eps, 0.5);
+	}
+
+	return 0;
+}
+
+static Optimizer <double> *make_optimizer(int kind)
+{
+	switch (kind) {
+	case 0:
+		return new SGD <double> (0.01);
+	case 1:
+		return new Momentum <double> (0.01, 0.9);
+	case 2:
+		return new Nesterov <double> (0.01, 0.9);
+	case 3:
+		return new AdaGrad <double> (0.01);
+	case 4:
+		return new RMSProp <double> (0.01, 0.9);
+	case 5:
+		return new Adam <double> (0.01, 0.9, 0.999);
+	}
+
+	return nullptr;
+}
+
+TEST(optimizer_fused)
+{
+	static const char *names[] = {
+		"SGD", "Momentum", "Nesterov", "AdaGrad", "RMSProp", "Adam"
+	};
+
+	// Odd sizes, so that the kernels also go through their scalar tails
+	DNN <double> model(6, {
+		Layer <double> (7, new Sigmoid <double> ()),
+		Layer <double> (5, new ReLU <double> ()),
+		Layer <double> (3, new Linear <double> ())
+	});
+
+	size_t size = model.size();
+
+	for (int kind = 0; kind < 6; kind++) {
+		Optimizer <double> *uopt = make_optimizer(kind);
+		Optimizer <double> *sopt = make_optimizer(kind);
+
+		DNN <double> stepped(6, {
+			Layer <double> (7, new Sigmoid <double> ()),
+			Layer <double> (5, new ReLU <double> ()),
+			Layer <double> (3, new Linear <double> ())
+		});
+
+		copy_weights(stepped, model);
+
+		// Reference parameters and state
+		Matrix <double> *W = new Matrix <double> [size];
+		Matrix <double> *M = new Matrix <double> [size];
+		Matrix <double> *S = new Matrix <double> [size];
+
+		for (size_t i = 0; i < size; i++) {
+			W[i] = model.layers()[i].mat();
+			M[i] = Matrix <double> (W[i].get_rows(), W[i].get_cols(), 0.0);
+			S[i] = M[i];
+		}
+
+		double err = 0;
+		for (size_t iter = 1; iter <= 4; iter++) {
+			Matrix <double> *Ju = new Matrix <double> [size];
+			Matrix <double> *Js = new Matrix <double> [size];
+
+			for (size_t i = 0; i < size; i++) {
+				Ju[i] = Matrix <double> (W[i].get_rows(), W[i].get_cols(),
+					[&](size_t r, size_t c) {
+						return sin(double(iter * 97 + i * 31 + r * 7 + c));
+					}
+				);
+
+				Js[i] = Ju[i];
+			}
+
+			uopt->update(Ju, size);
+			sopt->step(stepped.layers(), Js, size);
+
+			for (size_t i = 0; i < size; i++) {
+				for (size_t r = 0; r < W[i].get_rows(); r++) {
+					for (size_t c = 0; c < W[i].get_cols(); c++) {
+						double g = sin(double(iter * 97 + i * 31 + r * 7 + c));
+						double u = reference_update(kind, g,
+								M[i][r][c], S[i][r][c], iter);
+
+						W[i][r][c] += u;
+
+						double w = stepped.layers()[i].mat()[r][c];
+
+						err = std::max(err, fabs(Ju[i][r][c] - u)
+								/ std::max(fabs(u), 1e-300));
+						err = std::max(err, fabs(w - W[i][r][c])
+								/ std::max(fabs(W[i][r][c]), 1.0));
+					}
+				}
+			}
+
+			delete[] Ju;
+			delete[] Js;
+		}
+
+		oss << "Relative error of " << names[kind] << ": " << err << endl;
+
+		delete uopt;
+		delete sopt;
+
+		delete[] W;
+		delete[] M;
+		delete[] S;
+
+		if (err > 1e-12)
+			return false;
+	}
+
+	return true;
+}
+
+TEST(dnn_concurrent_inference)
+{
+	DNN <double> model(9, {
+		Layer <double> (14, new Sigmoid <double> ()),
+		Layer <double> (7, new ReLU <double> ()),
+		Layer <double> (4, new Softmax <double> ())
+	});
+
+	const size_t samples = 40;
+
+	DataSet <double> ins;
+	for (size_t i = 0; i < samples; i++) {
+		ins.push_back(Vector <double> (9,
+			[&](size_t j) {
+				return sin(double(i * 9 + j));
+			}
+		));
+	}
+
+	Matrix <double> batch = to_matrix(ins);
+	Matrix <double> expected = model.compute(batch);
+
+	// A single (const) network shared by all threads
+	const DNN <double> &shared = model;
+
+	const size_t threads = 4;
+
+	std::vector <std::thread> pool;
+	std::vector <double> errors(threads, 0);
+
+	for (size_t t = 0; t < threads; t++) {
+		pool.emplace_back(
+			[&, t]() {
+				InferenceScratch <double> scratch;
+
+				double err = 0;
+				for (size_t k = 0; k < 50; k++) {
+					// Alternate the entry points
+					const Matrix <double> &out = (k % 2)
+						? shared.infer(batch, scratch)
+						: shared.infer(batch);
+
+					err = std::max(err, max_difference(out, expected));
+
+					size_t i = (k * threads + t) % samples;
+
+					Vector <double> v = (k % 2)
+						? shared.infer(ins[i], scratch)
+						: shared.infer(ins[i]);
+
+					for (size_t j = 0; j < v.size(); j++)
+						err = std::max(err, fabs(v[j] - expected[i][j]));
+				}
+
+				errors[t] = err;
+			}
+		);
+	}
+
+	for (std::thread &thread : pool)
+		thread.join();
+
+	bool same = true;
+	for (size_t t = 0; t < threads; t++) {
+		oss << "Maximum difference on thread " << t << ": " << errors[t] << endl;
+
+		same &= (errors[t] < 1e-12);
+	}
+
+	return same;
+}
+
+TEST(dnn_softmax_cross_entropy)
+{
+	DNN <double> model(5, {
+		Layer <double> (8, new Sigmoid <double> ()),
+		Layer <double> (4, new Softmax <double> ())
+	});
+
+	DataSet <double> ins;
+	DataSet <double> outs;
+
+	for (size_t i = 0; i < 6; i++) {
+		ins.push_back(Vector <double> (5,
+			[&](size_t j) {
+				return sin(double(i * 5 + j));
+			}
+		));
+
+		outs.push_back(Vector <double> (4,
+			[&](size_t j) {
+				return double(i % 4 == j);
+			}
+		));
+	}
+
+	Erf <double> *erf = new CrossEntropy <double> ();
+
+	Matrix <double> X = to_matrix(ins);
+	Matrix <double> Y = to_matrix(outs);
+
+	// Fused gradient
+	Matrix <double> *J = batch_gradient(model.layers(), model.size(),
+			model.Acache(), model.Zcache(), X, Y, erf);
+
+	// Average loss over the batch
+	auto loss = [&]() {
+		Matrix <double> P = model.compute(X);
+
+		double sum = 0;
+		for (size_t i = 0; i < ins.size(); i++)
+			sum += erf->compute(outs[i], Vector <double> (P.get_cols(), P[i]))[0];
+
+		return sum / ins.size();
+	};
+
+	// Central differences
+	const double h = 1e-6;
+
+	double err = 0;
+	for (size_t l = 0; l < model.size(); l++) {
+		Matrix <double> &W = model.layers()[l].mat();
+
+		for (size_t r = 0; r < W.get_rows(); r++) {
+			for (size_t c = 0; c < W.get_cols(); c++) {
+				double w = W[r][c];
+
+				W[r][c] = w + h;
+				double fp = loss();
+
+				W[r][c] = w - h;
+				double fm = loss();
+
+				W[r][c] = w;
+
+				double g = (fp - fm) / (2 * h);
+
+				err = std::max(err, fabs(J[l][r][c] - g));
+			}
+		}
+	}
+
+	oss << "Difference with the numerical gradient: " << err << endl;
+
+	// The workspace takes the same path
+	Workspace <double> ws(model, ins.size());
+
+	ws.load(ins, outs);
+
+	Matrix <double> *Jw = workspace_gradient(model.layers(), ws, erf);
+
+	double wdiff = 0;
+	for (size_t l = 0; l < model.size(); l++)
+		wdiff = std::max(wdiff, max_difference(J[l], Jw[l]));
+
+	oss << "Difference with the workspace gradient: " << wdiff << endl;
+
+	// And so does the gradient of one sample at a time (used by fit,
+	// multithreaded_fit and mixed precision)
+	Matrix <double> *Js = simple_batch_gradient(model.layers(), model.size(),
+			model.acache(), model.zcache(), ins, outs, erf);
+
+	double sdiff = 0;
+	for (size_t l = 0; l < model.size(); l++)
+		sdiff = std::max(sdiff, max_difference(J[l], Js[l]));
+
+	oss << "Difference with the per-sample gradient: " << sdiff << endl;
+
+	// The unfused derivative clamps the predictions like the loss, so a
+	// prediction of zero gives a finite derivative
+	Erf <double> *derf = erf->derivative();
+
+	Vector <double> y {0.0, 1.0, 0.0, 0.0};
+	Vector <double> p {0.5, 0.0, 0.5, 0.0};
+
+	Vector <double> dv = derf->compute(y, p);
+
+	Matrix <double> dm;
+	derf->batch_compute(to_matrix(DataSet <double> {y}),
+			to_matrix(DataSet <double> {p}), dm);
+
+	bool finite = true;
+	for (size_t j = 0; j < 4; j++)
+		finite &= (std::isfinite(dv[j]) && dv[j] == dm[0][j]);
+
+	oss << "Finite derivative at a zero prediction: " << finite << endl;
+
+	delete derf;
+
+	delete[] J;
+	delete[] Js;
+	delete erf;
+
+	return err < 1e-8 && wdiff < 1e-12 && sdiff < 1e-12 && finite;
+}
+
+TEST(dnn_packed_dataset)
+{
+	DataSet <double> ins;
+	DataSet <double> outs;
+
+	for (size_t i = 0; i < 50; i++) {
+		ins.push_back(Vector <double> (6,
+			[&](size_t j) {
+				return sin(double(i * 6 + j));
+			}
+		));
+
+		outs.push_back(Vector <double> (3,
+			[&](size_t j) {
+				return double(i % 3 == j);
+			}
+		));
+	}
+
+	PackedDataSet <double> pins(ins);
+	PackedDataSet <double> pouts(outs);
+
+	// Batches are views of the samples
+	DataBatch <double> batch = pins.batch(40, 56);
+	if (batch.size() != 10 || batch[3] != pins.data()[43]) {
+		oss << "Incorrect batch view." << endl;
+
+		return false;
+	}
+
+	// Ranges past the end of the data set give empty batches
+	if (pins.batch(60, 70).size() != 0 || pins.batch(30, 20).size() != 0
+			|| to_matrix(pins.batch(55, 60)).size() != 0) {
+		oss << "Out of range batch is not empty." << endl;
+
+		return false;
+	}
+
+	// Training on the packed data sets must match training on the vectors
+	DNN <double> model(6, {
+		Layer <double> (9, new Sigmoid <double> ()),
+		Layer <double> (3, new Softmax <double> ())
+	});
+
+	DNN <double> packed = model;
+
+	Erf <double> *erf = new MSE <double> ();
+	Optimizer <double> *opt1 = new Adam <double> (0.01);
+	Optimizer <double> *opt2 = new Adam <double> (0.01);
+
+	ThreadPool pool(3);
+
+	PerformanceStatistics <double> s1;
+	PerformanceStatistics <double> s2;
+	for (size_t e = 0; e < 3; e++) {
+		s1 = train_dataset_perf(model, ins, outs, 16, erf, opt1, 0, pool);
+		s2 = train_dataset_perf(packed, pins, pouts, 16, erf, opt2, 0, pool);
+	}
+
+	double diff = 0;
+	for (size_t i = 0; i < model.size(); i++) {
+		diff = std::max(diff, max_difference(model.layers()[i].mat(),
+				packed.layers()[i].mat()));
+	}
+
+	oss << "Difference between the weights: " << diff << endl;
+	oss << "Cost (vectors): " << s1._cost << ", cost (packed): " << s2._cost << endl;
+
+	if (diff > 1e-12 || fabs(s1._cost - s2._cost) > 1e-9)
+		return false;
+
+	// Shuffling keeps the inputs and targets together
+	std::mt19937 gen(17);
+
+	shuffle(pins, pouts, gen);
+
+	bool paired = true;
+	for (size_t i = 0; i < pins.size(); i++) {
+		size_t k = pins.order()[i];
+
+		paired &= (pins[i][0] == ins[k][0] && pouts[i][k % 3] == 1);
+	}
+
+	oss << "Order after shuffling: " << pins.order()[0] << ", "
+		<< pins.order()[1] << ", " << pins.order()[2] << ", ..." << endl;
+
+	// Orders which are not permutations, and samples of different sizes,
+	// are rejected
+	bool rejected = true;
+
+	std::vector <size_t> order = pins.order();
+
+	order[7] = pins.size();
+	try {
+		pouts.reorder(order);
+
+		rejected = false;
+	} catch (const PackedDataSet <double> ::bad_order &) {}
+
+	order[7] = order[8];
+	try {
+		pouts.reorder(order);
+
+		rejected = false;
+	} catch (const PackedDataSet <double> ::bad_order &) {}
+
+	DataSet <double> ragged = ins;
+
+	ragged[20] = Vector <double> (4, 1.0);
+	try {
+		PackedDataSet <double> bad(ragged);
+
+		rejected = false;
+	} catch (const PackedDataSet <double> ::bad_dimensions &) {}
+
+	oss << "Invalid orders and samples rejected: " << rejected << endl;
+
+	delete erf;
+	delete opt1;
+	delete opt2;
+
+	return paired && rejected;
+}
+
+TEST(dnn_prefetcher)
+{
+	PackedDataSet <double> ins(50, 6);
+	PackedDataSet <double> outs(50, 3);
+
+	for (size_t i = 0; i < 50; i++) {
+		for (size_t j = 0; j < 6; j++)
+			ins.data()[i][j] = sin(double(i * 6 + j));
+
+		for (size_t j = 0; j < 3; j++)
+			outs.data()[i][j] = double(i % 3 == j);
+	}
+
+	// Loads the batches of each epoch from the packed data sets, from
+	// several threads at once
+	const size_t epochs = 3;
+	const size_t per_epoch = 4;
+
+	auto loader = [&](size_t k, Prefetcher <double> ::Batch &batch) {
+		size_t start = (k % per_epoch) * 16;
+		size_t end = std::min(start + 16, ins.size());
+
+		to_matrix(ins.batch(start, end), 0, end - start, batch.ins);
+		to_matrix(outs.batch(start, end), 0, end - start, batch.outs);
+	};
+
+	DNN <double> model(6, {
+		Layer <double> (9, new Sigmoid <double> ()),
+		Layer <double> (3, new Softmax <double> ())
+	});
+
+	DNN <double> prefetched = model;
+
+	Erf <double> *erf = new MSE <double> ();
+	Optimizer <double> *opt1 = new Adam <double> (0.01);
+	Optimizer <double> *opt2 = new Adam <double> (0.01);
+
+	ThreadPool pool(3);
+
+	PerformanceStatistics <double> s1;
+	for (size_t e = 0; e < epochs; e++)
+		s1 = train_dataset_perf(model, ins, outs, 16, erf, opt1, 0, pool);
+
+	Prefetcher <double> batches(epochs * per_epoch, loader, 3, 3);
+
+	// Only the cost of the last epoch is compared
+	PerformanceStatistics <double> s2;
+	for (size_t e = 0; e < epochs; e++) {
+		Prefetcher <double> epoch(per_epoch,
+			[&](size_t k, Prefetcher <double> ::Batch &batch) {
+				loader(e * per_epoch + k, batch);
+			}, 2, 2
+		);
+
+		s2 = train_prefetched_perf(prefetched, epoch, erf, opt2, 0, pool);
+	}
+
+	double diff = 0;
+	for (size_t i = 0; i < model.size(); i++) {
+		diff = std::max(diff, max_difference(model.layers()[i].mat(),
+				prefetched.layers()[i].mat()));
+	}
+
+	oss << "Difference between the weights: " << diff << endl;
+	oss << "Cost (packed): " << s1._cost << ", cost (prefetched): " << s2._cost << endl;
+
+	// The batches come in order, whatever the number of loading threads
+	bool ordered = true;
+
+	size_t count = 0;
+	while (const Prefetcher <double> ::Batch *batch = batches.next()) {
+		size_t start = (count % per_epoch) * 16;
+
+		ordered &= (batch->index == count && batch->ins[0][0] == ins[start][0]);
+		count++;
+	}
+
+	oss << "Batches handed out: " << count << endl;
+
+	// Errors of the loader are passed on to the consumer
+	Prefetcher <double> failing(8,
+		[&](size_t k, Prefetcher <double> ::Batch &batch) {
+			if (k == 5)
+				throw std::runtime_error("unreadable batch");
+
+			loader(k, batch);
+		}, 2, 2
+	);
+
+	bool thrown = false;
+	try {
+		while (failing.next());
+	} catch (const std::runtime_error &e) {
+		oss << "Loader error: " << e.what() << endl;
+
+		thrown = true;
+	}
+
+	delete erf;
+	delete opt1;
+	delete opt2;
+
+	return diff < 1e-12 && fabs(s1._cost - s2._cost) < 1e-9
+		&& ordered && count == epochs * per_epoch && thrown;
+}
+
+// Cost which kills the first worker process to compute it
+class LethalMSE : public MSE <double> {
+	std::atomic <int> *	_fired;
+public:
+	explicit LethalMSE(std::atomic <int> *fired) : _fired(fired) {}
+
+	Vector <double> operator()(const Vector <double> &a,
+			const Vector <double> &b) const override {
+		if (!_fired->exchange(1))
+			raise(SIGKILL);
+
+		return MSE <double> ::operator()(a, b);
+	}
+};
+
+TEST(dnn_data_parallel)
+{
+	DataSet <double> ins;
+	DataSet <double> outs;
+
+	for (size_t i = 0; i < 60; i++) {
+		ins.push_back(Vector <double> (8,
+			[&](size_t j) {
+				return sin(double(i * 8 + j));
+			}
+		));
+
+		outs.push_back(Vector <double> (4,
+			[&](size_t j) {
+				return double(i % 4 == j);
+			}
+		));
+	}
+
+	DNN <double> model(8, {
+		Layer <double> (12, new Sigmoid <double> ()),
+		Layer <double> (4, new Softmax <double> ())
+	});
+
+	Erf <double> *erf = new MSE <double> ();
+
+	// Reference: the same batches on a single process
+	auto reference = [&](size_t batch, size_t epochs) {
+		DNN <double> dnn = model;
+
+		Optimizer <double> *opt = new Adam <double> (0.01);
+
+		ThreadPool pool(1);
+		for (size_t e = 0; e < epochs; e++)
+			train_dataset_perf(dnn, ins, outs, batch, erf, opt, 0, pool);
+
+		delete opt;
+
+		return dnn;
+	};
+
+	auto difference = [&](DNN <double> &a, DNN <double> &b) {
+		double diff = 0;
+		for (size_t i = 0; i < a.size(); i++) {
+			diff = std::max(diff, max_difference(a.layers()[i].mat(),
+					b.layers()[i].mat()));
+		}
+
+		return diff;
+	};
+
+	struct {
+		size_t		workers;
+		size_t		batch;
+		dp_transport	transport;
+	} runs[] = {
+		{1, 12, DP_SharedMemory},
+		{2, 12, DP_SharedMemory},
+		{2, 12, DP_LocalSocket},
+		{3, 12, DP_SharedMemory},
+		{3, 12, DP_LocalSocket},
+		{3, 2, DP_SharedMemory},	// A worker has no samples
+		{3, 2, DP_LocalSocket}
+	};
+
+	DNN <double> ref12 = reference(12, 2);
+	DNN <double> ref2 = reference(2, 2);
+
+	std::vector <DNN <double>> trained;
+
+	bool ok = true;
+	for (auto &run : runs) {
+		DNN <double> dnn = model;
+
+		Optimizer <double> *opt = new Adam <double> (0.01);
+
+		DataParallelStatistics <double> stats = train_data_parallel(dnn,
+				ins, outs, run.batch, 2, erf, opt, run.workers,
+				run.transport);
+
+		delete opt;
+
+		double diff = difference(dnn, (run.batch == 12) ? ref12 : ref2);
+
+		oss << run.workers << " worker(s), batch " << run.batch
+			<< ((run.transport == DP_SharedMemory) ? ", shared memory: " : ", sockets: ")
+			<< stats._throughput << " samples/s, difference with one process = "
+			<< diff << ", replicas identical = " << stats._identical << endl;
+
+		ok &= (stats._identical && diff < 1e-10 && stats._samples == 120
+				&& stats._throughput > 0);
+
+		trained.push_back(dnn);
+	}
+
+	// With two workers, the sums of both transports are the same
+	double tdiff = difference(trained[1], trained[2]);
+
+	oss << "Difference between the transports: " << tdiff << endl;
+
+	// A worker killed by a signal stops the others instead of leaving them
+	// waiting at the barrier
+	bool stopped = false;
+
+	{
+		SharedRegion flag(sizeof(std::atomic <int>));
+
+		std::atomic <int> *fired = new (flag.data()) std::atomic <int> (0);
+
+		LethalMSE lethal(fired);
+
+		DNN <double> dnn = model;
+
+		Optimizer <double> *opt = new Adam <double> (0.01);
+
+		try {
+			train_data_parallel(dnn, ins, outs, 12, 2, &lethal, opt, 3);
+		} catch (const worker_error &) {
+			stopped = true;
+		}
+
+		delete opt;
+	}
+
+	oss << "Killed worker detected: " << stopped << endl;
+
+	delete erf;
+
+	return ok && tdiff == 0 && stopped;
+}
+
+TEST(dnn_profiler)
+{
+	DNN <double> model(16, {
+		Layer <double> (32, new ReLU <double> ()),
+		Layer <double> (16, new Sigmoid <double> ()),
+		Layer <double> (8, new Softmax <double> ())
+	});
+
+	DataSet <double> ins;
+	DataSet <double> outs;
+
+	for (size_t i = 0; i < 48; i++) {
+		ins.push_back(Vector <double> (16,
+			[&](size_t j) {
+				return sin(double(i * 16 + j));
+			}
+		));
+
+		outs.push_back(Vector <double> (8,
+			[&](size_t j) {
+				return double(i % 8 == j);
+			}
+		));
+	}
+
+	DNN <double> profiled = model;
+
+	Erf <double> *erf = new MSE <double> ();
+	Optimizer <double> *opt1 = new Adam <double> (0.01);
+	Optimizer <double> *opt2 = new Adam <double> (0.01);
+
+	ThreadPool pool(3);
+
+	Profiler prof(model.size());
+
+	Profiler::set_allocation_counter(thread_allocated_bytes);
+
+	// Nothing is recorded without a scope
+	PerformanceStatistics <double> s1 = train_dataset_perf(model, ins, outs,
+			16, erf, opt1, 0, pool);
+
+	PerformanceStatistics <double> s2 = train_dataset_perf(profiled, ins,
+			outs, 16, erf, opt2, 0, pool);
+
+	if (prof.total().calls) {
+		oss << "Recorded without being installed." << endl;
+
+		return false;
+	}
+
+	// Steady state epoch (the optimizers are sized by now)
+	train_dataset_perf(model, ins, outs, 16, erf, opt1, 0, pool);
+
+	{
+		Profiler::Scope scope(prof);
+
+		s2 = train_dataset_perf(profiled, ins, outs, 16, erf, opt2,
+				0, pool);
+	}
+
+	Profiler::set_allocation_counter(nullptr);
+
+	prof.print(oss);
+
+	oss << "Kernel time: " << s1._kernel_time << " us (unprofiled), "
+		<< s2._kernel_time << " us (profiled)" << endl;
+
+	bool recorded = true;
+	for (size_t i = 0; i < model.size(); i++) {
+		for (size_t p = 0; p < PROF_Phases; p++) {
+			ProfileRecord r = prof.get(i, (profile_phase) p);
+
+			recorded &= (r.calls > 0 && r.time > 0 && r.flops > 0);
+		}
+	}
+
+	// Three batches of 16, in three chunks each
+	double flops = 0;
+	for (size_t i = 0; i < model.size(); i++) {
+		const Matrix <double> &W = model.layers()[i].mat();
+
+		flops += 2.0 * 48 * W.get_rows() * W.get_cols();
+	}
+
+	double forward = prof.phase_total(PROF_Forward).flops;
+
+	oss << "Forward operations: " << forward << " (expected "
+		<< flops << ")" << endl;
+
+	// Profiling does not change the training
+	double diff = 0;
+	for (size_t i = 0; i < model.size(); i++) {
+		Matrix <double> d = model.layers()[i].mat()
+			- profiled.layers()[i].mat();
+
+		diff = std::max(diff, d.norm());
+	}
+
+	oss << "Difference between the weights: " << diff << endl;
+
+	delete erf;
+	delete opt1;
+	delete opt2;
+
+	return recorded && forward == flops && !prof.total().bytes
+		&& s1._kernel_time > 0 && s2._kernel_time > 0 && diff == 0;
+}
+
+TEST(dnn_checkpointing)
+{
+	DNN <double> model(16, {
+		Layer <double> (24, new Sigmoid <double> ()),
+		Layer <double> (24, new ReLU <double> ()),
+		Layer <double> (32, new Sigmoid <double> ()),
+		Layer <double> (24, new ReLU <double> ()),
+		Layer <double> (24, new Sigmoid <double> ()),
+		Layer <double> (16, new ReLU <double> ()),
+		Layer <double> (8, new Softmax <double> ())
+	});
+
+	DataSet <double> ins;
+	DataSet <double> outs;
+
+	for (size_t i = 0; i < 40; i++) {
+		ins.push_back(Vector <double> (16,
+			[&](size_t j) {
+				return sin(double(i * 16 + j));
+			}
+		));
+
+		outs.push_back(Vector <double> (8,
+			[&](size_t j) {
+				return double(i % 8 == j);
+			}
+		));
+	}
+
+	Erf <double> *erf = new MSE <double> ();
+
+	ThreadPool pool(3);
+
+	// The gradients are the same with any interval, for the whole batch
+	// and for a shorter one (in the first rows of the buffers)
+	DataSet <double> sins(ins.begin(), ins.begin() + 25);
+	DataSet <double> souts(outs.begin(), outs.begin() + 25);
+
+	Workspace <double> full(model, ins.size(), 3);
+
+	full.load(ins, outs);
+	Matrix <double> *Jf = workspace_gradient(model.layers(), full, erf, &pool);
+
+	vector <Matrix <double>> J(Jf, Jf + model.size());
+
+	full.load(sins, souts);
+	Jf = workspace_gradient(model.layers(), full, erf, &pool);
+
+	vector <Matrix <double>> Js(Jf, Jf + model.size());
+
+	// Nor do they allocate, on the pool or not, once the buffers are sized
+	vector <size_t *> counters = pool_counters(pool);
+
+	bool same = true;
+	bool none = true;
+	for (size_t k : {2, 3, 5, 7}) {
+		Workspace <double> ws(model, ins.size(), 3);
+
+		ws.set_checkpoint_interval(k);
+		ws.load(ins, outs);
+
+		// Sizes the derivative of the cost
+		workspace_gradient(model.layers(), ws, erf, &pool);
+
+		for (int step = 0; step < 4; step++) {
+			size_t before = pool_allocations(counters);
+
+			if (step == 2)
+				ws.load(sins, souts);
+
+			Matrix <double> *Jk = workspace_gradient(model.layers(), ws,
+					erf, (step % 2) ? nullptr : &pool);
+
+			none &= (pool_allocations(counters) == before);
+
+			for (size_t i = 0; i < model.size(); i++)
+				same &= (((step < 2) ? J : Js)[i] == Jk[i]);
+		}
+
+		oss << "Interval " << k << ": " << ws.bytes() << " bytes (every activation: "
+			<< full.bytes() << " bytes)" << endl;
+	}
+
+	// Checkpointed training gives the same network
+	DNN <double> checkpointed = model;
+
+	checkpointed.set_checkpoint_interval(3);
+
+	Optimizer <double> *opt1 = new Adam <double> (0.01);
+	Optimizer <double> *opt2 = new Adam <double> (0.01);
+
+	for (size_t e = 0; e < 2; e++) {
+		train_dataset_perf(model, ins, outs, 16, erf, opt1, 0, pool);
+		train_dataset_perf(checkpointed, ins, outs, 16, erf, opt2, 0, pool);
+	}
+
+	bool trained = true;
+	for (size_t i = 0; i < model.size(); i++)
+		trained &= (model.layers()[i].mat() == checkpointed.layers()[i].mat());
+
+	// A budget holds a larger batch with checkpoints
+	Workspace <double> ws(model, 0, 1);
+
+	size_t budget = 1 << 20;
+	size_t b1 = largest_batch(ws, budget);
+
+	ws.set_checkpoint_interval(3);
+
+	size_t b3 = largest_batch(ws, budget);
+
+	oss << "Largest batch in " << budget << " bytes: " << b1
+		<< " (every activation), " << b3 << " (interval 3)" << endl;
+
+	bool fits = (ws.bytes(b3) <= budget && ws.bytes(b3 + 1) > budget && b3 > b1);
+
+	std::vector <CheckpointCost> report = checkpoint_report(model, ins,
+			outs, erf, {0, 2, 3, 7});
+
+	for (const CheckpointCost &c : report) {
+		oss << "Interval " << c.interval << ": " << c.bytes << " bytes, "
+			<< c.time << " us per gradient, "
+			<< 100 * c.recomputed << "% of the products recomputed" << endl;
+	}
+
+	// Dropout cannot be recomputed
+	bool rejected = false;
+
+	DNN <double> dropout(16, {
+		Layer <double> (24, new Sigmoid <double> (),
+				RandomInitializer <double> (), 0.2),
+		Layer <double> (24, new ReLU <double> ()),
+		Layer <double> (8, new Softmax <double> ())
+	});
+
+	dropout.enable_dropout();
+	dropout.set_checkpoint_interval(2);
+
+	Workspace <double> dws(dropout, ins.size());
+	dws.load(ins, outs);
+
+	try {
+		workspace_gradient(dropout.layers(), dws, erf);
+	} catch (const bad_checkpointing &) {
+		rejected = true;
+	}
+
+	delete erf;
+	delete opt1;
+	delete opt2;
+
+	return same && none && trained && fits && rejected
+		&& report[2].bytes < report[0].bytes;
+}
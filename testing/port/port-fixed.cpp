@@ -0,0 +1,141 @@
+#include "port.hpp"
+
+// Everything on fixed size matrices can be evaluated at compile time
+static constexpr zhetapi::Mat3d rotation {
+	{0, -1, 0},
+	{1, 0, 0},
+	{0, 0, 1}
+};
+
+static_assert(zhetapi::determinant(rotation) == 1,
+		"Determinant is not a constant expression");
+static_assert((rotation * zhetapi::Vec3d {1, 0, 0}).y == 1,
+		"Product is not a constant expression");
+static_assert(rotation.transpose() * rotation == zhetapi::Mat3d::identity(),
+		"Transpose is not a constant expression");
+
+// Compares a fixed size matrix against a dynamic one
+template <class T, size_t R, size_t C>
+static bool same(const zhetapi::FixedMatrix <T, R, C> &a,
+		const zhetapi::Matrix <T> &b, T tolerance)
+{
+	for (size_t i = 0; i < R; i++) {
+		for (size_t j = 0; j < C; j++) {
+			if (fabs(a(i, j) - b[i][j]) > tolerance)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+template <size_t N>
+static bool check_inverse(ostringstream &oss)
+{
+	using namespace zhetapi;
+
+	FixedMatrix <double, N, N> A;
+	for (size_t i = 0; i < N; i++) {
+		for (size_t j = 0; j < N; j++)
+			A(i, j) = double((i * 7 + j * 3) % 11) - 5.0 + ((i == j) ? 9.0 : 0.0);
+	}
+
+	Matrix <double> M(N, N,
+		[&](size_t i, size_t j) {
+			return A(i, j);
+		}
+	);
+
+	double det = determinant(A);
+	if (fabs(det - M.determinant()) > 1e-8 * fabs(det)) {
+		oss << "Determinant of size " << N << " is incorrect: " << det
+			<< " vs. " << M.determinant() << endl;
+
+		return false;
+	}
+
+	if (!same(A * inverse(A), Matrix <double> (N, N,
+			[](size_t i, size_t j) {
+				return (i == j) ? 1.0 : 0.0;
+			}), 1e-10)) {
+		oss << "Inverse of size " << N << " is incorrect." << endl;
+
+		return false;
+	}
+
+	return true;
+}
+
+TEST(fixed_matrix)
+{
+	using namespace zhetapi;
+
+	// Products and transposes against dynamic matrices
+	FixedMatrix <double, 2, 3> A {
+		{1, 2, 3},
+		{4, 5, 6}
+	};
+
+	FixedMatrix <double, 3, 2> B = A.transpose() * 2.0;
+
+	Matrix <double> MA(2, 3,
+		[&](size_t i, size_t j) {
+			return A(i, j);
+		}
+	);
+
+	if (!same(A * B, MA * (MA.transpose() * 2.0), 0.0)) {
+		oss << "Product is incorrect." << endl;
+
+		return false;
+	}
+
+	Vec3d x {1, -1, 2};
+	FVec <double, 2> y = A * x;
+
+	if (y[0] != 5 || y[1] != 11 || A.row(1) != Vec3d {4, 5, 6}) {
+		oss << "Matrix-vector product is incorrect." << endl;
+
+		return false;
+	}
+
+	// Closed forms and elimination
+	if (!check_inverse <1> (oss)
+		|| !check_inverse <2> (oss)
+		|| !check_inverse <3> (oss)
+		|| !check_inverse <4> (oss)
+		|| !check_inverse <6> (oss))
+		return false;
+
+	// Repeated 3 x 3 products with fixed and dynamic matrices (timed with
+	// --bench)
+	const size_t iters = 100000;
+
+	Mat3d F = rotation;
+	Mat3d G = rotation;
+
+	tpoint start = clk.now();
+	for (size_t i = 0; i < iters; i++)
+		G = F * G;
+	double tfixed = chrono::duration <double> (clk.now() - start).count();
+
+	Matrix <double> D(3, 3,
+		[](size_t i, size_t j) {
+			return rotation(i, j);
+		}
+	);
+
+	Matrix <double> E = D;
+
+	start = clk.now();
+	for (size_t i = 0; i < iters; i++)
+		E = D * E;
+	double tdynamic = chrono::duration <double> (clk.now() - start).count();
+
+	if (benchmarks) {
+		oss << "Fixed 3 x 3 products: " << tfixed * 1e3 << " ms" << endl;
+		oss << "Dynamic 3 x 3 products: " << tdynamic * 1e3 << " ms" << endl;
+	}
+
+	return same(G, E, 0.0);
+}
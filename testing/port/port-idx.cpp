@@ -0,0 +1,107 @@
+#include "port.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+#include "../../engine/idx.hpp"
+
+using namespace zhetapi;
+
+// Writes an IDX file of unsigned bytes with the given dimensions
+static void write_idx(const char *path, const std::vector <size_t> &dims,
+		const std::vector <unsigned char> &bytes)
+{
+	std::ofstream fout(path, std::ios::binary);
+
+	fout.put(0).put(0).put(0x08).put(char(dims.size()));
+	for (size_t d : dims) {
+		for (int s = 24; s >= 0; s -= 8)
+			fout.put(char((d >> s) & 0xFF));
+	}
+
+	fout.write((const char *) bytes.data(), bytes.size());
+}
+
+TEST(idx_reader)
+{
+	const char *images = "port-idx-images.idx";
+	const char *labels = "port-idx-labels.idx";
+	const char *broken = "port-idx-broken.idx";
+	const char *empty = "port-idx-empty.idx";
+	const char *huge = "port-idx-huge.idx";
+
+	// Five 2 x 3 images, and their labels
+	std::vector <unsigned char> pixels(30);
+	for (size_t i = 0; i < pixels.size(); i++)
+		pixels[i] = (unsigned char) (i * 8);
+
+	write_idx(images, {5, 2, 3}, pixels);
+	write_idx(labels, {5}, {3, 0, 2, 1, 3});
+
+	// Truncated file
+	write_idx(broken, {5, 2, 3}, {1, 2, 3});
+
+	// Zero dimension, and dimensions whose product overflows
+	write_idx(empty, {5, 0, 3}, {});
+	write_idx(huge, {1, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF}, {1, 2, 3});
+
+	bool ok = true;
+
+	{
+		IDXFile imgs(images);
+		IDXFile lbls(labels);
+
+		oss << "Images: " << imgs.size() << " of " << imgs.dim_size(0)
+			<< " x " << imgs.dim_size(1) << endl;
+
+		ok &= (imgs.size() == 5 && imgs.dimensions() == 2
+			&& imgs.sample_size() == 6 && lbls.size() == 5
+			&& lbls.sample_size() == 1);
+
+		// Views point into the mapping
+		Tensor <unsigned char> view = imgs[2];
+		Tensor <unsigned char> expected({2, 3},
+			std::vector <unsigned char> (pixels.begin() + 12,
+				pixels.begin() + 18));
+
+		ok &= (view.sliced() && view.dimensions() == 2
+			&& view.dim_size(1) == 3 && view == expected);
+
+		// Converted and scaled batches
+		Matrix <double> X;
+		Matrix <float> Y;
+
+		imgs.convert(1, 4, X, 1.0/255);
+		lbls.one_hot(1, 4, 4, Y);
+
+		ok &= (X.get_rows() == 3 && X.get_cols() == 6
+			&& X[2][4] == pixels[3 * 6 + 4]/255.0);
+		ok &= (Y.get_rows() == 3 && Y[0][0] == 1 && Y[1][2] == 1
+			&& Y[2][1] == 1 && Y[2][0] == 0);
+
+		try {
+			imgs.convert(3, 6, X);
+
+			ok = false;
+		} catch (const IDXFile::bad_index &) {}
+	}
+
+	bool rejected = true;
+	for (const char *path : {broken, empty, huge}) {
+		try {
+			IDXFile bad(path);
+
+			rejected = false;
+		} catch (const IDXFile::bad_header &) {}
+	}
+
+	oss << "Invalid headers rejected: " << rejected << endl;
+
+	std::remove(images);
+	std::remove(labels);
+	std::remove(broken);
+	std::remove(empty);
+	std::remove(huge);
+
+	return ok && rejected;
+}
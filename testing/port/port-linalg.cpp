@@ -173,3 +173,160 @@ TEST(matrix_props)
 
 	return true;
 }
+
+TEST(lu_decomp)
+{
+	using namespace zhetapi;
+	using namespace zhetapi::linalg;
+
+	const size_t n = 50;
+
+	Matrix <double> A(n, n,
+		[](size_t i, size_t j) {
+			return (double) ((i * 37 + j * 11) % 17) - 8.0 + ((i == j) ? 20.0 : 0.0);
+		}
+	);
+
+	auto lu = lu_decompose(A);
+
+	oss << "Error (PLU) = " << (lu.product() - A).norm() << endl;
+	if ((lu.product() - A).norm() > 1e-10) {
+		oss << "Failure: A != PLU" << endl;
+
+		return false;
+	}
+
+	Matrix <double> L = lu.l();
+	Matrix <double> U = lu.u();
+
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < n; j++) {
+			if ((i < j && L[i][j] != 0) || (i > j && U[i][j] != 0)
+					|| (i == j && L[i][j] != 1)) {
+				oss << "Failure: L or U is not triangular" << endl;
+
+				return false;
+			}
+		}
+	}
+
+	Vector <double> b(n,
+		[](size_t i) {
+			return (double) i - 25.0;
+		}
+	);
+
+	Vector <double> x = solve(A, b);
+
+	double residual = (A * x - b).norm();
+
+	oss << "Residual = " << residual << endl;
+	if (residual > 1e-9) {
+		oss << "Failure: Ax != b" << endl;
+
+		return false;
+	}
+
+	// Same system, with the factorization computed above
+	Vector <double> y = lu.solve(b);
+
+	residual = (A * y - b).norm();
+
+	oss << "Residual (LU::solve) = " << residual << endl;
+	if (residual > 1e-9) {
+		oss << "Failure: Ay != b" << endl;
+
+		return false;
+	}
+
+	double error = (A * A.inverse() - Matrix <double> ::identity(n)).norm();
+
+	oss << "Error (A * A^-1) = " << error << endl;
+	if (error > 1e-9) {
+		oss << "Failure: A * A^-1 != I" << endl;
+
+		return false;
+	}
+
+	double det = A.determinant();
+	double rel = fabs(det - lu.determinant())/fabs(det);
+
+	oss << "det(A) = " << det << endl;
+	if (rel > 1e-12) {
+		oss << "Failure: inconsistent determinants" << endl;
+
+		return false;
+	}
+
+	// Timing (only with --bench)
+	if (benchmarks) {
+		Matrix <double> B(200, 200,
+			[](size_t i, size_t j) {
+				return (double) ((i * 7 + j * 13) % 29) + ((i == j) ? 50.0 : 0.0);
+			}
+		);
+
+		tpoint start = clk.now();
+		B.determinant();
+		double t = chrono::duration <double> (clk.now() - start).count();
+
+		oss << "Time for 200 x 200 determinant = " << t * 1000 << " ms" << endl;
+	}
+
+	return true;
+}
+
+TEST(lu_exact)
+{
+	using namespace zhetapi;
+	using namespace zhetapi::linalg;
+
+	Matrix <long long int> A {
+		{2, -1, 0, 3},
+		{1, 4, -2, 0},
+		{0, 5, 1, -1},
+		{3, 0, 2, 6}
+	};
+
+	// Computed by cofactor expansion
+	long long int det = 42;
+
+	oss << "A = " << A << endl;
+	oss << "det(A) = " << A.determinant() << endl;
+
+	if (A.determinant() != det) {
+		oss << "Failure: expected " << det << endl;
+
+		return false;
+	}
+
+	Matrix <long long int> adj = A.adjugate();
+	Matrix <long long int> I = Matrix <long long int> ::identity(4);
+
+	oss << "adj(A) = " << adj << endl;
+	if (A * adj != det * I) {
+		oss << "Failure: A * adj(A) != det(A) I" << endl;
+
+		return false;
+	}
+
+	// Rational solves are exact
+	using Q_t = Rational <int>;
+
+	Matrix <Q_t> Q {
+		{Q_t(2), Q_t(1)},
+		{Q_t(1), Q_t(3)}
+	};
+
+	Vector <Q_t> b {Q_t(1), Q_t(2)};
+	Vector <Q_t> x = solve(Q, b);
+
+	oss << "x = " << x << endl;
+	if (x[0] != Q_t(1, 5) || x[1] != Q_t(3, 5)) {
+		oss << "Failure: expected x = (1/5, 3/5)" << endl;
+
+		return false;
+	}
+
+	return true;
+}
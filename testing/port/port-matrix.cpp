@@ -1,5 +1,7 @@
 #include "port.hpp"
 
+#include "../../engine/core/kernels.hpp"
+
 TEST(matrix_construction_and_memory)
 {
 	using namespace zhetapi;
@@ -8,5 +10,463 @@ TEST(matrix_construction_and_memory)
 
 	oss << "Default constructor: " << tmp << endl;
 
+	// Rows can be dropped and restored in place, up to the rows which were
+	// allocated (also after a move)
+	Matrix <double> buf(8, 3, 1.0);
+
+	buf.set_rows(2);
+	buf.set_rows(8);
+
+	Matrix <double> moved = std::move(buf);
+
+	moved.set_rows(5);
+	moved.set_rows(8);
+
+	try {
+		moved.set_rows(9);
+
+		oss << "Rows set past the allocated components." << endl;
+
+		return false;
+	} catch (const Matrix <double> ::bad_rows &) {}
+
+	// Reallocating resets the capacity
+	moved.resize(2, 3);
+
+	try {
+		moved.set_rows(4);
+
+		oss << "Rows set past the components of a resized matrix." << endl;
+
+		return false;
+	} catch (const Matrix <double> ::bad_rows &) {}
+
+	return moved.get_rows() == 2;
+}
+
+template <class T>
+static bool check_product(ostringstream &oss, size_t m, size_t n, size_t k, T tolerance)
+{
+	using namespace zhetapi;
+
+	Matrix <T> A(m, k,
+		[](size_t i, size_t j) {
+			return T((i * 7 + j * 3) % 11) / T(5) - T(1);
+		}
+	);
+
+	Matrix <T> B(k, n,
+		[](size_t i, size_t j) {
+			return T((i * 5 + j * 2) % 13) / T(6) - T(1);
+		}
+	);
+
+	Matrix <T> C = A * B;
+
+	for (size_t i = 0; i < m; i++) {
+		for (size_t j = 0; j < n; j++) {
+			long double acc = 0;
+			for (size_t p = 0; p < k; p++)
+				acc += (long double) A[i][p] * B[p][j];
+
+			if (fabs(acc - C[i][j]) > tolerance) {
+				oss << "Mismatch for " << m << " x " << k << " times "
+					<< k << " x " << n << " at (" << i << ", "
+					<< j << "): " << C[i][j] << " vs. " << acc << endl;
+
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+TEST(matrix_multiplication)
+{
+	// Sizes that are not multiples of any block size
+	if (!check_product <double> (oss, 67, 91, 53, 1e-10))
+		return false;
+
+	if (!check_product <double> (oss, 131, 263, 301, 1e-10))
+		return false;
+
+	if (!check_product <float> (oss, 97, 145, 283, 1e-2))
+		return false;
+
+	// Generic types use the plain loop
+	if (!check_product <long double> (oss, 40, 40, 40, 1e-10))
+		return false;
+
+	return true;
+}
+
+// Checks C = alpha * op(A) * op(B) + beta * C against explicit transposes
+template <class T>
+static bool check_transposed(ostringstream &oss, size_t m, size_t n, size_t k,
+		zhetapi::blas::transpose_flag ta, zhetapi::blas::transpose_flag tb,
+		T tolerance)
+{
+	using namespace zhetapi;
+
+	bool at = (ta == blas::trans);
+	bool bt = (tb == blas::trans);
+
+	// Stored operands
+	Matrix <T> A(at ? k : m, at ? m : k,
+		[](size_t i, size_t j) {
+			return T((i * 7 + j * 3) % 11) / T(5) - T(1);
+		}
+	);
+
+	Matrix <T> B(bt ? n : k, bt ? k : n,
+		[](size_t i, size_t j) {
+			return T((i * 5 + j * 2) % 13) / T(6) - T(1);
+		}
+	);
+
+	Matrix <T> C(m, n, T(0.5));
+
+	Matrix <T> expected = T(2) * ((at ? A.transpose() : A) * (bt ? B.transpose() : B))
+		- T(3) * C;
+
+	blas::gemm(ta, tb, m, n, k,
+			T(2), A[0], A.get_cols(), B[0], B.get_cols(),
+			T(-3), C[0], n);
+
+	T error = (C - expected).norm();
+	if (error > tolerance) {
+		oss << "Mismatch for " << m << " x " << k << " times " << k
+			<< " x " << n << " (flags " << ta << ", " << tb
+			<< "): error = " << error << endl;
+
+		return false;
+	}
+
+	return true;
+}
+
+TEST(transposed_gemm)
+{
+	using namespace zhetapi;
+
+	blas::transpose_flag flags[] = {blas::no_trans, blas::trans};
+
+	for (auto ta : flags) {
+		for (auto tb : flags) {
+			// Simple loops and blocked kernels
+			if (!check_transposed <double> (oss, 7, 5, 9, ta, tb, 1e-10)
+				|| !check_transposed <double> (oss, 131, 97, 203, ta, tb, 1e-9)
+				|| !check_transposed <float> (oss, 67, 150, 90, ta, tb, 1e-2)
+				|| !check_transposed <long double> (oss, 20, 30, 10, ta, tb, 1e-10))
+				return false;
+		}
+	}
+
+	// Matrix-vector products
+	Matrix <double> M(40, 25,
+		[](size_t i, size_t j) {
+			return double((i * 3 + j) % 7) - 3;
+		}
+	);
+
+	Vector <double> x(40, 1.5);
+	Vector <double> y(25, 2.0);
+
+	Vector <double> expected = Vector <double> (M.transpose() * x) * 0.5 + y;
+
+	blas::gemv(blas::trans, 40, 25, 0.5, M[0], 25, &x[0], 1.0, &y[0]);
+
+	if ((y - expected).norm() > 1e-10) {
+		oss << "Transposed matrix-vector product is incorrect." << endl;
+
+		return false;
+	}
+
+	// Backpropagation kernel: M^T x without the bias component
+	Vector <double> u = rmt_and_mult(M, x);
+	Vector <double> full = M.transpose() * x;
+
+	for (size_t i = 0; i < u.size(); i++) {
+		if (u[i] != full[i + 1]) {
+			oss << "rmt_and_mult is incorrect at " << i << "." << endl;
+
+			return false;
+		}
+	}
+
+	// A^T * B with a transpose copy and with flags (timed with --bench)
+	const size_t n = 384;
+
+	Matrix <double> A(n, n, 1.5);
+	Matrix <double> B(n, n, 0.5);
+	Matrix <double> C(n, n);
+
+	tpoint start = clk.now();
+	Matrix <double> D = A.transpose() * B;
+	double copied = chrono::duration <double> (clk.now() - start).count();
+
+	start = clk.now();
+	blas::gemm(blas::trans, blas::no_trans, n, n, n,
+			1.0, A[0], n, B[0], n, 0.0, C[0], n);
+	double flagged = chrono::duration <double> (clk.now() - start).count();
+
+	if (benchmarks) {
+		oss << "A^T * B with a transpose (" << n << " x " << n << "): "
+			<< copied * 1e3 << " ms" << endl;
+		oss << "A^T * B with flags (" << n << " x " << n << "): "
+			<< flagged * 1e3 << " ms" << endl;
+	}
+
+	return C == D;
+}
+
+TEST(gemm_benchmark)
+{
+	using namespace zhetapi;
+
+	const size_t n = 512;
+	const double flops = 2.0 * n * n * n;
+
+	Matrix <double> A(n, n, 1.5);
+	Matrix <double> B(n, n, 0.5);
+	Matrix <double> C(n, n, 0.0);
+
+	tpoint start = clk.now();
+	blas::simple_gemm(n, n, n, A[0], n, B[0], n, C[0], n);
+	tpoint middle = clk.now();
+	Matrix <double> D = A * B;
+	tpoint end = clk.now();
+
+	if (benchmarks) {
+		double simple = chrono::duration <double> (middle - start).count();
+		double blocked = chrono::duration <double> (end - middle).count();
+
+		oss << "SIMD level: " << blas::simd_support() << endl;
+		oss << "Simple loop (" << n << " x " << n << "): "
+			<< flops / simple / 1e9 << " GFLOP/s" << endl;
+		oss << "Blocked kernel (" << n << " x " << n << "): "
+			<< flops / blocked / 1e9 << " GFLOP/s" << endl;
+	}
+
+	return D == C;
+}
+
+TEST(lazy_expressions)
+{
+	using namespace zhetapi;
+
+	const size_t n = 512;
+
+	Matrix <double> M(n, n,
+		[](size_t i, size_t j) {
+			return sin(i + 2.0 * j);
+		}
+	);
+
+	Matrix <double> J(n, n,
+		[](size_t i, size_t j) {
+			return cos(3.0 * i - j);
+		}
+	);
+
+	double beta = 0.9;
+
+	tpoint start = clk.now();
+	Matrix <double> eager = inv_shur(beta * M - (1 - beta) * J, shur(J, J) + M / 2.0);
+	tpoint middle = clk.now();
+	Matrix <double> fused = inv_shur(beta * lazy(M) - (1 - beta) * lazy(J),
+			shur(lazy(J), lazy(J)) + lazy(M) / 2.0);
+	tpoint end = clk.now();
+
+	if (benchmarks) {
+		double teager = chrono::duration <double> (middle - start).count();
+		double tlazy = chrono::duration <double> (end - middle).count();
+
+		oss << "Eager evaluation: " << teager * 1e3 << " ms" << endl;
+		oss << "Lazy evaluation: " << tlazy * 1e3 << " ms" << endl;
+	}
+
+	if (eager != fused) {
+		oss << "Lazy result differs from the eager result." << endl;
+
+		return false;
+	}
+
+	// Reductions
+	if ((lazy(M) - lazy(J)).norm() != (M - J).norm()) {
+		oss << "Lazy norm differs from the eager norm." << endl;
+
+		return false;
+	}
+
+	// Assigning to an operand of the expression
+	Matrix <double> expected = 2.0 * M - J;
+
+	M = 2.0 * lazy(M) - lazy(J);
+	if (M != expected) {
+		oss << "In place evaluation is incorrect." << endl;
+
+		return false;
+	}
+
+	Vector <double> v {1, 2, 3};
+	Vector <double> w = -lazy(v) + 1;
+
+	if (w[0] != 0 || w[1] != -1 || w[2] != -2) {
+		oss << "Vector evaluation is incorrect: " << w << endl;
+
+		return false;
+	}
+
+	return true;
+}
+
+TEST(matrix_views)
+{
+	using namespace zhetapi;
+
+	Matrix <double> A(6, 5,
+		[](size_t i, size_t j) {
+			return double(10 * i + j);
+		}
+	);
+
+	// Writes through a view reach the matrix
+	MatrixView <double> blk = A.block(1, 2, 3, 2);
+	blk(0, 0) = -1;
+
+	oss << "A = " << A << endl;
+	if (A[1][2] != -1 || blk(2, 1) != A[3][3]) {
+		oss << "Block does not refer to the matrix." << endl;
+
+		return false;
+	}
+
+	MatrixView <const double> col = A.column_view(4);
+	MatrixView <const double> tr = A.view().transpose();
+
+	if (col(5, 0) != A[5][4] || tr(4, 5) != A[5][4] || tr.contiguous()) {
+		oss << "Column or transpose views are incorrect." << endl;
+
+		return false;
+	}
+
+	Matrix <double> cblk(A.block(1, 2, 3, 2));
+	if (cblk != A.slice({1, 2}, {3, 3})
+			|| Matrix <double> (col) != Matrix <double> (A.get_column(4))) {
+		oss << "Slices and columns differ from their views." << endl;
+
+		return false;
+	}
+
+	// Products of (transposed and strided) views
+	Matrix <double> At = A.transpose();
+	if (tr * A.view() != At * A || A.block(0, 1, 6, 3).transpose() * A.block(0, 0, 6, 2)
+			!= At.slice({1, 0}, {3, 5}) * A.slice({0, 0}, {5, 1})) {
+		oss << "View products differ from matrix products." << endl;
+
+		return false;
+	}
+
+	// Row ranges (batches of rows)
+	MatrixView <double> batch = A.row_range(2, 5);
+	MatrixView <const double> inner = A.view().row_range(1, 3).row_range(1, 2);
+
+	if (batch.get_rows() != 3 || batch.data() != A[2] || !batch.contiguous()
+			|| inner.get_rows() != 1 || inner(0, 4) != A[2][4]
+			|| A.row_range(6, 6).size() != 0) {
+		oss << "Row ranges are incorrect." << endl;
+
+		return false;
+	}
+
+	int rejected = 0;
+
+	try {
+		A.row_range(4, 7);
+	} catch (const Matrix <double> ::dimension_mismatch &) {
+		rejected++;
+	}
+
+	try {
+		A.row_range(3, 2);
+	} catch (const Matrix <double> ::dimension_mismatch &) {
+		rejected++;
+	}
+
+	if (rejected != 2) {
+		oss << "Invalid row ranges were accepted." << endl;
+
+		return false;
+	}
+
+	Matrix <double> B(2, 5, 7.0);
+	Matrix <double> C = A.append_below(B);
+	Matrix <double> D = A.append_left(Matrix <double> (6, 1, 3.0));
+
+	if (C.get_rows() != 8 || C[7][4] != 7 || C[5][3] != A[5][3]
+			|| D.get_cols() != 6 || D[2][0] != 3 || D[2][1] != A[2][0]) {
+		oss << "Concatenation is incorrect." << endl;
+
+		return false;
+	}
+
+	// Indexing a tensor returns a sub-tensor which refers to it
+	Tensor <double> T({3, 4, 2}, 1.0);
+
+	Tensor <double> S = T[1];
+	S[{0, 0}] = 5.0;
+
+	Tensor <double> R = T[1];
+	Tensor <double> Q = T[2];
+
+	if (S.dimensions() != 2 || S.size() != 8 || !S.sliced()
+			|| R[{0, 0}] != 5.0 || Q[{0, 0}] != 1.0) {
+		oss << "Tensor index is not a sub-tensor." << endl;
+
+		return false;
+	}
+
+	// Read-only sub-tensors, and indices which are out of bounds
+	const Tensor <double> &CT = T;
+
+	Tensor <const double> CS = CT[1];
+
+	if (CS.dimensions() != 2 || CS.size() != 8 || !CS.sliced()
+			|| CS[{0, 0}] != 5.0 || CT[2][{1, 0}] != 1.0) {
+		oss << "Sub-tensor of a const tensor is incorrect." << endl;
+
+		return false;
+	}
+
+	Tensor <double> line(vector <size_t> {4}, 1.0);
+
+	rejected = 0;
+
+	try {
+		T[3];
+	} catch (const Tensor <double> ::index_out_of_bounds &) {
+		rejected++;
+	}
+
+	try {
+		CT[3];
+	} catch (const Tensor <double> ::index_out_of_bounds &) {
+		rejected++;
+	}
+
+	try {
+		line[0];
+	} catch (const Tensor <double> ::bad_dimensions &) {
+		rejected++;
+	}
+
+	if (rejected != 3) {
+		oss << "Invalid tensor indices were accepted." << endl;
+
+		return false;
+	}
+
 	return true;
 }
@@ -0,0 +1,417 @@
+#include "port.hpp"
+
+#include <atomic>
+#include <random>
+
+#include "../../engine/dnn.hpp"
+#include "../../engine/training.hpp"
+#include "../../engine/std/optimizers.hpp"
+
+// Allocation counting (per thread, since tests run concurrently)
+static thread_local size_t allocations = 0;
+static thread_local size_t allocated_bytes = 0;
+
+// The replacements allocate with malloc and release with free, which newer
+// versions of GCC take for a mismatch once they are inlined
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(size_t size)
+{
+	allocations++;
+	allocated_bytes += size;
+
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw bad_alloc();
+
+	return ptr;
+}
+
+void *operator new[](size_t size)
+{
+	allocations++;
+	allocated_bytes += size;
+
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw bad_alloc();
+
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+// Counters of the threads of a pool, including the caller (each thread runs
+// one of the tasks, since they wait for each other)
+vector <size_t *> pool_counters(zhetapi::ThreadPool &pool)
+{
+	vector <size_t *> counters(pool.size());
+
+	std::atomic <size_t> started(0);
+
+	pool.run(pool.size(),
+		[&](size_t i) {
+			counters[i] = &allocations;
+
+			started++;
+			while (started < counters.size())
+				std::this_thread::yield();
+		}
+	);
+
+	return counters;
+}
+
+size_t pool_allocations(const vector <size_t *> &counters)
+{
+	size_t total = 0;
+	for (size_t *c : counters)
+		total += *c;
+
+	return total;
+}
+
+// Bytes allocated by the calling thread (see Profiler::set_allocation_counter)
+size_t thread_allocated_bytes()
+{
+	return allocated_bytes;
+}
+
+TEST(tensor_move_semantics)
+{
+	using namespace zhetapi;
+
+	Matrix <double> A(64, 64, 1.0);
+	Matrix <double> B(64, 64, 2.0);
+
+	const double *buffer = A[0];
+
+	size_t before = allocations;
+	Matrix <double> C = std::move(A);
+	size_t moves = allocations - before;
+
+	oss << "Allocations for a move construction: " << moves << endl;
+	if (moves || C[0] != buffer) {
+		oss << "Move construction copied the components." << endl;
+
+		return false;
+	}
+
+	// Sums of temporaries should reuse the buffer of the temporary
+	before = allocations;
+	Matrix <double> D = (C + B) + B;
+	size_t chained = allocations - before;
+
+	oss << "Allocations for (C + B) + B: " << chained << endl;
+	if (chained > 2 || D[0][0] != 5.0) {
+		oss << "Redundant copies for a chain of sums." << endl;
+
+		return false;
+	}
+
+	// Slices must never be modified in place
+	double arr[4] {1, 2, 3, 4};
+
+	Vector <double> sum = Vector <double> (4, arr) + Vector <double> (4, 1.0);
+	if (arr[0] != 1 || sum[0] != 2) {
+		oss << "Slice was modified through an rvalue operation." << endl;
+
+		return false;
+	}
+
+	return true;
+}
+
+TEST(dnn_forward_allocations)
+{
+	using namespace zhetapi;
+	using namespace zhetapi::ml;
+
+	DNN <double> model(16, {
+		Layer <double> (32, new ReLU <double> ()),
+		Layer <double> (32, new ReLU <double> ()),
+		Layer <double> (8, new Sigmoid <double> ())
+	});
+
+	Vector <double> in(16, 0.5);
+
+	// Warm up
+	Vector <double> out = model(in);
+
+	size_t before = allocations;
+	out = model(in);
+	size_t count = allocations - before;
+
+	// Each layer should only allocate the (components and dimensions of
+	// the) linear output and the activation output
+	size_t expected = 4 * model.size();
+
+	oss << "Allocations for a forward pass: " << count
+		<< " (expected at most " << expected << ")" << endl;
+
+	// Const inference into a scratch does not allocate at all
+	Matrix <double> batch(10, 16, 0.25);
+	InferenceScratch <double> scratch;
+
+	model.infer(batch, scratch);
+
+	before = allocations;
+	model.infer(batch, scratch);
+	size_t icount = allocations - before;
+
+	oss << "Allocations for a batched inference: " << icount << endl;
+
+	return count <= expected && !icount;
+}
+
+TEST(lazy_expression_allocations)
+{
+	using namespace zhetapi;
+
+	Matrix <double> M(64, 64, 1.0);
+	Matrix <double> S(64, 64, 1.0);
+	Matrix <double> J(64, 64, 0.5);
+
+	size_t before = allocations;
+
+	M = 0.9 * lazy(M) - 0.1 * lazy(J);
+	S = 0.99 * lazy(S) + 0.01 * shur(lazy(J), lazy(J));
+	J = inv_shur(lazy(M), epow(lazy(S) + 1e-10, 0.5));
+
+	size_t count = allocations - before;
+
+	oss << "Allocations for a fused update: " << count << endl;
+
+	return count == 0;
+}
+
+TEST(dnn_training_allocations)
+{
+	using namespace zhetapi;
+	using namespace zhetapi::ml;
+
+	DNN <double> model(16, {
+		Layer <double> (32, new ReLU <double> ()),
+		Layer <double> (16, new Sigmoid <double> ()),
+		Layer <double> (8, new Softmax <double> ())
+	});
+
+	DataSet <double> ins;
+	DataSet <double> outs;
+
+	for (size_t i = 0; i < 24; i++) {
+		ins.push_back(Vector <double> (16,
+			[&](size_t j) {
+				return sin(double(i * 16 + j));
+			}
+		));
+
+		outs.push_back(Vector <double> (8,
+			[&](size_t j) {
+				return double(i % 8 == j);
+			}
+		));
+	}
+
+	Erf <double> *erf = new MSE <double> ();
+
+	// The gradients must match those of batch_gradient
+	Workspace <double> ws(model, ins.size());
+	Workspace <double> wsc(model, ins.size(), 3);
+
+	ThreadPool serial(1);
+	ThreadPool pool(3);
+
+	Matrix <double> *J = batch_gradient(model.layers(), model.size(),
+			model.Acache(), model.Zcache(), to_matrix(ins),
+			to_matrix(outs), erf);
+
+	// And so must those of a shorter batch, in the first rows of the
+	// buffers
+	DataSet <double> sins(ins.begin(), ins.begin() + 10);
+	DataSet <double> souts(outs.begin(), outs.begin() + 10);
+
+	Matrix <double> *Js = batch_gradient(model.layers(), model.size(),
+			model.Acache(), model.Zcache(), to_matrix(sins),
+			to_matrix(souts), erf);
+
+	for (int k = 0; k < 6; k++) {
+		Workspace <double> &w = (k % 3) ? wsc : ws;
+
+		if (k < 3)
+			w.load(ins, outs);
+		else
+			w.load(sins, souts);
+
+		Matrix <double> *Jw = workspace_gradient(model.layers(), w, erf,
+				(k % 3 == 2) ? &pool : &serial);
+
+		for (size_t i = 0; i < model.size(); i++) {
+			Matrix <double> diff = ((k < 3) ? J : Js)[i] - Jw[i];
+
+			if (diff.norm() > 1e-12) {
+				oss << "Workspace gradient differs for layer "
+					<< i << " (" << w.chunks() << " chunks, "
+					<< w.batch() << " samples)." << endl;
+
+				return false;
+			}
+		}
+	}
+
+	delete[] J;
+	delete[] Js;
+
+	// Steady state training steps
+	Optimizer <double> *opts[] = {
+		new SGD <double> (0.01),
+		new Momentum <double> (0.01),
+		new Adam <double> (0.01)
+	};
+
+	const char *names[] = {"SGD", "Momentum", "Adam"};
+
+	// Epochs in batches of 10, so that the last batch only has 4 samples
+	PackedDataSet <double> pins(ins);
+	PackedDataSet <double> pouts(outs);
+
+	const size_t batch = 10;
+	const size_t epochs = 3;
+
+	vector <size_t *> counters = pool_counters(pool);
+
+	bool none = true;
+	for (int k = 0; k < 6; k++) {
+		Optimizer <double> *opt = opts[k % 3];
+
+		auto epoch = [&]() {
+			for (size_t i = 0; i < ins.size(); i += batch) {
+				DataBatch <double> bi = pins.batch(i, i + batch);
+				DataBatch <double> bo = pouts.batch(i, i + batch);
+
+				if (k < 3)
+					fit(model, bi, bo, erf, opt, ws);
+				else
+					multithreaded_fit(model, bi, bo, erf, opt, wsc, pool);
+			}
+		};
+
+		// Warm up (sizes the optimizer state)
+		epoch();
+
+		size_t before = pool_allocations(counters);
+		for (size_t e = 0; e < epochs; e++)
+			epoch();
+
+		size_t count = pool_allocations(counters) - before;
+
+		oss << "Allocations for " << epochs << ((k < 3) ? " epochs (" : " chunked epochs (")
+			<< names[k % 3] << "): " << count << endl;
+
+		none &= !count;
+	}
+
+	// Epochs with statistics, which only allocate for the statistics of
+	// each sample when the workspace is kept across epochs
+	Workspace <double> wse(model, batch, pool.size());
+
+	train_dataset_perf(model, pins, pouts, batch, erf, opts[2], 0, pool, wse);
+
+	size_t before = pool_allocations(counters);
+	for (size_t e = 0; e < epochs; e++)
+		train_dataset_perf(model, pins, pouts, batch, erf, opts[2], 0, pool, wse);
+
+	size_t kept = pool_allocations(counters) - before;
+
+	before = pool_allocations(counters);
+	for (size_t e = 0; e < epochs; e++)
+		train_dataset_perf(model, pins, pouts, batch, erf, opts[2], 0, pool);
+
+	size_t fresh = pool_allocations(counters) - before;
+
+	oss << "Allocations for " << epochs << " epochs with statistics: "
+		<< kept << " (" << fresh << " with a workspace per epoch)" << endl;
+
+	none &= (kept < fresh);
+
+	delete erf;
+	for (Optimizer <double> *opt : opts)
+		delete opt;
+
+	return none;
+}
+
+TEST(packed_dataset_allocations)
+{
+	using namespace zhetapi;
+	using namespace zhetapi::ml;
+
+	DataSet <double> ins;
+	DataSet <double> outs;
+
+	for (size_t i = 0; i < 200; i++) {
+		ins.push_back(Vector <double> (32, double(i % 7) / 7.0));
+		outs.push_back(Vector <double> (4, double(i % 4 == 0)));
+	}
+
+	PackedDataSet <double> pins(ins);
+	PackedDataSet <double> pouts(outs);
+
+	DNN <double> model(32, {
+		Layer <double> (16, new Sigmoid <double> ()),
+		Layer <double> (4, new Softmax <double> ())
+	});
+
+	Erf <double> *erf = new MSE <double> ();
+	Optimizer <double> *opt = new SGD <double> (0.01);
+
+	ThreadPool pool(1);
+
+	std::mt19937 gen(5);
+
+	// Warm up
+	train_dataset_perf(model, ins, outs, 20, erf, opt, 0, pool);
+	train_dataset_perf(model, pins, pouts, 20, erf, opt, 0, pool);
+
+	size_t before = allocations;
+	train_dataset_perf(model, ins, outs, 20, erf, opt, 0, pool);
+	size_t vcount = allocations - before;
+
+	before = allocations;
+	shuffle(pins, pouts, gen);
+	train_dataset_perf(model, pins, pouts, 20, erf, opt, 0, pool);
+	size_t pcount = allocations - before;
+
+	oss << "Allocations for an epoch (vectors): " << vcount << endl;
+	oss << "Allocations for an epoch (packed): " << pcount << endl;
+
+	delete erf;
+	delete opt;
+
+	return pcount < vcount;
+}
@@ -0,0 +1,114 @@
+#include "port.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+#include "../../engine/dnn.hpp"
+
+using namespace zhetapi;
+using namespace zhetapi::ml;
+
+TEST(dnn_model_file)
+{
+	const char *file = "zhp_dnn_model.bin";
+
+	DNN <double> model(6, {
+		Layer <double> (9, new Sigmoid <double> ()),
+		Layer <double> (7, new ReLU <double> ()),
+		Layer <double> (3, new Softmax <double> ())
+	});
+
+	model.save_model(file);
+
+	Matrix <double> X(5, 6,
+		[](size_t i, size_t j) {
+			return sin(double(i * 6 + j));
+		}
+	);
+
+	bool ok = true;
+
+	{
+		ModelFile mf(file, true);
+
+		DNN <double> loaded;
+		loaded.load_model(mf);
+
+		// The weights are used in place, and aligned
+		for (size_t i = 0; i < loaded.size(); i++) {
+			const double *w = loaded.layers()[i].mat()[0];
+
+			ok &= (w == (const double *) mf.at(mf.layer(i).weights));
+			ok &= ((uintptr_t) w % ModelFile::alignment == 0);
+		}
+
+		double diff = max_difference(model.infer(X), loaded.infer(X));
+
+		oss << "Difference between the outputs: " << diff << endl;
+
+		ok &= (diff == 0 && loaded.input_size() == 6
+			&& loaded.output_size() == 3);
+
+		// Copies own their weights, and updates do not change the file
+		DNN <double> copy = loaded;
+
+		ok &= (copy.layers()[0].mat()[0] != loaded.layers()[0].mat()[0]);
+
+		loaded.layers()[0].mat()[0][0] += 1;
+
+		ok &= (max_difference(model.infer(X), copy.infer(X)) == 0);
+	}
+
+	ModelFile unchanged(file, true);
+
+	// Corruptions are detected
+	{
+		std::fstream fio(file, std::ios::binary | std::ios::in | std::ios::out);
+
+		fio.seekp(unchanged.layer(1).weights + 3);
+		fio.put(0x55);
+	}
+
+	bool detected = false;
+	try {
+		ModelFile corrupted(file, true);
+	} catch (const ModelFile::bad_checksum &) {
+		detected = true;
+	}
+
+	// Activation record whose name is longer than the record
+	{
+		std::fstream fio(file, std::ios::binary | std::ios::in | std::ios::out);
+
+		fio.seekp(unchanged.layer(0).activation);
+		for (size_t i = 0; i < sizeof(size_t); i++)
+			fio.put(char(0x7F));
+	}
+
+	try {
+		ModelFile corrupted(file);
+
+		DNN <double> bad;
+		bad.load_model(corrupted);
+
+		detected = false;
+	} catch (const Activation <double> ::bad_record &) {}
+
+	{
+		std::fstream fio(file, std::ios::binary | std::ios::in | std::ios::out);
+
+		fio.put('X');
+	}
+
+	try {
+		ModelFile corrupted(file);
+
+		detected = false;
+	} catch (const ModelFile::bad_header &) {}
+
+	oss << "Corruption detected: " << detected << endl;
+
+	remove(file);
+
+	return ok && detected;
+}
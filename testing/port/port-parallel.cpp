@@ -0,0 +1,96 @@
+#include "port.hpp"
+
+TEST(parallel_kernels)
+{
+	using namespace zhetapi;
+
+	Matrix <double> A(300, 200,
+		[](size_t i, size_t j) {
+			return double((i * 7 + j) % 13) - 6;
+		}
+	);
+
+	Matrix <double> B(200, 170,
+		[](size_t i, size_t j) {
+			return double((i + 3 * j) % 5) - 2;
+		}
+	);
+
+	Matrix <double> C(300, 200, 0.5);
+
+	// The thread counts are given for each call, since the global setting
+	// is shared with the tests running concurrently
+	Matrix <double> P1(300, 170, 0.0);
+	Matrix <double> P4(300, 170, 0.0);
+
+	tpoint start = clk.now();
+	blas::gemm(300, 170, 200, A[0], 200, B[0], 170, P1[0], 170, 1);
+	tpoint middle = clk.now();
+	blas::gemm(300, 170, 200, A[0], 200, B[0], 170, P4[0], 170, 4);
+	tpoint end = clk.now();
+
+	if (benchmarks) {
+		double serial = chrono::duration <double> (middle - start).count();
+		double multi = chrono::duration <double> (end - middle).count();
+
+		oss << "Product with 1 thread: " << serial * 1e3 << " ms" << endl;
+		oss << "Product with 4 threads: " << multi * 1e3 << " ms" << endl;
+	}
+
+	// Elementwise operations, with the global setting and in blocks
+	Matrix <double> S = shur(A, C) + A * 2.0 - C;
+	Matrix <double> S4(300, 200, 0.0);
+
+	parallel::for_range(S4.size(), parallel::get_threshold(),
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				S4[0][i] = A[0][i] * C[0][i] + A[0][i] * 2.0 - C[0][i];
+		}, 4
+	);
+
+	if (P1 != P4 || P1 != A * B || S != S4) {
+		oss << "Parallel results differ from serial results." << endl;
+
+		return false;
+	}
+
+	// Every index must be visited exactly once
+	vector <int> visits(1000, 0);
+
+	parallel::for_range(visits.size(), parallel::get_threshold(),
+		[&](size_t start, size_t end) {
+			for (size_t i = start; i < end; i++)
+				visits[i]++;
+		}, 7
+	);
+
+	for (int v : visits) {
+		if (v != 1) {
+			oss << "Index visited " << v << " times." << endl;
+
+			return false;
+		}
+	}
+
+	// Exceptions thrown by workers reach the caller
+	bool caught = false;
+
+	try {
+		parallel::for_range(16, parallel::get_threshold(),
+			[&](size_t start, size_t end) {
+				if (end == 16)
+					throw std::runtime_error("last block");
+			}, 4
+		);
+	} catch (const std::runtime_error &) {
+		caught = true;
+	}
+
+	if (!caught) {
+		oss << "Exception was not propagated." << endl;
+
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,152 @@
+#include "port.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+#include "../../engine/quantized.hpp"
+
+using namespace zhetapi;
+using namespace zhetapi::ml;
+
+// Whether the largest output is at the position of the expected class
+static bool same_class(const Vector <double> &a, const Vector <double> &e)
+{
+	size_t k = 0;
+	for (size_t i = 1; i < a.size(); i++) {
+		if (a[i] > a[k])
+			k = i;
+	}
+
+	return e[k] == 1;
+}
+
+TEST(dnn_quantized)
+{
+	// The integer kernels are exact, including the leftover components
+	std::mt19937 gen(5);
+	std::uniform_int_distribution <int> byte(-127, 127);
+
+	std::vector <int8_t> a(100);
+	std::vector <int8_t> b(100);
+	for (size_t i = 0; i < a.size(); i++) {
+		a[i] = byte(gen);
+		b[i] = byte(gen);
+	}
+
+	bool exact = true;
+	for (size_t k = 0; k <= a.size(); k += 7)
+		exact &= (blas::dot_s8(a.data(), b.data(), k) == blas::dot_s8_scalar(a.data(), b.data(), k));
+
+	if (!exact) {
+		oss << "Integer dot products differ from the scalar kernel." << endl;
+
+		return false;
+	}
+
+	DNN <double> model(16, {
+		Layer <double> (32, new ReLU <double> ()),
+		Layer <double> (24, new Sigmoid <double> ()),
+		Layer <double> (4, new Softmax <double> ())
+	});
+
+	DataSet <double> ins;
+	DataSet <double> outs;
+
+	for (size_t i = 0; i < 200; i++) {
+		ins.push_back(Vector <double> (16,
+			[&](size_t j) {
+				return sin(double(i * 16 + j));
+			}
+		));
+
+		// The class predicted by the network, as a one-hot vector
+		Vector <double> out = model(ins[i]);
+
+		size_t k = 0;
+		for (size_t j = 1; j < 4; j++) {
+			if (out[j] > out[k])
+				k = j;
+		}
+
+		outs.push_back(Vector <double> (4,
+			[&](size_t j) {
+				return double(j == k);
+			}
+		));
+	}
+
+	// Calibrate on part of the data
+	DataSet <double> calibration(ins.begin(), ins.begin() + 50);
+
+	QuantizedDNN <double> quantized(model, calibration);
+
+	QuantizationError <double> err = quantization_error(model, quantized,
+			ins, outs, same_class);
+
+	oss << "Maximum error: " << err.max_error << ", mean error: " << err.mean_error << endl;
+	oss << "Passed: " << err.passed << " (float), " << err.quantized_passed << " (int8)" << endl;
+
+	size_t fbytes = 0;
+	for (size_t i = 0; i < model.size(); i++)
+		fbytes += sizeof(double) * model.layers()[i].mat().size();
+
+	oss << "Parameters: " << fbytes << " bytes (float), " << quantized.bytes() << " bytes (int8)" << endl;
+
+	// The compact form gives the same network
+	const char *file = "zhp_dnn_quantized.bin";
+
+	quantized.save(file);
+
+	QuantizedDNN <double> loaded;
+	loaded.load(file);
+
+	// Truncated files, and a layer larger than the file, are rejected
+	std::vector <char> bytes;
+
+	{
+		std::ifstream fin(file, std::ios::binary);
+
+		bytes.assign(std::istreambuf_iterator <char> (fin),
+				std::istreambuf_iterator <char> ());
+	}
+
+	size_t rejected = 0;
+	for (size_t k = 0; k < 3; k++) {
+		std::vector <char> bad = bytes;
+
+		if (k < 2) {
+			bad.resize(k ? bad.size() - 1 : 40);
+		} else {
+			uint64_t rows = 1ULL << 31;
+			memcpy(&bad[32], &rows, sizeof(rows));
+		}
+
+		std::ofstream(file, std::ios::binary).write(bad.data(), bad.size());
+
+		try {
+			QuantizedDNN <double> broken;
+			broken.load(file);
+		} catch (const QuantizedDNN <double> ::bad_file &) {
+			rejected++;
+		}
+	}
+
+	remove(file);
+
+	Matrix <double> Q = quantized.infer(to_matrix(ins));
+
+	double diff = max_difference(Q, loaded.infer(to_matrix(ins)));
+
+	Vector <double> q = quantized.infer(ins[3]);
+
+	bool same = true;
+	for (size_t j = 0; j < q.size(); j++)
+		same &= (q[j] == Q[3][j]);
+
+	oss << "Corrupt files rejected: " << rejected << "/3" << endl;
+
+	return err.max_error < 0.05 && err.quantized_passed >= 190
+		&& quantized.bytes() * 5 < fbytes && diff == 0 && same
+		&& rejected == 3;
+}
@@ -0,0 +1,147 @@
+#include "port.hpp"
+
+// Deterministic matrix with roughly the given fraction of nonzeros
+static zhetapi::Matrix <double> sparse_pattern(size_t rs, size_t cs, double density)
+{
+	size_t period = max(size_t(1.0/density), size_t(1));
+
+	return zhetapi::Matrix <double> (rs, cs,
+		[&](size_t i, size_t j) {
+			size_t h = (i * 7919 + j * 104729 + i * j) % period;
+
+			return (h == 0) ? double((i + 2 * j) % 9) - 4.0 : 0.0;
+		}
+	);
+}
+
+TEST(sparse_products)
+{
+	using namespace zhetapi;
+
+	Matrix <double> A = sparse_pattern(120, 90, 0.1);
+	Matrix <double> B = sparse_pattern(90, 70, 0.1);
+
+	SparseMatrix <double> SA(A);
+	SparseMatrix <double> SB(B);
+
+	oss << "Nonzeros of A: " << SA.nonzeros() << " (density "
+		<< SA.density() << ")" << endl;
+
+	if (SA.dense() != A || SA.transpose().dense() != A.transpose()) {
+		oss << "Compression is not lossless." << endl;
+
+		return false;
+	}
+
+	if (SA(3, 4) != A[3][4] || SA(119, 89) != A[119][89]) {
+		oss << "Indexing is incorrect." << endl;
+
+		return false;
+	}
+
+	Vector <double> x(90,
+		[](size_t i) {
+			return double(i % 5) - 2.0;
+		}
+	);
+
+	Matrix <double> D(70, 30, 1.5);
+
+	// Components are small integers, so all products are exact
+	if (SA * x != Vector <double> (A * x)) {
+		oss << "SpMV differs from the dense product." << endl;
+
+		return false;
+	}
+
+	if (SA * B != A * B || A.transpose() * SA != A.transpose() * A) {
+		oss << "SpMM differs from the dense product." << endl;
+
+		return false;
+	}
+
+	SparseMatrix <double> SC = SA * SB;
+
+	oss << "Nonzeros of AB: " << SC.nonzeros() << endl;
+	if (SC.dense() != A * B || SC * D != (A * B) * D) {
+		oss << "SpGEMM differs from the dense product." << endl;
+
+		return false;
+	}
+
+	for (size_t i = 0; i < SC.get_rows(); i++) {
+		const vector <size_t> &off = SC.offsets();
+
+		if (!is_sorted(SC.indices().begin() + off[i],
+				SC.indices().begin() + off[i + 1])) {
+			oss << "Columns of SpGEMM row " << i << " are not sorted." << endl;
+
+			return false;
+		}
+	}
+
+	// Compressed arrays with unsorted or out of range columns
+	size_t rejected = 0;
+
+	for (vector <size_t> cols : {vector <size_t> {2, 1}, vector <size_t> {0, 3}}) {
+		try {
+			SparseMatrix <double> S(1, 3, {0, 2}, cols, {1.0, 2.0});
+		} catch (const SparseMatrix <double> ::bad_indices &) {
+			rejected++;
+		}
+	}
+
+	if (rejected != 2) {
+		oss << "Invalid column indices were accepted." << endl;
+
+		return false;
+	}
+
+	return true;
+}
+
+TEST(sparse_benchmark)
+{
+	using namespace zhetapi;
+
+	const size_t n = 1000;
+
+	Vector <double> x(n, 1.0);
+	Matrix <double> B(n, 64, 1.0);
+
+	for (double density : {0.1, 0.01, 0.001}) {
+		Matrix <double> A = sparse_pattern(n, n, density);
+		SparseMatrix <double> S(A);
+
+		tpoint t0 = clk.now();
+		Matrix <double> dv = A * x;
+		tpoint t1 = clk.now();
+		Vector <double> sv = S * x;
+		tpoint t2 = clk.now();
+		Matrix <double> dm = A * B;
+		tpoint t3 = clk.now();
+		Matrix <double> sm = S * B;
+		tpoint t4 = clk.now();
+
+		if (benchmarks) {
+			double tdv = chrono::duration <double> (t1 - t0).count();
+			double tsv = chrono::duration <double> (t2 - t1).count();
+			double tdm = chrono::duration <double> (t3 - t2).count();
+			double tsm = chrono::duration <double> (t4 - t3).count();
+
+			oss << "Density " << S.density() << ":" << endl;
+			oss << "\tMatrix-vector: dense " << tdv * 1e3 << " ms, sparse "
+				<< tsv * 1e3 << " ms" << endl;
+			oss << "\tMatrix-matrix (" << n << " x 64): dense " << tdm * 1e3
+				<< " ms, sparse " << tsm * 1e3 << " ms" << endl;
+		}
+
+		if (Vector <double> (dv) != sv || dm != sm) {
+			oss << "Sparse and dense products differ." << endl;
+
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -12,7 +12,37 @@ vector <singlet> rig {
 	RIG(gamma_and_factorial),
 	RIG(vector_construction_and_memory),
 	RIG(matrix_construction_and_memory),
+	RIG(matrix_multiplication),
+	RIG(transposed_gemm),
+	RIG(gemm_benchmark),
+	RIG(lazy_expressions),
+	RIG(matrix_views),
+	RIG(fixed_matrix),
+	RIG(parallel_kernels),
+	RIG(conv_kernels),
+	RIG(conv_filter),
+	RIG(sparse_products),
+	RIG(sparse_benchmark),
 	RIG(tensor_construction_and_memory),
+	RIG(tensor_move_semantics),
+	RIG(dnn_forward_allocations),
+	RIG(dnn_training_allocations),
+	RIG(packed_dataset_allocations),
+	RIG(dnn_precision),
+	RIG(dnn_batched),
+	RIG(dnn_multithreaded),
+	RIG(dnn_concurrent_inference),
+	RIG(dnn_softmax_cross_entropy),
+	RIG(dnn_packed_dataset),
+	RIG(dnn_prefetcher),
+	RIG(idx_reader),
+	RIG(dnn_model_file),
+	RIG(dnn_quantized),
+	RIG(dnn_data_parallel),
+	RIG(dnn_profiler),
+	RIG(dnn_checkpointing),
+	RIG(optimizer_fused),
+	RIG(lazy_expression_allocations),
 	RIG(integration),
 	RIG(function_computation),
 	RIG(vector_operations),
@@ -23,6 +53,8 @@ vector <singlet> rig {
 	RIG(lq_decomp),
 	RIG(qr_alg),
 	RIG(matrix_props),
+	RIG(lu_decomp),
+	RIG(lu_exact),
 	RIG(fourier_series),
 	RIG(polynomial_construction),
 	RIG(polynomial_comparison),
@@ -31,6 +63,8 @@ vector <singlet> rig {
 	RIG(act_relu),
 	RIG(act_leaky_relu),
 	RIG(act_sigmoid),
+	RIG(act_tanh),
+	RIG(act_batched),
 	RIG(module_construction),
 	RIG(parsing_global_assignment),
 	RIG(parsing_global_branching),
@@ -54,9 +88,21 @@ void segfault_sigaction(int signal, siginfo_t *si, void *arg)
 // Timers
 tclk clk;
 
+bool benchmarks = false;
+
 // Main program
-int main()
+int main(int argc, char *argv[])
 {
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--bench")) {
+			benchmarks = true;
+		} else {
+			cout << "Usage: " << argv[0] << " [--bench]" << endl;
+
+			return 1;
+		}
+	}
+
 #ifdef HANDLE_SEGFAULT
 
 	// Setup segfault handler
@@ -73,6 +119,11 @@ int main()
 
 #endif
 
+	// Register the activation loaders (used to read saved networks) before
+	// the tests run concurrently, since the registries are not synchronized
+	zhetapi::ml::ZhetapiInit <double> ();
+	zhetapi::ml::ZhetapiInit <float> ();
+
 	// Setup times
 	tpoint epoch = clk.now();
 
@@ -16,11 +16,15 @@
 // Engine headers
 #include "../../engine/all/zhplib.hpp"
 
+#include "../../engine/core/conv.hpp"
+#include "../../engine/fixed_matrix.hpp"
 #include "../../engine/fourier.hpp"
 #include "../../engine/linalg.hpp"
 #include "../../engine/matrix.hpp"
 #include "../../engine/module.hpp"
 #include "../../engine/polynomial.hpp"
+#include "../../engine/rational.hpp"
+#include "../../engine/sparse.hpp"
 #include "../../engine/tensor.hpp"
 #include "../../engine/token.hpp"
 #include "../../engine/vector.hpp"
@@ -54,6 +58,9 @@ using tpoint = chrono::high_resolution_clock::time_point;
 extern tclk clk;
 extern tpoint tmp;
 
+// Whether the timings of the tests are measured and printed (with --bench)
+extern bool benchmarks;
+
 // Bench marking structures
 struct bench {
 	tpoint epoch;
@@ -86,6 +93,24 @@ extern term_err err;
 ostream &operator<<(ostream &, const term_ok &);
 ostream &operator<<(ostream &, const term_err &);
 
+// Allocation counters of the tests (see port-memory.cpp)
+vector <size_t *> pool_counters(zhetapi::ThreadPool &);
+size_t pool_allocations(const vector <size_t *> &);
+size_t thread_allocated_bytes();
+
+// Largest absolute difference between the components of two matrices
+template <class T>
+static T max_difference(const zhetapi::Matrix <T> &A, const zhetapi::Matrix <T> &B)
+{
+	T diff = 0;
+	for (size_t i = 0; i < A.get_rows(); i++) {
+		for (size_t j = 0; j < A.get_cols(); j++)
+			diff = max(diff, T(fabs(A[i][j] - B[i][j])));
+	}
+
+	return diff;
+}
+
 // Test functions
 TEST(gamma_and_factorial);
 
@@ -93,8 +118,47 @@ TEST(vector_construction_and_memory);
 TEST(vector_operations);
 
 TEST(matrix_construction_and_memory);
+TEST(matrix_multiplication);
+TEST(transposed_gemm);
+TEST(gemm_benchmark);
+TEST(lazy_expressions);
+TEST(matrix_views);
+
+TEST(fixed_matrix);
+
+TEST(parallel_kernels);
+
+TEST(conv_kernels);
+TEST(conv_filter);
+
+TEST(sparse_products);
+TEST(sparse_benchmark);
+
 TEST(tensor_construction_and_memory);
 
+TEST(tensor_move_semantics);
+TEST(dnn_forward_allocations);
+TEST(dnn_training_allocations);
+TEST(packed_dataset_allocations);
+TEST(dnn_precision);
+TEST(dnn_batched);
+TEST(dnn_multithreaded);
+TEST(dnn_concurrent_inference);
+TEST(dnn_softmax_cross_entropy);
+TEST(dnn_packed_dataset);
+TEST(dnn_prefetcher);
+TEST(dnn_data_parallel);
+TEST(dnn_profiler);
+TEST(dnn_checkpointing);
+TEST(optimizer_fused);
+TEST(lazy_expression_allocations);
+
+TEST(idx_reader);
+
+TEST(dnn_model_file);
+
+TEST(dnn_quantized);
+
 TEST(integration);
 
 TEST(function_computation);
@@ -107,6 +171,8 @@ TEST(qr_decomp);
 TEST(lq_decomp);
 TEST(qr_alg);
 TEST(matrix_props);
+TEST(lu_decomp);
+TEST(lu_exact);
 
 TEST(fourier_series);
 
@@ -118,6 +184,8 @@ TEST(act_linear);
 TEST(act_relu);
 TEST(act_leaky_relu);
 TEST(act_sigmoid);
+TEST(act_tanh);
+TEST(act_batched);
 
 TEST(module_construction);
 